@@ -0,0 +1,257 @@
+////////////////////////////////////////////////////////////////
+//
+//    FreeLing - Open Source Language Analyzers
+//
+//    Copyright (C) 2004   TALP Research Center
+//                         Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public
+//    License as published by the Free Software Foundation; either
+//    version 3 of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@lsi.upc.es)
+//             TALP Research Center
+//             despatx C6.212 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _CACHED_ANALYZER
+#define _CACHED_ANALYZER
+
+#include <vector>
+#include <list>
+#include <map>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "freeling/version.h"
+#include "freeling/morfo/language.h"
+#include "freeling/morfo/tokenizer.h"
+#include "freeling/morfo/splitter.h"
+#include "freeling/morfo/processor.h"
+
+namespace freeling {
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Class cached_analyzer analyzes short texts (e.g. voice
+  ///  commands) with a tokenizer, a splitter and a chain of
+  ///  processors, and remembers the results of the most recent
+  ///  distinct texts, so a repeated text is not analyzed again:
+  ///
+  ///     cached_analyzer ca(tk, sp, 1000, L"es-tagger-v2");
+  ///     ca.add_stage(morfo); ca.add_stage(tagger);
+  ///     boost::shared_ptr<const std::list<sentence> > ls = ca.analyze(text);
+  ///
+  ///  Texts are normalized before lookup: leading and trailing
+  ///  whitespace is removed and inner runs of whitespace become
+  ///  one space. The normalized text is what gets analyzed, so
+  ///  word spans refer to it. The cache key also includes the
+  ///  given configuration string and the FreeLing version, so
+  ///  caches of differently configured analyzers never mix.
+  ///
+  ///  Results are shared between all callers asking for the same
+  ///  text and must not be modified; copy them to change them.
+  ///  The least recently used result is dropped when the cache is
+  ///  full. analyze() may be called from several threads; the
+  ///  splitter, which keeps state, is used by one at a time.
+  ///  Processors are used through their const methods and are
+  ///  not owned.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  class cached_analyzer {
+  public:
+    typedef boost::shared_ptr<const std::list<sentence> > result;
+
+    /// constructor. Capacity 0 disables caching
+    cached_analyzer(const tokenizer &, splitter &, size_t capacity,
+                    const std::wstring &config=L"");
+
+    /// append a processor to the chain. Must be called before the first analyze()
+    void add_stage(const processor &);
+
+    /// analyze a text, or get the cached analysis of the same text
+    result analyze(const std::wstring &);
+
+    /// number of cached results
+    size_t size() const;
+    /// number of analyze() calls answered from the cache
+    unsigned long hits() const;
+    /// number of analyze() calls that ran the analyzers
+    unsigned long misses() const;
+    /// drop all cached results
+    void clear();
+
+  private:
+    const tokenizer &tk;
+    splitter &sp;
+    size_t capacity;
+    /// key prefix: configuration and version
+    std::wstring prefix;
+    std::vector<const processor*> procs;
+
+    /// cached results, most recently used first
+    typedef std::list<std::pair<std::wstring,result> > lru_list;
+    lru_list lru;
+    std::map<std::wstring, lru_list::iterator> index;
+    unsigned long n_hits, n_misses;
+
+    mutable boost::mutex mtx;
+    boost::mutex split_mtx;
+
+    /// collapse and trim whitespace
+    static std::wstring normalize(const std::wstring &);
+    /// run tokenizer, splitter and processors
+    result run(const std::wstring &);
+
+    /// not copyable
+    cached_analyzer(const cached_analyzer &);
+    cached_analyzer& operator=(const cached_analyzer &);
+  };
+
+
+  ///////////////////////////////////////////////////////////////
+  /// Constructor.
+  ///////////////////////////////////////////////////////////////
+
+  inline cached_analyzer::cached_analyzer(const tokenizer &t, splitter &s, size_t cap,
+                                          const std::wstring &config)
+    : tk(t), sp(s), capacity(cap), n_hits(0), n_misses(0) {
+    prefix = config + L'\0';
+#ifdef FREELING_VERSION
+    std::string v = FREELING_VERSION;
+    prefix += std::wstring(v.begin(), v.end());
+#endif
+    prefix += L'\0';
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Append a processor to the chain.
+  ///////////////////////////////////////////////////////////////
+
+  inline void cached_analyzer::add_stage(const processor &p) {
+    procs.push_back(&p);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Analyze a text, or return the cached analysis. Concurrent
+  /// misses for the same text may both run the analyzers; the
+  /// first result stored is kept.
+  ///////////////////////////////////////////////////////////////
+
+  inline cached_analyzer::result cached_analyzer::analyze(const std::wstring &text) {
+    std::wstring norm = normalize(text);
+    std::wstring key = prefix + norm;
+
+    {
+      boost::mutex::scoped_lock lock(mtx);
+      std::map<std::wstring, lru_list::iterator>::iterator e = index.find(key);
+      if (e!=index.end()) {
+        n_hits++;
+        lru.splice(lru.begin(), lru, e->second);
+        return e->second->second;
+      }
+      n_misses++;
+    }
+
+    result r = run(norm);
+    if (capacity==0) return r;
+
+    boost::mutex::scoped_lock lock(mtx);
+    std::map<std::wstring, lru_list::iterator>::iterator e = index.find(key);
+    if (e!=index.end()) return e->second->second;
+
+    lru.push_front(std::make_pair(key, r));
+    index[key] = lru.begin();
+    if (lru.size() > capacity) {
+      index.erase(lru.back().first);
+      lru.pop_back();
+    }
+    return r;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Run the analyzers over a normalized text.
+  ///////////////////////////////////////////////////////////////
+
+  inline cached_analyzer::result cached_analyzer::run(const std::wstring &text) {
+    std::list<word> lw;
+    tk.tokenize(text, lw);
+
+    boost::shared_ptr<std::list<sentence> > ls(new std::list<sentence>());
+    {
+      boost::mutex::scoped_lock lock(split_mtx);
+      sp.split(lw, true, *ls);
+    }
+
+    for (size_t i=0; i<procs.size(); i++)
+      procs[i]->analyze(*ls);
+    return ls;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Remove leading and trailing whitespace, and replace inner
+  /// runs of whitespace with a single space.
+  ///////////////////////////////////////////////////////////////
+
+  inline std::wstring cached_analyzer::normalize(const std::wstring &text) {
+    std::wstring norm;
+    norm.reserve(text.size());
+    bool space=false;
+    for (std::wstring::const_iterator c=text.begin(); c!=text.end(); c++) {
+      if (*c==L' ' or *c==L'\t' or *c==L'\n' or *c==L'\r') space=true;
+      else {
+        if (space and not norm.empty()) norm.push_back(L' ');
+        norm.push_back(*c);
+        space=false;
+      }
+    }
+    return norm;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Cache statistics.
+  ///////////////////////////////////////////////////////////////
+
+  inline size_t cached_analyzer::size() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return lru.size();
+  }
+
+  inline unsigned long cached_analyzer::hits() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return n_hits;
+  }
+
+  inline unsigned long cached_analyzer::misses() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return n_misses;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Drop all cached results.
+  ///////////////////////////////////////////////////////////////
+
+  inline void cached_analyzer::clear() {
+    boost::mutex::scoped_lock lock(mtx);
+    index.clear();
+    lru.clear();
+  }
+
+} // namespace
+
+#endif
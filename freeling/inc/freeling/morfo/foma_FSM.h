@@ -26,7 +26,15 @@
 //
 ////////////////////////////////////////////////////////////////
 
+#ifndef _FOMA_FSM
+#define _FOMA_FSM
+
 #include <string>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "freeling/windll.h"
 
 typedef bool _Bool;
 #include "freeling/foma/fomalib.h"
@@ -62,4 +70,116 @@ namespace freeling {
     void set_basic_operation_cost(int);
   };
 
+
+  ////////////////////////////////////////////////////////
+  ///  Class foma_FSM_cache remembers the results of the
+  ///  most recent lookups in a foma_FSM, so that frequent
+  ///  forms are not searched again.  Lookup parameters
+  ///  must be changed through the cache, which then
+  ///  discards the stored results.
+  ////////////////////////////////////////////////////////
+
+  class foma_FSM_cache {
+  private:
+    typedef std::list<std::pair<std::wstring,int> > result_list;
+    typedef std::list<std::pair<std::wstring,result_list> > lru_list;
+
+    /// automaton being looked up
+    foma_FSM &fsm;
+    /// maximum number of forms kept
+    size_t capacity;
+    /// cached results, most recently used first
+    mutable lru_list lru;
+    /// position of each cached form in lru
+    mutable std::map<std::wstring,lru_list::iterator> index;
+
+  public:
+    /// constructor: cache lookups in given automaton
+    foma_FSM_cache(foma_FSM &, size_t cap=1000);
+
+    /// same as foma_FSM::get_similar_words, using stored results when possible
+    void get_similar_words(const std::wstring &, std::list<std::pair<std::wstring,int> > &) const;
+    /// look up a batch of forms. The i-th list of the result holds the matches for the i-th form.
+    /// Lists already in the result vector are cleared and reused.
+    void get_similar_words(const std::vector<std::wstring> &, std::vector<std::list<std::pair<std::wstring,int> > > &) const;
+
+    /// set maximum edit distance of desired results
+    void set_cutoff_threshold(int);
+    /// set maximum number of desired results
+    void set_num_matches(int);
+    /// Set cost for basic SED operations
+    void set_basic_operation_cost(int);
+
+    /// discard stored results
+    void clear();
+    /// number of forms currently stored
+    size_t size() const;
+  };
+
+  /// foma_FSM_cache methods definition. Inlined, so that no library rebuild is needed
+  //---------------------------------
+  inline foma_FSM_cache::foma_FSM_cache(foma_FSM &f, size_t cap) : fsm(f), capacity(cap>0 ? cap : 1) {}
+
+  //---------------------------------
+  inline void foma_FSM_cache::get_similar_words(const std::wstring &form, std::list<std::pair<std::wstring,int> > &res) const {
+    std::map<std::wstring,lru_list::iterator>::iterator p=index.find(form);
+    if (p!=index.end()) {
+      // move to front and return stored results
+      lru.splice(lru.begin(), lru, p->second);
+      res.insert(res.end(), p->second->second.begin(), p->second->second.end());
+      return;
+    }
+
+    // evict least recently used form if full
+    if (index.size()>=capacity) {
+      index.erase(lru.back().first);
+      lru.pop_back();
+    }
+
+    lru.push_front(std::make_pair(form,result_list()));
+    fsm.get_similar_words(form, lru.front().second);
+    index.insert(std::make_pair(form,lru.begin()));
+    res.insert(res.end(), lru.front().second.begin(), lru.front().second.end());
+  }
+
+  //---------------------------------
+  inline void foma_FSM_cache::get_similar_words(const std::vector<std::wstring> &forms, std::vector<std::list<std::pair<std::wstring,int> > > &res) const {
+    res.resize(forms.size());
+    for (size_t i=0; i<forms.size(); i++) {
+      res[i].clear();
+      get_similar_words(forms[i], res[i]);
+    }
+  }
+
+  //---------------------------------
+  inline void foma_FSM_cache::set_cutoff_threshold(int thr) {
+    fsm.set_cutoff_threshold(thr);
+    clear();
+  }
+
+  //---------------------------------
+  inline void foma_FSM_cache::set_num_matches(int max) {
+    fsm.set_num_matches(max);
+    clear();
+  }
+
+  //---------------------------------
+  inline void foma_FSM_cache::set_basic_operation_cost(int cost) {
+    fsm.set_basic_operation_cost(cost);
+    clear();
+  }
+
+  //---------------------------------
+  inline void foma_FSM_cache::clear() {
+    index.clear();
+    lru.clear();
+  }
+
+  //---------------------------------
+  inline size_t foma_FSM_cache::size() const {
+    return index.size();
+  }
+
 }
+
+#endif
@@ -0,0 +1,253 @@
+////////////////////////////////////////////////////////////////
+//
+//    FreeLing - Open Source Language Analyzers
+//
+//    Copyright (C) 2004   TALP Research Center
+//                         Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public
+//    License as published by the Free Software Foundation; either
+//    version 3 of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@lsi.upc.es)
+//             TALP Research Center
+//             despatx C6.212 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _LAZY_PROCESSOR
+#define _LAZY_PROCESSOR
+
+#include <list>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/type_traits/decay.hpp>
+
+#include "freeling/morfo/language.h"
+#include "freeling/morfo/processor.h"
+
+namespace freeling {
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Class lazy_model holds the constructor arguments of a
+  ///  FreeLing module (e.g. semanticDB, ukb, coref) and builds
+  ///  the module, loading its data files, the first time it is
+  ///  requested with get(). A configured analyzer thus only pays
+  ///  for the modules a request actually reaches.
+  ///
+  ///  Arguments are copied when the lazy_model is created.
+  ///  get() may be called from several threads; the module is
+  ///  built once, the others wait for it. If the constructor
+  ///  throws, the exception reaches the caller of get() and the
+  ///  next call tries again.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  template <class T>
+    class lazy_model {
+  public:
+    /// function that builds or fetches the module
+    typedef boost::function<boost::shared_ptr<const T> ()> factory_type;
+
+    /// constructor, taking the function that provides the module
+    /// (e.g. a model_registry::factory)
+    lazy_model(const factory_type &);
+    /// constructors, taking the arguments for T's constructor
+    template <class A1>
+      lazy_model(const A1 &);
+    template <class A1, class A2>
+      lazy_model(const A1 &, const A2 &);
+    template <class A1, class A2, class A3>
+      lazy_model(const A1 &, const A2 &, const A3 &);
+    template <class A1, class A2, class A3, class A4>
+      lazy_model(const A1 &, const A2 &, const A3 &, const A4 &);
+    template <class A1, class A2, class A3, class A4, class A5>
+      lazy_model(const A1 &, const A2 &, const A3 &, const A4 &, const A5 &);
+    template <class A1, class A2, class A3, class A4, class A5, class A6>
+      lazy_model(const A1 &, const A2 &, const A3 &, const A4 &, const A5 &, const A6 &);
+
+    /// get the module, building it on first use
+    const T & get() const;
+    /// whether the module has been built
+    bool loaded() const;
+
+  private:
+    factory_type make;
+
+    mutable boost::mutex mtx;
+    mutable boost::shared_ptr<const T> obj;
+
+    template <class A1>
+      static boost::shared_ptr<const T> construct(const A1 &a1) {
+      return boost::shared_ptr<const T>(new T(a1));
+    }
+    template <class A1, class A2>
+      static boost::shared_ptr<const T> construct(const A1 &a1, const A2 &a2) {
+      return boost::shared_ptr<const T>(new T(a1,a2));
+    }
+    template <class A1, class A2, class A3>
+      static boost::shared_ptr<const T> construct(const A1 &a1, const A2 &a2, const A3 &a3) {
+      return boost::shared_ptr<const T>(new T(a1,a2,a3));
+    }
+    template <class A1, class A2, class A3, class A4>
+      static boost::shared_ptr<const T> construct(const A1 &a1, const A2 &a2, const A3 &a3,
+                                                  const A4 &a4) {
+      return boost::shared_ptr<const T>(new T(a1,a2,a3,a4));
+    }
+    template <class A1, class A2, class A3, class A4, class A5>
+      static boost::shared_ptr<const T> construct(const A1 &a1, const A2 &a2, const A3 &a3,
+                                                  const A4 &a4, const A5 &a5) {
+      return boost::shared_ptr<const T>(new T(a1,a2,a3,a4,a5));
+    }
+    template <class A1, class A2, class A3, class A4, class A5, class A6>
+      static boost::shared_ptr<const T> construct(const A1 &a1, const A2 &a2, const A3 &a3,
+                                                  const A4 &a4, const A5 &a5, const A6 &a6) {
+      return boost::shared_ptr<const T>(new T(a1,a2,a3,a4,a5,a6));
+    }
+
+    /// not copyable
+    lazy_model(const lazy_model &);
+    lazy_model& operator=(const lazy_model &);
+  };
+
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Class lazy_processor is a processor that builds the
+  ///  wrapped processor on the first sentence it analyzes, so it
+  ///  can be put in a pipeline in place of the real module:
+  ///
+  ///     lazy_processor<ukb> wsd(L"/usr/share/freeling/common/ukb.dat");
+  ///     wsd.analyze(ls);   // ukb data is loaded here
+  ///
+  ///  Constructed from a model_registry::factory, the wrapped
+  ///  processor is shared with everyone else using the registry.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  template <class T>
+    class lazy_processor : public processor {
+  public:
+    /// constructors, taking the arguments for T's constructor
+    template <class A1>
+      lazy_processor(const A1 &a1) : model(a1) {}
+    template <class A1, class A2>
+      lazy_processor(const A1 &a1, const A2 &a2) : model(a1,a2) {}
+    template <class A1, class A2, class A3>
+      lazy_processor(const A1 &a1, const A2 &a2, const A3 &a3) : model(a1,a2,a3) {}
+    template <class A1, class A2, class A3, class A4>
+      lazy_processor(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4)
+      : model(a1,a2,a3,a4) {}
+    template <class A1, class A2, class A3, class A4, class A5>
+      lazy_processor(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4, const A5 &a5)
+      : model(a1,a2,a3,a4,a5) {}
+    template <class A1, class A2, class A3, class A4, class A5, class A6>
+      lazy_processor(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4, const A5 &a5,
+                     const A6 &a6)
+      : model(a1,a2,a3,a4,a5,a6) {}
+
+    /// analyze sentence, building the wrapped processor if needed
+    void analyze(sentence &s) const { model.get().analyze(s); }
+    /// analyze sentences, building the wrapped processor if needed
+    void analyze(std::list<sentence> &ls) const { model.get().analyze(ls); }
+    using processor::analyze;
+
+    /// get the wrapped processor, building it if needed
+    const T & get() const { return model.get(); }
+    /// whether the wrapped processor has been built
+    bool loaded() const { return model.loaded(); }
+
+  private:
+    lazy_model<T> model;
+  };
+
+
+  template <class T>
+    lazy_model<T>::lazy_model(const factory_type &f) : make(f) {}
+
+  template <class T> template <class A1>
+    lazy_model<T>::lazy_model(const A1 &a1)
+    : make(boost::bind(&lazy_model<T>::template construct<typename boost::decay<const A1>::type>,
+                       a1)) {}
+
+  template <class T> template <class A1, class A2>
+    lazy_model<T>::lazy_model(const A1 &a1, const A2 &a2)
+    : make(boost::bind(&lazy_model<T>::template construct<typename boost::decay<const A1>::type,
+                                                         typename boost::decay<const A2>::type>,
+                       a1, a2)) {}
+
+  template <class T> template <class A1, class A2, class A3>
+    lazy_model<T>::lazy_model(const A1 &a1, const A2 &a2, const A3 &a3)
+    : make(boost::bind(&lazy_model<T>::template construct<typename boost::decay<const A1>::type,
+                                                         typename boost::decay<const A2>::type,
+                                                         typename boost::decay<const A3>::type>,
+                       a1, a2, a3)) {}
+
+  template <class T> template <class A1, class A2, class A3, class A4>
+    lazy_model<T>::lazy_model(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4)
+    : make(boost::bind(&lazy_model<T>::template construct<typename boost::decay<const A1>::type,
+                                                         typename boost::decay<const A2>::type,
+                                                         typename boost::decay<const A3>::type,
+                                                         typename boost::decay<const A4>::type>,
+                       a1, a2, a3, a4)) {}
+
+  template <class T> template <class A1, class A2, class A3, class A4, class A5>
+    lazy_model<T>::lazy_model(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4,
+                              const A5 &a5)
+    : make(boost::bind(&lazy_model<T>::template construct<typename boost::decay<const A1>::type,
+                                                         typename boost::decay<const A2>::type,
+                                                         typename boost::decay<const A3>::type,
+                                                         typename boost::decay<const A4>::type,
+                                                         typename boost::decay<const A5>::type>,
+                       a1, a2, a3, a4, a5)) {}
+
+  template <class T> template <class A1, class A2, class A3, class A4, class A5, class A6>
+    lazy_model<T>::lazy_model(const A1 &a1, const A2 &a2, const A3 &a3, const A4 &a4,
+                              const A5 &a5, const A6 &a6)
+    : make(boost::bind(&lazy_model<T>::template construct<typename boost::decay<const A1>::type,
+                                                         typename boost::decay<const A2>::type,
+                                                         typename boost::decay<const A3>::type,
+                                                         typename boost::decay<const A4>::type,
+                                                         typename boost::decay<const A5>::type,
+                                                         typename boost::decay<const A6>::type>,
+                       a1, a2, a3, a4, a5, a6)) {}
+
+  ///////////////////////////////////////////////////////////////
+  /// Get the module, building it on first use.
+  ///////////////////////////////////////////////////////////////
+
+  template <class T>
+    const T & lazy_model<T>::get() const {
+    boost::mutex::scoped_lock lock(mtx);
+    if (not obj) obj = make();
+    return *obj;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Whether the module has been built.
+  ///////////////////////////////////////////////////////////////
+
+  template <class T>
+    bool lazy_model<T>::loaded() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return (obj ? true : false);
+  }
+
+} // namespace
+
+#endif
@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////
+//
+//    FreeLing - Open Source Language Analyzers
+//
+//    Copyright (C) 2004   TALP Research Center
+//                         Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public
+//    License as published by the Free Software Foundation; either
+//    version 3 of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@lsi.upc.es)
+//             TALP Research Center
+//             despatx C6.212 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _MODEL_REGISTRY
+#define _MODEL_REGISTRY
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <typeinfo>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/type_traits/decay.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace freeling {
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Class model_registry builds each FreeLing module once per
+  ///  distinct set of constructor arguments and hands out shared
+  ///  read-only references to it:
+  ///
+  ///     boost::shared_ptr<const hmm_tagger> tg =
+  ///       model_registry::global().get<hmm_tagger>(L"es/tagger.dat", true, FORCE_TAGGER);
+  ///
+  ///  A second get() with the same module type and arguments, from
+  ///  any analyzer or thread, returns the same object instead of
+  ///  loading the data files again. Modules are reference counted:
+  ///  the registry only keeps weak references, so a module is freed
+  ///  when its last user releases it, and loaded again if it is
+  ///  requested later.
+  ///
+  ///  Arguments are part of the key, so they must be printable to
+  ///  a std::wostream (strings, numbers, bools). Modules with
+  ///  option structures (e.g. maco) cannot be registered this way.
+  ///  Only const methods of shared modules may be used, which for
+  ///  processors means analyze().
+  ///
+  ///  A load holds only the lock of its own entry: requests for the
+  ///  same module wait for it, requests for other modules do not.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  class model_registry {
+  public:
+    /// constructor, for a registry separate from the global one
+    model_registry();
+
+    /// process-wide registry
+    static model_registry & global();
+
+    /// get module T built with the given arguments, loading it if needed
+    template <class T, class A1>
+      boost::shared_ptr<const T> get(const A1 &);
+    template <class T, class A1, class A2>
+      boost::shared_ptr<const T> get(const A1 &, const A2 &);
+    template <class T, class A1, class A2, class A3>
+      boost::shared_ptr<const T> get(const A1 &, const A2 &, const A3 &);
+    template <class T, class A1, class A2, class A3, class A4>
+      boost::shared_ptr<const T> get(const A1 &, const A2 &, const A3 &, const A4 &);
+    template <class T, class A1, class A2, class A3, class A4, class A5>
+      boost::shared_ptr<const T> get(const A1 &, const A2 &, const A3 &, const A4 &,
+                                     const A5 &);
+    template <class T, class A1, class A2, class A3, class A4, class A5, class A6>
+      boost::shared_ptr<const T> get(const A1 &, const A2 &, const A3 &, const A4 &,
+                                     const A5 &, const A6 &);
+
+    /// function calling get() with the given arguments, for lazy_model
+    template <class T, class A1>
+      boost::function<boost::shared_ptr<const T> ()> factory(const A1 &);
+    template <class T, class A1, class A2>
+      boost::function<boost::shared_ptr<const T> ()> factory(const A1 &, const A2 &);
+    template <class T, class A1, class A2, class A3>
+      boost::function<boost::shared_ptr<const T> ()> factory(const A1 &, const A2 &,
+                                                             const A3 &);
+    template <class T, class A1, class A2, class A3, class A4>
+      boost::function<boost::shared_ptr<const T> ()> factory(const A1 &, const A2 &,
+                                                             const A3 &, const A4 &);
+
+    /// number of modules currently alive
+    size_t size() const;
+    /// drop bookkeeping for modules that have been freed
+    void purge();
+
+  private:
+    /// per-module entry
+    struct entry_base {
+      virtual ~entry_base() {}
+      virtual bool expired() const =0;
+    };
+    template <class T>
+      struct entry : public entry_base {
+      boost::mutex mtx;
+      boost::weak_ptr<const T> model;
+      bool expired() const { return model.expired(); }
+    };
+
+    mutable boost::mutex mtx;
+    std::map<std::wstring, boost::shared_ptr<entry_base> > entries;
+
+    /// find or build the module with the given key
+    template <class T>
+      boost::shared_ptr<const T> lookup(const std::wstring &, const boost::function<T* ()> &);
+
+    /// build key from module type and arguments
+    template <class T>
+      static std::wostringstream & key_start(std::wostringstream &);
+
+    template <class T, class A1>
+      static T* construct(A1 a1) { return new T(a1); }
+    template <class T, class A1, class A2>
+      static T* construct(A1 a1, A2 a2) { return new T(a1,a2); }
+    template <class T, class A1, class A2, class A3>
+      static T* construct(A1 a1, A2 a2, A3 a3) { return new T(a1,a2,a3); }
+    template <class T, class A1, class A2, class A3, class A4>
+      static T* construct(A1 a1, A2 a2, A3 a3, A4 a4) { return new T(a1,a2,a3,a4); }
+    template <class T, class A1, class A2, class A3, class A4, class A5>
+      static T* construct(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5) {
+      return new T(a1,a2,a3,a4,a5);
+    }
+    template <class T, class A1, class A2, class A3, class A4, class A5, class A6>
+      static T* construct(A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6) {
+      return new T(a1,a2,a3,a4,a5,a6);
+    }
+
+    /// not copyable
+    model_registry(const model_registry &);
+    model_registry& operator=(const model_registry &);
+  };
+
+
+  inline model_registry::model_registry() {}
+
+  ///////////////////////////////////////////////////////////////
+  /// Process-wide registry.
+  ///////////////////////////////////////////////////////////////
+
+  inline model_registry & model_registry::global() {
+    static model_registry reg;
+    return reg;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Number of modules currently alive.
+  ///////////////////////////////////////////////////////////////
+
+  inline size_t model_registry::size() const {
+    boost::mutex::scoped_lock lock(mtx);
+    size_t n=0;
+    std::map<std::wstring, boost::shared_ptr<entry_base> >::const_iterator e;
+    for (e=entries.begin(); e!=entries.end(); e++)
+      if (not e->second->expired()) n++;
+    return n;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Drop bookkeeping for modules that have been freed.
+  ///////////////////////////////////////////////////////////////
+
+  inline void model_registry::purge() {
+    boost::mutex::scoped_lock lock(mtx);
+    std::map<std::wstring, boost::shared_ptr<entry_base> >::iterator e=entries.begin();
+    while (e!=entries.end()) {
+      if (e->second->expired()) entries.erase(e++);
+      else e++;
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Find the module with the given key, or build it with make.
+  ///////////////////////////////////////////////////////////////
+
+  template <class T>
+    boost::shared_ptr<const T> model_registry::lookup(const std::wstring &key,
+                                                      const boost::function<T* ()> &make) {
+    boost::shared_ptr<entry<T> > ent;
+    {
+      boost::mutex::scoped_lock lock(mtx);
+      boost::shared_ptr<entry_base> &e = entries[key];
+      if (not e) e.reset(new entry<T>());
+      // keys start with the type name, so the entry has type T
+      ent = boost::static_pointer_cast<entry<T> >(e);
+    }
+
+    boost::mutex::scoped_lock lock(ent->mtx);
+    boost::shared_ptr<const T> m = ent->model.lock();
+    if (not m) {
+      m.reset(make());
+      ent->model = m;
+    }
+    return m;
+  }
+
+  template <class T>
+    std::wostringstream & model_registry::key_start(std::wostringstream &key) {
+    key << typeid(T).name();
+    return key;
+  }
+
+  template <class T, class A1>
+    boost::shared_ptr<const T> model_registry::get(const A1 &a1) {
+    std::wostringstream key;
+    key_start<T>(key) << L'\0' << a1;
+    return lookup<T>(key.str(), boost::bind(&construct<T,const A1&>, boost::cref(a1)));
+  }
+
+  template <class T, class A1, class A2>
+    boost::shared_ptr<const T> model_registry::get(const A1 &a1, const A2 &a2) {
+    std::wostringstream key;
+    key_start<T>(key) << L'\0' << a1 << L'\0' << a2;
+    return lookup<T>(key.str(), boost::bind(&construct<T,const A1&,const A2&>,
+                                            boost::cref(a1), boost::cref(a2)));
+  }
+
+  template <class T, class A1, class A2, class A3>
+    boost::shared_ptr<const T> model_registry::get(const A1 &a1, const A2 &a2, const A3 &a3) {
+    std::wostringstream key;
+    key_start<T>(key) << L'\0' << a1 << L'\0' << a2 << L'\0' << a3;
+    return lookup<T>(key.str(), boost::bind(&construct<T,const A1&,const A2&,const A3&>,
+                                            boost::cref(a1), boost::cref(a2), boost::cref(a3)));
+  }
+
+  template <class T, class A1, class A2, class A3, class A4>
+    boost::shared_ptr<const T> model_registry::get(const A1 &a1, const A2 &a2, const A3 &a3,
+                                                   const A4 &a4) {
+    std::wostringstream key;
+    key_start<T>(key) << L'\0' << a1 << L'\0' << a2 << L'\0' << a3 << L'\0' << a4;
+    return lookup<T>(key.str(), boost::bind(&construct<T,const A1&,const A2&,const A3&,
+                                                       const A4&>,
+                                            boost::cref(a1), boost::cref(a2), boost::cref(a3),
+                                            boost::cref(a4)));
+  }
+
+  template <class T, class A1, class A2, class A3, class A4, class A5>
+    boost::shared_ptr<const T> model_registry::get(const A1 &a1, const A2 &a2, const A3 &a3,
+                                                   const A4 &a4, const A5 &a5) {
+    std::wostringstream key;
+    key_start<T>(key) << L'\0' << a1 << L'\0' << a2 << L'\0' << a3 << L'\0' << a4
+                      << L'\0' << a5;
+    return lookup<T>(key.str(), boost::bind(&construct<T,const A1&,const A2&,const A3&,
+                                                       const A4&,const A5&>,
+                                            boost::cref(a1), boost::cref(a2), boost::cref(a3),
+                                            boost::cref(a4), boost::cref(a5)));
+  }
+
+  template <class T, class A1, class A2, class A3, class A4, class A5, class A6>
+    boost::shared_ptr<const T> model_registry::get(const A1 &a1, const A2 &a2, const A3 &a3,
+                                                   const A4 &a4, const A5 &a5, const A6 &a6) {
+    std::wostringstream key;
+    key_start<T>(key) << L'\0' << a1 << L'\0' << a2 << L'\0' << a3 << L'\0' << a4
+                      << L'\0' << a5 << L'\0' << a6;
+    return lookup<T>(key.str(), boost::bind(&construct<T,const A1&,const A2&,const A3&,
+                                                       const A4&,const A5&,const A6&>,
+                                            boost::cref(a1), boost::cref(a2), boost::cref(a3),
+                                            boost::cref(a4), boost::cref(a5), boost::cref(a6)));
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Functions that call get() later, for lazy_model and
+  /// lazy_processor. Arguments are copied.
+  ///////////////////////////////////////////////////////////////
+
+  template <class T, class A1>
+    boost::function<boost::shared_ptr<const T> ()> model_registry::factory(const A1 &a1) {
+    return boost::bind(&model_registry::template get<T,
+                                                     typename boost::decay<const A1>::type>,
+                       this, a1);
+  }
+
+  template <class T, class A1, class A2>
+    boost::function<boost::shared_ptr<const T> ()> model_registry::factory(const A1 &a1,
+                                                                           const A2 &a2) {
+    return boost::bind(&model_registry::template get<T,
+                                                     typename boost::decay<const A1>::type,
+                                                     typename boost::decay<const A2>::type>,
+                       this, a1, a2);
+  }
+
+  template <class T, class A1, class A2, class A3>
+    boost::function<boost::shared_ptr<const T> ()> model_registry::factory(const A1 &a1,
+                                                                           const A2 &a2,
+                                                                           const A3 &a3) {
+    return boost::bind(&model_registry::template get<T,
+                                                     typename boost::decay<const A1>::type,
+                                                     typename boost::decay<const A2>::type,
+                                                     typename boost::decay<const A3>::type>,
+                       this, a1, a2, a3);
+  }
+
+  template <class T, class A1, class A2, class A3, class A4>
+    boost::function<boost::shared_ptr<const T> ()> model_registry::factory(const A1 &a1,
+                                                                           const A2 &a2,
+                                                                           const A3 &a3,
+                                                                           const A4 &a4) {
+    return boost::bind(&model_registry::template get<T,
+                                                     typename boost::decay<const A1>::type,
+                                                     typename boost::decay<const A2>::type,
+                                                     typename boost::decay<const A3>::type,
+                                                     typename boost::decay<const A4>::type>,
+                       this, a1, a2, a3, a4);
+  }
+
+} // namespace
+
+#endif
@@ -0,0 +1,311 @@
+////////////////////////////////////////////////////////////////
+//
+//    FreeLing - Open Source Language Analyzers
+//
+//    Copyright (C) 2004   TALP Research Center
+//                         Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public
+//    License as published by the Free Software Foundation; either
+//    version 3 of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@lsi.upc.es)
+//             TALP Research Center
+//             despatx C6.212 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _PARALLEL_ANALYZER
+#define _PARALLEL_ANALYZER
+
+#include <vector>
+#include <list>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/exception_ptr.hpp>
+
+#include "freeling/morfo/language.h"
+#include "freeling/morfo/processor.h"
+
+namespace freeling {
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Class parallel_analyzer runs a chain of processors over
+  ///  a list of sentences or a document, analyzing several
+  ///  sentences at a time on a pool of worker threads.
+  ///
+  ///  Stages added as sentence-local are applied to each
+  ///  sentence independently: a consecutive run of such stages
+  ///  is applied in full to one sentence by one thread, and
+  ///  idle threads pick up the next unprocessed sentence, so long
+  ///  and short sentences balance out. Stages that need the whole
+  ///  text (e.g. ukb) are added as document-level and act as
+  ///  barriers: they run on the calling thread once all earlier
+  ///  stages are done for every sentence.
+  ///
+  ///  Sentences are analyzed in place, so their order in the
+  ///  list never changes. Processors must be usable concurrently
+  ///  through their const analyze() methods, which holds for the
+  ///  standard modules (maco, hmm_tagger, nec, chart_parser,
+  ///  dep_txala...). Processors are not owned.
+  ///
+  ///  Requires linking boost_thread.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  class parallel_analyzer {
+  public:
+    /// constructor, 0 threads means one per hardware thread
+    parallel_analyzer(unsigned int nthreads=0);
+    /// destructor, stops worker threads
+    ~parallel_analyzer();
+
+    /// append a processor to the chain
+    void add_stage(const processor &, bool sentence_local=true);
+
+    /// analyze sentences
+    void analyze(std::list<sentence> &);
+    /// analyze document. Document-level stages are applied to each paragraph
+    void analyze(document &);
+
+    /// number of threads analyzing sentences, including the caller
+    unsigned int num_threads() const;
+
+  private:
+    /// chain element
+    struct stage {
+      const processor *proc;
+      bool local;
+    };
+    std::vector<stage> stages;
+
+    /// worker pool
+    boost::thread_group workers;
+    unsigned int nthreads;
+
+    /// current job: sentences and range of stages to apply to them
+    boost::mutex mtx;
+    boost::condition_variable job_ready;
+    boost::condition_variable job_done;
+    const std::vector<sentence*> *job;
+    size_t job_first, job_last;
+    size_t next_sent, pending;
+    unsigned long generation;
+    bool stopping;
+    boost::exception_ptr error;
+
+    /// apply the stage chain to the given sentences
+    void run(const std::vector<sentence*> &, const std::vector<std::list<sentence>*> &);
+    /// apply stages [first,last) to the given sentences
+    void run_local(const std::vector<sentence*> &, size_t, size_t);
+    /// take sentences from the current job until none are left
+    void work(boost::mutex::scoped_lock &);
+    /// worker thread body
+    void worker();
+
+    /// not copyable
+    parallel_analyzer(const parallel_analyzer &);
+    parallel_analyzer& operator=(const parallel_analyzer &);
+  };
+
+
+  ///////////////////////////////////////////////////////////////
+  /// Constructor. Starts nthreads-1 workers; the calling thread
+  /// counts as one.
+  ///////////////////////////////////////////////////////////////
+
+  inline parallel_analyzer::parallel_analyzer(unsigned int n)
+    : job(NULL), job_first(0), job_last(0), next_sent(0), pending(0),
+      generation(0), stopping(false) {
+
+    nthreads = (n>0 ? n : boost::thread::hardware_concurrency());
+    if (nthreads==0) nthreads=1;
+
+    for (unsigned int i=1; i<nthreads; i++)
+      workers.create_thread(boost::bind(&parallel_analyzer::worker, this));
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Destructor. Waits for the worker threads to exit.
+  ///////////////////////////////////////////////////////////////
+
+  inline parallel_analyzer::~parallel_analyzer() {
+    {
+      boost::mutex::scoped_lock lock(mtx);
+      stopping=true;
+    }
+    job_ready.notify_all();
+    workers.join_all();
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Append a processor to the chain. Sentence-local stages
+  /// may run on any thread; document-level ones are barriers.
+  ///////////////////////////////////////////////////////////////
+
+  inline void parallel_analyzer::add_stage(const processor &p, bool sentence_local) {
+    stage s;
+    s.proc = &p;
+    s.local = sentence_local;
+    stages.push_back(s);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Number of threads analyzing sentences, including the caller.
+  ///////////////////////////////////////////////////////////////
+
+  inline unsigned int parallel_analyzer::num_threads() const {
+    return nthreads;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Analyze a list of sentences in place.
+  ///////////////////////////////////////////////////////////////
+
+  inline void parallel_analyzer::analyze(std::list<sentence> &ls) {
+    std::vector<sentence*> sents;
+    sents.reserve(ls.size());
+    for (std::list<sentence>::iterator s=ls.begin(); s!=ls.end(); s++)
+      sents.push_back(&(*s));
+
+    std::vector<std::list<sentence>*> groups(1, &ls);
+    run(sents, groups);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Analyze a document in place. Sentence-local stages see the
+  /// sentences of all paragraphs at once; document-level stages
+  /// are applied paragraph by paragraph, as processor::analyze
+  /// would be by a serial pipeline.
+  ///////////////////////////////////////////////////////////////
+
+  inline void parallel_analyzer::analyze(document &doc) {
+    std::vector<sentence*> sents;
+    std::vector<std::list<sentence>*> groups;
+    for (document::iterator p=doc.begin(); p!=doc.end(); p++) {
+      groups.push_back(&(*p));
+      for (paragraph::iterator s=p->begin(); s!=p->end(); s++)
+        sents.push_back(&(*s));
+    }
+    run(sents, groups);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Apply the stage chain: runs of sentence-local stages go to
+  /// the pool, document-level stages run here in between.
+  ///////////////////////////////////////////////////////////////
+
+  inline void parallel_analyzer::run(const std::vector<sentence*> &sents,
+                                     const std::vector<std::list<sentence>*> &groups) {
+    size_t i=0;
+    while (i<stages.size()) {
+      if (stages[i].local) {
+        size_t j=i;
+        while (j<stages.size() && stages[j].local) j++;
+        run_local(sents,i,j);
+        i=j;
+      }
+      else {
+        for (size_t g=0; g<groups.size(); g++)
+          stages[i].proc->analyze(*groups[g]);
+        i++;
+      }
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Apply stages [first,last) to every given sentence, with the
+  /// calling thread taking part. Rethrows the first exception
+  /// thrown by a processor, once all threads are done.
+  ///////////////////////////////////////////////////////////////
+
+  inline void parallel_analyzer::run_local(const std::vector<sentence*> &sents,
+                                           size_t first, size_t last) {
+    if (sents.empty()) return;
+
+    boost::mutex::scoped_lock lock(mtx);
+    job = &sents;
+    job_first = first;
+    job_last = last;
+    next_sent = 0;
+    pending = sents.size();
+    error = boost::exception_ptr();
+    generation++;
+    job_ready.notify_all();
+
+    work(lock);
+    while (pending>0) job_done.wait(lock);
+    // workers waking up late must not see this job
+    job = NULL;
+
+    if (error) {
+      boost::exception_ptr e = error;
+      error = boost::exception_ptr();
+      lock.unlock();
+      boost::rethrow_exception(e);
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Take sentences from the current job until none are left.
+  /// Called with the lock held; releases it while analyzing.
+  ///////////////////////////////////////////////////////////////
+
+  inline void parallel_analyzer::work(boost::mutex::scoped_lock &lock) {
+    while (job!=NULL and next_sent<job->size()) {
+      sentence &s = *(*job)[next_sent++];
+      size_t first=job_first, last=job_last;
+      bool failed = (error ? true : false);
+
+      lock.unlock();
+      boost::exception_ptr e;
+      // once a stage has failed the remaining sentences are skipped
+      if (not failed) {
+        try {
+          for (size_t k=first; k<last; k++)
+            stages[k].proc->analyze(s);
+        }
+        catch (...) {
+          e = boost::current_exception();
+        }
+      }
+      lock.lock();
+
+      if (e and not error) error = e;
+      if (--pending == 0) job_done.notify_all();
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Worker thread body: wait for a new job and help with it.
+  ///////////////////////////////////////////////////////////////
+
+  inline void parallel_analyzer::worker() {
+    boost::mutex::scoped_lock lock(mtx);
+    unsigned long seen = generation;
+    while (true) {
+      while (not stopping and generation==seen) job_ready.wait(lock);
+      if (stopping) return;
+      seen = generation;
+      work(lock);
+    }
+  }
+
+} // namespace
+
+#endif
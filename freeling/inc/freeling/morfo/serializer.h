@@ -0,0 +1,712 @@
+////////////////////////////////////////////////////////////////
+//
+//    FreeLing - Open Source Language Analyzers
+//
+//    Copyright (C) 2004   TALP Research Center
+//                         Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public
+//    License as published by the Free Software Foundation; either
+//    version 3 of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@lsi.upc.es)
+//             TALP Research Center
+//             despatx C6.212 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _SERIALIZER
+#define _SERIALIZER
+
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+
+#include "freeling/morfo/language.h"
+
+namespace freeling {
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Classes binary_writer and binary_reader encode analyzed
+  ///  sentences and documents in a compact binary format, to
+  ///  cache analyses or pass them between processes without
+  ///  printing and re-parsing text:
+  ///
+  ///     std::string buf;
+  ///     binary_writer(buf).write(ls);
+  ///     ...
+  ///     std::list<sentence> ls2;
+  ///     binary_reader(buf.data(), buf.size()).read(ls2);
+  ///
+  ///  Everything the analyzers produce is kept: words with their
+  ///  analyses (including kbest selections, senses and
+  ///  retokenization), multiwords, alternatives, spans, sentence
+  ///  ids, predicate arguments, parse and dependency trees with
+  ///  their word and parse-tree links, and document coreference
+  ///  groups. User data vectors are kept too. Only the trees of
+  ///  the best tagger sequence (k=0) are stored. Processing status
+  ///  and document titles are not.
+  ///
+  ///  Strings are stored as variable-length character codes and
+  ///  integers as variable-length numbers, so the encoding does
+  ///  not depend on the size of wchar_t or on byte order. Each
+  ///  write() appends one self-contained record, so many records
+  ///  can share a buffer and be read back in sequence. The reader
+  ///  works on the caller's buffer without copying it, and throws
+  ///  std::runtime_error on a truncated or malformed record.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  class binary_writer {
+  public:
+    /// constructor, records are appended to the given string
+    binary_writer(std::string &);
+
+    /// append a sentence
+    void write(const sentence &);
+    /// append a list of sentences
+    void write(const std::list<sentence> &);
+    /// append a document
+    void write(const document &);
+
+  private:
+    std::string &buf;
+
+    /// position of each sentence word, to encode tree leaves
+    typedef std::map<const word*, size_t> word_index;
+    /// preorder position of each parse node, to encode dependency links
+    typedef std::map<const tree<node>*, size_t> node_index;
+
+    void put_header(char);
+    void put_uint(boost::uint64_t);
+    void put_int(long);
+    void put_bool(bool);
+    void put_double(double);
+    void put_string(const std::wstring &);
+    void put_strings(const std::vector<std::wstring> &);
+    void put_analysis(const analysis &);
+    void put_word(const word &);
+    void put_words(const std::list<word> &);
+    void put_node(const node &);
+    void put_parse_tree(const tree<node> &, const word_index &);
+    void put_dep_tree(const tree<depnode> &, const word_index &, const node_index &);
+    void put_sentence(const sentence &);
+  };
+
+
+  class binary_reader {
+  public:
+    /// constructor, reading records from the given buffer
+    binary_reader(const char *, size_t);
+    /// constructor, reading records from the given string
+    binary_reader(const std::string &);
+
+    /// read a sentence record
+    void read(sentence &);
+    /// read a sentence list record, appending to the list
+    void read(std::list<sentence> &);
+    /// read a document record, appending to the document
+    void read(document &);
+
+    /// whether all records have been read
+    bool at_end() const;
+
+  private:
+    const char *p, *end;
+
+    void get_header(char);
+    boost::uint64_t get_uint();
+    long get_int();
+    bool get_bool();
+    double get_double();
+    std::wstring get_string();
+    void get_strings(std::vector<std::wstring> &);
+    void get_analysis(analysis &);
+    void get_word(word &);
+    void get_words(std::list<word> &);
+    void get_node(node &);
+    void get_parse_tree(tree<node> &, const std::vector<word*> &);
+    void get_dep_tree(tree<depnode> &, const std::vector<word*> &,
+                      const std::vector<parse_tree::iterator> &);
+    void get_sentence(sentence &);
+    /// number of elements that follow, checked against the bytes left
+    size_t get_count();
+    void fail() const;
+  };
+
+
+  /// format signature and version
+  static const char BINARY_MAGIC[] = { 'F', 'L', 'B', '1' };
+  /// record kinds
+  static const char BINARY_SENTENCE = 'S';
+  static const char BINARY_SENTENCE_LIST = 'L';
+  static const char BINARY_DOCUMENT = 'D';
+
+
+  inline binary_writer::binary_writer(std::string &b) : buf(b) {}
+
+  ///////////////////////////////////////////////////////////////
+  /// Append a sentence record.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::write(const sentence &s) {
+    put_header(BINARY_SENTENCE);
+    put_sentence(s);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Append a sentence list record.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::write(const std::list<sentence> &ls) {
+    put_header(BINARY_SENTENCE_LIST);
+    put_uint(ls.size());
+    for (std::list<sentence>::const_iterator s=ls.begin(); s!=ls.end(); s++)
+      put_sentence(*s);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Append a document record. Coreference groups are stored for
+  /// the nodes of the sentence parse trees.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::write(const document &doc) {
+    put_header(BINARY_DOCUMENT);
+    put_uint(doc.size());
+
+    std::vector<std::pair<std::wstring,int> > coref;
+    for (document::const_iterator par=doc.begin(); par!=doc.end(); par++) {
+      put_uint(par->size());
+      for (paragraph::const_iterator s=par->begin(); s!=par->end(); s++) {
+        put_sentence(*s);
+        if (not s->is_parsed()) continue;
+
+        const parse_tree &pt = s->get_parse_tree();
+        for (parse_tree::const_iterator n=pt.begin(); n!=pt.end(); n++) {
+          std::wstring id = n->info.get_node_id();
+          int g = (id.empty() ? -1 : doc.get_coref_group(id));
+          if (g>=0) coref.push_back(std::make_pair(id,g));
+        }
+      }
+    }
+
+    put_uint(coref.size());
+    for (size_t i=0; i<coref.size(); i++) {
+      put_string(coref[i].first);
+      put_int(coref[i].second);
+    }
+  }
+
+  inline void binary_writer::put_header(char kind) {
+    buf.append(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    buf.push_back(kind);
+  }
+
+  inline void binary_writer::put_uint(boost::uint64_t n) {
+    while (n>=0x80) {
+      buf.push_back(char((n & 0x7F) | 0x80));
+      n >>= 7;
+    }
+    buf.push_back(char(n));
+  }
+
+  inline void binary_writer::put_int(long n) {
+    // zigzag, so small negative numbers stay short
+    boost::int64_t x = n;
+    put_uint((boost::uint64_t(x) << 1) ^ boost::uint64_t(x >> 63));
+  }
+
+  inline void binary_writer::put_bool(bool b) {
+    buf.push_back(b ? 1 : 0);
+  }
+
+  inline void binary_writer::put_double(double d) {
+    boost::uint64_t x;
+    std::memcpy(&x, &d, sizeof(x));
+    for (int i=0; i<8; i++) buf.push_back(char((x >> (8*i)) & 0xFF));
+  }
+
+  inline void binary_writer::put_string(const std::wstring &s) {
+    put_uint(s.size());
+    for (std::wstring::const_iterator c=s.begin(); c!=s.end(); c++)
+      put_uint(boost::uint32_t(*c));
+  }
+
+  inline void binary_writer::put_strings(const std::vector<std::wstring> &v) {
+    put_uint(v.size());
+    for (size_t i=0; i<v.size(); i++) put_string(v[i]);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Analysis: lemma, tag, optional probability and distance,
+  /// senses, retokenization, and the kbest sequences selecting it.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::put_analysis(const analysis &a) {
+    put_string(a.get_lemma());
+    put_string(a.get_tag());
+
+    put_bool(a.has_prob());
+    if (a.has_prob()) put_double(a.get_prob());
+    put_bool(a.has_distance());
+    if (a.has_distance()) put_double(a.get_distance());
+
+    const std::list<std::pair<std::wstring,double> > &ss = a.get_senses();
+    put_uint(ss.size());
+    for (std::list<std::pair<std::wstring,double> >::const_iterator s=ss.begin(); s!=ss.end(); s++) {
+      put_string(s->first);
+      put_double(s->second);
+    }
+
+    put_words(a.get_retokenizable());
+
+    std::vector<int> sel;
+    for (int k=0; k<=a.max_kbest(); k++)
+      if (a.is_selected(k)) sel.push_back(k);
+    put_uint(sel.size());
+    for (size_t i=0; i<sel.size(); i++) put_uint(sel[i]);
+
+    put_strings(a.user);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Word: form, multiword components, analyses and attributes.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::put_word(const word &w) {
+    put_string(w.get_form());
+    put_words(w.get_words_mw());
+    put_string(w.get_ph_form());
+    put_uint(w.get_span_start());
+    put_uint(w.get_span_finish());
+    put_uint(w.get_position());
+    put_bool(w.is_ambiguous_mw());
+    put_bool(w.found_in_dict());
+    put_bool(w.is_locked());
+
+    const std::list<std::pair<std::wstring,int> > &alt = w.get_alternatives();
+    put_uint(alt.size());
+    for (std::list<std::pair<std::wstring,int> >::const_iterator a=alt.begin(); a!=alt.end(); a++) {
+      put_string(a->first);
+      put_int(a->second);
+    }
+
+    put_uint(w.size());
+    for (word::const_iterator a=w.analysis_begin(); a!=w.analysis_end(); a++)
+      put_analysis(*a);
+
+    put_strings(w.user);
+  }
+
+  inline void binary_writer::put_words(const std::list<word> &lw) {
+    put_uint(lw.size());
+    for (std::list<word>::const_iterator w=lw.begin(); w!=lw.end(); w++)
+      put_word(*w);
+  }
+
+  inline void binary_writer::put_node(const node &n) {
+    put_string(n.get_node_id());
+    put_string(n.get_label());
+    put_bool(n.is_head());
+    put_int(n.get_chunk_ord());
+    put_strings(n.user);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Parse tree, in preorder. Leaves store the position of their
+  /// word in the sentence, or -1 if they have none.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::put_parse_tree(const tree<node> &t, const word_index &wi) {
+    put_node(t.info);
+
+    long pos = -1;
+    if (t.num_children()==0) {
+      word_index::const_iterator w = wi.find(&t.info.get_word());
+      if (w!=wi.end()) pos = w->second;
+    }
+    put_int(pos);
+
+    put_uint(t.num_children());
+    for (tree<node>::const_sibling_iterator c=t.sibling_begin(); c!=t.sibling_end(); ++c)
+      put_parse_tree(*c, wi);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Dependency tree, in preorder. Nodes store the position of
+  /// their word and the preorder position of their parse node.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::put_dep_tree(const tree<depnode> &t, const word_index &wi,
+                                          const node_index &ni) {
+    put_node(t.info);
+
+    word_index::const_iterator w = wi.find(&t.info.get_word());
+    put_int(w!=wi.end() ? long(w->second) : -1);
+    long link = -1;
+    parse_tree::const_iterator l = t.info.get_link();
+    if (l!=parse_tree::const_iterator()) {
+      node_index::const_iterator n = ni.find(&(*l));
+      if (n!=ni.end()) link = n->second;
+    }
+    put_int(link);
+
+    put_uint(t.num_children());
+    for (tree<depnode>::const_sibling_iterator c=t.sibling_begin(); c!=t.sibling_end(); ++c)
+      put_dep_tree(*c, wi, ni);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Sentence: words, id, predicate arguments, and the parse and
+  /// dependency trees of the best tagger sequence.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_writer::put_sentence(const sentence &s) {
+    put_words(s);
+    put_string(const_cast<sentence&>(s).get_sentence_id());
+
+    put_uint(s.pred_args.size());
+    for (std::map<int,sentence::pred_arg_set>::const_iterator p=s.pred_args.begin();
+         p!=s.pred_args.end(); p++) {
+      put_int(p->first);
+      put_string(p->second.first);
+      put_uint(p->second.second.size());
+      for (std::map<int,std::wstring>::const_iterator a=p->second.second.begin();
+           a!=p->second.second.end(); a++) {
+        put_int(a->first);
+        put_string(a->second);
+      }
+    }
+
+    word_index wi;
+    size_t i=0;
+    for (sentence::const_iterator w=s.begin(); w!=s.end(); w++) wi[&(*w)] = i++;
+
+    node_index ni;
+    put_bool(s.is_parsed());
+    if (s.is_parsed()) {
+      const parse_tree &pt = s.get_parse_tree();
+      put_parse_tree(pt, wi);
+      size_t j=0;
+      for (parse_tree::const_iterator n=pt.begin(); n!=pt.end(); n++) ni[&(*n)] = j++;
+    }
+    put_bool(s.is_dep_parsed());
+    if (s.is_dep_parsed()) put_dep_tree(s.get_dep_tree(), wi, ni);
+  }
+
+
+  inline binary_reader::binary_reader(const char *b, size_t n) : p(b), end(b+n) {}
+
+  inline binary_reader::binary_reader(const std::string &b)
+    : p(b.data()), end(b.data()+b.size()) {}
+
+  ///////////////////////////////////////////////////////////////
+  /// Whether all records have been read.
+  ///////////////////////////////////////////////////////////////
+
+  inline bool binary_reader::at_end() const {
+    return p==end;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Read a sentence record into s, replacing its contents.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_reader::read(sentence &s) {
+    get_header(BINARY_SENTENCE);
+    s.clear();
+    get_sentence(s);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Read a sentence list record. Sentences are built in place
+  /// at the end of the list.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_reader::read(std::list<sentence> &ls) {
+    get_header(BINARY_SENTENCE_LIST);
+    size_t n = get_count();
+    for (size_t i=0; i<n; i++) {
+      ls.push_back(sentence());
+      get_sentence(ls.back());
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Read a document record, appending its paragraphs.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_reader::read(document &doc) {
+    get_header(BINARY_DOCUMENT);
+    size_t np = get_count();
+    for (size_t i=0; i<np; i++) {
+      doc.push_back(paragraph());
+      size_t ns = get_count();
+      for (size_t j=0; j<ns; j++) {
+        doc.back().push_back(sentence());
+        get_sentence(doc.back().back());
+      }
+    }
+
+    size_t nc = get_count();
+    for (size_t i=0; i<nc; i++) {
+      std::wstring id = get_string();
+      doc.add_positive(id, int(get_int()));
+    }
+  }
+
+  inline void binary_reader::fail() const {
+    throw std::runtime_error("binary_reader: truncated or malformed record");
+  }
+
+  inline void binary_reader::get_header(char kind) {
+    if (size_t(end-p) < sizeof(BINARY_MAGIC)+1) fail();
+    if (std::memcmp(p, BINARY_MAGIC, sizeof(BINARY_MAGIC))!=0) fail();
+    p += sizeof(BINARY_MAGIC);
+    if (*p++ != kind) fail();
+  }
+
+  inline boost::uint64_t binary_reader::get_uint() {
+    boost::uint64_t n=0;
+    for (int shift=0; shift<64; shift+=7) {
+      if (p==end) fail();
+      unsigned char c = *p++;
+      n |= boost::uint64_t(c & 0x7F) << shift;
+      if (not (c & 0x80)) return n;
+    }
+    fail();
+    return 0;
+  }
+
+  inline long binary_reader::get_int() {
+    boost::uint64_t x = get_uint();
+    return long(boost::int64_t(x >> 1) ^ -boost::int64_t(x & 1));
+  }
+
+  inline size_t binary_reader::get_count() {
+    boost::uint64_t n = get_uint();
+    // every element takes at least one byte
+    if (n > boost::uint64_t(end-p)) fail();
+    return size_t(n);
+  }
+
+  inline bool binary_reader::get_bool() {
+    if (p==end) fail();
+    return (*p++ != 0);
+  }
+
+  inline double binary_reader::get_double() {
+    if (end-p < 8) fail();
+    boost::uint64_t x=0;
+    for (int i=0; i<8; i++) x |= boost::uint64_t((unsigned char)(*p++)) << (8*i);
+    double d;
+    std::memcpy(&d, &x, sizeof(d));
+    return d;
+  }
+
+  inline std::wstring binary_reader::get_string() {
+    size_t n = get_count();
+    std::wstring s;
+    s.reserve(n);
+    for (size_t i=0; i<n; i++) s.push_back(wchar_t(get_uint()));
+    return s;
+  }
+
+  inline void binary_reader::get_strings(std::vector<std::wstring> &v) {
+    size_t n = get_count();
+    v.clear();
+    v.reserve(n);
+    for (size_t i=0; i<n; i++) v.push_back(get_string());
+  }
+
+  inline void binary_reader::get_analysis(analysis &a) {
+    std::wstring lemma = get_string();
+    a.init(lemma, get_string());
+
+    if (get_bool()) a.set_prob(get_double());
+    if (get_bool()) a.set_distance(get_double());
+
+    std::list<std::pair<std::wstring,double> > ss;
+    size_t ns = get_count();
+    for (size_t i=0; i<ns; i++) {
+      std::wstring s = get_string();
+      ss.push_back(std::make_pair(s, get_double()));
+    }
+    a.set_senses(ss);
+
+    std::list<word> retok;
+    get_words(retok);
+    if (not retok.empty()) a.set_retokenizable(retok);
+
+    size_t nsel = get_count();
+    for (size_t i=0; i<nsel; i++) a.mark_selected(int(get_uint()));
+
+    get_strings(a.user);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Read a word into w, replacing its contents.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_reader::get_word(word &w) {
+    std::wstring form = get_string();
+    std::list<word> mw;
+    get_words(mw);
+    w = word(form, mw);
+
+    w.set_ph_form(get_string());
+    unsigned long start = get_uint();
+    w.set_span(start, get_uint());
+    w.set_position(get_uint());
+    w.set_ambiguous_mw(get_bool());
+    w.set_found_in_dict(get_bool());
+    bool locked = get_bool();
+
+    size_t nalt = get_count();
+    for (size_t i=0; i<nalt; i++) {
+      std::wstring alt = get_string();
+      w.add_alternative(alt, int(get_int()));
+    }
+
+    size_t na = get_count();
+    std::vector<std::vector<int> > sel(na);
+    int nk = 1;
+    for (size_t i=0; i<na; i++) {
+      analysis a;
+      get_analysis(a);
+      for (int k=0; k<=a.max_kbest(); k++)
+        if (a.is_selected(k)) sel[i].push_back(k);
+      if (a.max_kbest()>=nk) nk = a.max_kbest()+1;
+      w.add_analysis(a);
+    }
+    // add_analysis changes selections; restore them through the
+    // word, so that its selection counts are right
+    for (int k=0; k<nk; k++) w.unselect_all_analysis(k);
+    size_t i=0;
+    for (word::iterator a=w.analysis_begin(); a!=w.analysis_end(); a++, i++) {
+      for (size_t j=0; j<sel[i].size(); j++) w.select_analysis(a, sel[i][j]);
+    }
+
+    if (locked) w.lock_analysis();
+    get_strings(w.user);
+  }
+
+  inline void binary_reader::get_words(std::list<word> &lw) {
+    size_t n = get_count();
+    for (size_t i=0; i<n; i++) {
+      lw.push_back(word());
+      get_word(lw.back());
+    }
+  }
+
+  inline void binary_reader::get_node(node &n) {
+    n.set_node_id(get_string());
+    n.set_label(get_string());
+    n.set_head(get_bool());
+    n.set_chunk(int(get_int()));
+    get_strings(n.user);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Read a parse tree into t, whose node must be empty.
+  /// Children are built in place and hung without copying.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_reader::get_parse_tree(tree<node> &t, const std::vector<word*> &words) {
+    get_node(t.info);
+    long pos = get_int();
+    if (pos >= long(words.size())) fail();
+    if (pos >= 0) t.info.set_word(*words[pos]);
+
+    size_t nc = get_count();
+    for (size_t i=0; i<nc; i++) {
+      tree<node> *c = new tree<node>(node());
+      t.hang_child(*c);
+      get_parse_tree(*c, words);
+    }
+  }
+
+  inline void binary_reader::get_dep_tree(tree<depnode> &t, const std::vector<word*> &words,
+                                          const std::vector<parse_tree::iterator> &nodes) {
+    get_node(t.info);
+    long pos = get_int();
+    if (pos >= long(words.size())) fail();
+    if (pos >= 0) t.info.set_word(*words[pos]);
+    long link = get_int();
+    if (link >= long(nodes.size())) fail();
+    if (link >= 0) t.info.set_link(nodes[link]);
+
+    size_t nc = get_count();
+    for (size_t i=0; i<nc; i++) {
+      tree<depnode> *c = new tree<depnode>(depnode());
+      t.hang_child(*c);
+      get_dep_tree(*c, words, nodes);
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Read a sentence into s, which must be empty. Trees point to
+  /// the words of s, so s must be at its final location.
+  ///////////////////////////////////////////////////////////////
+
+  inline void binary_reader::get_sentence(sentence &s) {
+    size_t nw = get_count();
+    for (size_t i=0; i<nw; i++) {
+      word w;
+      get_word(w);
+      s.push_back(w);
+    }
+    s.set_sentence_id(get_string());
+
+    size_t np = get_count();
+    for (size_t i=0; i<np; i++) {
+      int pred = int(get_int());
+      sentence::pred_arg_set &pa = s.pred_args[pred];
+      pa.first = get_string();
+      size_t na = get_count();
+      for (size_t j=0; j<na; j++) {
+        int arg = int(get_int());
+        pa.second[arg] = get_string();
+      }
+    }
+
+    std::vector<word*> words;
+    for (sentence::iterator w=s.begin(); w!=s.end(); w++) words.push_back(&(*w));
+
+    std::vector<parse_tree::iterator> nodes;
+    if (get_bool()) {
+      parse_tree pt((node()));
+      get_parse_tree(pt, words);
+      s.set_parse_tree(pt);
+      parse_tree &spt = s.get_parse_tree();
+      spt.rebuild_node_index();
+      for (parse_tree::iterator n=spt.begin(); n!=spt.end(); n++) nodes.push_back(n);
+    }
+    if (get_bool()) {
+      dep_tree dt((depnode()));
+      get_dep_tree(dt, words, nodes);
+      s.set_dep_tree(dt);
+      s.get_dep_tree().rebuild_node_index();
+    }
+  }
+
+} // namespace
+
+#endif
@@ -0,0 +1,340 @@
+////////////////////////////////////////////////////////////////
+//
+//    FreeLing - Open Source Language Analyzers
+//
+//    Copyright (C) 2004   TALP Research Center
+//                         Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public
+//    License as published by the Free Software Foundation; either
+//    version 3 of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@lsi.upc.es)
+//             TALP Research Center
+//             despatx C6.212 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _STREAM_ANALYZER
+#define _STREAM_ANALYZER
+
+#include <vector>
+#include <list>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/exception_ptr.hpp>
+
+#include "freeling/morfo/language.h"
+#include "freeling/morfo/tokenizer.h"
+#include "freeling/morfo/splitter.h"
+#include "freeling/morfo/processor.h"
+
+namespace freeling {
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Class stream_analyzer analyzes text that arrives in
+  ///  pieces, such as a running ASR transcript, as a pipeline
+  ///  of concurrent stages.
+  ///
+  ///  Text passed to feed() is tokenized and split on the
+  ///  calling thread. Each completed sentence is queued to the
+  ///  first processor stage right away, and every stage runs on
+  ///  its own thread, so one sentence can be tagged while the
+  ///  next is being morphologically analyzed and the text after
+  ///  it is still being tokenized. Analyzed sentences are
+  ///  collected, in input order, with next().
+  ///
+  ///  Queues between stages are bounded: feed() blocks when the
+  ///  first stage falls behind by more than the given number of
+  ///  sentences. Analyzed sentences wait for next() in an
+  ///  unbounded queue, so the thread that feeds the stream can
+  ///  also collect from it without deadlocking. Sentences move
+  ///  between stages by list splicing, and are never copied.
+  ///
+  ///  The tokenizer and processors are used through their const
+  ///  methods and may be shared. The splitter keeps state and
+  ///  must not be used by anything else while the stream is
+  ///  alive. None of them are owned.
+  ///
+  ///  Requires linking boost_thread.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  class stream_analyzer {
+  public:
+    /// constructor
+    stream_analyzer(const tokenizer &, splitter &, size_t max_queued=16);
+    /// destructor, ends the stream and stops the stage threads
+    ~stream_analyzer();
+
+    /// append a processor stage. Must be called before the first feed()
+    void add_stage(const processor &);
+
+    /// tokenize and split more text, which should end at a token
+    /// boundary. If flush is set, pending words form a sentence even
+    /// without a sentence ender
+    void feed(const std::wstring &, bool flush=false);
+    /// end of input: flush the splitter and let the stages drain
+    void close();
+
+    /// wait for the next analyzed sentence and append it to the list.
+    /// Returns false once the stream is closed and fully drained
+    bool next(std::list<sentence> &);
+    /// as next(), but returns false at once if no sentence is ready
+    bool try_next(std::list<sentence> &);
+
+  private:
+    /// bounded queue of sentences between two stages
+    class queue {
+    public:
+      /// capacity 0 means unbounded
+      queue(size_t);
+      /// move the sentences in the list to the queue, waiting for room
+      void push(std::list<sentence> &);
+      /// move one sentence to the end of the list. false if closed and empty
+      bool pop(std::list<sentence> &, bool wait=true);
+      /// no more sentences will be pushed
+      void close();
+    private:
+      boost::mutex mtx;
+      boost::condition_variable not_empty, not_full;
+      std::list<sentence> items;
+      size_t count, capacity;
+      bool closed;
+    };
+
+    const tokenizer &tk;
+    splitter &sp;
+    size_t max_queued;
+    /// offset of the text fed so far, for word spans
+    unsigned long offset;
+    bool started, closed;
+
+    std::vector<const processor*> procs;
+    /// queues[i] feeds procs[i]; the last one holds analyzed sentences
+    std::vector<queue*> queues;
+    boost::thread_group workers;
+
+    /// first exception thrown by a stage, rethrown by next()
+    boost::mutex err_mtx;
+    boost::exception_ptr error;
+
+    /// start one thread per stage
+    void start();
+    /// stage thread body
+    void run_stage(size_t);
+    /// rethrow a stage's exception, if any
+    void check_error();
+
+    /// not copyable
+    stream_analyzer(const stream_analyzer &);
+    stream_analyzer& operator=(const stream_analyzer &);
+  };
+
+
+  ///////////////////////////////////////////////////////////////
+  /// Queue constructor.
+  ///////////////////////////////////////////////////////////////
+
+  inline stream_analyzer::queue::queue(size_t cap)
+    : count(0), capacity(cap), closed(false) {}
+
+  ///////////////////////////////////////////////////////////////
+  /// Move all sentences in ls to the queue, one at a time,
+  /// waiting for room. ls is left empty.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::queue::push(std::list<sentence> &ls) {
+    boost::mutex::scoped_lock lock(mtx);
+    while (not ls.empty()) {
+      while (capacity>0 and count>=capacity and not closed) not_full.wait(lock);
+      if (closed) { ls.clear(); return; }
+      items.splice(items.end(), ls, ls.begin());
+      count++;
+      not_empty.notify_one();
+    }
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Move the first queued sentence to the end of ls.
+  ///////////////////////////////////////////////////////////////
+
+  inline bool stream_analyzer::queue::pop(std::list<sentence> &ls, bool wait) {
+    boost::mutex::scoped_lock lock(mtx);
+    while (wait and items.empty() and not closed) not_empty.wait(lock);
+    if (items.empty()) return false;
+
+    ls.splice(ls.end(), items, items.begin());
+    count--;
+    not_full.notify_one();
+    return true;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Mark the queue as closed. Queued sentences can still be
+  /// popped; pending and later pushes are dropped.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::queue::close() {
+    boost::mutex::scoped_lock lock(mtx);
+    closed=true;
+    not_empty.notify_all();
+    not_full.notify_all();
+  }
+
+
+  ///////////////////////////////////////////////////////////////
+  /// Constructor. max_queued bounds every queue between stages.
+  ///////////////////////////////////////////////////////////////
+
+  inline stream_analyzer::stream_analyzer(const tokenizer &t, splitter &s, size_t mq)
+    : tk(t), sp(s), max_queued(mq>0 ? mq : 1), offset(0), started(false), closed(false) {}
+
+  ///////////////////////////////////////////////////////////////
+  /// Destructor. Closes the input and waits for the stages to
+  /// finish the sentences already queued.
+  ///////////////////////////////////////////////////////////////
+
+  inline stream_analyzer::~stream_analyzer() {
+    try {
+      close();
+    }
+    catch (...) {}
+    workers.join_all();
+    for (size_t i=0; i<queues.size(); i++) delete queues[i];
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Append a processor stage.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::add_stage(const processor &p) {
+    if (not started) procs.push_back(&p);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Create the queues and start one thread per stage.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::start() {
+    started=true;
+    for (size_t i=0; i<procs.size(); i++)
+      queues.push_back(new queue(max_queued));
+    queues.push_back(new queue(0));
+    for (size_t i=0; i<procs.size(); i++)
+      workers.create_thread(boost::bind(&stream_analyzer::run_stage, this, i));
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Tokenize and split text, queueing completed sentences.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::feed(const std::wstring &text, bool flush) {
+    if (closed) return;
+    if (not started) start();
+
+    std::list<word> lw;
+    tk.tokenize(text, offset, lw);
+
+    std::list<sentence> ls;
+    sp.split(lw, flush, ls);
+    queues.front()->push(ls);
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// End of input. Pending words form a last sentence.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::close() {
+    if (closed) return;
+    if (not started) start();
+
+    std::list<word> lw;
+    std::list<sentence> ls;
+    sp.split(lw, true, ls);
+    queues.front()->push(ls);
+
+    closed=true;
+    queues.front()->close();
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Wait for the next analyzed sentence.
+  ///////////////////////////////////////////////////////////////
+
+  inline bool stream_analyzer::next(std::list<sentence> &ls) {
+    if (not started) start();
+    bool b = queues.back()->pop(ls,true);
+    if (not b) check_error();
+    return b;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Get the next analyzed sentence if there is one ready.
+  ///////////////////////////////////////////////////////////////
+
+  inline bool stream_analyzer::try_next(std::list<sentence> &ls) {
+    if (not started) start();
+    bool b = queues.back()->pop(ls,false);
+    if (not b) check_error();
+    return b;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Stage thread: analyze sentences from queue i into queue i+1
+  /// until queue i is closed and empty, then close queue i+1.
+  /// A failing stage closes its input so the stream stops.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::run_stage(size_t i) {
+    std::list<sentence> ls;
+    while (queues[i]->pop(ls)) {
+      try {
+        procs[i]->analyze(ls.front());
+      }
+      catch (...) {
+        {
+          boost::mutex::scoped_lock lock(err_mtx);
+          if (not error) error = boost::current_exception();
+        }
+        // stop taking input; upstream pushes are dropped from now on
+        queues[i]->close();
+        break;
+      }
+      queues[i+1]->push(ls);
+    }
+    queues[i+1]->close();
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Rethrow the first exception thrown by a stage.
+  ///////////////////////////////////////////////////////////////
+
+  inline void stream_analyzer::check_error() {
+    boost::exception_ptr e;
+    {
+      boost::mutex::scoped_lock lock(err_mtx);
+      e = error;
+      error = boost::exception_ptr();
+    }
+    if (e) boost::rethrow_exception(e);
+  }
+
+} // namespace
+
+#endif
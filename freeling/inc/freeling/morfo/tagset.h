@@ -32,6 +32,8 @@
 #include <string>
 #include <map>
 #include <list>
+#include <deque>
+#include <boost/thread/mutex.hpp>
 
 #include "freeling/windll.h"
 
@@ -72,6 +74,117 @@ namespace freeling {
     std::wstring get_msf_string(const std::wstring &tag) const;
   };
 
+
+  ////////////////////////////////////////////////////////////////
+  /// The class tagset_cache decomposes each tag only once.
+  /// Tags are given a numeric id the first time they are seen,
+  /// and later lookups by id are plain indexed accesses.
+  /// The cache may be shared by several threads: its state is
+  /// guarded by a mutex, and entries never move once added, so the
+  /// references returned stay valid for the lifetime of the cache.
+  ////////////////////////////////////////////////////////////////
+
+  class tagset_cache {
+
+  private:
+    /// short tag and features computed for a tag
+    struct entry {
+      std::wstring short_tag;
+      std::list<std::pair<std::wstring,std::wstring> > features;
+      std::wstring msf_string;
+    };
+
+    /// tagset used to decompose new tags
+    const tagset &tags;
+    /// id assigned to each tag seen so far
+    mutable std::map<std::wstring,int> ids;
+    /// decomposition of each tag, indexed by id. A deque, so that
+    /// adding an entry does not move the ones already handed out.
+    mutable std::deque<entry> entries;
+    /// guards ids and entries
+    mutable boost::mutex mtx;
+
+  public:
+    /// constructor: cache conversions done by given tagset
+    tagset_cache(const tagset &);
+
+    /// get id for given tag, decomposing it if it is new
+    int get_id(const std::wstring &tag) const;
+
+    /// get short version of the tag with given id
+    const std::wstring & get_short_tag(int id) const;
+    /// get list of <feature,value> pairs for the tag with given id
+    const std::list<std::pair<std::wstring,std::wstring> > & get_msf_features(int id) const;
+    /// get <feature,value> pairs for the tag with given id, in a string format
+    const std::wstring & get_msf_string(int id) const;
+
+    /// same as above, looking up the tag id first
+    const std::wstring & get_short_tag(const std::wstring &tag) const;
+    const std::list<std::pair<std::wstring,std::wstring> > & get_msf_features(const std::wstring &tag) const;
+    const std::wstring & get_msf_string(const std::wstring &tag) const;
+
+    /// number of tags seen so far
+    int size() const;
+  };
+
+  /// tagset_cache methods definition. Inlined, so that no library rebuild is needed
+  //---------------------------------
+  inline tagset_cache::tagset_cache(const tagset &ts) : tags(ts) {}
+
+  //---------------------------------
+  inline int tagset_cache::get_id(const std::wstring &tag) const {
+    boost::mutex::scoped_lock lock(mtx);
+    std::map<std::wstring,int>::const_iterator p=ids.find(tag);
+    if (p!=ids.end()) return p->second;
+
+    int id=entries.size();
+    entries.push_back(entry());
+    entries.back().short_tag = tags.get_short_tag(tag);
+    entries.back().features = tags.get_msf_features(tag);
+    entries.back().msf_string = tags.get_msf_string(tag);
+    ids.insert(std::make_pair(tag,id));
+    return id;
+  }
+
+  //---------------------------------
+  inline const std::wstring & tagset_cache::get_short_tag(int id) const {
+    boost::mutex::scoped_lock lock(mtx);
+    return entries[id].short_tag;
+  }
+
+  //---------------------------------
+  inline const std::list<std::pair<std::wstring,std::wstring> > & tagset_cache::get_msf_features(int id) const {
+    boost::mutex::scoped_lock lock(mtx);
+    return entries[id].features;
+  }
+
+  //---------------------------------
+  inline const std::wstring & tagset_cache::get_msf_string(int id) const {
+    boost::mutex::scoped_lock lock(mtx);
+    return entries[id].msf_string;
+  }
+
+  //---------------------------------
+  inline const std::wstring & tagset_cache::get_short_tag(const std::wstring &tag) const {
+    return get_short_tag(get_id(tag));
+  }
+
+  //---------------------------------
+  inline const std::list<std::pair<std::wstring,std::wstring> > & tagset_cache::get_msf_features(const std::wstring &tag) const {
+    return get_msf_features(get_id(tag));
+  }
+
+  //---------------------------------
+  inline const std::wstring & tagset_cache::get_msf_string(const std::wstring &tag) const {
+    return get_msf_string(get_id(tag));
+  }
+
+  //---------------------------------
+  inline int tagset_cache::size() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return entries.size();
+  }
+
 } // namespace
 
 #endif
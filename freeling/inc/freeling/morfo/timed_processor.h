@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////
+//
+//    FreeLing - Open Source Language Analyzers
+//
+//    Copyright (C) 2004   TALP Research Center
+//                         Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public
+//    License as published by the Free Software Foundation; either
+//    version 3 of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@lsi.upc.es)
+//             TALP Research Center
+//             despatx C6.212 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#ifndef _TIMED_PROCESSOR
+#define _TIMED_PROCESSOR
+
+#include <list>
+#include <vector>
+#include <cmath>
+
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "freeling/morfo/language.h"
+#include "freeling/morfo/processor.h"
+
+namespace freeling {
+
+  ////////////////////////////////////////////////////////////////
+  ///
+  ///  Class timed_processor wraps a processor and measures it:
+  ///  how many sentences it analyzed, the time it spent on them,
+  ///  and the distribution of per-sentence latency. It can take
+  ///  the place of the wrapped module anywhere, including in a
+  ///  parallel_analyzer, to profile one stage of a pipeline:
+  ///
+  ///     timed_processor ttag(tagger);
+  ///     pa.add_stage(ttag);
+  ///     ...
+  ///     std::wcerr << ttag.sentences_per_second() << L" "
+  ///                << ttag.percentile(0.99) << std::endl;
+  ///
+  ///  When a whole list of sentences is analyzed in one call, each
+  ///  sentence in it is charged the average time of the call.
+  ///  Latencies are kept in a histogram with four buckets per
+  ///  power of two, so percentiles are exact to within 19%.
+  ///  Statistics may be read while analysis goes on.
+  ///
+  ///  Requires linking boost_chrono.
+  ///
+  //////////////////////////////////////////////////////////////////
+
+  class timed_processor : public processor {
+  public:
+    /// constructor. The wrapped processor is not owned
+    timed_processor(const processor &);
+
+    /// analyze sentence with the wrapped processor, timing it
+    void analyze(sentence &) const;
+    /// analyze sentences with the wrapped processor, timing it
+    void analyze(std::list<sentence> &) const;
+    using processor::analyze;
+
+    /// number of sentences analyzed
+    unsigned long sentences() const;
+    /// total time spent in the wrapped processor, in seconds,
+    /// summed over all threads
+    double seconds() const;
+    /// sentences analyzed per second of processor time
+    double sentences_per_second() const;
+    /// per-sentence latency, in seconds, below which the given
+    /// fraction (e.g. 0.99) of sentences fall
+    double percentile(double) const;
+    /// largest per-sentence latency, in seconds
+    double max_latency() const;
+    /// forget all measurements
+    void reset();
+
+  private:
+    typedef boost::chrono::steady_clock clock;
+
+    const processor &proc;
+
+    mutable boost::mutex mtx;
+    mutable unsigned long n_sent;
+    mutable boost::chrono::nanoseconds total, worst;
+    /// bucket i counts latencies up to 2^(i/4) microseconds
+    mutable std::vector<unsigned long> hist;
+
+    /// record one call that analyzed n sentences
+    void record(clock::duration, size_t) const;
+    /// upper bound of bucket i, in seconds
+    static double bucket_limit(size_t);
+  };
+
+
+  /// histogram size: up to 2^32 microseconds (over an hour)
+  static const size_t TIMED_PROCESSOR_BUCKETS = 4*32+1;
+
+
+  ///////////////////////////////////////////////////////////////
+  /// Constructor.
+  ///////////////////////////////////////////////////////////////
+
+  inline timed_processor::timed_processor(const processor &p)
+    : proc(p), n_sent(0), total(0), worst(0), hist(TIMED_PROCESSOR_BUCKETS,0) {}
+
+  ///////////////////////////////////////////////////////////////
+  /// Analyze with the wrapped processor and record the time
+  /// taken. Nothing is recorded if the processor throws.
+  ///////////////////////////////////////////////////////////////
+
+  inline void timed_processor::analyze(sentence &s) const {
+    clock::time_point start = clock::now();
+    proc.analyze(s);
+    record(clock::now()-start, 1);
+  }
+
+  inline void timed_processor::analyze(std::list<sentence> &ls) const {
+    clock::time_point start = clock::now();
+    proc.analyze(ls);
+    record(clock::now()-start, ls.size());
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Add a call to the statistics, charging each of its n
+  /// sentences with the average time.
+  ///////////////////////////////////////////////////////////////
+
+  inline void timed_processor::record(clock::duration d, size_t n) const {
+    if (n==0) return;
+    boost::chrono::nanoseconds ns = boost::chrono::duration_cast<boost::chrono::nanoseconds>(d);
+    boost::chrono::nanoseconds each = ns/n;
+
+    double us = double(each.count())/1000.0;
+    size_t b = 0;
+    if (us>1.0) b = size_t(std::ceil(4.0*std::log(us)/std::log(2.0)));
+    if (b>=TIMED_PROCESSOR_BUCKETS) b = TIMED_PROCESSOR_BUCKETS-1;
+
+    boost::mutex::scoped_lock lock(mtx);
+    n_sent += n;
+    total += ns;
+    if (each>worst) worst = each;
+    hist[b] += n;
+  }
+
+  inline double timed_processor::bucket_limit(size_t i) {
+    return std::pow(2.0, double(i)/4.0) / 1e6;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Statistics.
+  ///////////////////////////////////////////////////////////////
+
+  inline unsigned long timed_processor::sentences() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return n_sent;
+  }
+
+  inline double timed_processor::seconds() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return double(total.count())/1e9;
+  }
+
+  inline double timed_processor::sentences_per_second() const {
+    boost::mutex::scoped_lock lock(mtx);
+    if (total.count()==0) return 0;
+    return double(n_sent)*1e9/double(total.count());
+  }
+
+  inline double timed_processor::max_latency() const {
+    boost::mutex::scoped_lock lock(mtx);
+    return double(worst.count())/1e9;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Latency below which fraction q of the sentences fall, as
+  /// the upper bound of the histogram bucket reaching q. Never
+  /// more than the largest latency seen.
+  ///////////////////////////////////////////////////////////////
+
+  inline double timed_processor::percentile(double q) const {
+    boost::mutex::scoped_lock lock(mtx);
+    if (n_sent==0) return 0;
+
+    double target = q*double(n_sent);
+    unsigned long seen = 0;
+    double w = double(worst.count())/1e9;
+    for (size_t i=0; i<hist.size(); i++) {
+      seen += hist[i];
+      if (double(seen) >= target and seen>0) {
+        double lim = bucket_limit(i);
+        return (lim<w ? lim : w);
+      }
+    }
+    return w;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  /// Forget all measurements.
+  ///////////////////////////////////////////////////////////////
+
+  inline void timed_processor::reset() {
+    boost::mutex::scoped_lock lock(mtx);
+    n_sent = 0;
+    total = worst = boost::chrono::nanoseconds(0);
+    hist.assign(hist.size(), 0);
+  }
+
+} // namespace
+
+#endif
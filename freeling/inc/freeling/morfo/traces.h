@@ -71,6 +71,20 @@
 //#define AVAILABLE           0x40000000
 //#define AVAILABLE           0x80000000
 
+/// Compile-time trace filters. Traces above TRACE_MAX_LEVEL, or from
+/// modules not in TRACE_MODULES, are removed by the compiler together with
+/// their arguments. Override them with e.g. -DTRACE_MAX_LEVEL=2
+/// -DTRACE_MODULES=TAGGER_TRACE|DICT_TRACE
+#ifndef TRACE_MAX_LEVEL
+#define TRACE_MAX_LEVEL     0x7fffffff
+#endif
+#ifndef TRACE_MODULES
+#define TRACE_MODULES       0xffffffffUL
+#endif
+
+/// Number of trace counters kept in -DTRACE_COUNTERS mode, one per module bit
+#define TRACE_NUM_MODULES   32
+
 /// MOD_TRACECODE and MOD_TRACENAME are empty. The class 
 /// using the trace is expected to set them
 #undef MOD_TRACECODE
@@ -96,9 +110,65 @@ namespace freeling {
     static void trace_word_list(int,const std::list<word> &, const std::wstring &, unsigned long);
     static void trace_sentence(int,const sentence &, const std::wstring &, unsigned long);
     static void trace_sentence_list(int,const std::list<sentence> &, const std::wstring &, unsigned long);
+
+    /// whether a trace of given level and module would be displayed
+    static bool enabled(int, unsigned long);
+
+    /// trace counters, used by the TRACE macros in -DTRACE_COUNTERS mode
+    static void count(unsigned long);
+    static unsigned long get_count(unsigned long);
+    static void reset_counts();
+    static void dump_counts(std::wostream &);
+
+  private:
+    static unsigned long *counters();
+    static int module_index(unsigned long);
   };
 
   /// static trace methods definition.  Inlined for efficiency
+  //---------------------------------
+  inline bool traces::enabled(int lv, unsigned long modcode) {
+    return traces::TraceLevel>=lv && (traces::TraceModule&modcode);
+  }
+
+  //---------------------------------
+  /// Counters live in a function-local static so that they need no
+  /// definition in the library. Increments are not synchronized, so counts
+  /// gathered from several threads are approximate.
+  inline unsigned long *traces::counters() {
+    static unsigned long c[TRACE_NUM_MODULES];
+    return c;
+  }
+
+  //---------------------------------
+  inline int traces::module_index(unsigned long modcode) {
+    int i=0;
+    while (i<TRACE_NUM_MODULES-1 && !(modcode & (1UL<<i))) i++;
+    return i;
+  }
+
+  //---------------------------------
+  inline void traces::count(unsigned long modcode) {
+    counters()[module_index(modcode)]++;
+  }
+
+  //---------------------------------
+  inline unsigned long traces::get_count(unsigned long modcode) {
+    return counters()[module_index(modcode)];
+  }
+
+  //---------------------------------
+  inline void traces::reset_counts() {
+    for (int i=0; i<TRACE_NUM_MODULES; i++) counters()[i]=0;
+  }
+
+  //---------------------------------
+  inline void traces::dump_counts(std::wostream &out) {
+    for (int i=0; i<TRACE_NUM_MODULES; i++)
+      if (counters()[i]>0)
+        out<<L"0x"<<std::hex<<(1UL<<i)<<std::dec<<L": "<<counters()[i]<<std::endl;
+  }
+
   //---------------------------------
   inline void traces::error_crash(const std::wstring &msg, const std::wstring &modname, unsigned long modcode) {
     std::wcerr<<modname<<L": "<<msg<<std::endl; 
@@ -202,13 +272,28 @@ namespace freeling {
 
 /// Tracing macros. Compile with -DVERBOSE to get a traceable code.
 /// Compile without -DVERBOSE (default) to get faster, non-traceable, exploitation version.
+/// Compile with -DTRACE_COUNTERS instead of -DVERBOSE to only count, per module,
+/// how many trace points are reached. Nothing is formatted or displayed.
+
+/// true if the trace survives the compile-time filters (a constant for literal levels)
+#define TRACE_COMPILED(x) ((x)<=TRACE_MAX_LEVEL && (MOD_TRACECODE&(TRACE_MODULES)))
+
 #ifdef VERBOSE   
-/// ifdef VERBOSE --> TRACE macros exists
-#define TRACE(x,y) freeling::traces::trace(x,y,MOD_TRACENAME,MOD_TRACECODE)
-#define TRACE_WORD(x,y) freeling::traces::trace_word(x,y,MOD_TRACENAME,MOD_TRACECODE)
-#define TRACE_WORD_LIST(x,y) freeling::traces::trace_word_list(x,y,MOD_TRACENAME,MOD_TRACECODE)
-#define TRACE_SENTENCE(x,y) freeling::traces::trace_sentence(x,y,MOD_TRACENAME,MOD_TRACECODE)
-#define TRACE_SENTENCE_LIST(x,y) freeling::traces::trace_sentence_list(x,y,MOD_TRACENAME,MOD_TRACECODE)
+/// ifdef VERBOSE --> TRACE macros exists. Arguments are only evaluated when the trace is displayed.
+#define TRACE_IF_ENABLED(x,call) do { if (TRACE_COMPILED(x) && freeling::traces::enabled(x,MOD_TRACECODE)) call; } while (0)
+#define TRACE(x,y) TRACE_IF_ENABLED(x,freeling::traces::trace(x,y,MOD_TRACENAME,MOD_TRACECODE))
+#define TRACE_WORD(x,y) TRACE_IF_ENABLED(x,freeling::traces::trace_word(x,y,MOD_TRACENAME,MOD_TRACECODE))
+#define TRACE_WORD_LIST(x,y) TRACE_IF_ENABLED(x,freeling::traces::trace_word_list(x,y,MOD_TRACENAME,MOD_TRACECODE))
+#define TRACE_SENTENCE(x,y) TRACE_IF_ENABLED(x,freeling::traces::trace_sentence(x,y,MOD_TRACENAME,MOD_TRACECODE))
+#define TRACE_SENTENCE_LIST(x,y) TRACE_IF_ENABLED(x,freeling::traces::trace_sentence_list(x,y,MOD_TRACENAME,MOD_TRACECODE))
+#elif defined(TRACE_COUNTERS)
+/// ifdef TRACE_COUNTERS --> trace points are counted, not displayed. Arguments are not evaluated.
+#define TRACE_COUNT(x) do { if (TRACE_COMPILED(x)) freeling::traces::count(MOD_TRACECODE); } while (0)
+#define TRACE(x,y) TRACE_COUNT(x)
+#define TRACE_WORD(x,y) TRACE_COUNT(x)
+#define TRACE_WORD_LIST(x,y) TRACE_COUNT(x)
+#define TRACE_SENTENCE(x,y) TRACE_COUNT(x)
+#define TRACE_SENTENCE_LIST(x,y) TRACE_COUNT(x)
 #else
 /// ifndef VERBOSE --> No messages displayed. Faster code.
 #define TRACE(x,y)
@@ -133,6 +133,12 @@ namespace freeling {
     template<class C> static C wstring_to(const std::wstring &, const std::wstring &, bool mcsep=true);
     template<class C> static C wstring_to(const std::wstring &);
 
+    /// utf8 <-> wstring conversion into a caller-owned buffer, which is
+    /// overwritten and may be reused across calls to avoid reallocation
+    static void utf8_to_wstring(const char *, size_t, std::wstring &);
+    static void utf8_to_wstring(const std::string &, std::wstring &);
+    static void wstring_to_utf8(const std::wstring &, std::string &);
+
     template<class P1,class P2> static std::wstring pairlist2wstring(const std::list<std::pair<P1,P2> > &, const std::wstring &, const std::wstring &);
     template<class P1,class P2> static std::list<std::pair<P1,P2> > wstring2pairlist(const std::wstring &, const std::wstring &, const std::wstring &);
 
@@ -215,13 +221,37 @@ namespace freeling {
   template<>
     inline std::wstring util::wstring_from(const std::string &s) {
     std::wstring ws;
+    utf8_to_wstring(s, ws);
+    return ws; 
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// Convert utf8 text to a wstring, replacing the contents of ws.
+  /// The leading ASCII part is copied directly; the rest, if any, goes
+  /// through the utf8 decoder.
+  /////////////////////////////////////////////////////////////////////////////
+
+  inline void util::utf8_to_wstring(const char *s, size_t n, std::wstring &ws) {
+    ws.clear();
+    // no utf8 sequence decodes to more code units than it has bytes.
+    // Only grow: reserve() with a smaller size may shrink the buffer
+    // a caller is reusing.
+    if (ws.capacity()<n) ws.reserve(n);
+
+    size_t i=0;
+    while (i<n and (unsigned char)s[i]<0x80) ws.push_back(wchar_t(s[i++]));
+    if (i==n) return;
+
     if (sizeof(std::wstring::value_type)==2) 
-      utf8::utf8to16(s.begin(), s.end(), back_inserter(ws));
+      utf8::utf8to16(s+i, s+n, back_inserter(ws));
     else if (sizeof(std::wstring::value_type)==4) 
-      utf8::utf8to32(s.begin(), s.end(), back_inserter(ws));
+      utf8::utf8to32(s+i, s+n, back_inserter(ws));
     else 
       WARNING(L"Unexpected wchar size "+wstring_from<int>(sizeof(std::wstring::value_type)));
-    return ws; 
+  }
+
+  inline void util::utf8_to_wstring(const std::string &s, std::wstring &ws) {
+    utf8_to_wstring(s.data(), s.size(), ws);
   }
 
 
@@ -270,14 +300,29 @@ namespace freeling {
   template<>
     inline std::string util::wstring_to(const std::wstring &ws) {
     std::string s;
+    wstring_to_utf8(ws, s);
+    return s;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// Convert a wstring to utf8, replacing the contents of s.
+  /// The leading ASCII part is copied directly.
+  /////////////////////////////////////////////////////////////////////////////
+
+  inline void util::wstring_to_utf8(const std::wstring &ws, std::string &s) {
+    s.clear();
+    if (s.capacity()<ws.size()) s.reserve(ws.size());
+
+    std::wstring::const_iterator c=ws.begin();
+    while (c!=ws.end() and (unsigned long)(*c)<0x80) s.push_back(char(*c++));
+    if (c==ws.end()) return;
+
     if (sizeof(std::wstring::value_type)==2) 
-      utf8::utf16to8(ws.begin(), ws.end(), back_inserter(s));
+      utf8::utf16to8(c, ws.end(), back_inserter(s));
     else if (sizeof(std::wstring::value_type)==4) 
-      utf8::utf32to8(ws.begin(), ws.end(), back_inserter(s));
+      utf8::utf32to8(c, ws.end(), back_inserter(s));
     else 
       WARNING(L"Unexpected wchar size "+wstring_from<int>(sizeof(std::wstring::value_type)));
-
-    return s;
   }
 
 
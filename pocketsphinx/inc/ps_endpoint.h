@@ -0,0 +1,183 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2013 Carnegie Mellon University.  All rights
+ * reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * This work was supported in part by funding from the Defense Advanced 
+ * Research Projects Agency and the National Science Foundation of the 
+ * United States of America, and the CMU Sphinx Speech Consortium.
+ *
+ * THIS SOFTWARE IS PROVIDED BY CARNEGIE MELLON UNIVERSITY ``AS IS'' AND 
+ * ANY EXPRESSED OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL CARNEGIE MELLON UNIVERSITY
+ * NOR ITS EMPLOYEES BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ */
+
+/**
+ * @file ps_endpoint.h Early detection of final hypotheses
+ *
+ * With a closed grammar the hypothesis is often complete well before
+ * the trailing silence that ends the utterance.  An endpoint tracker
+ * watches the partial hypothesis after each block of input and reports
+ * it as "likely final" once it has reached a final state of the
+ * grammar and has not changed for a given number of frames:
+ *
+ * <pre>
+ * ps_endpoint_init(&ep, 20);
+ * ps_start_utt(ps, NULL);
+ * while (... read audio ...) {
+ *     ps_process_raw(ps, buf, n, FALSE, FALSE);
+ *     if ((hyp = ps_endpoint_update(&ep, ps)) != NULL)
+ *         act_on(hyp);
+ * }
+ * ps_end_utt(ps);
+ * ps_endpoint_reset(&ep);
+ * </pre>
+ *
+ * The result is only a prediction.  The hypothesis returned by
+ * ps_get_hyp() after ps_end_utt() remains the final one and should be
+ * used to confirm or cancel what was started early.
+ *
+ * ps_get_prob() returns no posterior for partial hypotheses, so the
+ * tracker relies on grammar finality and stability alone.
+ */
+
+#ifndef __PS_ENDPOINT_H__
+#define __PS_ENDPOINT_H__
+
+#include <string.h>
+
+/* SphinxBase headers. */
+#include <sphinxbase/prim_type.h>
+#include <sphinxbase/ckd_alloc.h>
+
+/* PocketSphinx headers. */
+#include <pocketsphinx.h>
+
+#if defined(__cplusplus) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+#define PS_ENDPOINT_INLINE static inline
+#elif defined(__GNUC__)
+#define PS_ENDPOINT_INLINE static __inline__
+#elif defined(_MSC_VER)
+#define PS_ENDPOINT_INLINE static __inline
+#else
+#define PS_ENDPOINT_INLINE static
+#endif
+
+/**
+ * Endpoint tracker state.
+ */
+typedef struct ps_endpoint_s {
+    int32 stable_frames; /**< Frames the hypothesis must stay unchanged. */
+    int32 changed_frame; /**< Frame at which the hypothesis last changed. */
+    int32 emitted;       /**< Whether a result was reported for this utterance. */
+    char *hyp;           /**< Copy of the last partial hypothesis. */
+} ps_endpoint_t;
+
+/**
+ * Initialize an endpoint tracker.
+ *
+ * @param ep Tracker to initialize.
+ * @param stable_frames Number of frames a final hypothesis must remain
+ *        unchanged before it is reported.
+ */
+PS_ENDPOINT_INLINE void
+ps_endpoint_init(ps_endpoint_t *ep, int32 stable_frames)
+{
+    ep->stable_frames = stable_frames;
+    ep->changed_frame = 0;
+    ep->emitted = FALSE;
+    ep->hyp = NULL;
+}
+
+/**
+ * Reset an endpoint tracker for a new utterance.
+ */
+PS_ENDPOINT_INLINE void
+ps_endpoint_reset(ps_endpoint_t *ep)
+{
+    ckd_free(ep->hyp);
+    ep->hyp = NULL;
+    ep->changed_frame = 0;
+    ep->emitted = FALSE;
+}
+
+/**
+ * Release the memory held by an endpoint tracker.
+ */
+PS_ENDPOINT_INLINE void
+ps_endpoint_free(ps_endpoint_t *ep)
+{
+    ps_endpoint_reset(ep);
+}
+
+/**
+ * Check the current partial hypothesis.
+ *
+ * Call after each ps_process_raw() or ps_process_cep() during an
+ * utterance.
+ *
+ * @param ep Tracker.
+ * @param ps Decoder, between ps_start_utt() and ps_end_utt().
+ * @return The hypothesis, the first time it is found to be likely
+ *         final in this utterance, NULL otherwise.  The string is owned
+ *         by the tracker and is valid until the next call.
+ */
+PS_ENDPOINT_INLINE char const *
+ps_endpoint_update(ps_endpoint_t *ep, ps_decoder_t *ps)
+{
+    char const *hyp;
+    int32 is_final = FALSE;
+    int32 frame;
+
+    if (ep->emitted)
+        return NULL;
+
+    hyp = ps_get_hyp_final(ps, &is_final);
+    frame = ps_get_n_frames(ps);
+
+    if (hyp == NULL || *hyp == '\0') {
+        ckd_free(ep->hyp);
+        ep->hyp = NULL;
+        ep->changed_frame = frame;
+        return NULL;
+    }
+
+    if (ep->hyp == NULL || strcmp(ep->hyp, hyp) != 0) {
+        ckd_free(ep->hyp);
+        ep->hyp = ckd_salloc(hyp);
+        ep->changed_frame = frame;
+        return NULL;
+    }
+
+    if (is_final && frame - ep->changed_frame >= ep->stable_frames) {
+        ep->emitted = TRUE;
+        return ep->hyp;
+    }
+
+    return NULL;
+}
+
+#endif /* __PS_ENDPOINT_H__ */
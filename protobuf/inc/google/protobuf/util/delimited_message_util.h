@@ -0,0 +1,259 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+// http://code.google.com/p/protobuf/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Utilities for streams of length-delimited messages: each message is
+// preceded by its size as a varint, the same framing used by Java's
+// writeDelimitedTo() and parseDelimitedFrom().
+//
+// Besides writing and parsing such streams, DelimitedRecordReader walks
+// the records of an in-memory stream without parsing them, and
+// FindLengthDelimitedField() locates one sub-message or string field of
+// a serialized message by skipping over the others.  Together they let a
+// reader parse only the records and fields it actually looks at:
+//
+//   DelimitedRecordReader reader(data, size);
+//   const void* record;
+//   int record_size;
+//   while (reader.Next(&record, &record_size)) {
+//     const void* field;
+//     int field_size;
+//     if (FindLengthDelimitedField(record, record_size, 3,
+//                                  &field, &field_size)) {
+//       Lattice lattice;
+//       lattice.ParseFromArray(field, field_size);
+//       ...
+//     }
+//   }
+//   if (reader.failed()) { ... }
+//
+// The functions are defined inline here, so nothing needs to be added
+// to the protobuf libraries.
+
+#ifndef GOOGLE_PROTOBUF_UTIL_DELIMITED_MESSAGE_UTIL_H__
+#define GOOGLE_PROTOBUF_UTIL_DELIMITED_MESSAGE_UTIL_H__
+
+#include <climits>
+
+#include <google/protobuf/message_lite.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <google/protobuf/stubs/common.h>
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+// Writes the size of the message as a varint, followed by the message.
+// Returns false if the output failed.
+inline bool SerializeDelimitedToCodedStream(const MessageLite& message,
+                                            io::CodedOutputStream* output);
+
+// Same as above, over a ZeroCopyOutputStream.
+inline bool SerializeDelimitedToZeroCopyStream(const MessageLite& message,
+                                               io::ZeroCopyOutputStream* output);
+
+// Reads one size-prefixed message.  Returns false on error or at end of
+// input; if clean_eof is not NULL it is set to true in the latter case,
+// when the input ended exactly between two messages.
+//
+// The total bytes limit of the CodedInputStream applies to the whole
+// stream, so long streams should be read with the ZeroCopy version,
+// which uses a fresh CodedInputStream for every message.
+inline bool ParseDelimitedFromCodedStream(MessageLite* message,
+                                          io::CodedInputStream* input,
+                                          bool* clean_eof);
+
+// Same as above, over a ZeroCopyInputStream.
+inline bool ParseDelimitedFromZeroCopyStream(MessageLite* message,
+                                             io::ZeroCopyInputStream* input,
+                                             bool* clean_eof);
+
+// Finds the first occurrence of the given field in a serialized message,
+// which must have the length-delimited wire type (a sub-message, string,
+// bytes or packed repeated field).  On success, points *field_data at its
+// contents within data and sets *field_size.  Other fields are skipped
+// without being parsed.  Returns false if the field is absent or the
+// data is malformed.
+//
+// A non-repeated sub-message sent in several pieces is meant to be merged
+// by the parser; only the first piece is found here.
+inline bool FindLengthDelimitedField(const void* data, int size,
+                                     int field_number,
+                                     const void** field_data,
+                                     int* field_size);
+
+// Iterates over the records of a length-delimited stream held in memory,
+// returning pointers into the buffer, which must outlive the reader.
+class DelimitedRecordReader {
+ public:
+  DelimitedRecordReader(const void* data, int size)
+    : data_(reinterpret_cast<const uint8*>(data)), size_(size),
+      position_(0), failed_(false) {}
+
+  // Points *record_data at the next record and sets *record_size.
+  // Returns false at the end of the buffer, or if a record is truncated,
+  // after which failed() returns true.
+  inline bool Next(const void** record_data, int* record_size);
+
+  // Parses the next record into message.  Same return value as Next(),
+  // but a record that does not parse also sets failed().
+  inline bool NextMessage(MessageLite* message);
+
+  // The number of bytes consumed so far.
+  int position() const { return position_; }
+
+  // true if the buffer was malformed.
+  bool failed() const { return failed_; }
+
+ private:
+  const uint8* data_;
+  int size_;
+  int position_;
+  bool failed_;
+
+  GOOGLE_DISALLOW_EVIL_CONSTRUCTORS(DelimitedRecordReader);
+};
+
+// ===================================================================
+// inline implementations
+
+inline bool SerializeDelimitedToCodedStream(const MessageLite& message,
+                                            io::CodedOutputStream* output) {
+  const int size = message.ByteSize();
+  output->WriteVarint32(size);
+
+  uint8* buffer = output->GetDirectBufferForNBytesAndAdvance(size);
+  if (buffer != NULL) {
+    message.SerializeWithCachedSizesToArray(buffer);
+  } else {
+    message.SerializeWithCachedSizes(output);
+  }
+  return !output->HadError();
+}
+
+inline bool SerializeDelimitedToZeroCopyStream(const MessageLite& message,
+                                               io::ZeroCopyOutputStream* output) {
+  io::CodedOutputStream coded_output(output);
+  return SerializeDelimitedToCodedStream(message, &coded_output);
+}
+
+inline bool ParseDelimitedFromCodedStream(MessageLite* message,
+                                          io::CodedInputStream* input,
+                                          bool* clean_eof) {
+  if (clean_eof != NULL) *clean_eof = false;
+  const int start = input->CurrentPosition();
+
+  uint32 size;
+  if (!input->ReadVarint32(&size)) {
+    if (clean_eof != NULL) *clean_eof = input->CurrentPosition() == start;
+    return false;
+  }
+
+  // PushLimit takes an int; a larger size would turn negative and lift the
+  // limit instead of enforcing it.
+  if (size > static_cast<uint32>(INT_MAX)) return false;
+
+  io::CodedInputStream::Limit limit = input->PushLimit(static_cast<int>(size));
+  if (!message->ParseFromCodedStream(input)) return false;
+  if (!input->ConsumedEntireMessage()) return false;
+  input->PopLimit(limit);
+  return true;
+}
+
+inline bool ParseDelimitedFromZeroCopyStream(MessageLite* message,
+                                             io::ZeroCopyInputStream* input,
+                                             bool* clean_eof) {
+  io::CodedInputStream coded_input(input);
+  return ParseDelimitedFromCodedStream(message, &coded_input, clean_eof);
+}
+
+inline bool FindLengthDelimitedField(const void* data, int size,
+                                     int field_number,
+                                     const void** field_data,
+                                     int* field_size) {
+  io::CodedInputStream input(reinterpret_cast<const uint8*>(data), size);
+
+  for (uint32 tag = input.ReadTag(); tag != 0; tag = input.ReadTag()) {
+    if (internal::WireFormatLite::GetTagFieldNumber(tag) == field_number &&
+        internal::WireFormatLite::GetTagWireType(tag) ==
+          internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32 length;
+      if (!input.ReadVarint32(&length)) return false;
+      const int offset = input.CurrentPosition();
+      if (length > static_cast<uint32>(size - offset)) return false;
+      *field_data = reinterpret_cast<const uint8*>(data) + offset;
+      *field_size = static_cast<int>(length);
+      return true;
+    }
+    if (!internal::WireFormatLite::SkipField(&input, tag)) return false;
+  }
+  return false;
+}
+
+inline bool DelimitedRecordReader::Next(const void** record_data,
+                                        int* record_size) {
+  if (failed_ || position_ == size_) return false;
+
+  // A fresh stream per record keeps the total bytes limit per record.
+  io::CodedInputStream input(data_ + position_, size_ - position_);
+  uint32 length;
+  if (!input.ReadVarint32(&length)) {
+    failed_ = true;
+    return false;
+  }
+  const int start = position_ + input.CurrentPosition();
+  if (length > static_cast<uint32>(size_ - start)) {
+    failed_ = true;
+    return false;
+  }
+
+  *record_data = data_ + start;
+  *record_size = static_cast<int>(length);
+  position_ = start + static_cast<int>(length);
+  return true;
+}
+
+inline bool DelimitedRecordReader::NextMessage(MessageLite* message) {
+  const void* record_data;
+  int record_size;
+  if (!Next(&record_data, &record_size)) return false;
+  if (!message->ParseFromArray(record_data, record_size)) {
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#endif  // GOOGLE_PROTOBUF_UTIL_DELIMITED_MESSAGE_UTIL_H__
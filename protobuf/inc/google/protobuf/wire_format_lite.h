@@ -384,6 +384,21 @@ class LIBPROTOBUF_EXPORT WireFormatLite {
   static inline uint8* WriteBoolNoTagToArray    (bool value, output) INL;
   static inline uint8* WriteEnumNoTagToArray    (int value, output) INL;
 
+  // Write the elements of a packed fixed-size field, without the tag and
+  // length.  On little-endian machines this is a single copy.
+  static inline uint8* WriteFixed32NoTagToArray(
+    const RepeatedField<uint32>& value, output);
+  static inline uint8* WriteFixed64NoTagToArray(
+    const RepeatedField<uint64>& value, output);
+  static inline uint8* WriteSFixed32NoTagToArray(
+    const RepeatedField<int32>& value, output);
+  static inline uint8* WriteSFixed64NoTagToArray(
+    const RepeatedField<int64>& value, output);
+  static inline uint8* WriteFloatNoTagToArray(
+    const RepeatedField<float>& value, output);
+  static inline uint8* WriteDoubleNoTagToArray(
+    const RepeatedField<double>& value, output);
+
   // Write fields, including tags.
   static inline uint8* WriteInt32ToArray(
     field_number, int32 value, output) INL;
@@ -490,6 +505,18 @@ class LIBPROTOBUF_EXPORT WireFormatLite {
       google::protobuf::io::CodedInputStream* input,
       RepeatedField<CType>* value) GOOGLE_ATTRIBUTE_ALWAYS_INLINE;
 
+  // Like ReadRepeatedFixedSizePrimitive, for packed fields: the elements
+  // are read straight from the buffer into space reserved up front.
+  template <typename CType, enum FieldType DeclaredType>
+  static inline bool ReadPackedFixedSizePrimitive(
+      google::protobuf::io::CodedInputStream* input,
+      RepeatedField<CType>* value);
+
+  // Helper for the packed fixed-size writers above.
+  template <typename CType, uint8* (*Writer)(CType, uint8*)>
+  static inline uint8* WriteFixedSizeNoTagToArray(
+      const RepeatedField<CType>& value, uint8* target);
+
   static const CppType kFieldTypeToCppTypeMap[];
   static const WireFormatLite::WireType kWireTypeForFieldType[];
 
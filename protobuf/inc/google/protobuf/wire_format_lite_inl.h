@@ -333,6 +333,80 @@ inline bool WireFormatLite::ReadPackedPrimitive(io::CodedInputStream* input,
   return true;
 }
 
+template <typename CType, enum WireFormatLite::FieldType DeclaredType>
+inline bool WireFormatLite::ReadPackedFixedSizePrimitive(
+    io::CodedInputStream* input,
+    RepeatedField<CType>* values) {
+  uint32 length;
+  if (!input->ReadVarint32(&length)) return false;
+  const uint32 new_entries = length / sizeof(CType);
+  if (new_entries * sizeof(CType) != length) return false;
+
+  // Reserve space for all the elements at once, unless the length is more
+  // than the enclosing message has left, in which case it may be bogus and
+  // must not drive a large allocation.
+  const int bytes_limit = input->BytesUntilLimit();
+  const bool reserve =
+      bytes_limit >= 0 && length <= static_cast<uint32>(bytes_limit);
+  if (reserve) values->Reserve(values->size() + new_entries);
+
+  CType value;
+  uint32 remaining = new_entries;
+  while (remaining > 0) {
+    // Read as many elements as the current buffer holds without any
+    // per-element bounds check.
+    const void* void_pointer;
+    int size;
+    input->GetDirectBufferPointerInline(&void_pointer, &size);
+    uint32 in_buffer = static_cast<uint32>(size) / sizeof(CType);
+    if (in_buffer > remaining) in_buffer = remaining;
+    if (!reserve) {
+      const int capacity_left = values->Capacity() - values->size();
+      if (in_buffer > static_cast<uint32>(capacity_left)) {
+        in_buffer = capacity_left;
+      }
+    }
+
+    if (in_buffer == 0) {
+      // The next element straddles two buffers, or needs more space.
+      if (!ReadPrimitive<CType, DeclaredType>(input, &value)) return false;
+      values->Add(value);
+      remaining--;
+      continue;
+    }
+
+    const uint8* buffer = reinterpret_cast<const uint8*>(void_pointer);
+    for (uint32 i = 0; i < in_buffer; i++) {
+      buffer = ReadPrimitiveFromArray<CType, DeclaredType>(buffer, &value);
+      values->AddAlreadyReserved(value);
+    }
+    input->Skip(static_cast<int>(in_buffer * sizeof(CType)));
+    remaining -= in_buffer;
+  }
+  return true;
+}
+
+// Specializations of ReadPackedPrimitive for the fixed size types, which use
+// the optimized code path.
+#define READ_PACKED_FIXED_SIZE_PRIMITIVE(CPPTYPE, DECLARED_TYPE)               \
+template <>                                                                    \
+inline bool WireFormatLite::ReadPackedPrimitive<                               \
+  CPPTYPE, WireFormatLite::DECLARED_TYPE>(                                     \
+    io::CodedInputStream* input,                                               \
+    RepeatedField<CPPTYPE>* values) {                                          \
+  return ReadPackedFixedSizePrimitive<                                         \
+    CPPTYPE, WireFormatLite::DECLARED_TYPE>(input, values);                    \
+}
+
+READ_PACKED_FIXED_SIZE_PRIMITIVE(uint32, TYPE_FIXED32)
+READ_PACKED_FIXED_SIZE_PRIMITIVE(uint64, TYPE_FIXED64)
+READ_PACKED_FIXED_SIZE_PRIMITIVE(int32, TYPE_SFIXED32)
+READ_PACKED_FIXED_SIZE_PRIMITIVE(int64, TYPE_SFIXED64)
+READ_PACKED_FIXED_SIZE_PRIMITIVE(float, TYPE_FLOAT)
+READ_PACKED_FIXED_SIZE_PRIMITIVE(double, TYPE_DOUBLE)
+
+#undef READ_PACKED_FIXED_SIZE_PRIMITIVE
+
 template <typename CType, enum WireFormatLite::FieldType DeclaredType>
 bool WireFormatLite::ReadPackedPrimitiveNoInline(io::CodedInputStream* input,
                                                  RepeatedField<CType>* values) {
@@ -558,6 +632,52 @@ inline uint8* WireFormatLite::WriteDoubleNoTagToArray(double value,
   return io::CodedOutputStream::WriteLittleEndian64ToArray(EncodeDouble(value),
                                                            target);
 }
+
+template <typename CType, uint8* (*Writer)(CType, uint8*)>
+inline uint8* WireFormatLite::WriteFixedSizeNoTagToArray(
+    const RepeatedField<CType>& value, uint8* target) {
+#if defined(PROTOBUF_LITTLE_ENDIAN)
+  const int size = value.size() * static_cast<int>(sizeof(CType));
+  if (size > 0) memcpy(target, value.data(), size);
+  return target + size;
+#else
+  for (int i = 0; i < value.size(); i++) {
+    target = Writer(value.Get(i), target);
+  }
+  return target;
+#endif
+}
+
+inline uint8* WireFormatLite::WriteFixed32NoTagToArray(
+    const RepeatedField<uint32>& value, uint8* target) {
+  return WriteFixedSizeNoTagToArray<uint32, WriteFixed32NoTagToArray>(
+      value, target);
+}
+inline uint8* WireFormatLite::WriteFixed64NoTagToArray(
+    const RepeatedField<uint64>& value, uint8* target) {
+  return WriteFixedSizeNoTagToArray<uint64, WriteFixed64NoTagToArray>(
+      value, target);
+}
+inline uint8* WireFormatLite::WriteSFixed32NoTagToArray(
+    const RepeatedField<int32>& value, uint8* target) {
+  return WriteFixedSizeNoTagToArray<int32, WriteSFixed32NoTagToArray>(
+      value, target);
+}
+inline uint8* WireFormatLite::WriteSFixed64NoTagToArray(
+    const RepeatedField<int64>& value, uint8* target) {
+  return WriteFixedSizeNoTagToArray<int64, WriteSFixed64NoTagToArray>(
+      value, target);
+}
+inline uint8* WireFormatLite::WriteFloatNoTagToArray(
+    const RepeatedField<float>& value, uint8* target) {
+  return WriteFixedSizeNoTagToArray<float, WriteFloatNoTagToArray>(
+      value, target);
+}
+inline uint8* WireFormatLite::WriteDoubleNoTagToArray(
+    const RepeatedField<double>& value, uint8* target) {
+  return WriteFixedSizeNoTagToArray<double, WriteDoubleNoTagToArray>(
+      value, target);
+}
 inline uint8* WireFormatLite::WriteBoolNoTagToArray(bool value,
                                                     uint8* target) {
   return io::CodedOutputStream::WriteVarint32ToArray(value ? 1 : 0, target);
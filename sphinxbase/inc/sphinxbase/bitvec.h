@@ -148,6 +148,162 @@ SPHINXBASE_EXPORT
 size_t bitvec_count_set(bitvec_t *vec,	/* In: Bit vector to search */
                         size_t len);	/* In: Lenght of above bit vector */
 
+/*
+ * Word-level operations.  These are defined here rather than in the
+ * library so that the compiler can inline them into search loops.
+ */
+#if defined(__cplusplus) || (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+#define BITVEC_INLINE static inline
+#elif defined(__GNUC__)
+#define BITVEC_INLINE static __inline__
+#elif defined(_MSC_VER)
+#define BITVEC_INLINE static __inline
+#else
+#define BITVEC_INLINE static
+#endif
+
+/**
+ * Return the number of bits set in a single bitvec_t word.
+ */
+BITVEC_INLINE int32
+bitvec_word_count(bitvec_t w)
+{
+#if defined(__GNUC__)
+    return __builtin_popcount(w);
+#else
+    w = w - ((w >> 1) & 0x55555555);
+    w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+    w = (w + (w >> 4)) & 0x0f0f0f0f;
+    return (int32)((w * 0x01010101) >> 24);
+#endif
+}
+
+/**
+ * Return the index of the lowest bit set in a single bitvec_t word.
+ * @param w is the word, which must not be zero
+ */
+BITVEC_INLINE int32
+bitvec_word_first(bitvec_t w)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(w);
+#else
+    int32 b = 0;
+    while (!(w & 1)) {
+        w >>= 1;
+        ++b;
+    }
+    return b;
+#endif
+}
+
+/**
+ * Return the number of bits set among the first n bits of vec, counting
+ * a word at a time.
+ *
+ * @param vec is the bit vector
+ * @param n is the number of bits in <code>vec</code>
+ */
+BITVEC_INLINE size_t
+bitvec_popcount(const bitvec_t *vec, size_t n)
+{
+    size_t words = n / BITVEC_BITS;
+    size_t w, count = 0;
+
+    for (w = 0; w < words; ++w)
+        count += bitvec_word_count(vec[w]);
+    if (n % BITVEC_BITS)
+        count += bitvec_word_count(vec[words]
+                                   & (((bitvec_t)1 << (n % BITVEC_BITS)) - 1));
+    return count;
+}
+
+/**
+ * Find the first bit set in vec at or after bit start.
+ *
+ * The set bits of a vector can be visited with:
+ * <pre>
+ * for (b = bitvec_next_set(v, n, 0); b < n; b = bitvec_next_set(v, n, b + 1))
+ * </pre>
+ *
+ * @param vec is the bit vector
+ * @param n is the number of bits in <code>vec</code>
+ * @param start is the first bit to look at
+ * @return the index of the bit found, or n if there is none
+ */
+BITVEC_INLINE int32
+bitvec_next_set(const bitvec_t *vec, int32 n, int32 start)
+{
+    int32 w, words;
+    bitvec_t word;
+
+    if (start >= n)
+        return n;
+    w = start / BITVEC_BITS;
+    word = vec[w] & ((bitvec_t)-1 << (start % BITVEC_BITS));
+    words = bitvec_size(n);
+    while (word == 0) {
+        if (++w >= words)
+            return n;
+        word = vec[w];
+    }
+    start = w * BITVEC_BITS + bitvec_word_first(word);
+    return start < n ? start : n;
+}
+
+/**
+ * Write the indices of all bits set in vec to list, in increasing order.
+ *
+ * @param vec is the bit vector
+ * @param n is the number of bits in <code>vec</code>
+ * @param list receives the indices, and must have room for all of them
+ * @return the number of indices written
+ */
+BITVEC_INLINE int32
+bitvec_to_list(const bitvec_t *vec, int32 n, int32 *list)
+{
+    int32 w, words = bitvec_size(n);
+    int32 count = 0;
+
+    for (w = 0; w < words; ++w) {
+        bitvec_t word = vec[w];
+        while (word) {
+            int32 b = w * BITVEC_BITS + bitvec_word_first(word);
+            if (b >= n)
+                return count;
+            list[count++] = b;
+            word &= word - 1;
+        }
+    }
+    return count;
+}
+
+/**
+ * Set dst to the bitwise AND of a and b, over n bits.  dst may be the
+ * same as a or b.
+ */
+BITVEC_INLINE void
+bitvec_and(bitvec_t *dst, const bitvec_t *a, const bitvec_t *b, size_t n)
+{
+    size_t w, words = bitvec_size(n);
+
+    for (w = 0; w < words; ++w)
+        dst[w] = a[w] & b[w];
+}
+
+/**
+ * Set dst to the bitwise OR of a and b, over n bits.  dst may be the
+ * same as a or b.
+ */
+BITVEC_INLINE void
+bitvec_or(bitvec_t *dst, const bitvec_t *a, const bitvec_t *b, size_t n)
+{
+    size_t w, words = bitvec_size(n);
+
+    for (w = 0; w < words; ++w)
+        dst[w] = a[w] | b[w];
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -34,8 +34,17 @@
 #include <jni.h>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <string.h>
 
+#ifdef WIN32
+#include <windows.h>
+#define VOCE_THREAD_LOCAL __declspec(thread)
+#else
+#include <unistd.h>
+#define VOCE_THREAD_LOCAL __thread
+#endif
+
 /// The namespace containing everything in the Voce C++ API.
 namespace voce
 {
@@ -45,15 +54,50 @@ const std::string pathSeparator = ";";
 const std::string pathSeparator = ":";
 #endif
 
+	/// Predefined Sphinx-4 recognition settings.  DEFAULT_PROFILE uses
+	/// voce.config.xml as it is.  The others bound the search beams,
+	/// trading accuracy for speed, and silence the recognizer monitors'
+	/// per-utterance reports.
+	enum RecognitionProfile
+	{
+		DEFAULT_PROFILE,
+		LOW_LATENCY_PROFILE,
+		BALANCED_PROFILE,
+		ACCURATE_PROFILE
+	};
+
 	/// Contains things that should only be accessed within Voce.
 	namespace internal
 	{
-		/// Global instance of the JNI environment.
+		/// Global instance of the JNI environment.  This is the 
+		/// environment of the thread that called init().
 		JNIEnv* gEnv = NULL;
 
+		/// The JNI environment of the calling thread, once it has been 
+		/// looked up or attached.  A JNIEnv is only valid on its own 
+		/// thread.
+		VOCE_THREAD_LOCAL JNIEnv* tEnv = NULL;
+
+		/// True if Voce attached the calling thread to the Java virtual 
+		/// machine, and so may detach it.
+		VOCE_THREAD_LOCAL bool tAttached = false;
+
+		/// Counts the calls to destroy().  A thread's tEnv and tAttached 
+		/// only describe the current virtual machine if tGeneration 
+		/// matches it.
+		unsigned int gGeneration = 0;
+
+		/// The value of gGeneration when the calling thread's tEnv was 
+		/// looked up.
+		VOCE_THREAD_LOCAL unsigned int tGeneration = 0;
+
 		/// Global instance of the Java virtual machine.
 		JavaVM *gJVM = NULL;
 
+		/// True if Voce created the Java virtual machine, and so must 
+		/// destroy it.
+		bool gOwnJVM = false;
+
 		/// Global reference to the main Voce Java class.
 		jclass gClass = NULL;
 
@@ -71,6 +115,9 @@ const std::string pathSeparator = ":";
 		/// The name of the main Voce Java class.
 		const std::string gClassName = "voce/SpeechInterface";
 
+		/// The recognition profile applied by the next init().
+		RecognitionProfile gProfile = DEFAULT_PROFILE;
+
 		/// A simple message logging function.  The message type gets printed 
 		/// before the actual message.
 		void log(const std::string& msgType, const std::string& msg)
@@ -85,6 +132,58 @@ const std::string pathSeparator = ":";
 			std::cout << "] " << msg << std::endl;
 		}
 
+		/// Suspends the calling thread for the given number of 
+		/// milliseconds.
+		void sleepMs(int ms)
+		{
+#ifdef WIN32
+			Sleep(ms);
+#else
+			usleep(ms * 1000);
+#endif
+		}
+
+		/// Returns the JNI environment for the calling thread, attaching 
+		/// the thread to the Java virtual machine the first time it calls 
+		/// into Voce.  Returns NULL if Voce has not been initialized or 
+		/// the thread cannot be attached.
+		JNIEnv* getEnv()
+		{
+			if (!gJVM)
+			{
+				return NULL;
+			}
+
+			if (tEnv && tGeneration == gGeneration)
+			{
+				return tEnv;
+			}
+
+			// Whatever this thread cached belongs to a destroyed 
+			// instance; look the thread up again.
+			tEnv = NULL;
+
+			JNIEnv* env = NULL;
+			jint status = gJVM->GetEnv((void**)&env, JNI_VERSION_1_4);
+
+			if (JNI_EDETACHED == status)
+			{
+				status = gJVM->AttachCurrentThread((void**)&env, NULL);
+				tAttached = (JNI_OK == status);
+			}
+
+			if (JNI_OK != status)
+			{
+				log("ERROR", "The calling thread cannot be attached to the \
+Java virtual machine.");
+				return NULL;
+			}
+
+			tEnv = env;
+			tGeneration = gGeneration;
+			return env;
+		}
+
 		/// Finds and returns a method ID for the given function name and 
 		/// Java method signature.
 		jmethodID loadJavaMethodID(const std::string& functionName, 
@@ -121,6 +220,93 @@ const std::string pathSeparator = ":";
 
 			return methodID;
 		}
+
+		/// Sets the Java system properties for the current recognition
+		/// profile, or clears them for the default profile.  Sphinx-4
+		/// reads them when it loads voce.config.xml: a name like
+		/// "absoluteBeamWidth" overrides the global property of that
+		/// name, and "component[property]" overrides one component
+		/// property.
+		void applyRecognitionProfile(JNIEnv* env)
+		{
+			const char* names[] = {"absoluteBeamWidth", "relativeBeamWidth",
+				"accuracyTracker[showSummary]", "speedTracker[showSummary]"};
+			const int numNames = 4;
+			const char* values[numNames] = {NULL, NULL, "false", "false"};
+
+			switch (gProfile)
+			{
+			case LOW_LATENCY_PROFILE:
+				values[0] = "250";
+				values[1] = "1E-40";
+				break;
+			case BALANCED_PROFILE:
+				values[0] = "1000";
+				values[1] = "1E-60";
+				break;
+			case ACCURATE_PROFILE:
+				values[0] = "5000";
+				values[1] = "1E-80";
+				break;
+			default:
+				values[2] = NULL;
+				values[3] = NULL;
+				break;
+			}
+
+			jclass system = env->FindClass("java/lang/System");
+
+			if (0 == system)
+			{
+				env->ExceptionClear();
+				log("ERROR", "java.lang.System cannot be found.  Recognition \
+profile will be ignored.");
+				return;
+			}
+
+			jmethodID setProperty = env->GetStaticMethodID(system,
+				"setProperty",
+				"(Ljava/lang/String;Ljava/lang/String;)Ljava/lang/String;");
+			jmethodID clearProperty = env->GetStaticMethodID(system,
+				"clearProperty", "(Ljava/lang/String;)Ljava/lang/String;");
+
+			if (0 == setProperty || 0 == clearProperty)
+			{
+				env->ExceptionClear();
+				env->DeleteLocalRef(system);
+				log("ERROR", "java.lang.System properties cannot be set.  \
+Recognition profile will be ignored.");
+				return;
+			}
+
+			for (int i = 0; i < numNames; ++i)
+			{
+				jstring jName = env->NewStringUTF(names[i]);
+				jobject old = NULL;
+
+				if (values[i])
+				{
+					jstring jValue = env->NewStringUTF(values[i]);
+					old = env->CallStaticObjectMethod(system, setProperty,
+						jName, jValue);
+					env->DeleteLocalRef(jValue);
+				}
+				else
+				{
+					old = env->CallStaticObjectMethod(system, clearProperty,
+						jName);
+				}
+
+				if (old)
+				{
+					env->DeleteLocalRef(old);
+				}
+
+				env->DeleteLocalRef(jName);
+			}
+
+			env->DeleteLocalRef(system);
+		}
 	}
 
 	/// Initializes Voce.  This function performs some extra stuff needed 
@@ -130,79 +316,95 @@ const std::string pathSeparator = ":";
 	/// working directory of the executable using Voce.  See documentation 
 	/// for the Java version for an explanation of the rest of the 
 	/// parameters.
+	/// 
+	/// The 'jvmOptions' are passed to the Java virtual machine after 
+	/// Voce's own, e.g. "-Xshare:auto" and 
+	/// "-XX:SharedArchiveFile=voce.jsa" to start from a class data 
+	/// sharing archive, or JIT settings.  If the process already runs a 
+	/// Java virtual machine, Voce uses it instead of creating one, and 
+	/// the options are ignored; that machine's class path must then 
+	/// include voce.jar.
 	void init(const std::string& vocePath, bool initSynthesis, 
 		bool initRecognition, const std::string& grammarPath, 
-		const std::string& grammarName)
+		const std::string& grammarName, 
+		const std::vector<std::string>& jvmOptions)
 	{
-		// Setup the Java virtual machine.
-		JavaVMInitArgs vm_args;
-		memset(&vm_args, 0, sizeof(vm_args));
-		vm_args.version = JNI_VERSION_1_4;
+		JavaVM* existingJVM = NULL;
+		jsize numJVMs = 0;
 
-		long status = 0;
-
-		// If recognition is being used, we need to increase the max heap 
-		// size.
-		if (initRecognition)
+		if (JNI_OK == JNI_GetCreatedJavaVMs(&existingJVM, 1, &numJVMs) 
+			&& numJVMs > 0)
 		{
-			vm_args.nOptions = 2;
+			// Attach to the virtual machine already running in this 
+			// process.  It is only Voce's to destroy if an earlier init() 
+			// created it.
+			if (internal::gJVM != existingJVM)
+			{
+				internal::gJVM = existingJVM;
+				internal::gOwnJVM = false;
+			}
 
-			// Setup the VM options.
-			// TODO: check out other options to be used here, like disabling the 
-			// JIT compiler.
-			JavaVMOption options[2];
+			internal::tEnv = NULL;
+			internal::gEnv = internal::getEnv();
 
-			// Add the required Java class paths.
-			std::string classPathString = "-Djava.class.path=";
-			classPathString += vocePath;
-			classPathString += "/voce.jar";
-			options[0].optionString = const_cast<char*>(classPathString.c_str());
-			options[0].extraInfo = NULL;
-
-			// Add an option to increase the max heap size.
-			options[1].optionString = const_cast<char*>("-Xmx256m");
-			options[1].extraInfo = NULL;
-			//options[1].optionString = "-Djava.compiler=NONE"; // Disable JIT.
-			//options[1].optionString = "-verbose:gc,class,jni";
-			vm_args.options = options;
-			//vm_args.ignoreUnrecognized = JNI_FALSE;
+			if (!internal::gEnv)
+			{
+				return;
+			}
 
-			// Create the VM.
-			status = JNI_CreateJavaVM(&internal::gJVM, 
-				(void**)&internal::gEnv, &vm_args);
+			internal::log("", "Using existing Java virtual machine");
 		}
 		else
 		{
-			vm_args.nOptions = 1;
-
 			// Setup the VM options.
-			// TODO: check out other options to be used here, like disabling the 
-			// JIT compiler.
-			JavaVMOption options[1];
+			std::vector<std::string> optionStrings;
 
 			// Add the required Java class paths.
-			std::string classPathString = "-Djava.class.path=";
-			classPathString += vocePath;
-			classPathString += "/voce.jar";
-			options[0].optionString = const_cast<char*>(classPathString.c_str());
-			options[0].extraInfo = NULL;
-			//options[1].optionString = "-Djava.compiler=NONE"; // Disable JIT.
-			//options[1].optionString = "-verbose:gc,class,jni";
-			vm_args.options = options;
+			optionStrings.push_back("-Djava.class.path=" + vocePath 
+				+ "/voce.jar");
+
+			// If recognition is being used, we need to increase the max 
+			// heap size.
+			if (initRecognition)
+			{
+				optionStrings.push_back("-Xmx256m");
+			}
+
+			optionStrings.insert(optionStrings.end(), jvmOptions.begin(), 
+				jvmOptions.end());
+
+			std::vector<JavaVMOption> options(optionStrings.size());
+
+			for (size_t i = 0; i < optionStrings.size(); ++i)
+			{
+				options[i].optionString = 
+					const_cast<char*>(optionStrings[i].c_str());
+				options[i].extraInfo = NULL;
+			}
+
+			// Setup the Java virtual machine.
+			JavaVMInitArgs vm_args;
+			memset(&vm_args, 0, sizeof(vm_args));
+			vm_args.version = JNI_VERSION_1_4;
+			vm_args.nOptions = (jint)options.size();
+			vm_args.options = &options[0];
 			//vm_args.ignoreUnrecognized = JNI_FALSE;
 
 			// Create the VM.
-			status = JNI_CreateJavaVM(&internal::gJVM, 
+			long status = JNI_CreateJavaVM(&internal::gJVM, 
 				(void**)&internal::gEnv, &vm_args);
-		}
 
-		if (status < 0)
-		{
-			internal::log("ERROR", "Java virtual machine cannot be created");
-			return;
-		}
+			if (status < 0)
+			{
+				internal::log("ERROR", "Java virtual machine cannot be created");
+				return;
+			}
 
-		internal::log("", "Java virtual machine created");
+			internal::log("", "Java virtual machine created");
+			internal::gOwnJVM = true;
+			internal::tEnv = internal::gEnv;
+			internal::tGeneration = internal::gGeneration;
+		}
 
 		// Find the main Voce class by name.
 		jclass c = internal::gEnv->FindClass(internal::gClassName.c_str());
@@ -245,10 +447,66 @@ Make sure the class path correctly points to the Voce classes.");
 		jstring jStrGrammarName = internal::gEnv->NewStringUTF(
 			grammarName.c_str());
 
+		if (initRecognition)
+		{
+			internal::applyRecognitionProfile(internal::gEnv);
+		}
+
 		// Initialize the Java Voce stuff.
 		internal::gEnv->CallStaticVoidMethod(internal::gClass, 
 			internal::gInitID, jStrVocePath, initSynthesis, initRecognition, 
 			jStrGrammarPath, jStrGrammarName);
+
+		internal::gEnv->DeleteLocalRef(jStrVocePath);
+		internal::gEnv->DeleteLocalRef(jStrGrammarPath);
+		internal::gEnv->DeleteLocalRef(jStrGrammarName);
+	}
+
+	/// Initializes Voce with the default Java virtual machine options.
+	void init(const std::string& vocePath, bool initSynthesis, 
+		bool initRecognition, const std::string& grammarPath, 
+		const std::string& grammarName)
+	{
+		init(vocePath, initSynthesis, initRecognition, grammarPath, 
+			grammarName, std::vector<std::string>());
+	}
+
+	/// Selects the recognition profile.  Sphinx-4 reads its settings
+	/// only when the recognizer is created, so the profile takes effect
+	/// at the next init() with recognition enabled; call destroy() and
+	/// init() again to switch a running recognizer.  The profiles
+	/// override properties of the components in the stock
+	/// voce.config.xml, which a custom config file must also define.
+	void setRecognitionProfile(RecognitionProfile profile)
+	{
+		internal::gProfile = profile;
+	}
+
+	/// Returns the selected recognition profile.
+	RecognitionProfile getRecognitionProfile()
+	{
+		return internal::gProfile;
+	}
+
+	/// Detaches the calling thread from the Java virtual machine.  Any 
+	/// thread other than the one that called init() must call this 
+	/// before it exits if it has used Voce; otherwise the virtual 
+	/// machine cannot be destroyed.  Calling Voce again afterwards 
+	/// attaches the thread again.  Threads that were already attached 
+	/// when they first called Voce, e.g. Java threads calling in through 
+	/// native methods, are left attached.
+	void detachThread()
+	{
+		if (internal::gJVM && internal::tAttached 
+			&& internal::tGeneration == internal::gGeneration 
+			&& internal::tEnv != internal::gEnv)
+		{
+			internal::gJVM->DetachCurrentThread();
+			internal::tAttached = false;
+		}
+
+		internal::tEnv = NULL;
+		internal::tAttached = false;
 	}
 
 	/// In addition to the usual Java Voce destroy call, this function 
@@ -283,43 +541,68 @@ initialization.  Request will be ignored.");
 		internal::gEnv->DeleteGlobalRef(
 			(jobject)internal::gIsRecognizerEnabledID);
 
-		if (internal::gJVM)
+		if (internal::gJVM && internal::gOwnJVM)
 		{
 			// Destroy the virtual machine.
 			internal::gJVM->DestroyJavaVM();
 			internal::log("", "Java virtual machine destroyed");
 		}
+		else if (internal::gJVM && internal::tAttached)
+		{
+			// The virtual machine belongs to someone else; only undo 
+			// Voce's attachment of this thread.
+			internal::gJVM->DetachCurrentThread();
+		}
+
+		// Forget the environment so that a later init() starts over and 
+		// calls made until then are ignored.  Other threads notice the 
+		// new generation and drop their cached environments.
+		++internal::gGeneration;
+		internal::gJVM = NULL;
+		internal::gOwnJVM = false;
+		internal::gEnv = NULL;
+		internal::gClass = NULL;
+		internal::tEnv = NULL;
+		internal::tAttached = false;
 	}
 
 	/// Requests that the given string be synthesized as soon as possible.
 	void synthesize(const std::string& message)
 	{
-		if (!internal::gEnv)
+		JNIEnv* env = internal::getEnv();
+
+		if (!env)
 		{
 			internal::log("warning", "synthesize called before \
 initialization.  Request will be ignored.");
+			return;
 		}
 
 		// Convert the C++ string to a Java string.
-		jstring jstr = internal::gEnv->NewStringUTF(message.c_str());
+		jstring jstr = env->NewStringUTF(message.c_str());
 
-		// Call the Java method.
-		internal::gEnv->CallStaticVoidMethod(internal::gClass, 
+		// Call the Java method.  Threads attached from native code never 
+		// return to Java, so local references must be freed here.
+		env->CallStaticVoidMethod(internal::gClass, 
 			internal::gSynthesizeID, jstr);
+		env->DeleteLocalRef(jstr);
 	}
 
 	/// Tells the speech synthesizer to stop synthesizing.  This cancels all 
 	/// pending messages.
 	void stopSynthesizing()
 	{
-		if (!internal::gEnv)
+		JNIEnv* env = internal::getEnv();
+
+		if (!env)
 		{
-			internal::log("warning", "synthesize called before \
+			internal::log("warning", "stopSynthesizing called before \
 initialization.  Request will be ignored.");
+			return;
 		}
 
 		// Call the Java method.
-		internal::gEnv->CallStaticVoidMethod(internal::gClass, 
+		env->CallStaticVoidMethod(internal::gClass, 
 			internal::gStopSynthesizingID);
 	}
 
@@ -327,14 +610,17 @@ initialization.  Request will be ignored.");
 	/// recognizer's queue.
 	int getRecognizerQueueSize()
 	{
-		if (!internal::gEnv)
+		JNIEnv* env = internal::getEnv();
+
+		if (!env)
 		{
 			internal::log("warning", "getRecognizerQueueSize called before \
 initialization.  Request will be ignored.");
+			return 0;
 		}
 
 		// Call the Java method.
-		return internal::gEnv->CallStaticIntMethod(internal::gClass, 
+		return env->CallStaticIntMethod(internal::gClass, 
 			internal::gGetRecognizerQueueSizeID);
 	}
 
@@ -342,50 +628,111 @@ initialization.  Request will be ignored.");
 	/// recognizer's queue.
 	std::string popRecognizedString()
 	{
-		if (!internal::gEnv)
+		JNIEnv* env = internal::getEnv();
+
+		if (!env)
 		{
 			internal::log("warning", "popRecognizedString called before \
 initialization.  Request will be ignored.");
+			return "";
 		}
 
 		// Call the Java method.
-		jstring jstr = (jstring)internal::gEnv->CallStaticObjectMethod(
+		jstring jstr = (jstring)env->CallStaticObjectMethod(
 			internal::gClass, internal::gPopRecognizedStringID);
 
+		if (!jstr)
+		{
+			return "";
+		}
+
 		// Convert string from Java to C++.  Be sure to release memory 
 		// when finished.
-		const char* tempStr = internal::gEnv->GetStringUTFChars(jstr, 0);
+		const char* tempStr = env->GetStringUTFChars(jstr, 0);
 		std::string cppStr = tempStr;
-		internal::gEnv->ReleaseStringUTFChars(jstr, tempStr);
+		env->ReleaseStringUTFChars(jstr, tempStr);
+		env->DeleteLocalRef(jstr);
 
 		return cppStr;
 	}
 
+	/// Waits for the next recognized string, removes it from the 
+	/// recognizer's queue and stores it in 'result'.  Returns false if 
+	/// nothing was recognized within 'timeoutMs' milliseconds; a 
+	/// negative timeout waits forever.  The Java side has no way to 
+	/// notify native code, so the queue is checked every 'pollMs' 
+	/// milliseconds, which costs one JNI call per check while idle.  
+	/// Callers block here instead of spinning on getRecognizerQueueSize().
+	bool waitRecognizedString(std::string& result, int timeoutMs, 
+		int pollMs = 10)
+	{
+		if (!internal::getEnv())
+		{
+			internal::log("warning", "waitRecognizedString called before \
+initialization.  Request will be ignored.");
+			return false;
+		}
+
+		if (pollMs < 1)
+		{
+			pollMs = 1;
+		}
+
+		int waited = 0;
+
+		while (getRecognizerQueueSize() == 0)
+		{
+			if (timeoutMs >= 0 && waited >= timeoutMs)
+			{
+				return false;
+			}
+
+			int step = pollMs;
+
+			if (timeoutMs >= 0 && timeoutMs - waited < step)
+			{
+				step = timeoutMs - waited;
+			}
+
+			internal::sleepMs(step);
+			waited += step;
+		}
+
+		result = popRecognizedString();
+		return true;
+	}
+
 	/// Enables and disables the speech recognizer.
 	void setRecognizerEnabled(bool e)
 	{
-		if (!internal::gEnv)
+		JNIEnv* env = internal::getEnv();
+
+		if (!env)
 		{
 			internal::log("warning", "setRecognizerEnabled called before \
 initialization.  Request will be ignored.");
+			return;
 		}
 
 		// Call the Java method.
-		internal::gEnv->CallStaticVoidMethod(internal::gClass, 
+		env->CallStaticVoidMethod(internal::gClass, 
 			internal::gSetRecognizerEnabledID, e);
 	}
 
 	/// Returns true if the recognizer is currently enabled.
 	bool isRecognizerEnabled()
 	{
-		if (!internal::gEnv)
+		JNIEnv* env = internal::getEnv();
+
+		if (!env)
 		{
 			internal::log("warning", "isRecognizerEnabled called before \
 initialization.  Request will be ignored.");
+			return false;
 		}
 
 		// Call the Java method.
-		jboolean b = internal::gEnv->CallStaticBooleanMethod(internal::gClass, 
+		jboolean b = env->CallStaticBooleanMethod(internal::gClass, 
 			internal::gIsRecognizerEnabledID);
 
 		if (JNI_FALSE == b)
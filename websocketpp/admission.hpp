@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_ADMISSION_HPP
+#define WEBSOCKETPP_ADMISSION_HPP
+
+#include <websocketpp/close.hpp>
+#include <websocketpp/metrics.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/http/constants.hpp>
+
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+/// Per tenant quotas and admission control for sessions
+/**
+ * A controller holds a set of named resources, for example decoder slots,
+ * NLP workers and TTS streams, each with an optional total capacity, plus
+ * optional per tenant quotas on each resource. A session is admitted by
+ * reserving everything it needs at once with try_admit(). Either all of the
+ * demand is granted and a reservation is returned, or nothing is taken and
+ * the session should be shed immediately:
+ *
+ * ```
+ * bool on_validate(connection_hdl hdl) {
+ *     server::connection_ptr con = s.get_con_from_hdl(hdl);
+ *     admission::reservation_ptr r = ctl.try_admit(tenant_of(con), demand);
+ *     if (!r) {
+ *         admission::reject_handshake(con);
+ *         return false;
+ *     }
+ *     sessions[hdl] = r;
+ *     return true;
+ * }
+ * ```
+ *
+ * Resources are returned when the last copy of the reservation is released.
+ * Rejecting in the validate handler sends a 503 before the WebSocket upgrade,
+ * which is the cheapest way to shed. Sessions that are already open can be
+ * closed with close_code, which asks the client to try again later.
+ *
+ * All methods are thread safe. The controller must outlive its reservations.
+ */
+namespace admission {
+
+/// Close code for sessions shed after the handshake
+static close::status::value const close_code = close::status::try_again_later;
+
+/// Amount of each resource a session needs, by resource name
+typedef std::map<std::string,size_t> demand;
+
+class controller;
+
+/// Resources held by an admitted session
+/**
+ * The resources are returned to the controller when the reservation is
+ * destroyed.
+ */
+class reservation {
+public:
+    ~reservation();
+
+    /// Tenant the resources were reserved for
+    std::string const & get_tenant() const {
+        return m_tenant;
+    }
+
+    /// Resources held by this reservation
+    demand const & get_demand() const {
+        return m_demand;
+    }
+private:
+    friend class controller;
+
+    reservation(controller & c, std::string const & tenant, demand const & d)
+      : m_controller(c)
+      , m_tenant(tenant)
+      , m_demand(d) {}
+
+    // noncopyable
+    reservation(reservation const &);
+    reservation & operator=(reservation const &);
+
+    controller &    m_controller;
+    std::string     m_tenant;
+    demand          m_demand;
+};
+
+typedef lib::shared_ptr<reservation> reservation_ptr;
+
+/// Admission counters for one tenant
+struct tenant_stats {
+    tenant_stats() : admitted(0), rejected(0) {}
+
+    /// Sessions admitted
+    uint64_t admitted;
+    /// Sessions rejected for lack of quota or capacity
+    uint64_t rejected;
+    /// Time admitted sessions waited before being admitted
+    metrics::histogram queue_time;
+    /// Amount of each resource currently held
+    demand in_use;
+};
+
+/// Grants and tracks resource reservations
+class controller {
+public:
+    /// Set the total amount of a resource shared by all tenants
+    /**
+     * A resource without a capacity is only limited by tenant quotas.
+     */
+    void set_capacity(std::string const & resource, size_t amount) {
+        scoped_lock_type lock(m_lock);
+        m_capacity[resource] = amount;
+    }
+
+    /// Set the amount of a resource one tenant may hold at once
+    /**
+     * Overrides the default quota for this tenant.
+     */
+    void set_quota(std::string const & tenant, std::string const & resource,
+        size_t amount)
+    {
+        scoped_lock_type lock(m_lock);
+        m_tenants[tenant].quota[resource] = amount;
+    }
+
+    /// Set the quota on a resource for tenants without their own quota
+    void set_default_quota(std::string const & resource, size_t amount) {
+        scoped_lock_type lock(m_lock);
+        m_default_quota[resource] = amount;
+    }
+
+    /// Reserve everything a session needs, or nothing
+    /**
+     * @param tenant The tenant the session belongs to
+     * @param d The amount of each resource to reserve
+     * @param queued_since When the session started waiting, from
+     * metrics::now_us(). If non-zero the wait is recorded in the tenant's
+     * queue time histogram on admission.
+     * @return The reservation, or an empty pointer if any resource is over
+     * capacity or over the tenant's quota.
+     */
+    reservation_ptr try_admit(std::string const & tenant, demand const & d,
+        uint64_t queued_since = 0)
+    {
+        scoped_lock_type lock(m_lock);
+        tenant_state & t = m_tenants[tenant];
+
+        demand::const_iterator it;
+        for (it = d.begin(); it != d.end(); ++it) {
+            if (!fits(t, it->first, it->second)) {
+                t.stats.rejected++;
+                return reservation_ptr();
+            }
+        }
+
+        for (it = d.begin(); it != d.end(); ++it) {
+            m_in_use[it->first] += it->second;
+            t.stats.in_use[it->first] += it->second;
+        }
+
+        t.stats.admitted++;
+        if (queued_since) {
+            uint64_t now = metrics::now_us();
+            t.stats.queue_time.record(now > queued_since ?
+                now - queued_since : 0);
+        }
+
+        return reservation_ptr(new reservation(*this,tenant,d));
+    }
+
+    /// Amount of a resource currently held by all tenants
+    size_t get_in_use(std::string const & resource) const {
+        scoped_lock_type lock(m_lock);
+        demand::const_iterator it = m_in_use.find(resource);
+        return (it == m_in_use.end() ? 0 : it->second);
+    }
+
+    /// Names of all tenants seen so far
+    std::vector<std::string> get_tenants() const {
+        scoped_lock_type lock(m_lock);
+        std::vector<std::string> tenants;
+        tenants.reserve(m_tenants.size());
+
+        tenant_map::const_iterator it;
+        for (it = m_tenants.begin(); it != m_tenants.end(); ++it) {
+            tenants.push_back(it->first);
+        }
+        return tenants;
+    }
+
+    /// Snapshot of a tenant's counters
+    tenant_stats get_stats(std::string const & tenant) const {
+        scoped_lock_type lock(m_lock);
+        tenant_map::const_iterator it = m_tenants.find(tenant);
+        return (it == m_tenants.end() ? tenant_stats() : it->second.stats);
+    }
+private:
+    friend class reservation;
+
+    typedef lib::lock_guard<lib::mutex> scoped_lock_type;
+
+    struct tenant_state {
+        demand          quota;
+        tenant_stats    stats;
+    };
+
+    typedef std::map<std::string,tenant_state> tenant_map;
+
+    static bool within(demand const & limits, std::string const & resource,
+        size_t amount, bool & limited)
+    {
+        demand::const_iterator it = limits.find(resource);
+        if (it == limits.end()) {
+            limited = false;
+            return true;
+        }
+        limited = true;
+        return amount <= it->second;
+    }
+
+    static size_t held(demand const & d, std::string const & resource) {
+        demand::const_iterator it = d.find(resource);
+        return (it == d.end() ? 0 : it->second);
+    }
+
+    bool fits(tenant_state const & t, std::string const & resource,
+        size_t amount) const
+    {
+        bool limited;
+        if (!within(m_capacity,resource,held(m_in_use,resource) + amount,
+            limited))
+        {
+            return false;
+        }
+
+        size_t tenant_total = held(t.stats.in_use,resource) + amount;
+        if (!within(t.quota,resource,tenant_total,limited)) {
+            return false;
+        }
+        if (!limited && !within(m_default_quota,resource,tenant_total,
+            limited))
+        {
+            return false;
+        }
+        return true;
+    }
+
+    void release(std::string const & tenant, demand const & d) {
+        scoped_lock_type lock(m_lock);
+        tenant_state & t = m_tenants[tenant];
+
+        demand::const_iterator it;
+        for (it = d.begin(); it != d.end(); ++it) {
+            m_in_use[it->first] -= it->second;
+            t.stats.in_use[it->first] -= it->second;
+        }
+    }
+
+    mutable lib::mutex  m_lock;
+    demand              m_capacity;
+    demand              m_default_quota;
+    demand              m_in_use;
+    tenant_map m_tenants;
+};
+
+inline reservation::~reservation() {
+    m_controller.release(m_tenant,m_demand);
+}
+
+/// Reject a handshake from a validate handler because of load
+/**
+ * Sets a 503 Service Unavailable response with a Retry-After header. The
+ * validate handler must then return false.
+ *
+ * @param con The connection being validated
+ * @param retry_after Seconds the client should wait before retrying
+ */
+template <typename connection_ptr>
+void reject_handshake(connection_ptr con, unsigned int retry_after = 1) {
+    std::stringstream s;
+    s << retry_after;
+    con->set_status(http::status_code::service_unavailable);
+    con->append_header("Retry-After",s.str());
+}
+
+/// Write admission counters in the Prometheus text exposition format
+/**
+ * Every series carries a `tenant` label, and the in use gauge also a
+ * `resource` label.
+ *
+ * @param out The stream to write to
+ * @param c The controller to report on
+ * @param prefix Prepended to every metric name
+ */
+inline void write_prometheus(std::ostream & out, controller const & c,
+    std::string const & prefix = "websocketpp_admission_")
+{
+    std::vector<std::string> tenants = c.get_tenants();
+    std::vector<tenant_stats> stats;
+    std::vector<std::string> labels;
+    stats.reserve(tenants.size());
+    labels.reserve(tenants.size());
+
+    for (size_t i = 0; i < tenants.size(); ++i) {
+        stats.push_back(c.get_stats(tenants[i]));
+        labels.push_back("tenant=" + metrics::detail::quote_label(tenants[i]));
+    }
+
+    metrics::detail::write_header(out,prefix,"admitted_total",
+        "Sessions admitted.","counter");
+    for (size_t i = 0; i < stats.size(); ++i) {
+        metrics::detail::write_sample(out,prefix,"admitted_total",
+            stats[i].admitted,labels[i]);
+    }
+
+    metrics::detail::write_header(out,prefix,"rejected_total",
+        "Sessions rejected for lack of quota or capacity.","counter");
+    for (size_t i = 0; i < stats.size(); ++i) {
+        metrics::detail::write_sample(out,prefix,"rejected_total",
+            stats[i].rejected,labels[i]);
+    }
+
+    metrics::detail::write_header(out,prefix,"queue_time_seconds",
+        "Time sessions waited before admission.","histogram");
+    for (size_t i = 0; i < stats.size(); ++i) {
+        metrics::detail::write_histogram_samples(out,prefix,
+            "queue_time_seconds",stats[i].queue_time,labels[i]);
+    }
+
+    metrics::detail::write_header(out,prefix,"in_use",
+        "Resources currently held.","gauge");
+    for (size_t i = 0; i < stats.size(); ++i) {
+        demand::const_iterator r;
+        for (r = stats[i].in_use.begin(); r != stats[i].in_use.end(); ++r) {
+            metrics::detail::write_sample(out,prefix,"in_use",r->second,
+                labels[i] + ",resource=" +
+                metrics::detail::quote_label(r->first));
+        }
+    }
+}
+
+} // namespace admission
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_ADMISSION_HPP
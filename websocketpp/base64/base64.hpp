@@ -102,6 +102,56 @@ inline std::string base64_encode(unsigned char const * bytes_to_encode, unsigned
   return ret;
 }
 
+/// Base64 encode into a caller supplied buffer
+/**
+ * Writes 4 * ((len + 2) / 3) characters to `out` and does not allocate. No
+ * null terminator is written.
+ *
+ * @param bytes_to_encode The bytes to encode
+ * @param len The number of bytes to encode
+ * @param out Buffer of at least base64_encoded_size(len) characters
+ * @return The number of characters written
+ */
+inline size_t base64_encode(unsigned char const * bytes_to_encode, size_t len,
+    char * out)
+{
+    static char const table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+        "abcdefghijklmnopqrstuvwxyz"
+        "0123456789+/";
+
+    char * cursor = out;
+    size_t i = 0;
+
+    for (; i + 3 <= len; i += 3) {
+        unsigned int v = (bytes_to_encode[i] << 16)
+                       | (bytes_to_encode[i+1] << 8)
+                       | bytes_to_encode[i+2];
+        *cursor++ = table[(v >> 18) & 0x3f];
+        *cursor++ = table[(v >> 12) & 0x3f];
+        *cursor++ = table[(v >> 6) & 0x3f];
+        *cursor++ = table[v & 0x3f];
+    }
+
+    if (i < len) {
+        unsigned int v = bytes_to_encode[i] << 16;
+        if (i + 1 < len) {
+            v |= bytes_to_encode[i+1] << 8;
+        }
+        *cursor++ = table[(v >> 18) & 0x3f];
+        *cursor++ = table[(v >> 12) & 0x3f];
+        *cursor++ = (i + 1 < len) ? table[(v >> 6) & 0x3f] : '=';
+        *cursor++ = '=';
+    }
+
+    return static_cast<size_t>(cursor - out);
+}
+
+/// Number of characters base64_encode produces for `len` input bytes
+inline size_t base64_encoded_size(size_t len) {
+    return 4 * ((len + 2) / 3);
+}
+
 inline std::string base64_encode(std::string const & data) {
     return base64_encode(reinterpret_cast<const unsigned char *>(data.data()),data.size());
 }
@@ -116,4 +116,16 @@
     #endif
 #endif
 
+// Thread local storage for trivial types. Left undefined where the compiler
+// offers none; code using it must provide a fallback.
+#ifndef _WEBSOCKETPP_THREAD_LOCAL_TOKEN_
+    #if __cplusplus >= 201103L
+        #define _WEBSOCKETPP_THREAD_LOCAL_TOKEN_ thread_local
+    #elif defined(_MSC_VER)
+        #define _WEBSOCKETPP_THREAD_LOCAL_TOKEN_ __declspec(thread)
+    #elif defined(__GNUC__)
+        #define _WEBSOCKETPP_THREAD_LOCAL_TOKEN_ __thread
+    #endif
+#endif
+
 #endif // WEBSOCKETPP_COMMON_CPP11_HPP
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_CONCURRENCY_AFFINITY_HPP
+#define WEBSOCKETPP_CONCURRENCY_AFFINITY_HPP
+
+#ifndef NDEBUG
+#include <websocketpp/common/atomic.hpp>
+
+#include <cassert>
+#endif
+
+namespace websocketpp {
+namespace concurrency {
+
+/// Implementation for checked no-op locking primitives
+namespace affinity_impl {
+/// A mutex that does no locking, and in debug builds detects overlapping use
+class owner_mutex {
+public:
+    owner_mutex()
+#ifndef NDEBUG
+      : m_held(false)
+#endif
+    {}
+
+    /// Mark the mutex held; asserts that no other lock holds it
+    void acquire() {
+#ifndef NDEBUG
+        bool was_held = m_held.exchange(true);
+        assert(!was_held && "websocketpp::concurrency::affinity: "
+            "state entered from two threads at once");
+        (void)was_held;
+#endif
+    }
+
+    /// Mark the mutex free
+    void release() {
+#ifndef NDEBUG
+        m_held.store(false);
+#endif
+    }
+private:
+    // non-copyable
+    owner_mutex(owner_mutex const &);
+    owner_mutex & operator=(owner_mutex const &);
+
+#ifndef NDEBUG
+    lib::atomic<bool> m_held;
+#endif
+};
+
+/// A lock guard for owner_mutex
+class owner_lock_guard {
+public:
+    explicit owner_lock_guard(owner_mutex & m) : m_mutex(m) {
+        m_mutex.acquire();
+    }
+    ~owner_lock_guard() {
+        m_mutex.release();
+    }
+private:
+    // non-copyable
+    owner_lock_guard(owner_lock_guard const &);
+    owner_lock_guard & operator=(owner_lock_guard const &);
+
+    owner_mutex & m_mutex;
+};
+} // namespace affinity_impl
+
+/// Concurrency policy for endpoints whose state is only touched by one thread
+/**
+ * For deployments where one thread runs the transport (a single thread
+ * calling io_service::run for the asio transport) and every call into the
+ * endpoint and its connections is made from that thread: handlers, and
+ * code that thread runs between them.
+ *
+ * Like none, it compiles every lock out of release builds. Unlike none, a
+ * debug build (without NDEBUG) checks that promise: each lock marks its
+ * mutex held for the critical section it guards, and asserts if another
+ * thread is already inside it. Only overlapping use can be detected, so a
+ * passing run shows the absence of races it exercised, not of all races.
+ *
+ * Other threads must not call the endpoint or a connection directly, not
+ * even send(). They hand work to the transport thread instead, for the asio
+ * transport by posting it with get_io_service().post().
+ */
+class affinity {
+public:
+    /// The type of a mutex primitive
+    typedef affinity_impl::owner_mutex mutex_type;
+
+    /// The type of a scoped/RAII lock primitive
+    typedef affinity_impl::owner_lock_guard scoped_lock_type;
+};
+
+} // namespace concurrency
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONCURRENCY_AFFINITY_HPP
@@ -143,6 +143,14 @@ struct core_client {
 
         /// Length of time to wait for socket shutdown
         static const long timeout_socket_shutdown = 5000;
+
+        /// Tick length of the timer wheel used for connection timeouts
+        /**
+         * Handshake, pong, and proxy timeouts fire up to two ticks after
+         * they are due. Only the first endpoint to use an io_service sets
+         * the tick length of that io_service's wheel.
+         */
+        static const long timer_wheel_resolution = 100;
     };
 
     /// Transport Endpoint Component
@@ -197,9 +205,21 @@ struct core_client {
     static const websocketpp::log::level alog_level =
         websocketpp::log::alevel::all ^ websocketpp::log::alevel::devel;
 
-    ///
+    /// Maximum size of a connection's read buffer
+    /**
+     * Read buffers start at connection_read_buffer_min_size and double each
+     * time a read fills them, up to this size. They halve again after a run
+     * of reads that use a quarter of the buffer or less.
+     */
     static const size_t connection_read_buffer_size = 16384;
 
+    /// Minimum size of a connection's read buffer
+    /**
+     * Setting this equal to connection_read_buffer_size gives every
+     * connection a fixed size buffer.
+     */
+    static const size_t connection_read_buffer_min_size = 1024;
+
     /// Drop connections immediately on protocol error.
     /**
      * Drop connections on protocol error rather than sending a close frame.
@@ -236,6 +256,96 @@ struct core_client {
      */
     static const size_t max_message_size = 32000000;
 
+    /// Write coalescing window, in milliseconds
+    /**
+     * When greater than zero, a connection with less than
+     * write_coalesce_size bytes queued waits up to this long for more
+     * messages before starting a transport write. All frames queued by then
+     * go out in a single scatter/gather write. This trades a little latency
+     * for fewer system calls when an application sends many small messages.
+     *
+     * Terminal messages (close frames) are never held back. Transports
+     * without timer support always write immediately.
+     *
+     * The default is 0, which writes as soon as a message is queued.
+     */
+    static const long write_coalesce_delay = 0;
+
+    /// Queued byte count that ends the write coalescing window early
+    /**
+     * Once at least this many payload bytes are queued, the write starts
+     * without waiting for write_coalesce_delay to expire. Only used when
+     * write_coalesce_delay is greater than zero.
+     */
+    static const size_t write_coalesce_size = 16384;
+
+    /// Write control frames, interactive data, and bulk data from separate lanes
+    /**
+     * When true, each connection keeps one send queue per
+     * send_priority::value. Ping and pong frames are written ahead of queued
+     * data, text messages ahead of binary ones, and large binary messages
+     * are fragmented so they cannot hold up the other lanes. Use
+     * connection::send(msg, priority) to choose a lane explicitly. See
+     * send_priority in connection.hpp.
+     *
+     * Messages in different lanes may reach the peer in a different order
+     * than they were sent. Messages compressed with permessage-deflate are
+     * the exception: they all go in the interactive lane and keep their send
+     * order, since each one is inflated with the history of the previous
+     * ones. The default is false, which keeps a single queue in send order.
+     */
+    static const bool enable_send_priority = false;
+
+    /// Largest bulk lane payload written per transport write, in bytes
+    /**
+     * Only used when enable_send_priority is true. Unprepared binary messages
+     * in the bulk lane that are larger than this are split into fragments of
+     * this size, and each transport write takes at most about this many bytes
+     * from the bulk lane. Zero disables both.
+     */
+    static const size_t send_fragment_size = 65536;
+
+    /// Collect per-connection and per-endpoint metrics
+    /**
+     * When true, connections count bytes, messages, send queue depth, and
+     * write latency, and feed totals to their endpoint. See metrics.hpp.
+     * When false the recording code is compiled out.
+     */
+    static const bool enable_metrics = false;
+
+    /// Mark the library's pipeline stages for the sampling profiler
+    /**
+     * When true, frame reads, frame writes, and permessage-deflate run inside
+     * profiler::stage_scope guards, so profiles can be split by stage. See
+     * profiler.hpp. When false the marks compile to nothing.
+     */
+    static const bool enable_profiler_stages = false;
+
+    /// Give open connections integer ids in a table owned by the endpoint
+    /**
+     * When true, endpoint::get_con_from_id resolves a connection::get_id
+     * value without reference counting. The table is guarded by the
+     * concurrency policy's mutex, a no-op with concurrency::none. See
+     * connection_registry.hpp.
+     */
+    static const bool enable_connection_registry = false;
+
+    /// Default send queue high water mark, in payload bytes
+    /**
+     * When the bytes waiting in a connection's send queue reach this value
+     * the connection's high water handler is called and its send policy
+     * applies to further sends. Zero means no limit. Connections can change
+     * this with set_send_queue_limits.
+     */
+    static const size_t send_queue_high_water = 0;
+
+    /// Default send queue low water mark, in payload bytes
+    /**
+     * Once a queue that crossed the high water mark drains to this value the
+     * connection's low water handler is called.
+     */
+    static const size_t send_queue_low_water = 0;
+
     /// Global flag for enabling/disabling extensions
     static const bool enable_extensions = true;
 
@@ -255,6 +365,32 @@ struct core_client {
         /// allow any possible window size. A value of 15 means do not allow
         /// negotiation of the window size (ie require the default).
         static const uint8_t minimum_outgoing_window_bits = 8;
+
+        /// zlib compression level used for outgoing messages. Values range
+        /// from 0 (no compression) to 9 (best compression). -1 selects the
+        /// zlib default (currently 6).
+        static const int compression_level = -1;
+
+        /// zlib memory level for the compressor. Values range from 1 to 9.
+        /// Lower values use less memory per connection at some cost in
+        /// speed and ratio.
+        static const int memory_level = 8;
+
+        /// Outgoing payloads smaller than this many bytes are sent
+        /// uncompressed even if compression was requested.
+        static const size_t minimum_compress_size = 64;
+
+        /// Whether binary messages may be compressed. Set to false when binary
+        /// payloads are already compressed media such as encoded audio.
+        static const bool compress_binary = true;
+
+        /// If the running average of compressed size as a percentage of
+        /// uncompressed size reaches this value, compression is suspended for
+        /// compress_backoff_messages messages before being tried again.
+        static const unsigned int maximum_compress_ratio = 95;
+
+        /// Number of messages sent uncompressed after a poor ratio is seen
+        static const size_t compress_backoff_messages = 16;
     };
 
     typedef websocketpp::extensions::permessage_deflate::disabled
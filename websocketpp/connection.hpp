@@ -32,14 +32,19 @@
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/functional.hpp>
+#include <websocketpp/connection_registry.hpp>
 #include <websocketpp/error.hpp>
 #include <websocketpp/frame.hpp>
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/logger/levels.hpp>
+#include <websocketpp/message_buffer/read_buffer.hpp>
+#include <websocketpp/metrics.hpp>
 #include <websocketpp/processors/processor.hpp>
+#include <websocketpp/profiler_stage.hpp>
 #include <websocketpp/transport/base/connection.hpp>
 
 #include <algorithm>
+#include <deque>
 #include <iostream>
 #include <queue>
 #include <sstream>
@@ -128,6 +133,24 @@ typedef lib::function<void(connection_hdl,std::string)> pong_timeout_handler;
  */
 typedef lib::function<bool(connection_hdl)> validate_handler;
 
+/// The type and function signature of a high water handler
+/**
+ * The high water handler is called when the payload bytes waiting in a
+ * connection's send queue rise to or above its high water mark. It is called
+ * from the thread that called send. It is not called again until the queue
+ * has drained to the low water mark.
+ */
+typedef lib::function<void(connection_hdl)> high_water_handler;
+
+/// The type and function signature of a low water handler
+/**
+ * The low water handler is called when a send queue that crossed its high
+ * water mark has drained to or below its low water mark. It is called from
+ * the transport's write path. Applications that paused their producers in the
+ * high water handler typically resume them here.
+ */
+typedef lib::function<void(connection_hdl)> low_water_handler;
+
 /// The type and function signature of a http handler
 /**
  * The http handler is called when an HTTP connection is made that does not
@@ -216,6 +239,47 @@ namespace internal_state {
 } // namespace internal_state
 } // namespace session
 
+namespace send_policy {
+/// What send does with a message that would take the send queue past its
+/// high water mark
+enum value {
+    /// Queue the message anyway. The high water handler is the only signal.
+    queue = 0,
+    /// Refuse the message with error::send_queue_full
+    reject = 1,
+    /// Make room by discarding the oldest queued data messages that are
+    /// complete, uncompressed, and not yet handed to the transport. Control
+    /// frames, partly written or partly queued messages, and compressed
+    /// messages are never dropped. Bulk lane messages go before interactive
+    /// ones. If not enough room can be made the message is queued anyway.
+    drop_oldest = 2
+};
+} // namespace send_policy
+
+namespace send_priority {
+/// Send queue lane a message is written from
+/**
+ * Only used when the config's enable_send_priority setting is true. Each
+ * transport write drains the control lane first, then the interactive lane,
+ * then at most send_fragment_size bytes of the bulk lane. Within a lane
+ * messages keep their order.
+ */
+enum value {
+    /// Ping and pong frames. Close frames also use this lane but wait until
+    /// the data lanes have been written.
+    control = 0,
+    /// Latency sensitive data. The default for text messages.
+    interactive = 1,
+    /// Large transfers. The default for binary messages. Unprepared,
+    /// uncompressed binary messages larger than send_fragment_size are split
+    /// into fragments so that other lanes can be written between them.
+    bulk = 2
+};
+
+/// Number of send queue lanes
+static size_t const count = 3;
+} // namespace send_priority
+
 /// Represents an individual WebSocket connection
 template <typename config>
 class connection
@@ -247,12 +311,14 @@ public:
 
     typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
     typedef typename concurrency_type::mutex_type mutex_type;
+    typedef connection_registry<concurrency_type> connection_registry_type;
 
     typedef typename config::request_type request_type;
     typedef typename config::response_type response_type;
 
     typedef typename config::message_type message_type;
     typedef typename message_type::ptr message_ptr;
+    typedef typename message_type::shared_payload_ptr shared_payload_ptr;
 
     typedef typename config::con_msg_manager_type con_msg_manager_type;
     typedef typename con_msg_manager_type::ptr con_msg_manager_ptr;
@@ -266,8 +332,19 @@ public:
     // Message handler (needs to know message type)
     typedef lib::function<void(connection_hdl,message_ptr)> message_handler;
 
+    /// Type of the handler for chunks of streamed data messages
+    /**
+     * Called with the connection, the message opcode, a pointer to and the
+     * length of the chunk, and whether the chunk completes the message. The
+     * bytes are only valid for the duration of the call.
+     */
+    typedef lib::function<void(connection_hdl,frame::opcode::value,
+        uint8_t const *,size_t,bool)> message_chunk_handler;
+
     /// Type of a pointer to a transport timer handle
     typedef typename transport_con_type::timer_ptr timer_ptr;
+    /// Type of a pointer to a transport timeout handle
+    typedef typename transport_con_type::timeout_ptr timeout_ptr;
 
     // Misc Convenience Types
     typedef session::internal_state::value istate_type;
@@ -281,7 +358,7 @@ private:
 public:
 
     explicit connection(bool p_is_server, std::string const & ua, alog_type& alog,
-        elog_type& elog, rng_type & rng)
+        elog_type& elog, rng_type & rng, con_msg_manager_ptr msg_manager)
       : transport_con_type(p_is_server, alog, elog)
       , m_handle_read_frame(lib::bind(
             &type::handle_read_frame,
@@ -301,9 +378,24 @@ public:
       , m_max_message_size(config::max_message_size)
       , m_state(session::state::connecting)
       , m_internal_state(session::internal_state::USER_INIT)
-      , m_msg_manager(new con_msg_manager_type())
+      , m_buf(NULL)
+      , m_buf_size(0)
+      , m_buf_target(config::connection_read_buffer_min_size)
+      , m_buf_small_reads(0)
+      , m_msg_manager(msg_manager)
+      , m_send_open_lane(send_priority::count)
       , m_send_buffer_size(0)
+      , m_send_high_water(config::send_queue_high_water)
+      , m_send_low_water(config::send_queue_low_water <
+            config::send_queue_high_water ? config::send_queue_low_water :
+            config::send_queue_high_water)
+      , m_send_policy(send_policy::queue)
+      , m_above_high_water(false)
+      , m_write_coalesce_generation(0)
+      , m_write_coalesce_flush(false)
       , m_write_flag(false)
+      , m_write_start(0)
+      , m_id(0)
       , m_read_flag(true)
       , m_is_server(p_is_server)
       , m_alog(alog)
@@ -316,6 +408,15 @@ public:
         m_alog.write(log::alevel::devel,"connection constructor");
     }
 
+    ~connection() {
+        if (m_buf) {
+            m_read_buffer_pool->release(m_buf,m_buf_size);
+        }
+        if (m_id) {
+            m_registry->remove(m_id);
+        }
+    }
+
     /// Get a shared pointer to this component
     ptr get_shared() {
         return lib::static_pointer_cast<type>(transport_con_type::get_shared());
@@ -417,6 +518,26 @@ public:
         m_interrupt_handler = h;
     }
 
+    /// Set high water handler
+    /**
+     * @see websocketpp::high_water_handler
+     *
+     * @param h The new high_water_handler
+     */
+    void set_high_water_handler(high_water_handler h) {
+        m_high_water_handler = h;
+    }
+
+    /// Set low water handler
+    /**
+     * @see websocketpp::low_water_handler
+     *
+     * @param h The new low_water_handler
+     */
+    void set_low_water_handler(low_water_handler h) {
+        m_low_water_handler = h;
+    }
+
     /// Set http handler
     /**
      * The http handler is called after an HTTP request other than a WebSocket
@@ -458,6 +579,32 @@ public:
         m_message_handler = h;
     }
 
+    /// Set message chunk handler
+    /**
+     * While a chunk handler is set, data messages are not accumulated into
+     * message buffers. Instead the handler is called with each piece of
+     * payload as it is read off the wire, unmasked and decompressed but not
+     * copied, and the message handler is not called for data messages. This
+     * allows messages of any size to be received in constant memory.
+     * max_message_size does not apply to streamed messages; the handler may
+     * close the connection if a message grows too large.
+     *
+     * Streaming requires a protocol processor that supports it (RFC6455). On
+     * connections using older protocol versions whole messages continue to be
+     * delivered to the message handler.
+     *
+     * Set an empty handler to go back to whole message delivery for messages
+     * that start afterwards.
+     *
+     * @param h The new message_chunk_handler
+     */
+    void set_message_chunk_handler(message_chunk_handler h) {
+        m_message_chunk_handler = h;
+        if (m_processor) {
+            m_processor->set_streaming(m_message_chunk_handler ? true : false);
+        }
+    }
+
     //////////////////////////////////////////
     // Connection timeouts and other limits //
     //////////////////////////////////////////
@@ -563,6 +710,41 @@ public:
         }
     }
 
+    /// Set the send queue water marks
+    /**
+     * The marks are measured in payload bytes waiting in the send queue, the
+     * same quantity get_buffered_amount returns. Reaching `high` calls the
+     * high water handler and applies the send policy to further sends.
+     * Draining to `low` calls the low water handler. A `high` of zero disables
+     * both.
+     *
+     * The defaults come from the config's send_queue_high_water and
+     * send_queue_low_water settings.
+     *
+     * This method invokes the m_write_lock mutex
+     *
+     * @param high The high water mark in bytes, or zero for no limit
+     * @param low The low water mark in bytes. Clamped to `high`.
+     */
+    void set_send_queue_limits(size_t high, size_t low) {
+        scoped_lock_type lock(m_write_lock);
+        m_send_high_water = high;
+        m_send_low_water = (std::min)(low,high);
+    }
+
+    /// Set the send policy applied above the high water mark
+    /**
+     * The default is send_policy::queue.
+     *
+     * This method invokes the m_write_lock mutex
+     *
+     * @param p The new send policy
+     */
+    void set_send_policy(send_policy::value p) {
+        scoped_lock_type lock(m_write_lock);
+        m_send_policy = p;
+    }
+
     //////////////////////////////////
     // Uncategorized public methods //
     //////////////////////////////////
@@ -585,6 +767,75 @@ public:
         return get_buffered_amount();
     }
 
+    /// Get a copy of this connection's metrics
+    /**
+     * Metrics are only collected when the config's enable_metrics setting
+     * is true. Otherwise all values are zero.
+     *
+     * This method invokes the m_write_lock mutex
+     *
+     * @return The counters and write latency histogram for this connection
+     */
+    metrics::connection_metrics get_metrics() const {
+        scoped_lock_type lock(m_write_lock);
+        return m_metrics;
+    }
+
+    /// Set the endpoint wide metrics this connection contributes to
+    /**
+     * Called by the endpoint when the connection is created. Only used when
+     * the config's enable_metrics setting is true.
+     *
+     * @param m The endpoint metrics object
+     */
+    void set_endpoint_metrics(lib::shared_ptr<metrics::endpoint_metrics> m) {
+        m_endpoint_metrics = m;
+    }
+
+    /// Set the pool this connection draws its read buffers from
+    /**
+     * Called by the endpoint when the connection is created. A connection
+     * without a pool allocates its read buffers directly.
+     *
+     * @param pool The read buffer pool
+     */
+    void set_read_buffer_pool(message_buffer::read_buffer_pool::ptr pool) {
+        m_read_buffer_pool = pool;
+    }
+
+    /// Get the size of the connection's current read buffer
+    /**
+     * @return The read buffer size in bytes, zero before the first read
+     */
+    size_t get_read_buffer_size() const {
+        return m_buf_size;
+    }
+
+    /// Get this connection's id in its endpoint's connection registry
+    /**
+     * Only assigned when the config's enable_connection_registry setting is
+     * true. The id is assigned just before the open handler is called and
+     * resolves through endpoint::get_con_from_id until the close or fail
+     * handler returns.
+     *
+     * @return The connection's id, or zero if it has none
+     */
+    connection_id get_id() const {
+        return m_id;
+    }
+
+    /// Set the registry this connection adds itself to when it opens
+    /**
+     * Called by the endpoint when the connection is created. Only used when
+     * the config's enable_connection_registry setting is true.
+     *
+     * @param registry The endpoint's connection registry
+     */
+    void set_connection_registry(
+        lib::shared_ptr<connection_registry_type> registry) {
+        m_registry = registry;
+    }
+
     ////////////////////
     // Action Methods //
     ////////////////////
@@ -621,6 +872,27 @@ public:
     lib::error_code send(void const * payload, size_t len, frame::opcode::value
         op = frame::opcode::binary);
 
+    /// Send a message that refers to a shared, immutable payload
+    /**
+     * Convenience method for sending one payload to many connections. The
+     * outgoing message keeps a reference to the payload instead of copying it.
+     * When the frame is neither masked nor compressed, as for a server without
+     * permessage-deflate, the payload bytes are written straight from the
+     * shared buffer and only the frame header is built per connection.
+     * Otherwise the payload is copied during framing as usual.
+     *
+     * The payload must not be modified after it has been passed in.
+     *
+     * This method locks the m_write_lock mutex
+     *
+     * @param payload A pointer to the payload to send.
+     *
+     * @param op The opcode to generated the message with. Default is
+     * frame::opcode::text
+     */
+    lib::error_code send(shared_payload_ptr payload, frame::opcode::value op =
+        frame::opcode::text);
+
     /// Add a message to the outgoing send queue
     /**
      * If presented with a prepared message it is added without validation or
@@ -636,6 +908,41 @@ public:
      */
     lib::error_code send(message_ptr msg);
 
+    /// Add a message to a specific lane of the outgoing send queue
+    /**
+     * As send(message_ptr), but the message is queued in the given lane
+     * rather than the one its opcode defaults to. Control frames always use
+     * the control lane. When the config's enable_send_priority setting is
+     * false the lane is ignored and all messages share one queue. Messages
+     * compressed with permessage-deflate always use the interactive lane.
+     *
+     * This method invokes the m_write_lock mutex
+     *
+     * @param msg A message_ptr to the message to send.
+     *
+     * @param priority The lane to queue the message in.
+     */
+    lib::error_code send(message_ptr msg, send_priority::value priority);
+
+    /// Frame a data message without adding it to the send queue
+    /**
+     * Runs this connection's protocol processor over msg and returns a new,
+     * prepared message. Passing the result to send() queues it without any
+     * further validation or framing. This can be done on this connection or
+     * on any other connection that would produce identical bytes on the
+     * wire: a server connection using the same WebSocket version, with the
+     * message not flagged for compression.
+     *
+     * This method locks the m_write_lock mutex
+     *
+     * @param msg The unprepared message to frame.
+     *
+     * @param ec A status code, zero on success.
+     *
+     * @return The prepared message, or an empty pointer on error.
+     */
+    message_ptr prepare_data_frame(message_ptr msg, lib::error_code & ec);
+
     /// Asyncronously invoke handler::on_inturrupt
     /**
      * Signals to the connection to asyncronously invoke the on_inturrupt
@@ -1058,6 +1365,31 @@ public:
      */
     session::state::value get_state() const;
 
+    /// Get the WebSocket protocol version in use by this connection
+    /**
+     * The version is known once the opening handshake has selected a
+     * protocol processor.
+     *
+     * @return The protocol version, or -1 if no processor is selected yet.
+     */
+    int get_websocket_version() const {
+        return m_processor ? m_processor->get_version() : -1;
+    }
+
+    /// Get compression statistics for this connection
+    /**
+     * Counts messages that were sent compressed and messages the compression
+     * policy chose to send uncompressed, along with the bytes fed to and
+     * produced by the compressor.
+     *
+     * @return The statistics, or all zeros if no compression extension was
+     * negotiated.
+     */
+    extensions::compression_stats get_compression_stats() const {
+        return m_processor ? m_processor->get_compression_stats()
+                           : extensions::compression_stats();
+    }
+
 
     /// Get the WebSocket close code sent by this endpoint.
     /**
@@ -1167,6 +1499,16 @@ public:
     void handle_read_frame(lib::error_code const & ec, size_t bytes_transferred);
     void read_frame();
 
+    /// Make m_buf match the size picked for the next read
+    /**
+     * Must only be called while no read is outstanding and m_buf holds no
+     * unprocessed bytes.
+     */
+    void prepare_read_buffer();
+
+    /// Pick the size of the next read buffer based on the last read
+    void adapt_read_buffer(size_t bytes_transferred);
+
     /// Get array of WebSocket protocol versions that this connection supports.
     const std::vector<int>& get_supported_versions() const;
 
@@ -1198,6 +1540,16 @@ public:
      * non-zero otherwise.
      */
     void handle_write_frame(lib::error_code const & ec);
+
+    /// Flush the send queue once the write coalescing window has elapsed
+    /**
+     * This method locks the m_write_lock mutex
+     *
+     * @param generation The coalescing window the timer was started for.
+     * @param ec A status code from the transport timer.
+     */
+    void handle_write_coalesce_timeout(uint64_t generation,
+        lib::error_code const & ec);
 protected:
     void handle_transport_init(lib::error_code const & ec);
 
@@ -1317,21 +1669,74 @@ private:
      * @todo unit tests
      *
      * @param msg The message to push
+     *
+     * @param priority The lane to push it to. Ignored unless the config's
+     * enable_send_priority setting is true.
      */
-    void write_push(message_ptr msg);
+    void write_push(message_ptr msg, send_priority::value priority);
 
     /// Pop a message from the write queue
     /**
-     * Removes and returns a message from the write queue and updates any
-     * associated shared state.
+     * Removes and returns the next message to write and updates any
+     * associated shared state. Lanes are tried in priority order. A lane is
+     * skipped if another lane has a data message partially written, if its
+     * next message is a close frame and data is still queued, or if it is
+     * the bulk lane and bulk_bytes has reached send_fragment_size.
      *
      * Must be called while holding m_write_lock
      *
      * @todo unit tests
      *
-     * @return the message_ptr at the front of the queue
+     * @param bulk_bytes Payload bytes taken from the bulk lane for the
+     * current write. Updated if the returned message comes from that lane.
+     *
+     * @return the next message_ptr to write, or an empty pointer if there is
+     * none
+     */
+    message_ptr write_pop(size_t & bulk_bytes);
+
+    /// Whether all lanes of the write queue are empty
+    /**
+     * Must be called while holding m_write_lock
+     */
+    bool write_queue_empty() const;
+
+    /// Number of messages in all lanes of the write queue
+    /**
+     * Must be called while holding m_write_lock
+     */
+    size_t write_queue_size() const;
+
+    /// Split a binary message into fragments and queue them in the bulk lane
+    /**
+     * Must be called while holding m_write_lock
+     *
+     * @param msg The unprepared message to split
+     *
+     * @return A status code, zero on success, non-zero otherwise
+     */
+    lib::error_code write_push_fragments(message_ptr msg);
+
+    /// Apply the send policy before queueing a data message
+    /**
+     * Does nothing while the queue is below the high water mark. Above it,
+     * rejects the message or drops old messages according to m_send_policy.
+     *
+     * Must be called while holding m_write_lock
+     *
+     * @param len The payload size of the message about to be queued
+     * @return Whether the message may be queued
+     */
+    bool apply_send_policy(size_t len);
+
+    /// Note a high water crossing after queueing a message
+    /**
+     * Must be called while holding m_write_lock
+     *
+     * @return Whether the queue just crossed its high water mark and the high
+     * water handler should be called once the lock is released
      */
-    message_ptr write_pop();
+    bool check_high_water();
 
     /// Prints information about the incoming connection to the access log
     /**
@@ -1379,9 +1784,12 @@ private:
     pong_handler            m_pong_handler;
     pong_timeout_handler    m_pong_timeout_handler;
     interrupt_handler       m_interrupt_handler;
+    high_water_handler      m_high_water_handler;
+    low_water_handler       m_low_water_handler;
     http_handler            m_http_handler;
     validate_handler        m_validate_handler;
     message_handler         m_message_handler;
+    message_chunk_handler   m_message_chunk_handler;
 
     /// constant values
     long                    m_open_handshake_timeout_dur;
@@ -1408,15 +1816,19 @@ private:
      * Serializes access to the write queue as well as shared state within the
      * processor.
      */
-    mutex_type              m_write_lock;
+    mutable mutex_type      m_write_lock;
 
     // connection resources
-    char                    m_buf[config::connection_read_buffer_size];
+    message_buffer::read_buffer_pool::ptr m_read_buffer_pool;
+    char *                  m_buf;
+    size_t                  m_buf_size;
+    size_t                  m_buf_target;
+    size_t                  m_buf_small_reads;
     size_t                  m_buf_cursor;
     termination_handler     m_termination_handler;
     con_msg_manager_ptr     m_msg_manager;
-    timer_ptr               m_handshake_timer;
-    timer_ptr               m_ping_timer;
+    timeout_ptr             m_handshake_timer;
+    timeout_ptr             m_ping_timer;
 
     /// @todo this is not memory efficient. this value is not used after the
     /// handshake.
@@ -1433,11 +1845,22 @@ private:
      */
     processor_ptr           m_processor;
 
-    /// Queue of unsent outgoing messages
+    /// Queues of unsent outgoing messages, one per send_priority lane
+    /**
+     * Only the interactive lane is used when the config's
+     * enable_send_priority setting is false.
+     *
+     * Lock: m_write_lock
+     */
+    std::deque<message_ptr> m_send_queue[send_priority::count];
+
+    /// Lane whose current data message has been partly written
     /**
+     * send_priority::count when no data message is in progress.
+     *
      * Lock: m_write_lock
      */
-    std::queue<message_ptr> m_send_queue;
+    size_t m_send_open_lane;
 
     /// Size in bytes of the outstanding payloads in the write queue
     /**
@@ -1445,6 +1868,38 @@ private:
      */
     size_t m_send_buffer_size;
 
+    /// Send queue water marks in payload bytes, and the policy above high
+    /**
+     * Lock: m_write_lock
+     */
+    size_t m_send_high_water;
+    size_t m_send_low_water;
+    send_policy::value m_send_policy;
+
+    /// True between crossing the high water mark and draining to low
+    /**
+     * Lock: m_write_lock
+     */
+    bool m_above_high_water;
+
+    /// Timer bounding the current write coalescing window, if one is open
+    /**
+     * Lock: m_write_lock
+     */
+    timer_ptr m_write_coalesce_timer;
+
+    /// Counts coalescing windows so a stale timer cannot flush a newer one
+    /**
+     * Lock: m_write_lock
+     */
+    uint64_t m_write_coalesce_generation;
+
+    /// Set when the coalescing window has closed and the queue must be written
+    /**
+     * Lock: m_write_lock
+     */
+    bool m_write_coalesce_flush;
+
     /// buffer holding the various parts of the current message being writen
     /**
      * Lock m_write_lock
@@ -1461,6 +1916,24 @@ private:
      */
     bool m_write_flag;
 
+    /// Metrics for this connection, collected when config::enable_metrics
+    /**
+     * Lock m_write_lock
+     */
+    metrics::connection_metrics m_metrics;
+
+    /// Time the outstanding transport write was issued, in microseconds
+    uint64_t m_write_start;
+
+    /// Endpoint wide metrics this connection feeds, if any
+    lib::shared_ptr<metrics::endpoint_metrics> m_endpoint_metrics;
+
+    /// Registry of the endpoint's open connections, if enabled
+    lib::shared_ptr<connection_registry_type> m_registry;
+
+    /// Id of this connection in m_registry, zero if it is not registered
+    connection_id m_id;
+
     /// True if this connection is presently reading new data
     bool m_read_flag;
 
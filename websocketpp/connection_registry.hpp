@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_CONNECTION_REGISTRY_HPP
+#define WEBSOCKETPP_CONNECTION_REGISTRY_HPP
+
+#include <websocketpp/common/stdint.hpp>
+
+#include <vector>
+
+namespace websocketpp {
+
+/// Integer identifier of an open connection
+/**
+ * The low 32 bits index a slot in the endpoint's connection_registry, the
+ * high 32 bits hold the slot's generation when the connection was added. An
+ * id keeps naming the same connection: once the connection is removed the
+ * slot's generation moves on and the old id no longer resolves, even after
+ * the slot is reused. Zero is never a valid id.
+ */
+typedef uint64_t connection_id;
+
+/// Dense table of open connections indexed by connection_id
+/**
+ * Enabled by the `enable_connection_registry` config setting. Connections are
+ * added when they open and removed when they terminate. Looking up an id is
+ * an array index and a generation compare, with no reference counting.
+ *
+ * The table is guarded by a mutex of the endpoint's concurrency policy, so
+ * with concurrency::none it takes no lock at all. With a real concurrency
+ * policy, connections on different transport threads may open and terminate
+ * concurrently.
+ */
+template <typename concurrency>
+class connection_registry {
+public:
+    connection_registry() : m_free(invalid_index), m_size(0) {}
+
+    /// Add a connection
+    /**
+     * @param con The connection
+     * @return The connection's new id
+     */
+    connection_id add(void * con) {
+        scoped_lock_type lock(m_lock);
+        uint32_t index;
+
+        if (m_free != invalid_index) {
+            index = m_free;
+            m_free = m_slots[index].next_free;
+        } else {
+            index = static_cast<uint32_t>(m_slots.size());
+            m_slots.push_back(slot());
+        }
+
+        m_slots[index].con = con;
+        ++m_size;
+
+        return make_id(index,m_slots[index].generation);
+    }
+
+    /// Remove a connection
+    /**
+     * Ids that do not resolve are ignored.
+     *
+     * @param id The id returned by add
+     */
+    void remove(connection_id id) {
+        scoped_lock_type lock(m_lock);
+        uint32_t index = get_index(id);
+        if (!find_locked(id)) {
+            return;
+        }
+
+        slot & s = m_slots[index];
+        s.con = NULL;
+        // zero is reserved so that no id is ever 0
+        if (++s.generation == 0) {
+            s.generation = 1;
+        }
+        s.next_free = m_free;
+        m_free = index;
+        --m_size;
+    }
+
+    /// Look up a connection
+    /**
+     * @param id The id to look up
+     * @return The connection, or NULL if id does not name an open connection
+     */
+    void * find(connection_id id) const {
+        scoped_lock_type lock(m_lock);
+        return find_locked(id);
+    }
+
+    /// Get the number of connections in the registry
+    size_t size() const {
+        scoped_lock_type lock(m_lock);
+        return m_size;
+    }
+private:
+    typedef typename concurrency::mutex_type mutex_type;
+    typedef typename concurrency::scoped_lock_type scoped_lock_type;
+
+    static const uint32_t invalid_index = 0xffffffff;
+
+    void * find_locked(connection_id id) const {
+        uint32_t index = get_index(id);
+        if (index >= m_slots.size()) {
+            return NULL;
+        }
+
+        slot const & s = m_slots[index];
+        if (s.generation != get_generation(id)) {
+            return NULL;
+        }
+        return s.con;
+    }
+
+    struct slot {
+        slot() : con(NULL), generation(1), next_free(invalid_index) {}
+
+        void *      con;
+        uint32_t    generation;
+        uint32_t    next_free;
+    };
+
+    static connection_id make_id(uint32_t index, uint32_t generation) {
+        return (static_cast<connection_id>(generation) << 32) | index;
+    }
+
+    static uint32_t get_index(connection_id id) {
+        return static_cast<uint32_t>(id & 0xffffffff);
+    }
+
+    static uint32_t get_generation(connection_id id) {
+        return static_cast<uint32_t>(id >> 32);
+    }
+
+    mutable mutex_type  m_lock;
+    std::vector<slot>   m_slots;
+    uint32_t            m_free;
+    size_t              m_size;
+};
+
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_CONNECTION_REGISTRY_HPP
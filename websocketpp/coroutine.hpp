@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_COROUTINE_HPP
+#define WEBSOCKETPP_COROUTINE_HPP
+
+#include <websocketpp/close.hpp>
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/error.hpp>
+#include <websocketpp/frame.hpp>
+
+#include <boost/coroutine/coroutine.hpp>
+
+#include <deque>
+#include <string>
+
+namespace websocketpp {
+/// Stackful coroutine sessions on top of the handler interface
+/**
+ * A session runs a function on its own stack for the lifetime of a
+ * connection. Inside it, co_read and co_send suspend the function rather than
+ * returning to the caller, so an exchange that would otherwise be spread over
+ * a chain of handlers and the state passed between them reads as straight
+ * line code:
+ *
+ *     void run(coroutine::session<server> & s) {
+ *         while (server::message_ptr msg = s.co_read()) {
+ *             s.co_send(process(msg->get_payload()));
+ *         }
+ *     }
+ *
+ *     void on_open(server * s, connection_hdl hdl) {
+ *         coroutine::spawn(*s,hdl,&run);
+ *     }
+ *
+ * The session's handlers are bound once when it is spawned, so no closure is
+ * allocated per message. All of a session's code runs on whichever transport
+ * thread delivers the event that resumes it, one event at a time.
+ *
+ * Requires Boost.Coroutine, and with it linking against boost_coroutine and
+ * boost_context.
+ */
+namespace coroutine {
+
+/// A connection driven by a coroutine
+/**
+ * spawn takes over the connection's message, close, fail, high water, and
+ * low water handlers. Messages that arrive while the coroutine is busy are
+ * queued and returned by later calls to co_read. When the function returns,
+ * the connection is closed with status normal if it is still open.
+ */
+template <typename endpoint_type>
+class session : public lib::enable_shared_from_this< session<endpoint_type> > {
+public:
+    /// Type of this session
+    typedef session<endpoint_type> type;
+    /// Type of a shared pointer to this session
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of the endpoint's connections
+    typedef typename endpoint_type::connection_type connection_type;
+    /// Type of a shared pointer to the endpoint's connections
+    typedef typename endpoint_type::connection_ptr connection_ptr;
+    /// Type of a pointer to a message
+    typedef typename endpoint_type::message_ptr message_ptr;
+
+    /// Type of the function a session runs
+    typedef lib::function<void(type &)> session_function;
+
+    /// Start a session on an open connection (exception free)
+    /**
+     * The function starts running immediately and returns control to the
+     * caller the first time it suspends.
+     *
+     * @param e The endpoint the connection belongs to
+     * @param hdl The connection to drive
+     * @param f The function to run
+     * @param stack_size Size of the coroutine's stack in bytes, or zero for
+     * the Boost.Coroutine default
+     * @param ec Set to indicate what error occurred, if any.
+     * @return The session, or an empty pointer on error
+     */
+    static ptr spawn(endpoint_type & e, connection_hdl hdl, session_function f,
+        size_t stack_size, lib::error_code & ec)
+    {
+        connection_ptr con = e.get_con_from_hdl(hdl,ec);
+        if (ec) {
+            return ptr();
+        }
+
+        ptr s(new type(con,f));
+
+        con->set_message_handler(lib::bind(&type::handle_message,s,
+            lib::placeholders::_2));
+        con->set_close_handler(lib::bind(&type::handle_terminate,s));
+        con->set_fail_handler(lib::bind(&type::handle_terminate,s));
+        con->set_high_water_handler(lib::bind(&type::handle_high_water,s));
+        con->set_low_water_handler(lib::bind(&type::handle_low_water,s));
+
+        s->start(stack_size);
+        ec = lib::error_code();
+        return s;
+    }
+
+    ~session() {
+        // unwinds the coroutine's stack if it is still suspended
+        delete m_coro;
+    }
+
+    /// Wait for the next message
+    /**
+     * Suspends the coroutine until a message arrives, if none is queued.
+     *
+     * @return The message, or an empty pointer once the connection has
+     * closed or failed
+     */
+    message_ptr co_read() {
+        while (m_queue.empty()) {
+            if (!m_con) {
+                return message_ptr();
+            }
+            suspend(WAIT_READ);
+        }
+
+        message_ptr msg = m_queue.front();
+        m_queue.pop_front();
+        return msg;
+    }
+
+    /// Send a message, waiting for the send queue to drain if it is full
+    /**
+     * If the send leaves the connection's send queue at or above its high
+     * water mark, the coroutine is suspended until the queue drains to the
+     * low water mark or the connection ends. Without water marks (see
+     * connection::set_send_queue_limits) co_send never suspends.
+     *
+     * @param payload The payload to send
+     * @param op The opcode of the message
+     * @return A status code indicating an error, if any.
+     */
+    lib::error_code co_send(std::string const & payload,
+        frame::opcode::value op = frame::opcode::text)
+    {
+        if (!m_con) {
+            return error::make_error_code(error::invalid_state);
+        }
+        lib::error_code ec = m_con->send(payload,op);
+        wait_for_drain();
+        return ec;
+    }
+
+    /// Send a message from a buffer (see the string overload)
+    lib::error_code co_send(void const * payload, size_t len,
+        frame::opcode::value op = frame::opcode::binary)
+    {
+        if (!m_con) {
+            return error::make_error_code(error::invalid_state);
+        }
+        lib::error_code ec = m_con->send(payload,len,op);
+        wait_for_drain();
+        return ec;
+    }
+
+    /// Send a prepared message (see the string overload)
+    lib::error_code co_send(message_ptr msg) {
+        if (!m_con) {
+            return error::make_error_code(error::invalid_state);
+        }
+        lib::error_code ec = m_con->send(msg);
+        wait_for_drain();
+        return ec;
+    }
+
+    /// Whether the connection is still open
+    /**
+     * @return false once the connection has closed or failed
+     */
+    bool is_open() const {
+        return !!m_con;
+    }
+
+    /// Get the connection the session drives
+    /**
+     * @return The connection, or an empty pointer once it has closed or
+     * failed
+     */
+    connection_ptr get_connection() const {
+        return m_con;
+    }
+
+    /// Get the handle of the connection the session drives
+    connection_hdl get_handle() const {
+        return m_hdl;
+    }
+private:
+    typedef boost::coroutines::coroutine<void()> coro_type;
+
+    enum wait_state {
+        WAIT_NONE = 0,
+        WAIT_READ = 1,
+        WAIT_DRAIN = 2
+    };
+
+    session(connection_ptr con, session_function f)
+      : m_con(con)
+      , m_hdl(con->get_handle())
+      , m_function(f)
+      , m_coro(NULL)
+      , m_caller(NULL)
+      , m_wait(WAIT_NONE)
+      , m_above_high_water(false) {}
+
+    // non-copyable
+    session(session const &);
+    session & operator=(session const &);
+
+    void start(size_t stack_size) {
+        boost::coroutines::attributes attr;
+        if (stack_size) {
+            attr = boost::coroutines::attributes(stack_size);
+        }
+
+        m_coro = new coro_type(lib::bind(&type::run,this,
+            lib::placeholders::_1),attr);
+    }
+
+    void run(coro_type & caller) {
+        m_caller = &caller;
+        m_function(*this);
+        m_caller = NULL;
+        finish();
+    }
+
+    // The function returned, so nothing will read the connection any more.
+    // Close it if it is still open and drop it, which breaks the cycle
+    // between it and the handlers that refer to this session.
+    void finish() {
+        m_queue.clear();
+        m_above_high_water = false;
+
+        if (m_con) {
+            lib::error_code ec;
+            m_con->close(close::status::normal,"",ec);
+            m_con.reset();
+        }
+    }
+
+    void suspend(wait_state w) {
+        m_wait = w;
+        (*m_caller)();
+        m_wait = WAIT_NONE;
+    }
+
+    // Continue the coroutine if it is waiting for the given event. Events
+    // raised by the coroutine itself, for example from within send, only
+    // update state.
+    void resume(wait_state w) {
+        if (m_wait == w && m_coro && *m_coro) {
+            // the coroutine may drop the last reference to the connection,
+            // and with it to this session
+            ptr self = type::shared_from_this();
+            (*m_coro)();
+        }
+    }
+
+    void wait_for_drain() {
+        while (m_above_high_water && m_con) {
+            suspend(WAIT_DRAIN);
+        }
+    }
+
+    void handle_message(message_ptr msg) {
+        if (!m_con) {
+            // the session has finished, the message has no reader
+            return;
+        }
+        m_queue.push_back(msg);
+        resume(WAIT_READ);
+    }
+
+    void handle_high_water() {
+        m_above_high_water = true;
+    }
+
+    void handle_low_water() {
+        m_above_high_water = false;
+        resume(WAIT_DRAIN);
+    }
+
+    void handle_terminate() {
+        // Dropping the connection breaks the cycle between it and the
+        // handlers that refer to this session.
+        m_con.reset();
+        m_above_high_water = false;
+
+        if (m_wait != WAIT_NONE) {
+            resume(m_wait);
+        }
+    }
+
+    connection_ptr          m_con;
+    connection_hdl          m_hdl;
+    session_function        m_function;
+    coro_type *             m_coro;
+    coro_type *             m_caller;
+    wait_state              m_wait;
+    bool                    m_above_high_water;
+    std::deque<message_ptr> m_queue;
+};
+
+/// Start a coroutine session on an open connection (exception free)
+/**
+ * @see session::spawn
+ */
+template <typename endpoint_type>
+typename session<endpoint_type>::ptr spawn(endpoint_type & e,
+    connection_hdl hdl, typename session<endpoint_type>::session_function f,
+    lib::error_code & ec)
+{
+    return session<endpoint_type>::spawn(e,hdl,f,0,ec);
+}
+
+/// Start a coroutine session on an open connection
+/**
+ * Typically called from the open handler.
+ *
+ * @see session::spawn
+ *
+ * @param e The endpoint the connection belongs to
+ * @param hdl The connection to drive
+ * @param f The function to run
+ * @return The session
+ */
+template <typename endpoint_type>
+typename session<endpoint_type>::ptr spawn(endpoint_type & e,
+    connection_hdl hdl, typename session<endpoint_type>::session_function f)
+{
+    lib::error_code ec;
+    typename session<endpoint_type>::ptr s =
+        session<endpoint_type>::spawn(e,hdl,f,0,ec);
+    if (ec) {
+        throw ec;
+    }
+    return s;
+}
+
+} // namespace coroutine
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_COROUTINE_HPP
@@ -34,6 +34,8 @@
 
 #include <iostream>
 #include <set>
+#include <utility>
+#include <vector>
 
 namespace websocketpp {
 
@@ -66,8 +68,13 @@ public:
 
     /// Type of message_handler
     typedef typename connection_type::message_handler message_handler;
+    /// Type of message_chunk_handler
+    typedef typename connection_type::message_chunk_handler
+        message_chunk_handler;
     /// Type of message pointers that this endpoint uses
     typedef typename connection_type::message_ptr message_ptr;
+    /// Type of shared immutable payload pointers that this endpoint accepts
+    typedef typename connection_type::shared_payload_ptr shared_payload_ptr;
 
     /// Type of error logger
     typedef typename config::elog_type elog_type;
@@ -78,10 +85,16 @@ public:
     typedef typename concurrency_type::scoped_lock_type scoped_lock_type;
     /// Type of our concurrency policy's mutex object
     typedef typename concurrency_type::mutex_type mutex_type;
+    /// Type of the table of open connections, see connection_registry.hpp
+    typedef connection_registry<concurrency_type> connection_registry_type;
 
     /// Type of RNG
     typedef typename config::rng_type rng_type;
 
+    /// Type of the endpoint message manager that supplies each connection
+    /// with its connection message manager
+    typedef typename config::endpoint_msg_manager_type endpoint_msg_manager_type;
+
     // TODO: organize these
     typedef typename connection_type::termination_handler termination_handler;
 
@@ -95,6 +108,12 @@ public:
       , m_close_handshake_timeout_dur(config::timeout_close_handshake)
       , m_pong_timeout_dur(config::timeout_pong)
       , m_max_message_size(config::max_message_size)
+      , m_metrics(new metrics::endpoint_metrics())
+      , m_connection_registry(new connection_registry_type())
+      , m_read_buffer_pool(new message_buffer::read_buffer_pool(
+            config::connection_read_buffer_min_size,
+            config::connection_read_buffer_size
+        ))
       , m_is_server(p_is_server)
     {
         m_alog.set_channels(config::alog_level);
@@ -105,6 +124,18 @@ public:
         transport_type::init_logging(&m_alog, &m_elog);
     }
 
+    /// Get the metrics aggregated across this endpoint's connections
+    /**
+     * Metrics are only collected when the config's enable_metrics setting
+     * is true. Otherwise all values are zero. Pass the result to
+     * metrics::write_prometheus to export it.
+     *
+     * @return The endpoint metrics
+     */
+    metrics::endpoint_metrics const & get_metrics() const {
+        return *m_metrics;
+    }
+
     /// Returns the user agent string that this endpoint will use
     /**
      * Returns the user agent string that this endpoint will use when creating
@@ -218,6 +249,17 @@ public:
         return m_elog;
     }
 
+    /// Get reference to the endpoint message manager
+    /**
+     * The endpoint message manager hands out the message manager for each new
+     * connection. Pooled managers use this to expose their retention limits.
+     *
+     * @return A reference to the endpoint message manager
+     */
+    endpoint_msg_manager_type & get_msg_manager() {
+        return m_msg_manager;
+    }
+
     /*************************/
     /* Set Handler functions */
     /*************************/
@@ -257,6 +299,17 @@ public:
         scoped_lock_type guard(m_mutex);
         m_interrupt_handler = h;
     }
+
+    void set_high_water_handler(high_water_handler h) {
+        m_alog.write(log::alevel::devel,"set_high_water_handler");
+        scoped_lock_type guard(m_mutex);
+        m_high_water_handler = h;
+    }
+    void set_low_water_handler(low_water_handler h) {
+        m_alog.write(log::alevel::devel,"set_low_water_handler");
+        scoped_lock_type guard(m_mutex);
+        m_low_water_handler = h;
+    }
     void set_http_handler(http_handler h) {
         m_alog.write(log::alevel::devel,"set_http_handler");
         scoped_lock_type guard(m_mutex);
@@ -272,6 +325,11 @@ public:
         scoped_lock_type guard(m_mutex);
         m_message_handler = h;
     }
+    void set_message_chunk_handler(message_chunk_handler h) {
+        m_alog.write(log::alevel::devel,"set_message_chunk_handler");
+        scoped_lock_type guard(m_mutex);
+        m_message_chunk_handler = h;
+    }
 
     //////////////////////////////////////////
     // Connection timeouts and other limits //
@@ -459,9 +517,49 @@ public:
     void send(connection_hdl hdl, void const * payload, size_t len,
         frame::opcode::value op);
 
+    /// Send a shared, immutable payload without copying it
+    /**
+     * @see connection::send(shared_payload_ptr, frame::opcode::value)
+     *
+     * @param [in] hdl The handle identifying the connection to send via.
+     * @param [in] payload The shared payload to send.
+     * @param [in] op The opcode to generated the message with.
+     * @param [out] ec A code to fill in for errors
+     */
+    void send(connection_hdl hdl, shared_payload_ptr payload,
+        frame::opcode::value op, lib::error_code & ec);
+    void send(connection_hdl hdl, shared_payload_ptr payload,
+        frame::opcode::value op);
+
     void send(connection_hdl hdl, message_ptr msg, lib::error_code & ec);
     void send(connection_hdl hdl, message_ptr msg);
 
+    /// Send one message to many connections, framing it as few times as possible
+    /**
+     * On a server endpoint, frames are not masked. An uncompressed message
+     * therefore produces the same bytes for every recipient that speaks the
+     * same protocol version. The message is framed once per version seen,
+     * and that single prepared message is queued on every such connection.
+     * Client connections and messages flagged for compression are framed
+     * per connection, as send() would do.
+     *
+     * Handles whose connection has gone away or is not open are skipped.
+     *
+     * @param [in] begin Iterator to the first connection_hdl to send to.
+     * @param [in] end Iterator one past the last connection_hdl.
+     * @param [in] msg The unprepared message to send.
+     * @param [out] ec Set if the message could not be framed at all.
+     *
+     * @return The number of connections the message was queued on.
+     */
+    template <typename hdl_iterator>
+    size_t broadcast(hdl_iterator begin, hdl_iterator end, message_ptr msg,
+        lib::error_code & ec);
+
+    /// Send one message to many connections (exception version)
+    template <typename hdl_iterator>
+    size_t broadcast(hdl_iterator begin, hdl_iterator end, message_ptr msg);
+
     void close(connection_hdl hdl, close::status::value const code,
         std::string const & reason, lib::error_code & ec);
     void close(connection_hdl hdl, close::status::value const code,
@@ -542,6 +640,36 @@ public:
         }
         return con;
     }
+
+    /// Retrieves a connection from its registry id
+    /**
+     * Requires the config's enable_connection_registry setting. Unlike
+     * get_con_from_hdl this touches no reference count, which suits loops
+     * that send to many connections. With concurrency::none it takes no lock
+     * either.
+     *
+     * NOTE: The connection may terminate on another transport thread as soon
+     * as the lookup returns. Only use the pointer while the connection is
+     * known to be alive, for example from a handler on a single threaded
+     * transport. Keep a connection_ptr to hold on to the connection for
+     * longer.
+     *
+     * @param id The id from connection::get_id
+     * @return The connection, or NULL if id does not name an open connection
+     */
+    connection_type * get_con_from_id(connection_id id) const {
+        return static_cast<connection_type *>(m_connection_registry->find(id));
+    }
+
+    /// Get the number of open connections in the connection registry
+    /**
+     * Requires the config's enable_connection_registry setting.
+     *
+     * @return The number of open connections
+     */
+    size_t get_registered_connection_count() const {
+        return m_connection_registry->size();
+    }
 protected:
     connection_ptr create_connection();
 
@@ -558,9 +686,12 @@ private:
     pong_handler                m_pong_handler;
     pong_timeout_handler        m_pong_timeout_handler;
     interrupt_handler           m_interrupt_handler;
+    high_water_handler          m_high_water_handler;
+    low_water_handler           m_low_water_handler;
     http_handler                m_http_handler;
     validate_handler            m_validate_handler;
     message_handler             m_message_handler;
+    message_chunk_handler       m_message_chunk_handler;
 
     long                        m_open_handshake_timeout_dur;
     long                        m_close_handshake_timeout_dur;
@@ -568,6 +699,10 @@ private:
     size_t                      m_max_message_size;
 
     rng_type m_rng;
+    endpoint_msg_manager_type   m_msg_manager;
+    lib::shared_ptr<metrics::endpoint_metrics> m_metrics;
+    lib::shared_ptr<connection_registry_type> m_connection_registry;
+    message_buffer::read_buffer_pool::ptr m_read_buffer_pool;
 
     // static settings
     bool const                  m_is_server;
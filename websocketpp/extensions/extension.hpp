@@ -29,6 +29,7 @@
 #define WEBSOCKETPP_EXTENSION_HPP
 
 #include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/stdint.hpp>
 #include <websocketpp/common/system_error.hpp>
 
 #include <string>
@@ -88,6 +89,30 @@ inline lib::error_code make_error_code(error::value e) {
 }
 
 } // namespace error
+
+/// Counters describing how a compression extension treated outgoing messages
+/**
+ * Messages are counted only if compression was requested for them and the
+ * extension was negotiated. `bytes_in` and `bytes_out` cover compressed
+ * messages only.
+ */
+struct compression_stats {
+    compression_stats()
+      : compressed(0)
+      , skipped(0)
+      , bytes_in(0)
+      , bytes_out(0) {}
+
+    /// Number of messages sent compressed
+    uint64_t compressed;
+    /// Number of messages the compression policy sent uncompressed
+    uint64_t skipped;
+    /// Payload bytes fed to the compressor
+    uint64_t bytes_in;
+    /// Bytes produced by the compressor
+    uint64_t bytes_out;
+};
+
 } // namespace extensions
 } // namespace websocketpp
 
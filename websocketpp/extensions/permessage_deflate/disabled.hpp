@@ -31,6 +31,7 @@
 #include <websocketpp/common/cpp11.hpp>
 #include <websocketpp/common/system_error.hpp>
 
+#include <websocketpp/frame.hpp>
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/extensions/extension.hpp>
 
@@ -69,6 +70,14 @@ public:
         return false;
     }
 
+    bool should_compress(frame::opcode::value, size_t) {
+        return false;
+    }
+
+    compression_stats get_stats() const {
+        return compression_stats();
+    }
+
     lib::error_code compress(std::string const & in, std::string & out) {
         return make_error_code(error::disabled);
     }
@@ -34,6 +34,7 @@
 #include <websocketpp/common/platforms.hpp>
 #include <websocketpp/common/system_error.hpp>
 #include <websocketpp/error.hpp>
+#include <websocketpp/frame.hpp>
 
 #include <websocketpp/extensions/extension.hpp>
 
@@ -75,6 +76,14 @@ namespace extensions {
  * `lib::error_code compress(std::string const & in, std::string & out)`\n
  * Compress the bytes in `in` and append them to `out`
  *
+ * **should_compress**\n
+ * `bool should_compress(frame::opcode::value op, size_t size)`\n
+ * Ask the compression policy whether a message should be compressed
+ *
+ * **get_stats**\n
+ * `compression_stats const & get_stats() const`\n
+ * Retrieve counters describing what the compression policy did
+ *
  * **decompress**\n
  * `lib::error_code decompress(uint8_t const * buf, size_t len, std::string &
  * out)`\n
@@ -208,8 +217,11 @@ public:
       , m_c2s_max_window_bits(15)
       , m_s2c_max_window_bits_mode(mode::accept)
       , m_c2s_max_window_bits_mode(mode::accept)
-      , m_initialized(false)
+      , m_deflate_initialized(false)
+      , m_inflate_initialized(false)
       , m_compress_buffer_size(16384)
+      , m_ratio(0)
+      , m_backoff(0)
     {
         m_dstate.zalloc = Z_NULL;
         m_dstate.zfree = Z_NULL;
@@ -223,68 +235,33 @@ public:
     }
 
     ~enabled() {
-        if (!m_initialized) {
-            return;
-        }
-
-        int ret = deflateEnd(&m_dstate);
-
-        if (ret != Z_OK) {
-            //std::cout << "error cleaning up zlib compression state"
-            //          << std::endl;
+        if (m_deflate_initialized) {
+            deflateEnd(&m_dstate);
         }
-
-        ret = inflateEnd(&m_istate);
-
-        if (ret != Z_OK) {
-            //std::cout << "error cleaning up zlib decompression state"
-            //          << std::endl;
+        if (m_inflate_initialized) {
+            inflateEnd(&m_istate);
         }
     }
 
     /// Initialize zlib state
     /**
+     * Sets up both the compressor and the decompressor. Calling this is
+     * optional: compress() and decompress() each set up their own half on
+     * first use, so a connection that only ever receives compressed messages
+     * never pays for a compressor, and vice versa.
+     *
+     * Compression level and memory level come from the config's
+     * compression_level and memory_level settings. The window sizes are the
+     * negotiated ones.
      *
-     * @todo memory level, strategy, etc are hardcoded
      * @todo server detection is hardcoded
      */
     lib::error_code init() {
-        uint8_t deflate_bits;
-        uint8_t inflate_bits;
-
-        if (true /*is_server*/) {
-            deflate_bits = m_s2c_max_window_bits;
-            inflate_bits = m_c2s_max_window_bits;
-        } else {
-            deflate_bits = m_c2s_max_window_bits;
-            inflate_bits = m_s2c_max_window_bits;
-        }
-
-        int ret = deflateInit2(
-            &m_dstate,
-            Z_DEFAULT_COMPRESSION,
-            Z_DEFLATED,
-            -1*deflate_bits,
-            8, // memory level 1-9
-            /*Z_DEFAULT_STRATEGY*/Z_FIXED
-        );
-
-        if (ret != Z_OK) {
-            return make_error_code(error::zlib_error);
+        lib::error_code ec = init_deflate();
+        if (!ec) {
+            ec = init_inflate();
         }
-
-        ret = inflateInit2(
-            &m_istate,
-            -1*inflate_bits
-        );
-
-        if (ret != Z_OK) {
-            return make_error_code(error::zlib_error);
-        }
-
-        m_compress_buffer.reset(new unsigned char[m_compress_buffer_size]);
-        m_initialized = true;
-        return lib::error_code();
+        return ec;
     }
 
     /// Test if this object impliments the permessage-deflate specification
@@ -477,39 +454,102 @@ public:
         return ret;
     }
 
+    /// Ask the compression policy whether a message should be compressed
+    /**
+     * A message is sent uncompressed if it is binary and the config's
+     * compress_binary setting is false, if it is smaller than
+     * minimum_compress_size, or if recent messages compressed poorly.
+     *
+     * The recent ratio is a running average of compressed / uncompressed size
+     * in percent. Once it reaches maximum_compress_ratio the next
+     * compress_backoff_messages messages are skipped, after which one message
+     * is compressed again to take a fresh measurement.
+     *
+     * Skipped messages are counted in the connection's statistics.
+     *
+     * @param op The opcode of the message
+     * @param size The uncompressed payload size of the message
+     * @return Whether the message should be compressed
+     */
+    bool should_compress(frame::opcode::value op, size_t size) {
+        bool skip = (op == frame::opcode::BINARY && !config::compress_binary)
+                    || size < config::minimum_compress_size;
+
+        if (!skip && m_backoff > 0) {
+            --m_backoff;
+            skip = true;
+        }
+
+        if (skip) {
+            ++m_stats.skipped;
+        }
+        return !skip;
+    }
+
+    /// Retrieve counters describing what the compression policy did
+    compression_stats const & get_stats() const {
+        return m_stats;
+    }
+
     /// Compress bytes
     /**
+     * Deflates straight into the storage of `out`, growing it as needed, so
+     * no intermediate buffer is involved. With s2c_no_context_takeover the
+     * compressor is reset afterwards so the next message starts from an empty
+     * window.
+     *
      * @param [in] in String to compress
      * @param [out] out String to append compressed bytes to
      * @return Error or status code
      */
     lib::error_code compress(std::string const & in, std::string & out) {
-        if (!m_initialized) {
-            return make_error_code(error::uninitialized);
+        lib::error_code ec = init_deflate();
+        if (ec) {
+            return ec;
         }
 
-        size_t output;
-
-        m_dstate.avail_out = m_compress_buffer_size;
+        m_dstate.avail_in = static_cast<uInt>(in.size());
         m_dstate.next_in = (unsigned char *)(const_cast<char *>(in.data()));
 
+        size_t const start = out.size();
+        size_t offset = start;
+        // deflateBound covers the whole input; the sync flush marker adds a
+        // few bytes more.
+        out.resize(offset + deflateBound(&m_dstate,uLong(in.size())) + 8);
+
         do {
-            // Output to local buffer
-            m_dstate.avail_out = m_compress_buffer_size;
-            m_dstate.next_out = m_compress_buffer.get();
+            if (offset == out.size()) {
+                out.resize(out.size() + m_compress_buffer_size);
+            }
 
-            deflate(&m_dstate, Z_SYNC_FLUSH);
+            m_dstate.avail_out = static_cast<uInt>(out.size() - offset);
+            m_dstate.next_out = reinterpret_cast<unsigned char *>(&out[offset]);
 
-            output = m_compress_buffer_size - m_dstate.avail_out;
+            int ret = deflate(&m_dstate, Z_SYNC_FLUSH);
+            if (ret == Z_STREAM_ERROR) {
+                out.resize(offset);
+                return make_error_code(error::zlib_error);
+            }
 
-            out.append((char *)(m_compress_buffer.get()),output);
+            offset = out.size() - m_dstate.avail_out;
         } while (m_dstate.avail_out == 0);
 
+        out.resize(offset);
+
+        if (m_s2c_no_context_takeover) {
+            deflateReset(&m_dstate);
+        }
+
+        update_ratio(in.size(), offset - start);
+
         return lib::error_code();
     }
 
     /// Decompress bytes
     /**
+     * Inflates straight into the storage of `out`, growing it in steps of the
+     * compress buffer size.
+     *
      * @param buf Byte buffer to decompress
      * @param len Length of buf
      * @param out String to append decompressed bytes to
@@ -518,34 +558,119 @@ public:
     lib::error_code decompress(uint8_t const * buf, size_t len, std::string &
         out)
     {
-        if (!m_initialized) {
-            return make_error_code(error::uninitialized);
+        lib::error_code ec = init_inflate();
+        if (ec) {
+            return ec;
         }
 
         int ret;
 
-        m_istate.avail_in = len;
+        m_istate.avail_in = static_cast<uInt>(len);
         m_istate.next_in = const_cast<unsigned char *>(buf);
 
+        size_t offset = out.size();
+
         do {
-            m_istate.avail_out = m_compress_buffer_size;
-            m_istate.next_out = m_compress_buffer.get();
+            out.resize(offset + m_compress_buffer_size);
+
+            m_istate.avail_out = static_cast<uInt>(m_compress_buffer_size);
+            m_istate.next_out = reinterpret_cast<unsigned char *>(&out[offset]);
 
             ret = inflate(&m_istate, Z_SYNC_FLUSH);
 
             if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR) {
+                out.resize(offset);
                 return make_error_code(error::zlib_error);
             }
 
-            out.append(
-                reinterpret_cast<char *>(m_compress_buffer.get()),
-                m_compress_buffer_size - m_istate.avail_out
-            );
+            offset += m_compress_buffer_size - m_istate.avail_out;
         } while (m_istate.avail_out == 0);
 
+        out.resize(offset);
+
         return lib::error_code();
     }
 private:
+    /// Record the result of one compression for the policy and statistics
+    void update_ratio(size_t in_size, size_t out_size) {
+        ++m_stats.compressed;
+        m_stats.bytes_in += in_size;
+        m_stats.bytes_out += out_size;
+
+        if (in_size == 0) {
+            return;
+        }
+
+        unsigned int ratio = static_cast<unsigned int>(
+            std::min<uint64_t>(uint64_t(out_size) * 100 / in_size, 200));
+
+        if (m_stats.compressed == 1) {
+            m_ratio = ratio;
+        } else {
+            m_ratio = (3 * m_ratio + ratio) / 4;
+        }
+
+        if (m_ratio >= config::maximum_compress_ratio) {
+            m_backoff = config::compress_backoff_messages;
+        }
+    }
+
+    /// Set up the compressor if it is not running yet
+    lib::error_code init_deflate() {
+        if (m_deflate_initialized) {
+            return lib::error_code();
+        }
+
+        uint8_t deflate_bits;
+        if (true /*is_server*/) {
+            deflate_bits = m_s2c_max_window_bits;
+        } else {
+            deflate_bits = m_c2s_max_window_bits;
+        }
+
+        int ret = deflateInit2(
+            &m_dstate,
+            config::compression_level,
+            Z_DEFLATED,
+            -1*deflate_bits,
+            config::memory_level,
+            /*Z_DEFAULT_STRATEGY*/Z_FIXED
+        );
+
+        if (ret != Z_OK) {
+            return make_error_code(error::zlib_error);
+        }
+
+        m_deflate_initialized = true;
+        return lib::error_code();
+    }
+
+    /// Set up the decompressor if it is not running yet
+    lib::error_code init_inflate() {
+        if (m_inflate_initialized) {
+            return lib::error_code();
+        }
+
+        uint8_t inflate_bits;
+        if (true /*is_server*/) {
+            inflate_bits = m_c2s_max_window_bits;
+        } else {
+            inflate_bits = m_s2c_max_window_bits;
+        }
+
+        int ret = inflateInit2(
+            &m_istate,
+            -1*inflate_bits
+        );
+
+        if (ret != Z_OK) {
+            return make_error_code(error::zlib_error);
+        }
+
+        m_inflate_initialized = true;
+        return lib::error_code();
+    }
+
     /// Generate negotiation response
     /**
      * @return Generate extension negotiation reponse string to send to client
@@ -711,9 +836,12 @@ private:
     mode::value m_s2c_max_window_bits_mode;
     mode::value m_c2s_max_window_bits_mode;
 
-    bool m_initialized;
+    bool m_deflate_initialized;
+    bool m_inflate_initialized;
     size_t m_compress_buffer_size;
-    lib::unique_ptr_uchar_array m_compress_buffer;
+    compression_stats m_stats;
+    unsigned int m_ratio;
+    size_t m_backoff;
     z_stream m_dstate;
     z_stream m_istate;
 };
@@ -35,6 +35,23 @@
 
 #include <websocketpp/utilities.hpp>
 
+// Vector masking kernels are selected at compile time from the instruction
+// sets the compiler targets. Define WEBSOCKETPP_NO_SIMD_MASKING to fall back
+// to plain word by word masking.
+#if !defined(WEBSOCKETPP_STRICT_MASKING) && !defined(WEBSOCKETPP_NO_SIMD_MASKING)
+    #if defined(__AVX2__)
+        #include <immintrin.h>
+        #define _WEBSOCKETPP_AVX2_MASKING_
+    #elif defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #include <emmintrin.h>
+        #define _WEBSOCKETPP_SSE2_MASKING_
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #include <arm_neon.h>
+        #define _WEBSOCKETPP_NEON_MASKING_
+    #endif
+#endif
+
 namespace websocketpp {
 /// Data structures and utility functions for manipulating WebSocket frames
 /**
@@ -647,6 +664,67 @@ inline size_t circshift_prepared_key(size_t prepared_key, size_t offset) {
     }
 }
 
+/// Vector mask/unmask of the leading whole vector blocks of a buffer
+/**
+ * Masks as many bytes from the start of input as fit in whole vector
+ * registers (16 bytes for SSE2 and NEON, 32 for AVX2) and reports how many
+ * it processed. The caller finishes the remainder with word or byte masking.
+ * Every block length is a multiple of the four byte key period and of the
+ * machine word, so prepared_key applies unchanged to the first unprocessed
+ * byte. Loads and stores are unaligned, so input and output may point
+ * anywhere, including to the same buffer. When no vector instruction set is
+ * available this is a no-op that returns zero.
+ *
+ * @param input buffer to mask or unmask
+ *
+ * @param output buffer to store the output. May be the same as input.
+ *
+ * @param length length of data buffer
+ *
+ * @param prepared_key Prepared key to use.
+ *
+ * @return the number of leading bytes that were masked
+ */
+inline size_t vector_mask(uint8_t const * input, uint8_t * output,
+    size_t length, size_t prepared_key)
+{
+#if defined(_WEBSOCKETPP_AVX2_MASKING_) || defined(_WEBSOCKETPP_SSE2_MASKING_) \
+    || defined(_WEBSOCKETPP_NEON_MASKING_)
+    uint32_converter key;
+    key.i = static_cast<uint32_t>(prepared_key);
+    size_t i = 0;
+#endif
+
+#if defined(_WEBSOCKETPP_AVX2_MASKING_)
+    __m256i k = _mm256_set1_epi32(static_cast<int>(key.i));
+    for (; i + 32 <= length; i += 32) {
+        __m256i d = _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(input + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i),
+            _mm256_xor_si256(d,k));
+    }
+    return i;
+#elif defined(_WEBSOCKETPP_SSE2_MASKING_)
+    __m128i k = _mm_set1_epi32(static_cast<int>(key.i));
+    for (; i + 16 <= length; i += 16) {
+        __m128i d = _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(input + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i),
+            _mm_xor_si128(d,k));
+    }
+    return i;
+#elif defined(_WEBSOCKETPP_NEON_MASKING_)
+    uint8x16_t k = vreinterpretq_u8_u32(vdupq_n_u32(key.i));
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(output + i, veorq_u8(vld1q_u8(input + i),k));
+    }
+    return i;
+#else
+    (void)input; (void)output; (void)length; (void)prepared_key;
+    return 0;
+#endif
+}
+
 /// Byte by byte mask/unmask
 /**
  * Iterator based byte by byte masking and unmasking for WebSocket payloads.
@@ -728,11 +806,12 @@ inline void word_mask_exact(uint8_t* input, uint8_t* output, size_t length,
     const masking_key_type& key)
 {
     size_t prepared_key = prepare_masking_key(key);
+    size_t v = vector_mask(input,output,length,prepared_key);
     size_t n = length/sizeof(size_t);
     size_t* input_word = reinterpret_cast<size_t*>(input);
     size_t* output_word = reinterpret_cast<size_t*>(output);
 
-    for (size_t i = 0; i < n; i++) {
+    for (size_t i = v/sizeof(size_t); i < n; i++) {
         output_word[i] = input_word[i] ^ prepared_key;
     }
 
@@ -798,8 +877,9 @@ inline size_t word_mask_circ(uint8_t * input, uint8_t * output, size_t length,
     size_t * input_word = reinterpret_cast<size_t *>(input);
     size_t * output_word = reinterpret_cast<size_t *>(output);
 
-    // mask word by word
-    for (size_t i = 0; i < n; i++) {
+    // mask whole vectors, then the remaining whole words
+    size_t v = vector_mask(input,output,length,prepared_key);
+    for (size_t i = v/sizeof(size_t); i < n; i++) {
         output_word[i] = input_word[i] ^ prepared_key;
     }
 
@@ -41,7 +41,7 @@ inline void parser::set_version(std::string const & version) {
 }
 
 inline std::string const & parser::get_header(std::string const & key) const {
-    header_list::const_iterator h = m_headers.find(key);
+    header_list::const_iterator h = find_header(key.data(),key.size());
 
     if (h == m_headers.end()) {
         return empty_header;
@@ -53,7 +53,7 @@ inline std::string const & parser::get_header(std::string const & key) const {
 inline bool parser::get_header_as_plist(std::string const & key,
     parameter_list & out) const
 {
-    header_list::const_iterator it = m_headers.find(key);
+    header_list::const_iterator it = find_header(key.data(),key.size());
 
     if (it == m_headers.end() || it->second.size() == 0) {
         return false;
@@ -69,21 +69,35 @@ inline void parser::append_header(std::string const & key, std::string const &
         throw exception("Invalid header name",status_code::bad_request);
     }
 
-    if (this->get_header(key) == "") {
-        m_headers[key] = val;
+    header_list::iterator it = find_header(key.data(),key.size());
+
+    if (it == m_headers.end()) {
+        m_headers.push_back(std::make_pair(key,val));
+    } else if (it->second.empty()) {
+        it->second = val;
     } else {
-        m_headers[key] += ", " + val;
+        it->second.append(", ").append(val);
     }
 }
 
 inline void parser::replace_header(std::string const & key, std::string const &
     val)
 {
-    m_headers[key] = val;
+    header_list::iterator it = find_header(key.data(),key.size());
+
+    if (it == m_headers.end()) {
+        m_headers.push_back(std::make_pair(key,val));
+    } else {
+        it->second = val;
+    }
 }
 
 inline void parser::remove_header(std::string const & key) {
-    m_headers.erase(key);
+    header_list::iterator it = find_header(key.data(),key.size());
+
+    if (it != m_headers.end()) {
+        m_headers.erase(it);
+    }
 }
 
 inline void parser::set_body(std::string const & value) {
@@ -147,19 +161,94 @@ inline void parser::process_header(std::string::iterator begin,
         throw exception("Invalid header line",status_code::bad_request);
     }
 
-    append_header(strip_lws(std::string(begin,cursor)),
-                  strip_lws(std::string(cursor+sizeof(header_separator)-1,end)));
+    // Trim the name and value in place rather than through strip_lws so the
+    // only allocations are the stored strings themselves.
+    std::string::iterator name_begin = extract_all_lws(begin,cursor);
+    std::string::iterator name_end = extract_all_lws(
+        std::string::reverse_iterator(cursor),
+        std::string::reverse_iterator(name_begin)).base();
+
+    std::string::iterator value_begin = extract_all_lws(
+        cursor+sizeof(header_separator)-1,end);
+    std::string::iterator value_end = extract_all_lws(
+        std::string::reverse_iterator(end),
+        std::string::reverse_iterator(value_begin)).base();
+
+    if (std::find_if(name_begin,name_end,is_not_token_char) != name_end) {
+        throw exception("Invalid header name",status_code::bad_request);
+    }
+
+    char const * name = &*begin + (name_begin-begin);
+    header_list::iterator it = find_header(name,
+        static_cast<size_t>(name_end-name_begin));
+
+    if (it == m_headers.end()) {
+        if (m_headers.empty()) {
+            m_headers.reserve(16);
+        }
+        m_headers.push_back(header_list::value_type());
+        m_headers.back().first.assign(name_begin,name_end);
+        m_headers.back().second.assign(value_begin,value_end);
+    } else if (it->second.empty()) {
+        it->second.assign(value_begin,value_end);
+    } else {
+        it->second.append(", ").append(value_begin,value_end);
+    }
+}
+
+inline header_list::iterator parser::find_header(char const * key, size_t len)
+{
+    header_list::iterator it;
+    for (it = m_headers.begin(); it != m_headers.end(); ++it) {
+        if (it->first.size() == len &&
+            utility::ci_equal(it->first.data(),key,len))
+        {
+            break;
+        }
+    }
+    return it;
+}
+
+inline header_list::const_iterator parser::find_header(char const * key,
+    size_t len) const
+{
+    header_list::const_iterator it;
+    for (it = m_headers.begin(); it != m_headers.end(); ++it) {
+        if (it->first.size() == len &&
+            utility::ci_equal(it->first.data(),key,len))
+        {
+            break;
+        }
+    }
+    return it;
 }
 
 inline std::string parser::raw_headers() const {
-    std::stringstream raw;
+    std::string raw;
+    raw.reserve(raw_headers_size());
+    append_raw_headers(raw);
+    return raw;
+}
+
+inline size_t parser::raw_headers_size() const {
+    size_t size = 0;
 
     header_list::const_iterator it;
     for (it = m_headers.begin(); it != m_headers.end(); it++) {
-        raw << it->first << ": " << it->second << "\r\n";
+        size += it->first.size() + it->second.size() + 4;
     }
 
-    return raw.str();
+    return size;
+}
+
+inline void parser::append_raw_headers(std::string & out) const {
+    header_list::const_iterator it;
+    for (it = m_headers.begin(); it != m_headers.end(); it++) {
+        out.append(it->first);
+        out.append(": ",2);
+        out.append(it->second);
+        out.append("\r\n",2);
+    }
 }
 
 
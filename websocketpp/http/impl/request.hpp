@@ -132,13 +132,25 @@ inline size_t request::consume(const char *buf, size_t len) {
 }
 
 inline std::string request::raw() {
-    // TODO: validation. Make sure all required fields have been set?
-    std::stringstream ret;
-
-    ret << m_method << " " << m_uri << " " << get_version() << "\r\n";
-    ret << raw_headers() << "\r\n" << m_body;
+    std::string ret;
+    append_raw(ret);
+    return ret;
+}
 
-    return ret.str();
+inline void request::append_raw(std::string & out) const {
+    // TODO: validation. Make sure all required fields have been set?
+    out.reserve(out.size() + m_method.size() + m_uri.size() +
+        get_version().size() + 4 + raw_headers_size() + 2 + m_body.size());
+
+    out.append(m_method);
+    out += ' ';
+    out.append(m_uri);
+    out += ' ';
+    out.append(get_version());
+    out.append("\r\n",2);
+    append_raw_headers(out);
+    out.append("\r\n",2);
+    out.append(m_body);
 }
 
 inline void request::set_method(const std::string& method) {
@@ -171,7 +183,10 @@ inline void request::process(std::string::iterator begin, std::string::iterator
         throw exception("Invalid request line1",status_code::bad_request);
     }
 
-    set_method(std::string(cursor_start,cursor_end));
+    if (std::find_if(cursor_start,cursor_end,is_not_token_char) != cursor_end) {
+        throw exception("Invalid method token.",status_code::bad_request);
+    }
+    m_method.assign(cursor_start,cursor_end);
 
     cursor_start = cursor_end+1;
     cursor_end = std::find(cursor_start,end,' ');
@@ -180,8 +195,8 @@ inline void request::process(std::string::iterator begin, std::string::iterator
         throw exception("Invalid request line2",status_code::bad_request);
     }
 
-    set_uri(std::string(cursor_start,cursor_end));
-    set_version(std::string(cursor_end+1,end));
+    m_uri.assign(cursor_start,cursor_end);
+    m_version.assign(cursor_end+1,end);
 }
 
 } // namespace parser
@@ -199,16 +199,37 @@ inline bool response::parse_complete(std::istream& s) {
 }
 
 inline std::string response::raw() const {
-    // TODO: validation. Make sure all required fields have been set?
-
-    std::stringstream ret;
-
-    ret << get_version() << " " << m_status_code << " " << m_status_msg;
-    ret << "\r\n" << raw_headers() << "\r\n";
+    std::string ret;
+    append_raw(ret);
+    return ret;
+}
 
-    ret << m_body;
+inline void response::append_raw(std::string & out) const {
+    // TODO: validation. Make sure all required fields have been set?
 
-    return ret.str();
+    // status codes are at most a few digits; write them without a stream
+    char code[12];
+    int n = 0;
+    unsigned int value = static_cast<unsigned int>(m_status_code);
+    do {
+        code[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value && n < static_cast<int>(sizeof(code)));
+
+    out.reserve(out.size() + get_version().size() + 1 + n + 1 +
+        m_status_msg.size() + 2 + raw_headers_size() + 2 + m_body.size());
+
+    out.append(get_version());
+    out += ' ';
+    while (n) {
+        out += code[--n];
+    }
+    out += ' ';
+    out.append(m_status_msg);
+    out.append("\r\n",2);
+    append_raw_headers(out);
+    out.append("\r\n",2);
+    out.append(m_body);
 }
 
 inline void response::set_status(status_code::value code) {
@@ -235,7 +256,7 @@ inline void response::process(std::string::iterator begin,
         throw exception("Invalid response line",status_code::bad_request);
     }
 
-    set_version(std::string(cursor_start,cursor_end));
+    m_version.assign(cursor_start,cursor_end);
 
     cursor_start = cursor_end+1;
     cursor_end = std::find(cursor_start,end,' ');
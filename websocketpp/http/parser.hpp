@@ -31,6 +31,8 @@
 #include <algorithm>
 #include <iostream>
 #include <map>
+#include <utility>
+#include <vector>
 
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/http/constants.hpp>
@@ -48,7 +50,13 @@ namespace state {
     };
 }
 
-typedef std::map<std::string, std::string, utility::ci_less > header_list;
+/// Flat list of header name/value pairs in the order they were added
+/**
+ * Handshakes carry a dozen or so headers, so a linear scan with a length
+ * check before the case insensitive compare beats a tree lookup and avoids a
+ * node allocation per header.
+ */
+typedef std::vector<std::pair<std::string, std::string> > header_list;
 
 /// Read and return the next token in the stream
 /**
@@ -515,6 +523,19 @@ protected:
      */
     void process_header(std::string::iterator begin, std::string::iterator end);
 
+    /// Find a header by name, ignoring case
+    /**
+     * @param [in] key Pointer to the name to look for. Need not be null
+     * terminated.
+     * @param [in] len Length of the name in bytes.
+     * @return An iterator to the header, or m_headers.end() if not found.
+     */
+    header_list::iterator find_header(char const * key, size_t len);
+
+    /// Find a header by name, ignoring case (const version)
+    header_list::const_iterator find_header(char const * key, size_t len)
+        const;
+
     /// Generate and return the HTTP headers as a string
     /**
      * Each headers will be followed by the \r\n sequence including the last one.
@@ -524,6 +545,17 @@ protected:
      */
     std::string raw_headers() const;
 
+    /// Number of bytes raw_headers() would return
+    size_t raw_headers_size() const;
+
+    /// Append the HTTP headers to a string
+    /**
+     * Writes the same bytes as raw_headers() without building a temporary.
+     *
+     * @param out The string to append to.
+     */
+    void append_raw_headers(std::string & out) const;
+
     std::string m_version;
     header_list m_headers;
     std::string m_body;
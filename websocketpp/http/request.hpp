@@ -87,6 +87,15 @@ public:
     /// Returns the full raw request
     std::string raw();
 
+    /// Append the full raw request to a string
+    /**
+     * Reserves the exact size needed and appends to the existing contents,
+     * so a buffer that is reused keeps its storage.
+     *
+     * @param out The string to append to.
+     */
+    void append_raw(std::string & out) const;
+
     /// Set the HTTP method. Must be a valid HTTP token
     void set_method(const std::string& method);
 
@@ -105,6 +105,15 @@ public:
     /// Returns the full raw response
     std::string raw() const;
 
+    /// Append the full raw response to a string
+    /**
+     * Reserves the exact size needed and appends to the existing contents,
+     * so a buffer that is reused keeps its storage.
+     *
+     * @param out The string to append to.
+     */
+    void append_raw(std::string & out) const;
+
     /// Set response status code and message
     /**
      * Sets the response status code to `code` and looks up the corresponding
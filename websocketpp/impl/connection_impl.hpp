@@ -92,8 +92,30 @@ lib::error_code connection<config>::send(const void* payload, size_t len,
     return send(msg);
 }
 
+template <typename config>
+lib::error_code connection<config>::send(shared_payload_ptr payload,
+    frame::opcode::value op)
+{
+    if (!payload) {
+        return error::make_error_code(error::payload_violation);
+    }
+
+    message_ptr msg = m_msg_manager->get_message(op,0);
+    msg->set_shared_payload(payload);
+
+    return send(msg);
+}
+
 template <typename config>
 lib::error_code connection<config>::send(typename config::message_type::ptr msg)
+{
+    return send(msg, msg->get_opcode() == frame::opcode::binary ?
+        send_priority::bulk : send_priority::interactive);
+}
+
+template <typename config>
+lib::error_code connection<config>::send(typename config::message_type::ptr
+    msg, send_priority::value priority)
 {
     if (m_alog.static_test(log::alevel::devel)) {
         m_alog.write(log::alevel::devel,"connection send");
@@ -104,15 +126,40 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
        return error::make_error_code(error::invalid_state);
     }
 
+    if (frame::opcode::is_control(msg->get_opcode())) {
+        priority = send_priority::control;
+    }
+
     message_ptr outgoing_msg;
     bool needs_writing = false;
+    bool high_water = false;
 
     if (msg->get_prepared()) {
         outgoing_msg = msg;
 
         scoped_lock_type lock(m_write_lock);
-        write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        if (!apply_send_policy(outgoing_msg->get_payload().size())) {
+            return error::make_error_code(error::send_queue_full);
+        }
+        write_push(outgoing_msg,priority);
+        high_water = check_high_water();
+        needs_writing = !m_write_flag && !write_queue_empty();
+    } else if (config::enable_send_priority && config::send_fragment_size > 0
+        && priority == send_priority::bulk
+        && msg->get_opcode() == frame::opcode::binary && msg->get_fin()
+        && !msg->get_compressed() && m_processor->get_version() != 0
+        && msg->get_payload().size() > config::send_fragment_size)
+    {
+        scoped_lock_type lock(m_write_lock);
+        if (!apply_send_policy(msg->get_payload().size())) {
+            return error::make_error_code(error::send_queue_full);
+        }
+        lib::error_code ec = write_push_fragments(msg);
+        if (ec) {
+            return ec;
+        }
+        high_water = check_high_water();
+        needs_writing = !m_write_flag && !write_queue_empty();
     } else {
         outgoing_msg = m_msg_manager->get_message();
 
@@ -121,14 +168,26 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
         }
 
         scoped_lock_type lock(m_write_lock);
+
+        // The policy runs before framing: framing a compressed message
+        // advances the deflate context even if the frame is then discarded.
+        if (!apply_send_policy(msg->get_payload().size())) {
+            return error::make_error_code(error::send_queue_full);
+        }
+
         lib::error_code ec = m_processor->prepare_data_frame(msg,outgoing_msg);
 
         if (ec) {
             return ec;
         }
 
-        write_push(outgoing_msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        write_push(outgoing_msg,priority);
+        high_water = check_high_water();
+        needs_writing = !m_write_flag && !write_queue_empty();
+    }
+
+    if (high_water && m_high_water_handler) {
+        m_high_water_handler(m_connection_hdl);
     }
 
     if (needs_writing) {
@@ -141,6 +200,30 @@ lib::error_code connection<config>::send(typename config::message_type::ptr msg)
     return lib::error_code();
 }
 
+template <typename config>
+typename connection<config>::message_ptr
+connection<config>::prepare_data_frame(message_ptr msg, lib::error_code & ec)
+{
+    if (m_state != session::state::open) {
+        ec = error::make_error_code(error::invalid_state);
+        return message_ptr();
+    }
+
+    message_ptr outgoing_msg = m_msg_manager->get_message();
+    if (!outgoing_msg) {
+        ec = error::make_error_code(error::no_outgoing_buffers);
+        return message_ptr();
+    }
+
+    scoped_lock_type lock(m_write_lock);
+    ec = m_processor->prepare_data_frame(msg,outgoing_msg);
+    if (ec) {
+        return message_ptr();
+    }
+
+    return outgoing_msg;
+}
+
 template <typename config>
 void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
     if (m_alog.static_test(log::alevel::devel)) {
@@ -169,7 +252,7 @@ void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
         }
 
         if (m_pong_timeout_dur > 0) {
-            m_ping_timer = transport_con_type::set_timer(
+            m_ping_timer = transport_con_type::set_timeout(
                 m_pong_timeout_dur,
                 lib::bind(
                     &type::handle_pong_timeout,
@@ -190,8 +273,8 @@ void connection<config>::ping(const std::string& payload, lib::error_code& ec) {
     bool needs_writing = false;
     {
         scoped_lock_type lock(m_write_lock);
-        write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        write_push(msg,send_priority::control);
+        needs_writing = !m_write_flag && !write_queue_empty();
     }
 
     if (needs_writing) {
@@ -255,8 +338,8 @@ void connection<config>::pong(const std::string& payload, lib::error_code& ec) {
     bool needs_writing = false;
     {
         scoped_lock_type lock(m_write_lock);
-        write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        write_push(msg,send_priority::control);
+        needs_writing = !m_write_flag && !write_queue_empty();
     }
 
     if (needs_writing) {
@@ -684,6 +767,9 @@ void connection<config>::handle_transport_init(lib::error_code const & ec) {
         // We are a client. Set the processor to the version specified in the
         // config file and send a handshake request.
         m_processor = get_processor(config::client_version);
+        if (m_processor && m_message_chunk_handler) {
+            m_processor->set_streaming(true);
+        }
         this->send_http_request();
     }
 }
@@ -693,7 +779,7 @@ void connection<config>::read_handshake(size_t num_bytes) {
     m_alog.write(log::alevel::devel,"connection read");
 
     if (m_open_handshake_timeout_dur > 0) {
-        m_handshake_timer = transport_con_type::set_timer(
+        m_handshake_timer = transport_con_type::set_timeout(
             m_open_handshake_timeout_dur,
             lib::bind(
                 &type::handle_open_handshake_timeout,
@@ -703,10 +789,12 @@ void connection<config>::read_handshake(size_t num_bytes) {
         );
     }
 
+    this->prepare_read_buffer();
+
     transport_con_type::async_read_at_least(
         num_bytes,
         m_buf,
-        config::connection_read_buffer_size,
+        m_buf_size,
         lib::bind(
             &type::handle_read_handshake,
             type::get_shared(),
@@ -746,7 +834,7 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
     }
 
     // Boundaries checking. TODO: How much of this should be done?
-    if (bytes_transferred > config::connection_read_buffer_size) {
+    if (bytes_transferred > m_buf_size) {
         m_elog.write(log::elevel::fatal,"Fatal boundaries checking error.");
         this->terminate(make_error_code(error::general));
         return;
@@ -765,7 +853,7 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
 
     // More paranoid boundaries checking.
     // TODO: Is this overkill?
-    if (bytes_processed > config::connection_read_buffer_size) {
+    if (bytes_processed > m_buf_size) {
         m_elog.write(log::elevel::fatal,"Fatal boundaries checking error.");
         this->terminate(make_error_code(error::general));
         return;
@@ -830,7 +918,7 @@ void connection<config>::handle_read_handshake(lib::error_code const & ec,
         transport_con_type::async_read_at_least(
             1,
             m_buf,
-            config::connection_read_buffer_size,
+            m_buf_size,
             lib::bind(
                 &type::handle_read_handshake,
                 type::get_shared(),
@@ -863,6 +951,8 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
     size_t bytes_transferred)
 {
     //m_alog.write(log::alevel::devel,"connection handle_read_frame");
+    profiler::conditional_stage_scope<config::enable_profiler_stages>
+        stage("websocket.read");
 
     this->atomic_state_check(
         istate::PROCESS_CONNECTION,
@@ -912,6 +1002,7 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
     }*/
 
     size_t p = 0;
+    size_t messages = 0;
 
     if (m_alog.static_test(log::alevel::devel)) {
         std::stringstream s;
@@ -962,6 +1053,20 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
             return;
         }
 
+        processor::payload_chunk chunk;
+        if (m_processor->get_chunk(chunk)) {
+            if (chunk.last) {
+                ++messages;
+            }
+
+            if (m_state != session::state::open) {
+                m_elog.write(log::elevel::warn, "got non-close frame while closing");
+            } else if (m_message_chunk_handler) {
+                m_message_chunk_handler(m_connection_hdl, chunk.opcode,
+                    chunk.data, chunk.len, chunk.last);
+            }
+        }
+
         if (m_processor->ready()) {
             if (m_alog.static_test(log::alevel::devel)) {
                 std::stringstream s;
@@ -970,6 +1075,7 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
             }
 
             message_ptr msg = m_processor->get_message();
+            ++messages;
 
             if (!msg) {
                 m_alog.write(log::alevel::devel, "null message from m_processor");
@@ -986,6 +1092,22 @@ void connection<config>::handle_read_frame(lib::error_code const & ec,
         }
     }
 
+    if (config::enable_metrics) {
+        {
+            scoped_lock_type lock(m_write_lock);
+            m_metrics.bytes_in += bytes_transferred;
+            m_metrics.messages_in += messages;
+        }
+        if (m_endpoint_metrics) {
+            m_endpoint_metrics->add_read(bytes_transferred,messages);
+        }
+    }
+
+    // Every byte has been consumed, so the buffer can be swapped before the
+    // next read is issued.
+    this->adapt_read_buffer(bytes_transferred);
+    this->prepare_read_buffer();
+
     read_frame();
 }
 
@@ -1006,11 +1128,61 @@ void connection<config>::read_frame() {
          config::connection_read_buffer_size : m_processor->get_bytes_needed())*/
         1,
         m_buf,
-        config::connection_read_buffer_size,
+        m_buf_size,
         m_handle_read_frame
     );
 }
 
+template <typename config>
+void connection<config>::prepare_read_buffer() {
+    if (!m_read_buffer_pool) {
+        // no endpoint pool; a pool that caches nothing allocates directly
+        m_read_buffer_pool.reset(new message_buffer::read_buffer_pool(
+            config::connection_read_buffer_min_size,
+            config::connection_read_buffer_size,
+            0
+        ));
+    }
+
+    size_t size = m_read_buffer_pool->round_size(m_buf_target);
+    m_buf_target = size;
+
+    if (m_buf && m_buf_size == size) {
+        return;
+    }
+
+    if (m_buf) {
+        m_read_buffer_pool->release(m_buf,m_buf_size);
+    }
+    m_buf = m_read_buffer_pool->allocate(size);
+    m_buf_size = size;
+
+    if (m_alog.static_test(log::alevel::devel)) {
+        std::stringstream s;
+        s << "read buffer size: " << m_buf_size;
+        m_alog.write(log::alevel::devel,s.str());
+    }
+}
+
+template <typename config>
+void connection<config>::adapt_read_buffer(size_t bytes_transferred) {
+    // Number of consecutive reads using a quarter of the buffer or less
+    // after which the buffer is halved
+    static size_t const shrink_after = 8;
+
+    if (bytes_transferred >= m_buf_size) {
+        m_buf_target = m_buf_size * 2;
+        m_buf_small_reads = 0;
+    } else if (bytes_transferred <= m_buf_size / 4) {
+        if (++m_buf_small_reads >= shrink_after) {
+            m_buf_target = m_buf_size / 2;
+            m_buf_small_reads = 0;
+        }
+    } else {
+        m_buf_small_reads = 0;
+    }
+}
+
 template <typename config>
 bool connection<config>::initialize_processor() {
     m_alog.write(log::alevel::devel,"initialize_processor");
@@ -1032,6 +1204,9 @@ bool connection<config>::initialize_processor() {
 
     // if the processor is not null we are done
     if (m_processor) {
+        if (m_message_chunk_handler) {
+            m_processor->set_streaming(true);
+        }
         return true;
     }
 
@@ -1188,7 +1363,8 @@ void connection<config>::send_http_response() {
         m_handshake_buffer = m_processor->get_raw(m_response);
     } else {
         // a processor wont exist for raw HTTP responses.
-        m_handshake_buffer = m_response.raw();
+        m_handshake_buffer.clear();
+        m_response.append_raw(m_handshake_buffer);
     }
 
     if (m_alog.static_test(log::alevel::devel)) {
@@ -1257,6 +1433,10 @@ void connection<config>::handle_send_http_response(lib::error_code const & ec) {
         "handle_send_http_response must be called from PROCESS_HTTP_REQUEST state"
     );
 
+    if (config::enable_connection_registry && m_registry) {
+        m_id = m_registry->add(this);
+    }
+
     if (m_open_handler) {
         m_open_handler(m_connection_hdl);
     }
@@ -1295,14 +1475,15 @@ void connection<config>::send_http_request() {
         }
     }
 
-    m_handshake_buffer = m_request.raw();
+    m_handshake_buffer.clear();
+    m_request.append_raw(m_handshake_buffer);
 
     if (m_alog.static_test(log::alevel::devel)) {
         m_alog.write(log::alevel::devel,"Raw Handshake request:\n"+m_handshake_buffer);
     }
 
     if (m_open_handshake_timeout_dur > 0) {
-        m_handshake_timer = transport_con_type::set_timer(
+        m_handshake_timer = transport_con_type::set_timeout(
             m_open_handshake_timeout_dur,
             lib::bind(
                 &type::handle_open_handshake_timeout,
@@ -1344,10 +1525,12 @@ void connection<config>::handle_send_http_request(lib::error_code const & ec) {
         "handle_send_http_request must be called from WRITE_HTTP_REQUEST state"
     );
 
+    this->prepare_read_buffer();
+
     transport_con_type::async_read_at_least(
         1,
         m_buf,
-        config::connection_read_buffer_size,
+        m_buf_size,
         lib::bind(
             &type::handle_read_http_response,
             type::get_shared(),
@@ -1413,6 +1596,10 @@ void connection<config>::handle_read_http_response(lib::error_code const & ec,
 
         this->log_open_result();
 
+        if (config::enable_connection_registry && m_registry) {
+            m_id = m_registry->add(this);
+        }
+
         if (m_open_handler) {
             m_open_handler(m_connection_hdl);
         }
@@ -1428,7 +1615,7 @@ void connection<config>::handle_read_http_response(lib::error_code const & ec,
         transport_con_type::async_read_at_least(
             1,
             m_buf,
-            config::connection_read_buffer_size,
+            m_buf_size,
             lib::bind(
                 &type::handle_read_http_response,
                 type::get_shared(),
@@ -1527,6 +1714,10 @@ void connection<config>::handle_terminate(terminate_status tstat,
         log_err(log::elevel::devel,"handle_terminate",ec);
     }
 
+    if (config::enable_metrics && m_endpoint_metrics) {
+        m_endpoint_metrics->connection_closed();
+    }
+
     // clean shutdown
     if (tstat == failed) {
         if (m_fail_handler) {
@@ -1542,6 +1733,11 @@ void connection<config>::handle_terminate(terminate_status tstat,
         m_elog.write(log::elevel::rerror,"Unknown terminate_status");
     }
 
+    if (m_id) {
+        m_registry->remove(m_id);
+        m_id = 0;
+    }
+
     // call the termination handler if it exists
     // if it exists it might (but shouldn't) refer to a bad memory location.
     // If it does, we don't care and should catch and ignore it.
@@ -1559,6 +1755,8 @@ template <typename config>
 void connection<config>::write_frame() {
     //m_alog.write(log::alevel::devel,"connection write_frame");
 
+    bool low_water = false;
+
     {
         scoped_lock_type lock(m_write_lock);
 
@@ -1570,17 +1768,63 @@ void connection<config>::write_frame() {
             return;
         }
 
+        // Hold small writes back for up to write_coalesce_delay so that
+        // frames queued in quick succession share one transport write. A
+        // terminal message or a full window ends the wait early.
+        bool terminal_queued = false;
+        for (size_t i = 0; i < send_priority::count; ++i) {
+            if (!m_send_queue[i].empty() &&
+                m_send_queue[i].back()->get_terminal())
+            {
+                terminal_queued = true;
+            }
+        }
+
+        if (config::write_coalesce_delay > 0 && !m_write_coalesce_flush &&
+            !write_queue_empty() && !terminal_queued &&
+            m_send_buffer_size < config::write_coalesce_size)
+        {
+            if (!m_write_coalesce_timer) {
+                ++m_write_coalesce_generation;
+                m_write_coalesce_timer = transport_con_type::set_timer(
+                    config::write_coalesce_delay,
+                    lib::bind(
+                        &type::handle_write_coalesce_timeout,
+                        type::get_shared(),
+                        m_write_coalesce_generation,
+                        lib::placeholders::_1
+                    )
+                );
+            }
+            // Without transport timer support, write immediately.
+            if (m_write_coalesce_timer) {
+                return;
+            }
+        }
+
+        m_write_coalesce_flush = false;
+        if (m_write_coalesce_timer) {
+            m_write_coalesce_timer->cancel();
+            m_write_coalesce_timer.reset();
+        }
+
         // pull off all the messages that are ready to write.
         // stop if we get a message marked terminal
-        message_ptr next_message = write_pop();
+        size_t bulk_bytes = 0;
+        message_ptr next_message = write_pop(bulk_bytes);
         while (next_message) {
             m_current_msgs.push_back(next_message);
             if (!next_message->get_terminal()) {
-                next_message = write_pop();
+                next_message = write_pop(bulk_bytes);
             } else {
                 next_message = message_ptr();
             }
         }
+
+        if (m_above_high_water && m_send_buffer_size <= m_send_low_water) {
+            m_above_high_water = false;
+            low_water = true;
+        }
         
         if (m_current_msgs.empty()) {
             // there was nothing to send
@@ -1590,9 +1834,17 @@ void connection<config>::write_frame() {
             // responsible for holding the write flag until they are 
             // successfully sent or there is some error
             m_write_flag = true;
+
+            if (config::enable_metrics) {
+                m_write_start = metrics::now_us();
+            }
         }
     }
 
+    if (low_water && m_low_water_handler) {
+        m_low_water_handler(m_connection_hdl);
+    }
+
     typename std::vector<message_ptr>::iterator it;
     for (it = m_current_msgs.begin(); it != m_current_msgs.end(); ++it) {
         std::string const & header = (*it)->get_header();
@@ -1651,12 +1903,35 @@ void connection<config>::write_frame() {
 template <typename config>
 void connection<config>::handle_write_frame(lib::error_code const & ec)
 {
+    profiler::conditional_stage_scope<config::enable_profiler_stages>
+        stage("websocket.write");
+
     if (m_alog.static_test(log::alevel::devel)) {
         m_alog.write(log::alevel::devel,"connection handle_write_frame");
     }
 
     bool terminal = m_current_msgs.back()->get_terminal();
 
+    if (config::enable_metrics && !ec) {
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < m_current_msgs.size(); ++i) {
+            bytes += m_current_msgs[i]->get_header().size()
+                   + m_current_msgs[i]->get_payload().size();
+        }
+        uint64_t latency = metrics::now_us() - m_write_start;
+
+        {
+            scoped_lock_type lock(m_write_lock);
+            m_metrics.bytes_out += bytes;
+            m_metrics.messages_out += m_current_msgs.size();
+            m_metrics.writes++;
+            m_metrics.write_latency.record(latency);
+        }
+        if (m_endpoint_metrics) {
+            m_endpoint_metrics->add_write(bytes,m_current_msgs.size(),latency);
+        }
+    }
+
     m_send_buffer.clear();
     m_current_msgs.clear();
     // TODO: recycle instead of deleting
@@ -1679,7 +1954,7 @@ void connection<config>::handle_write_frame(lib::error_code const & ec)
         // release write flag
         m_write_flag = false;
 
-        needs_writing = !m_send_queue.empty();
+        needs_writing = !write_queue_empty();
     }
 
     if (needs_writing) {
@@ -1690,6 +1965,44 @@ void connection<config>::handle_write_frame(lib::error_code const & ec)
     }
 }
 
+template <typename config>
+void connection<config>::handle_write_coalesce_timeout(uint64_t generation,
+    lib::error_code const & ec)
+{
+    if (ec) {
+        if (ec == transport::error::operation_aborted) {
+            // the window was closed early by a large or terminal write
+            return;
+        }
+
+        log_err(log::elevel::devel,"write_coalesce_timeout",ec);
+    }
+
+    {
+        scoped_lock_type lock(m_write_lock);
+
+        // A write that started after this timer expired, but before this
+        // handler ran, has already flushed the window. A newer window may
+        // have opened since; its own timer will close it.
+        if (!m_write_coalesce_timer ||
+            generation != m_write_coalesce_generation)
+        {
+            return;
+        }
+
+        m_write_coalesce_timer.reset();
+
+        // Nothing can be written once the connection has been terminated.
+        if (m_state == session::state::closed) {
+            return;
+        }
+
+        m_write_coalesce_flush = true;
+    }
+
+    write_frame();
+}
+
 template <typename config>
 void connection<config>::atomic_state_change(istate_type req, istate_type dest,
     std::string msg)
@@ -1934,7 +2247,7 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
     // Start a timer so we don't wait forever for the acknowledgement close
     // frame
     if (m_close_handshake_timeout_dur > 0) {
-        m_handshake_timer = transport_con_type::set_timer(
+        m_handshake_timer = transport_con_type::set_timeout(
             m_close_handshake_timeout_dur,
             lib::bind(
                 &type::handle_close_handshake_timeout,
@@ -1947,8 +2260,8 @@ lib::error_code connection<config>::send_close_frame(close::status::value code,
     bool needs_writing = false;
     {
         scoped_lock_type lock(m_write_lock);
-        write_push(msg);
-        needs_writing = !m_write_flag && !m_send_queue.empty();
+        write_push(msg,send_priority::control);
+        needs_writing = !m_write_flag && !write_queue_empty();
     }
 
     if (needs_writing) {
@@ -2011,46 +2324,255 @@ connection<config>::get_processor(int version) const {
 }
 
 template <typename config>
-void connection<config>::write_push(typename config::message_type::ptr msg)
+void connection<config>::write_push(typename config::message_type::ptr msg,
+    send_priority::value priority)
 {
     if (!msg) {
         return;
     }
 
+    if (!config::enable_send_priority) {
+        priority = send_priority::interactive;
+    } else if (priority != send_priority::control && msg->get_compressed()) {
+        // Compressed messages were deflated in the order they were queued
+        // and, with context takeover, each one depends on the previous. They
+        // all share one lane so the peer inflates them in that order.
+        priority = send_priority::interactive;
+    }
+
     m_send_buffer_size += msg->get_payload().size();
-    m_send_queue.push(msg);
+    m_send_queue[priority].push_back(msg);
+
+    if (config::enable_metrics) {
+        m_metrics.send_queue_depth = write_queue_size();
+        m_metrics.send_queue_peak = (std::max)(m_metrics.send_queue_peak,
+            m_metrics.send_queue_depth);
+    }
 
     if (m_alog.static_test(log::alevel::devel)) {
         std::stringstream s;
-        s << "write_push: message count: " << m_send_queue.size()
+        s << "write_push: message count: " << write_queue_size()
           << " buffer size: " << m_send_buffer_size;
         m_alog.write(log::alevel::devel,s.str());
     }
 }
 
 template <typename config>
-typename config::message_type::ptr connection<config>::write_pop()
+typename config::message_type::ptr connection<config>::write_pop(
+    size_t & bulk_bytes)
 {
     message_ptr msg;
 
-    if (m_send_queue.empty()) {
+    size_t lane = 0;
+    for (; lane < send_priority::count; ++lane) {
+        std::deque<message_ptr> const & q = m_send_queue[lane];
+
+        if (q.empty()) {
+            continue;
+        }
+
+        // Control frames may be written between the fragments of a data
+        // message. Data frames of another message may not.
+        if (lane != send_priority::control &&
+            m_send_open_lane != send_priority::count &&
+            m_send_open_lane != lane)
+        {
+            continue;
+        }
+
+        // A close frame ends the connection, so it waits for the data that
+        // was queued ahead of it.
+        if (lane == send_priority::control &&
+            q.front()->get_opcode() == frame::opcode::close &&
+            (!m_send_queue[send_priority::interactive].empty() ||
+             !m_send_queue[send_priority::bulk].empty()))
+        {
+            continue;
+        }
+
+        if (lane == send_priority::bulk && config::send_fragment_size > 0 &&
+            bulk_bytes >= config::send_fragment_size)
+        {
+            continue;
+        }
+
+        break;
+    }
+
+    if (lane == send_priority::count) {
         return msg;
     }
 
-    msg = m_send_queue.front();
+    msg = m_send_queue[lane].front();
 
     m_send_buffer_size -= msg->get_payload().size();
-    m_send_queue.pop();
+    m_send_queue[lane].pop_front();
+
+    if (lane != send_priority::control) {
+        m_send_open_lane = msg->get_fin() ? send_priority::count : lane;
+    }
+    if (lane == send_priority::bulk) {
+        bulk_bytes += msg->get_payload().size();
+    }
+
+    if (config::enable_metrics) {
+        m_metrics.send_queue_depth = write_queue_size();
+    }
 
     if (m_alog.static_test(log::alevel::devel)) {
         std::stringstream s;
-        s << "write_pop: message count: " << m_send_queue.size()
+        s << "write_pop: message count: " << write_queue_size()
           << " buffer size: " << m_send_buffer_size;
         m_alog.write(log::alevel::devel,s.str());
     }
     return msg;
 }
 
+template <typename config>
+bool connection<config>::write_queue_empty() const {
+    for (size_t i = 0; i < send_priority::count; ++i) {
+        if (!m_send_queue[i].empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename config>
+size_t connection<config>::write_queue_size() const {
+    size_t n = 0;
+    for (size_t i = 0; i < send_priority::count; ++i) {
+        n += m_send_queue[i].size();
+    }
+    return n;
+}
+
+template <typename config>
+lib::error_code connection<config>::write_push_fragments(
+    typename config::message_type::ptr msg)
+{
+    std::string const & payload = msg->get_payload();
+    size_t const total = payload.size();
+    size_t const fragment_size = config::send_fragment_size;
+
+    // Frame every fragment before queueing any of them so that a failure
+    // cannot leave a partial message in the queue.
+    std::vector<message_ptr> fragments;
+    fragments.reserve((total + fragment_size - 1) / fragment_size);
+
+    for (size_t offset = 0; offset < total; offset += fragment_size) {
+        size_t len = (std::min)(total - offset, fragment_size);
+        frame::opcode::value op = (offset == 0 ? frame::opcode::binary :
+            frame::opcode::continuation);
+
+        message_ptr in = m_msg_manager->get_message(op,len);
+        message_ptr out = m_msg_manager->get_message();
+        if (!in || !out) {
+            return error::make_error_code(error::no_outgoing_buffers);
+        }
+
+        in->set_payload(payload.data() + offset,len);
+        in->set_fin(offset + len == total);
+
+        lib::error_code ec = m_processor->prepare_data_frame(in,out);
+        if (ec) {
+            return ec;
+        }
+        fragments.push_back(out);
+    }
+
+    for (size_t i = 0; i < fragments.size(); ++i) {
+        write_push(fragments[i],send_priority::bulk);
+    }
+    return lib::error_code();
+}
+
+template <typename config>
+bool connection<config>::apply_send_policy(size_t len) {
+    if (m_send_high_water == 0 ||
+        m_send_buffer_size + len <= m_send_high_water)
+    {
+        return true;
+    }
+
+    if (m_send_policy == send_policy::reject) {
+        return false;
+    }
+
+    if (m_send_policy == send_policy::drop_oldest) {
+        size_t dropped = 0;
+
+        // Bulk data goes first. The control lane never holds droppable
+        // messages.
+        for (size_t lane = send_priority::bulk;
+            lane > send_priority::control; --lane)
+        {
+            std::deque<message_ptr> & q = m_send_queue[lane];
+            typename std::deque<message_ptr>::iterator it = q.begin();
+
+            while (it != q.end() &&
+                m_send_buffer_size + len > m_send_high_water)
+            {
+                message_ptr const & m = *it;
+                frame::opcode::value op = m->get_opcode();
+
+                // Only whole, uncompressed data messages can go without
+                // corrupting the stream: dropping part of a message would
+                // leave it unfinished and a compressed message carries
+                // deflate context the next one depends on.
+                if ((op != frame::opcode::text &&
+                     op != frame::opcode::binary) ||
+                    m->get_compressed() || m->get_terminal())
+                {
+                    ++it;
+                    continue;
+                }
+
+                // A fragmented message whose first frame is still queued has
+                // not started, so it can go as a whole if its last frame has
+                // been queued too.
+                typename std::deque<message_ptr>::iterator last = it;
+                while (last != q.end() && !(*last)->get_fin()) {
+                    ++last;
+                }
+                if (last == q.end()) {
+                    break;
+                }
+                ++last;
+
+                for (typename std::deque<message_ptr>::iterator f = it;
+                    f != last; ++f)
+                {
+                    m_send_buffer_size -= (*f)->get_payload().size();
+                }
+                it = q.erase(it,last);
+                ++dropped;
+            }
+        }
+
+        if (dropped > 0 && m_alog.static_test(log::alevel::devel)) {
+            std::stringstream s;
+            s << "send queue above high water mark, dropped " << dropped
+              << " message(s)";
+            m_alog.write(log::alevel::devel,s.str());
+        }
+    }
+
+    return true;
+}
+
+template <typename config>
+bool connection<config>::check_high_water() {
+    if (m_send_high_water == 0 || m_above_high_water ||
+        m_send_buffer_size < m_send_high_water)
+    {
+        return false;
+    }
+
+    m_above_high_water = true;
+    return true;
+}
+
 template <typename config>
 void connection<config>::log_open_result()
 {
@@ -43,7 +43,7 @@ endpoint<connection,config>::create_connection() {
     //scoped_lock_type guard(m_mutex);
     // Create a connection on the heap and manage it using a shared pointer
     connection_ptr con(new connection_type(m_is_server,m_user_agent,m_alog,
-        m_elog, m_rng));
+        m_elog, m_rng, m_msg_manager.get_manager()));
 
     connection_weak_ptr w(con);
 
@@ -61,9 +61,22 @@ endpoint<connection,config>::create_connection() {
     con->set_pong_handler(m_pong_handler);
     con->set_pong_timeout_handler(m_pong_timeout_handler);
     con->set_interrupt_handler(m_interrupt_handler);
+    con->set_high_water_handler(m_high_water_handler);
+    con->set_low_water_handler(m_low_water_handler);
     con->set_http_handler(m_http_handler);
     con->set_validate_handler(m_validate_handler);
     con->set_message_handler(m_message_handler);
+    con->set_message_chunk_handler(m_message_chunk_handler);
+
+    con->set_read_buffer_pool(m_read_buffer_pool);
+
+    if (config::enable_connection_registry) {
+        con->set_connection_registry(m_connection_registry);
+    }
+
+    if (config::enable_metrics) {
+        con->set_endpoint_metrics(m_metrics);
+    }
 
     if (m_open_handshake_timeout_dur != config::timeout_open_handshake) {
         con->set_open_handshake_timeout(m_open_handshake_timeout_dur);
@@ -86,6 +99,12 @@ endpoint<connection,config>::create_connection() {
         return connection_ptr();
     }
 
+    // Counted only once the transport accepted the connection. A connection
+    // that failed init is never terminated, so it would never be uncounted.
+    if (config::enable_metrics) {
+        m_metrics->connection_created();
+    }
+
     return con;
 }
 
@@ -178,6 +197,24 @@ void endpoint<connection,config>::send(connection_hdl hdl, void const * payload,
     if (ec) { throw ec; }
 }
 
+template <typename connection, typename config>
+void endpoint<connection,config>::send(connection_hdl hdl,
+    shared_payload_ptr payload, frame::opcode::value op, lib::error_code & ec)
+{
+    connection_ptr con = get_con_from_hdl(hdl,ec);
+    if (ec) {return;}
+    ec = con->send(payload,op);
+}
+
+template <typename connection, typename config>
+void endpoint<connection,config>::send(connection_hdl hdl,
+    shared_payload_ptr payload, frame::opcode::value op)
+{
+    lib::error_code ec;
+    send(hdl,payload,op,ec);
+    if (ec) { throw ec; }
+}
+
 template <typename connection, typename config>
 void endpoint<connection,config>::send(connection_hdl hdl, message_ptr msg,
     lib::error_code & ec)
@@ -194,6 +231,74 @@ void endpoint<connection,config>::send(connection_hdl hdl, message_ptr msg) {
     if (ec) { throw ec; }
 }
 
+template <typename connection, typename config>
+template <typename hdl_iterator>
+size_t endpoint<connection,config>::broadcast(hdl_iterator begin,
+    hdl_iterator end, message_ptr msg, lib::error_code & ec)
+{
+    // One prepared frame per protocol version: hybi00 frames differ from the
+    // hybi07/08/13 family, whose unmasked data frames are identical.
+    std::vector<std::pair<int,message_ptr> > prepared;
+    size_t queued = 0;
+
+    ec = lib::error_code();
+
+    for (hdl_iterator it = begin; it != end; ++it) {
+        lib::error_code con_ec;
+        connection_ptr con = get_con_from_hdl(*it,con_ec);
+        if (con_ec || con->get_state() != session::state::open) {
+            continue;
+        }
+
+        if (!con->is_server() || msg->get_compressed()) {
+            if (!con->send(msg)) {
+                ++queued;
+            }
+            continue;
+        }
+
+        int version = con->get_websocket_version();
+        message_ptr frame;
+        for (size_t i = 0; i < prepared.size(); ++i) {
+            if (prepared[i].first == version) {
+                frame = prepared[i].second;
+                break;
+            }
+        }
+
+        if (!frame) {
+            frame = con->prepare_data_frame(msg,con_ec);
+            if (con_ec) {
+                // Validation failures (bad opcode, invalid UTF-8) would fail
+                // the same way on every connection, so stop here.
+                if (con_ec != error::make_error_code(error::invalid_state)) {
+                    ec = con_ec;
+                    return queued;
+                }
+                continue;
+            }
+            prepared.push_back(std::make_pair(version,frame));
+        }
+
+        if (!con->send(frame)) {
+            ++queued;
+        }
+    }
+
+    return queued;
+}
+
+template <typename connection, typename config>
+template <typename hdl_iterator>
+size_t endpoint<connection,config>::broadcast(hdl_iterator begin,
+    hdl_iterator end, message_ptr msg)
+{
+    lib::error_code ec;
+    size_t queued = broadcast(begin,end,msg,ec);
+    if (ec) { throw ec; }
+    return queued;
+}
+
 template <typename connection, typename config>
 void endpoint<connection,config>::close(connection_hdl hdl, close::status::value
     const code, std::string const & reason,
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_LOGGER_ASYNC_HPP
+#define WEBSOCKETPP_LOGGER_ASYNC_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/logger/levels.hpp>
+
+namespace websocketpp {
+namespace log {
+
+/// Logger that formats and writes on a background thread
+/**
+ * A drop in replacement for log::basic for use as alog_type or elog_type.
+ * write() copies the channel, a timestamp, and the message text into a fixed
+ * size record in a bounded lock free ring and returns. A writer thread owned
+ * by the logger drains the ring, formats each record in the same layout as
+ * log::basic, and writes it to the ostream.
+ *
+ * Behavior that differs from log::basic:
+ * - Messages longer than max_message_size bytes are truncated.
+ * - If the ring is full the message is dropped rather than blocking the
+ *   caller. The number of dropped messages is reported by get_dropped() and
+ *   written to the log once there is room again.
+ * - The ostream is written from the writer thread. It must not be used by
+ *   other code without external synchronization while the logger is alive.
+ * - The destructor writes out everything still in the ring before returning.
+ *
+ * The concurrency policy is accepted for interface compatibility. The writer
+ * thread needs real threads, so this logger cannot be used in builds without
+ * thread support.
+ *
+ * Each record takes a little more than max_message_size bytes, so the default
+ * ring of 256 records costs about 60KB, allocated when the logger is
+ * constructed. An endpoint has two loggers. The writer thread is only started
+ * by the first message that passes the channel filter, so a logger with its
+ * channels cleared costs no thread. Configs that log heavily can choose a
+ * larger ring:
+ *
+ *     typedef websocketpp::log::async<concurrency_type,
+ *         websocketpp::log::alevel, 4096> alog_type;
+ *
+ * @tparam ring_records Number of records in the ring. Must be a power of
+ * two.
+ */
+template <typename concurrency, typename names, size_t ring_records = 256>
+class async {
+public:
+    /// Maximum number of message bytes kept per record
+    static size_t const max_message_size = 200;
+
+    /// Number of records in the ring
+    static size_t const ring_size = ring_records;
+
+    async<concurrency,names,ring_records>(std::ostream * out = &std::cout)
+      : m_static_channels(0xffffffff)
+      , m_dynamic_channels(0)
+      , m_out(out)
+    {
+        start();
+    }
+
+    async<concurrency,names,ring_records>(level c,
+        std::ostream * out = &std::cout)
+      : m_static_channels(c)
+      , m_dynamic_channels(0)
+      , m_out(out)
+    {
+        start();
+    }
+
+    ~async() {
+        {
+            lib::lock_guard<lib::mutex> lock(m_wake_lock);
+            m_stop = true;
+            m_sleeping.store(false);
+        }
+        m_wake.notify_one();
+        if (m_started.load()) {
+            m_writer.join();
+        }
+        delete[] m_ring;
+    }
+
+    /// Change the output stream
+    /**
+     * Records already queued may be written to either stream.
+     */
+    void set_ostream(std::ostream * out = &std::cout) {
+        lib::lock_guard<lib::mutex> lock(m_wake_lock);
+        m_out = out;
+    }
+
+    void set_channels(level channels) {
+        if (channels == names::none) {
+            clear_channels(names::all);
+            return;
+        }
+
+        level current = m_dynamic_channels.load();
+        while (!m_dynamic_channels.compare_exchange_weak(current,
+            current | (channels & m_static_channels))) {}
+    }
+
+    void clear_channels(level channels) {
+        level current = m_dynamic_channels.load();
+        while (!m_dynamic_channels.compare_exchange_weak(current,
+            current & ~channels)) {}
+    }
+
+    void write(level channel, std::string const & msg) {
+        this->write(channel,msg.data(),msg.size());
+    }
+
+    void write(level channel, char const * msg) {
+        this->write(channel,msg,std::strlen(msg));
+    }
+
+    _WEBSOCKETPP_CONSTEXPR_TOKEN_ bool static_test(level channel) const {
+        return ((channel & m_static_channels) != 0);
+    }
+
+    bool dynamic_test(level channel) {
+        return ((channel & m_dynamic_channels.load(lib::memory_order_relaxed))
+            != 0);
+    }
+
+    /// Number of messages dropped because the ring was full
+    uint64_t get_dropped() const {
+        return m_dropped.load(lib::memory_order_relaxed);
+    }
+private:
+    // Not copyable: the writer thread refers to this object
+    async(async const &);
+    async & operator=(async const &);
+
+    struct record {
+        lib::atomic<size_t> sequence;
+        std::time_t time;
+        level channel;
+        size_t length;
+        char text[max_message_size];
+    };
+
+    // fails to compile unless ring_records is a power of two
+    typedef char ring_size_is_a_power_of_two
+        [(ring_records != 0 && (ring_records & (ring_records - 1)) == 0)
+        ? 1 : -1];
+
+    void start() {
+        m_stop = false;
+        m_sleeping.store(false);
+        m_dropped.store(0);
+        m_reported_dropped = 0;
+        m_enqueue_pos.store(0);
+        m_dequeue_pos = 0;
+        m_last_time = 0;
+        m_time_buffer[0] = '\0';
+        m_started.store(false);
+
+        m_ring = new record[ring_size];
+        for (size_t i = 0; i < ring_size; ++i) {
+            m_ring[i].sequence.store(i,lib::memory_order_relaxed);
+        }
+    }
+
+    /// Start the writer thread, unless another producer already did
+    void start_writer() {
+        lib::lock_guard<lib::mutex> lock(m_wake_lock);
+        if (!m_started.load(lib::memory_order_relaxed)) {
+            m_writer = lib::thread(lib::bind(&async::run,this));
+            m_started.store(true,lib::memory_order_release);
+        }
+    }
+
+    /// Claim a record, fill it, and publish it to the writer
+    void write(level channel, char const * msg, size_t len) {
+        if (!this->dynamic_test(channel)) { return; }
+
+        size_t pos = m_enqueue_pos.load(lib::memory_order_relaxed);
+        record * r;
+
+        for (;;) {
+            r = &m_ring[pos & (ring_size - 1)];
+            size_t seq = r->sequence.load(lib::memory_order_acquire);
+
+            if (seq == pos) {
+                if (m_enqueue_pos.compare_exchange_weak(pos,pos+1,
+                    lib::memory_order_relaxed))
+                {
+                    break;
+                }
+            } else if (seq < pos) {
+                // ring is full
+                m_dropped.fetch_add(1,lib::memory_order_relaxed);
+                return;
+            } else {
+                pos = m_enqueue_pos.load(lib::memory_order_relaxed);
+            }
+        }
+
+        r->time = std::time(NULL);
+        r->channel = channel;
+        r->length = len < max_message_size ? len : max_message_size;
+        std::memcpy(r->text,msg,r->length);
+        // seq_cst, as is the exchange below: together with the flag store
+        // and sequence load in run() this is a Dekker style handshake, in
+        // which either the writer sees the record or this sees the flag.
+        r->sequence.store(pos+1,lib::memory_order_seq_cst);
+
+        if (!m_started.load(lib::memory_order_acquire)) {
+            // the new writer drains the ring before it first sleeps
+            start_writer();
+            return;
+        }
+
+        // Only wake the writer if it went to sleep. A busy writer picks the
+        // record up without the producer touching the mutex.
+        if (m_sleeping.exchange(false,lib::memory_order_seq_cst)) {
+            lib::lock_guard<lib::mutex> lock(m_wake_lock);
+            m_wake.notify_one();
+        }
+    }
+
+    /// Writer thread main loop
+    void run() {
+        for (;;) {
+            if (drain()) {
+                continue;
+            }
+
+            m_sleeping.store(true,lib::memory_order_seq_cst);
+
+            // a record published before the flag was set would otherwise
+            // wait for the next one
+            if (ready(lib::memory_order_seq_cst)) {
+                m_sleeping.store(false);
+                continue;
+            }
+
+            lib::unique_lock<lib::mutex> lock(m_wake_lock);
+            while (m_sleeping.load() && !m_stop) {
+                m_wake.wait(lock);
+            }
+            if (m_stop) {
+                lock.unlock();
+                drain();
+                return;
+            }
+        }
+    }
+
+    bool ready(lib::memory_order order = lib::memory_order_acquire) const {
+        record const & r = m_ring[m_dequeue_pos & (ring_size - 1)];
+        return r.sequence.load(order) == m_dequeue_pos+1;
+    }
+
+    /// Write out all published records
+    /**
+     * @return Whether any records were written
+     */
+    bool drain() {
+        bool wrote = false;
+        std::ostream * out;
+        {
+            lib::lock_guard<lib::mutex> lock(m_wake_lock);
+            out = m_out;
+        }
+
+        while (ready()) {
+            record & r = m_ring[m_dequeue_pos & (ring_size - 1)];
+
+            *out << "[" << timestamp(r.time) << "] "
+                 << "[" << names::channel_name(r.channel) << "] ";
+            out->write(r.text,static_cast<std::streamsize>(r.length));
+            *out << "\n";
+
+            r.sequence.store(m_dequeue_pos+ring_size,lib::memory_order_release);
+            ++m_dequeue_pos;
+            wrote = true;
+        }
+
+        uint64_t dropped = m_dropped.load(lib::memory_order_relaxed);
+        if (dropped != m_reported_dropped) {
+            *out << "[" << timestamp(std::time(NULL)) << "] "
+                 << "[log] "
+                 << (dropped - m_reported_dropped)
+                 << " log messages dropped, log ring full\n";
+            m_reported_dropped = dropped;
+            wrote = true;
+        }
+
+        if (wrote) {
+            out->flush();
+        }
+        return wrote;
+    }
+
+    // Same format as log::basic. The formatted string is cached and only
+    // rebuilt when the second changes.
+    char const * timestamp(std::time_t t) {
+        if (t != m_last_time) {
+            std::tm* lt = std::localtime(&t);
+            std::strftime(m_time_buffer,sizeof(m_time_buffer),
+                "%Y-%m-%d %H:%M:%S",lt);
+            m_last_time = t;
+        }
+        return m_time_buffer;
+    }
+
+    level const m_static_channels;
+    lib::atomic<level> m_dynamic_channels;
+    std::ostream * m_out;
+
+    record * m_ring;
+    lib::atomic<size_t> m_enqueue_pos;
+    lib::atomic<uint64_t> m_dropped;
+
+    // writer thread state
+    size_t m_dequeue_pos;
+    uint64_t m_reported_dropped;
+    std::time_t m_last_time;
+    char m_time_buffer[20];
+
+    lib::atomic<bool> m_sleeping;
+    lib::atomic<bool> m_started;
+    bool m_stop;
+    lib::mutex m_wake_lock;
+    lib::condition_variable m_wake;
+    lib::thread m_writer;
+};
+
+} // log
+} // websocketpp
+
+#endif // WEBSOCKETPP_LOGGER_ASYNC_HPP
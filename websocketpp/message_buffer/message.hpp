@@ -89,6 +89,9 @@ public:
     typedef typename con_msg_man_type::ptr con_msg_man_ptr;
     typedef typename con_msg_man_type::weak_ptr con_msg_man_weak_ptr;
 
+    /// Type of a shared pointer to an immutable, externally owned payload
+    typedef lib::shared_ptr<std::string const> shared_payload_ptr;
+
     /// Construct an empty message
     /**
      * Construct an empty message
@@ -241,20 +244,53 @@ public:
 
     /// Get a reference to the payload string
     /**
+     * If the message refers to a shared payload, that payload is returned.
+     *
      * @return A const reference to the message's payload string
      */
     std::string const & get_payload() const {
-        return m_payload;
+        return m_shared_payload ? *m_shared_payload : m_payload;
     }
 
     /// Get a non-const reference to the payload string
     /**
+     * If the message refers to a shared payload, it is first copied into the
+     * message's own storage and the reference is dropped, so writes through
+     * the returned reference never reach the shared buffer.
+     *
      * @return A reference to the message's payload string
      */
     std::string & get_raw_payload() {
+        if (m_shared_payload) {
+            m_payload.assign(*m_shared_payload);
+            m_shared_payload.reset();
+        }
         return m_payload;
     }
 
+    /// Get the shared payload this message refers to, if any
+    /**
+     * @return A pointer to the shared payload, or an empty pointer if the
+     * message owns its payload.
+     */
+    shared_payload_ptr const & get_shared_payload() const {
+        return m_shared_payload;
+    }
+
+    /// Refer to an immutable shared payload instead of owning a copy
+    /**
+     * The message keeps a reference to the payload rather than copying it.
+     * Many messages, for example one per recipient of a broadcast, may refer
+     * to the same buffer. The caller must not modify the string after handing
+     * it over.
+     *
+     * @param payload A pointer to the payload to refer to.
+     */
+    void set_shared_payload(shared_payload_ptr payload) {
+        m_payload.clear();
+        m_shared_payload = payload;
+    }
+
     /// Set payload data
     /**
      * Set the message buffer's payload to the given value.
@@ -262,6 +298,7 @@ public:
      * @param payload A string to set the payload to.
      */
     void set_payload(std::string const & payload) {
+        m_shared_payload.reset();
         m_payload = payload;
     }
 
@@ -273,6 +310,7 @@ public:
      * @param len The length of new payload in bytes.
      */
     void set_payload(void const * payload, size_t len) {
+        m_shared_payload.reset();
         m_payload.reserve(len);
         char const * pl = static_cast<char const *>(payload);
         m_payload.assign(pl, pl + len);
@@ -285,7 +323,7 @@ public:
      * @param payload A string containing the data array to append.
      */
     void append_payload(std::string const & payload) {
-        m_payload.append(payload);
+        get_raw_payload().append(payload);
     }
 
     /// Append payload data
@@ -296,8 +334,30 @@ public:
      * @param len The length of payload in bytes
      */
     void append_payload(void const * payload, size_t len) {
-        m_payload.reserve(m_payload.size()+len);
-        m_payload.append(static_cast<char const *>(payload),len);
+        std::string & p = get_raw_payload();
+        p.reserve(p.size()+len);
+        p.append(static_cast<char const *>(payload),len);
+    }
+
+    /// Return the message to its freshly constructed state
+    /**
+     * Clears the header, extension data, and payload and restores the default
+     * flags. The storage already reserved by the strings is kept so that a
+     * message manager can hand the same object out again without another
+     * allocation.
+     *
+     * @param op The opcode the reset message should carry.
+     */
+    void reset(frame::opcode::value op) {
+        m_header.clear();
+        m_extension_data.clear();
+        m_payload.clear();
+        m_shared_payload.reset();
+        m_opcode = op;
+        m_prepared = false;
+        m_fin = true;
+        m_terminal = false;
+        m_compressed = false;
     }
 
     /// Recycle the message
@@ -327,6 +387,7 @@ private:
     std::string                 m_header;
     std::string                 m_extension_data;
     std::string                 m_payload;
+    shared_payload_ptr          m_shared_payload;
     frame::opcode::value        m_opcode;
     bool                        m_prepared;
     bool                        m_fin;
@@ -25,54 +25,20 @@
  *
  */
 
-#ifndef WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
-#define WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
+
+#ifndef WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
+#define WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
 
 #include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+#include <websocketpp/frame.hpp>
 
-#include <string>
+#include <cstddef>
+#include <vector>
 
 namespace websocketpp {
 namespace message_buffer {
 
-/* # message:
- * object that stores a message while it is being sent or received. Contains
- * the message payload itself, the message header, the extension data, and the
- * opcode.
- *
- * # connection_message_manager:
- * An object that manages all of the message_buffers associated with a given
- * connection. Impliments the get_message_buffer(size) method that returns
- * a message buffer at least size bytes long.
- *
- * Message buffers are reference counted with shared ownership semantics. Once
- * requested from the manager the requester and it's associated downstream code
- * may keep a pointer to the message indefinitely at a cost of extra resource
- * usage. Once the reference count drops to the point where the manager is the
- * only reference the messages is recycled using whatever method is implemented
- * in the manager.
- *
- * # endpoint_message_manager:
- * An object that manages connection_message_managers. Impliments the
- * get_message_manager() method. This is used once by each connection to
- * request the message manager that they are supposed to use to manage message
- * buffers for their own use.
- *
- * TYPES OF CONNECTION_MESSAGE_MANAGERS
- * - allocate a message with the exact size every time one is requested
- * - maintain a pool of pre-allocated messages and return one when needed.
- *   Recycle previously used messages back into the pool
- *
- * TYPES OF ENDPOINT_MESSAGE_MANAGERS
- *  - allocate a new connection manager for each connection. Message pools
- *    become connection specific. This increases memory usage but improves
- *    concurrency.
- *  - allocate a single connection manager and share a pointer to it with all
- *    connections created by this endpoint. The message pool will be shared
- *    among all connections, improving memory usage and performance at the cost
- *    of reduced concurrency
- */
-
 /// Custom deleter for use in shared_ptrs to message.
 /**
  * This is used to catch messages about to be deleted and offer the manager the
@@ -92,133 +58,336 @@ void message_deleter(T* msg) {
     }
 }
 
-/// Represents a buffer for a single WebSocket message.
+namespace pool {
+
+/// A connection message manager that recycles messages through a pool
 /**
+ * Messages handed out by this manager are owned by shared_ptrs that use
+ * message_deleter. When the last reference goes away the message is reset and
+ * returned to a free list instead of being deleted, so a later get_message()
+ * call reuses both the message object and the payload storage it had already
+ * reserved.
  *
+ * Free messages are kept in size classes keyed on payload capacity (128 B,
+ * 1 KiB, 8 KiB and 64 KiB). A request for a payload of a given size is served
+ * from the smallest class that fits it. Messages whose payload grew beyond the
+ * largest class, or that arrive when their class is already full, are freed
+ * normally so that one large message cannot pin memory for the lifetime of the
+ * manager.
  *
+ * The payload capacity held on the free lists is also bounded by a byte budget,
+ * default_max_free_bytes unless set otherwise, so that an idle manager keeps at
+ * most that much memory no matter how its traffic was distributed over the
+ * size classes.
+ *
+ * The free lists are guarded by a mutex because messages may be released from
+ * any thread that held a reference to them, not just the connection's own.
  */
-template <typename con_msg_manager>
-class message {
+template <typename message>
+class con_msg_manager
+  : public lib::enable_shared_from_this<con_msg_manager<message> >
+{
 public:
-    typedef lib::shared_ptr<message> ptr;
+    typedef con_msg_manager<message> type;
+    typedef lib::shared_ptr<con_msg_manager> ptr;
+    typedef lib::weak_ptr<con_msg_manager> weak_ptr;
 
-    typedef typename con_msg_manager::weak_ptr con_msg_man_ptr;
+    typedef typename message::ptr message_ptr;
 
-    message(con_msg_man_ptr manager, size_t size = 128)
-      : m_manager(manager)
-      , m_payload(size) {}
+    /// Number of payload size classes kept by the pool
+    static size_t const num_classes = 4;
 
-    frame::opcode::value get_opcode() const {
-        return m_opcode;
-    }
-    const std::string& get_header() const {
-        return m_header;
+    /// Maximum number of free messages retained in each size class
+    static size_t const max_free_per_class = 32;
+
+    /// Default limit on the payload bytes held by free messages
+    static size_t const default_max_free_bytes = 65536;
+
+    /// Construct a pool with a given free payload budget
+    /**
+     * @param max_free_bytes The most payload capacity, in bytes, that the pool
+     * holds on to while its messages are unused. Zero disables pooling.
+     */
+    explicit con_msg_manager(size_t max_free_bytes = default_max_free_bytes)
+      : m_free_bytes(0)
+      , m_max_free_bytes(max_free_bytes) {}
+
+    ~con_msg_manager() {
+        for (size_t i = 0; i < num_classes; ++i) {
+            typename free_list::iterator it;
+            for (it = m_free[i].begin(); it != m_free[i].end(); ++it) {
+                delete *it;
+            }
+        }
     }
-    const std::string& get_extension_data() const {
-        return m_extension_data;
+
+    /// Get an empty message buffer
+    /**
+     * @return A shared pointer to an empty message, recycled if one is
+     * available.
+     */
+    message_ptr get_message() {
+        return get_message(frame::opcode::text,0);
     }
-    const std::string& get_payload() const {
-        return m_payload;
+
+    /// Get a message buffer with specified size and opcode
+    /**
+     * @param op The opcode to use
+     * @param size Minimum size in bytes to request for the message payload.
+     *
+     * @return A shared pointer to a message with at least size bytes of payload
+     * storage reserved, recycled if one is available.
+     */
+    message_ptr get_message(frame::opcode::value op, size_t size) {
+        message * msg = NULL;
+
+        size_t c = class_for_request(size);
+        if (c < num_classes) {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            if (!m_free[c].empty()) {
+                msg = m_free[c].back();
+                m_free[c].pop_back();
+                m_free_bytes -= msg->get_raw_payload().capacity();
+            }
+        }
+
+        if (msg) {
+            msg->reset(op);
+            msg->get_raw_payload().reserve(size);
+        } else {
+            // Round fresh allocations up to their class so that the payload
+            // can be filed back into the same class when it is recycled.
+            size_t reserve = (c < num_classes ? class_size(c) : size);
+            msg = new message(type::shared_from_this(),op,reserve);
+        }
+
+        return message_ptr(msg,&message_deleter<message>);
     }
 
-    /// Recycle the message
+    /// Recycle a message
     /**
-     * A request to recycle this message was received. Forward that request to
-     * the connection message manager for processing. Errors and exceptions
-     * from the manager's recycle member function should be passed back up the
-     * call chain. The caller to message::recycle will deal with them.
+     * Called by message::recycle when the last reference to a message handed
+     * out by this manager is released. The message is reset and filed under
+     * the size class its payload capacity qualifies for.
      *
-     * Recycle must *only* be called by the message shared_ptr's destructor.
-     * Once recycled successfully, ownership of the memory has been passed to
-     * another system and must not be accessed again.
+     * @param msg The message to be recycled.
      *
-     * @return true if the message was successfully recycled, false otherwise.
+     * @return true if the message was taken back into the pool, false if the
+     * caller should free it.
      */
-    bool recycle() {
-        typename con_msg_manager::ptr shared = m_manager.lock();
+    bool recycle(message * msg) {
+        // Reset first so that a shared payload reference is dropped rather
+        // than copied in by get_raw_payload().
+        msg->reset(frame::opcode::text);
 
-        if (shared) {
-            return shared->(recycle(this));
-        } else {
+        size_t capacity = msg->get_raw_payload().capacity();
+        size_t c = class_for_capacity(capacity);
+        if (c >= num_classes) {
+            return false;
+        }
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        if (m_free[c].size() >= max_free_per_class ||
+            capacity > m_max_free_bytes - m_free_bytes)
+        {
             return false;
         }
+        m_free[c].push_back(msg);
+        m_free_bytes += capacity;
+        return true;
     }
-private:
-    con_msg_man_ptr             m_manager;
 
-    frame::opcode::value        m_opcode;
-    std::string                 m_header;
-    std::string                 m_extension_data;
-    std::string                 m_payload;
-};
+    /// Set the limit on the payload bytes held by free messages
+    /**
+     * Free messages beyond the new limit are released immediately, largest
+     * size class first.
+     *
+     * @param max_free_bytes The most payload capacity, in bytes, that the pool
+     * holds on to while its messages are unused. Zero disables pooling.
+     */
+    void set_max_free_bytes(size_t max_free_bytes) {
+        free_list excess;
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            m_max_free_bytes = max_free_bytes;
+            for (size_t i = num_classes; i > 0 &&
+                m_free_bytes > m_max_free_bytes; --i)
+            {
+                free_list & list = m_free[i-1];
+                while (!list.empty() && m_free_bytes > m_max_free_bytes) {
+                    m_free_bytes -= list.back()->get_raw_payload().capacity();
+                    excess.push_back(list.back());
+                    list.pop_back();
+                }
+            }
+        }
 
-namespace alloc {
+        typename free_list::iterator it;
+        for (it = excess.begin(); it != excess.end(); ++it) {
+            delete *it;
+        }
+    }
 
-/// A connection message manager that allocates a new message for each
-/// request.
-template <typename message>
-class con_msg_manager {
-public:
-    typedef lib::shared_ptr<con_msg_manager> ptr;
-    typedef lib::weak_ptr<con_msg_manager> weak_ptr;
+    /// Get the limit on the payload bytes held by free messages
+    /**
+     * @return The free payload budget in bytes.
+     */
+    size_t get_max_free_bytes() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_max_free_bytes;
+    }
 
-    typedef typename message::ptr message_ptr;
+    /// Get the payload bytes currently held by free messages
+    /**
+     * @return The total payload capacity of all messages in the pool.
+     */
+    size_t get_free_bytes() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_free_bytes;
+    }
 
-    /// Get a message buffer with specified size
+    /// Get the number of free messages currently held by the pool
     /**
-     * @param size Minimum size in bytes to request for the message payload.
-     *
-     * @return A shared pointer to a new message with specified size.
+     * @return The total number of messages waiting in all size classes.
      */
-    message_ptr get_message(size_t size) const {
-        return message_ptr(new message(size));
+    size_t get_free_count() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        size_t count = 0;
+        for (size_t i = 0; i < num_classes; ++i) {
+            count += m_free[i].size();
+        }
+        return count;
     }
+private:
+    typedef std::vector<message *> free_list;
 
-    /// Recycle a message
+    static size_t class_size(size_t c) {
+        return size_t(128) << (3*c);
+    }
+
+    /// Smallest class whose messages can hold size bytes without growing
+    static size_t class_for_request(size_t size) {
+        size_t c = 0;
+        while (c < num_classes && class_size(c) < size) {
+            ++c;
+        }
+        return c;
+    }
+
+    /// Largest class that a payload of the given capacity satisfies
     /**
-     * This method shouldn't be called. If it is, return false to indicate an
-     * error. The rest of the method recycle chain should notice this and free
-     * the memory.
-     *
-     * @param msg The message to be recycled.
-     *
-     * @return true if the message was successfully recycled, false otherwse.
+     * Capacities below the smallest class still go to class 0; reserve() in
+     * get_message() makes up the difference.
      */
-    bool recycle(message * msg) {
-        return false;
+    static size_t class_for_capacity(size_t capacity) {
+        if (capacity > class_size(num_classes-1)) {
+            return num_classes;
+        }
+        size_t c = num_classes-1;
+        while (c > 0 && class_size(c) > capacity) {
+            --c;
+        }
+        return c;
     }
+
+    // Not copyable: the free lists own raw message pointers.
+    con_msg_manager(con_msg_manager const &);
+    con_msg_manager & operator=(con_msg_manager const &);
+
+    free_list                   m_free[num_classes];
+    size_t                      m_free_bytes;
+    size_t                      m_max_free_bytes;
+    mutable lib::mutex          m_lock;
 };
 
-/// An endpoint message manager that allocates a new manager for each
-/// connection.
+/// An endpoint message manager that gives each connection its own pool
+/**
+ * Each connection recycles messages only among its own traffic. Nothing is
+ * shared between connections, so the pool mutex is uncontended, at the cost of
+ * holding up to the free payload budget per connection. The budget defaults to
+ * con_msg_manager::default_max_free_bytes and applies to connections created
+ * after it is set.
+ */
 template <typename con_msg_manager>
 class endpoint_msg_manager {
 public:
     typedef typename con_msg_manager::ptr con_msg_man_ptr;
 
+    endpoint_msg_manager()
+      : m_max_free_bytes(con_msg_manager::default_max_free_bytes) {}
+
     /// Get a pointer to a connection message manager
     /**
-     * @return A pointer to the requested connection message manager.
+     * @return A pointer to a new pooled connection message manager.
      */
     con_msg_man_ptr get_manager() const {
-        return con_msg_man_ptr(new con_msg_manager());
+        return con_msg_man_ptr(new con_msg_manager(m_max_free_bytes));
+    }
+
+    /// Set the free payload budget given to each new connection's pool
+    /**
+     * @param max_free_bytes The most payload capacity, in bytes, that each
+     * connection keeps while its messages are unused. Zero disables pooling.
+     */
+    void set_max_free_bytes(size_t max_free_bytes) {
+        m_max_free_bytes = max_free_bytes;
+    }
+
+    /// Get the free payload budget given to each new connection's pool
+    /**
+     * @return The per-connection free payload budget in bytes.
+     */
+    size_t get_max_free_bytes() const {
+        return m_max_free_bytes;
     }
+private:
+    size_t m_max_free_bytes;
 };
 
-} // namespace alloc
+/// An endpoint message manager that shares one pool among all connections
+/**
+ * Every connection created by the endpoint draws from and returns to the same
+ * free lists. Idle memory is bounded per endpoint rather than per connection,
+ * which suits servers with many mostly idle connections, at the cost of all of
+ * them contending for one mutex.
+ */
+template <typename con_msg_manager>
+class shared_endpoint_msg_manager {
+public:
+    typedef typename con_msg_manager::ptr con_msg_man_ptr;
 
-namespace pool {
+    /// Default limit on the payload bytes held by the endpoint-wide pool
+    static size_t const default_max_free_bytes = 1048576;
 
-/// A connection messages manager that maintains a pool of messages that is
-/// used to fulfill get_message requests.
-class con_msg_manager {
+    shared_endpoint_msg_manager()
+      : m_manager(new con_msg_manager(default_max_free_bytes)) {}
 
-};
+    /// Get a pointer to a connection message manager
+    /**
+     * @return A pointer to the endpoint-wide pooled message manager.
+     */
+    con_msg_man_ptr get_manager() const {
+        return m_manager;
+    }
 
-/// An endpoint manager that maintains a shared pool of connection managers
-/// and returns an appropriate one for the requesting connection.
-class endpoint_msg_manager {
+    /// Set the free payload budget of the endpoint-wide pool
+    /**
+     * @param max_free_bytes The most payload capacity, in bytes, that the
+     * endpoint keeps while its messages are unused. Zero disables pooling.
+     */
+    void set_max_free_bytes(size_t max_free_bytes) {
+        m_manager->set_max_free_bytes(max_free_bytes);
+    }
 
+    /// Get the free payload budget of the endpoint-wide pool
+    /**
+     * @return The endpoint-wide free payload budget in bytes.
+     */
+    size_t get_max_free_bytes() const {
+        return m_manager->get_max_free_bytes();
+    }
+private:
+    con_msg_man_ptr m_manager;
 };
 
 } // namespace pool
@@ -226,4 +395,4 @@ class endpoint_msg_manager {
 } // namespace message_buffer
 } // namespace websocketpp
 
-#endif // WEBSOCKETPP_MESSAGE_BUFFER_ALLOC_HPP
+#endif // WEBSOCKETPP_MESSAGE_BUFFER_POOL_HPP
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_MESSAGE_BUFFER_READ_BUFFER_HPP
+#define WEBSOCKETPP_MESSAGE_BUFFER_READ_BUFFER_HPP
+
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace websocketpp {
+namespace message_buffer {
+
+/// A pool of connection read buffers shared by all connections of an endpoint
+/**
+ * Buffers come in size classes that double from a minimum size up to a
+ * maximum size. The last class is exactly the maximum size, even if that is
+ * not a power of two multiple of the minimum. Released buffers are kept on a
+ * free list per class, up to a limit, so that connections growing and
+ * shrinking their buffers mostly trade memory with each other instead of
+ * going to the allocator.
+ *
+ * The free lists are guarded by a mutex because connections of one endpoint
+ * may run on different threads.
+ */
+class read_buffer_pool {
+public:
+    typedef lib::shared_ptr<read_buffer_pool> ptr;
+
+    /// Construct a pool
+    /**
+     * @param min_size Size of the smallest buffer class in bytes
+     * @param max_size Size of the largest buffer class in bytes
+     * @param max_free_per_class Maximum number of free buffers retained in
+     * each size class
+     */
+    read_buffer_pool(size_t min_size, size_t max_size,
+        size_t max_free_per_class = 64)
+      : m_min_size(min_size > 0 ? min_size : 1)
+      , m_max_size(max_size > m_min_size ? max_size : m_min_size)
+      , m_max_free_per_class(max_free_per_class)
+      , m_cached_bytes(0)
+    {
+        size_t classes = 1;
+        for (size_t s = m_min_size; s < m_max_size; s *= 2) {
+            ++classes;
+        }
+        m_free.resize(classes);
+    }
+
+    ~read_buffer_pool() {
+        for (size_t i = 0; i < m_free.size(); ++i) {
+            for (size_t j = 0; j < m_free[i].size(); ++j) {
+                delete[] m_free[i][j];
+            }
+        }
+    }
+
+    /// Size of the smallest buffer class
+    size_t get_min_size() const {
+        return m_min_size;
+    }
+
+    /// Size of the largest buffer class
+    size_t get_max_size() const {
+        return m_max_size;
+    }
+
+    /// Round a size up to the size of the class that serves it
+    /**
+     * Sizes above the maximum are clamped to the maximum.
+     *
+     * @param size The requested size in bytes
+     * @return The size of the buffer allocate would hand out
+     */
+    size_t round_size(size_t size) const {
+        return class_size(class_index(size));
+    }
+
+    /// Get a buffer of at least the given size
+    /**
+     * @param size The requested size in bytes. Pass the result of round_size
+     * to know the size of the buffer returned.
+     * @return A buffer of round_size(size) bytes
+     */
+    char * allocate(size_t size) {
+        size_t i = class_index(size);
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            if (!m_free[i].empty()) {
+                char * buf = m_free[i].back();
+                m_free[i].pop_back();
+                m_cached_bytes -= class_size(i);
+                return buf;
+            }
+        }
+        return new char[class_size(i)];
+    }
+
+    /// Return a buffer to the pool
+    /**
+     * @param buf A buffer obtained from allocate. May be NULL.
+     * @param size The size passed to allocate for this buffer
+     */
+    void release(char * buf, size_t size) {
+        if (!buf) {
+            return;
+        }
+        size_t i = class_index(size);
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            if (m_free[i].size() < m_max_free_per_class) {
+                m_free[i].push_back(buf);
+                m_cached_bytes += class_size(i);
+                return;
+            }
+        }
+        delete[] buf;
+    }
+
+    /// Number of bytes held in free buffers
+    size_t get_cached_bytes() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_cached_bytes;
+    }
+private:
+    // non-copyable
+    read_buffer_pool(read_buffer_pool const &);
+    read_buffer_pool & operator=(read_buffer_pool const &);
+
+    size_t class_index(size_t size) const {
+        size_t i = 0;
+        for (size_t s = m_min_size; s < size && i+1 < m_free.size(); s *= 2) {
+            ++i;
+        }
+        return i;
+    }
+
+    size_t class_size(size_t i) const {
+        if (i+1 == m_free.size()) {
+            return m_max_size;
+        }
+        return m_min_size << i;
+    }
+
+    size_t const m_min_size;
+    size_t const m_max_size;
+    size_t const m_max_free_per_class;
+
+    mutable lib::mutex m_lock;
+    std::vector<std::vector<char *> > m_free;
+    size_t m_cached_bytes;
+};
+
+} // namespace message_buffer
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_MESSAGE_BUFFER_READ_BUFFER_HPP
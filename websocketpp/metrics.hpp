@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_METRICS_HPP
+#define WEBSOCKETPP_METRICS_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/chrono.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#ifndef _WEBSOCKETPP_CPP11_CHRONO_
+    #include <boost/date_time/posix_time/posix_time_types.hpp>
+#endif
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace websocketpp {
+/// Counters and latency histograms for connections and endpoints
+/**
+ * Collection is switched on by the `enable_metrics` config setting. When it is
+ * false every recording site is behind a compile time constant test and
+ * generates no code, in the same way as `m_alog.static_test`.
+ *
+ * Connection metrics are updated by the connection and read with
+ * connection::get_metrics(). Endpoint metrics are shared by all connections of
+ * an endpoint, updated with relaxed atomics, and read with
+ * endpoint::get_metrics(). write_prometheus renders either in the Prometheus
+ * text exposition format.
+ */
+namespace metrics {
+
+/// Microseconds from a monotonic clock where one is available
+inline uint64_t now_us() {
+#ifdef _WEBSOCKETPP_CPP11_CHRONO_
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#else
+    static boost::posix_time::ptime const epoch(
+        boost::gregorian::date(1970,1,1));
+    return static_cast<uint64_t>(
+        (boost::posix_time::microsec_clock::universal_time() - epoch)
+        .total_microseconds());
+#endif
+}
+
+/// Latency histogram with power of two microsecond buckets
+/**
+ * Bucket i counts samples below 2^i microseconds that did not fit an earlier
+ * bucket. The last bucket also takes everything larger, about 4 seconds and
+ * up.
+ */
+class histogram {
+public:
+    static size_t const bucket_count = 23;
+
+    histogram() : m_count(0), m_sum(0) {
+        std::fill(m_buckets,m_buckets+bucket_count,uint64_t(0));
+    }
+
+    /// Record one sample in microseconds
+    void record(uint64_t us) {
+        m_buckets[bucket_for(us)]++;
+        m_count++;
+        m_sum += us;
+    }
+
+    /// Add the samples of another histogram to this one
+    void merge(histogram const & other) {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            m_buckets[i] += other.m_buckets[i];
+        }
+        m_count += other.m_count;
+        m_sum += other.m_sum;
+    }
+
+    /// Number of samples in bucket i (not cumulative)
+    uint64_t get_bucket(size_t i) const {
+        return m_buckets[i];
+    }
+
+    /// Exclusive upper bound of bucket i in microseconds
+    static uint64_t get_bucket_bound(size_t i) {
+        return uint64_t(1) << i;
+    }
+
+    uint64_t get_count() const {
+        return m_count;
+    }
+
+    /// Sum of all samples in microseconds
+    uint64_t get_sum() const {
+        return m_sum;
+    }
+
+    static size_t bucket_for(uint64_t us) {
+        size_t i = 0;
+        while (i < bucket_count - 1 && us >= get_bucket_bound(i)) {
+            ++i;
+        }
+        return i;
+    }
+private:
+    friend class endpoint_metrics;
+
+    uint64_t m_buckets[bucket_count];
+    uint64_t m_count;
+    uint64_t m_sum;
+};
+
+/// Metrics for a single connection
+struct connection_metrics {
+    connection_metrics()
+      : bytes_in(0)
+      , bytes_out(0)
+      , messages_in(0)
+      , messages_out(0)
+      , writes(0)
+      , send_queue_depth(0)
+      , send_queue_peak(0) {}
+
+    /// Bytes read from the transport after the opening handshake
+    uint64_t bytes_in;
+    /// Frame bytes written to the transport, headers included
+    uint64_t bytes_out;
+    /// Messages delivered, control messages included
+    uint64_t messages_in;
+    /// Frames written
+    uint64_t messages_out;
+    /// Transport writes issued
+    uint64_t writes;
+    /// Messages currently waiting in the send queue
+    size_t send_queue_depth;
+    /// Largest send queue depth seen
+    size_t send_queue_peak;
+    /// Time from issuing a transport write to its completion
+    histogram write_latency;
+};
+
+/// Metrics aggregated across all connections of an endpoint
+/**
+ * Safe to update from several threads at once. Readers see each value as it
+ * was at some recent point, but values are not a consistent snapshot of each
+ * other.
+ */
+class endpoint_metrics {
+public:
+    endpoint_metrics() {
+        m_connections_created.store(0);
+        m_connections_closed.store(0);
+        m_bytes_in.store(0);
+        m_bytes_out.store(0);
+        m_messages_in.store(0);
+        m_messages_out.store(0);
+        m_latency_count.store(0);
+        m_latency_sum.store(0);
+        for (size_t i = 0; i < histogram::bucket_count; ++i) {
+            m_latency_buckets[i].store(0);
+        }
+    }
+
+    void connection_created() {
+        m_connections_created.fetch_add(1,lib::memory_order_relaxed);
+    }
+
+    void connection_closed() {
+        m_connections_closed.fetch_add(1,lib::memory_order_relaxed);
+    }
+
+    void add_read(uint64_t bytes, uint64_t messages) {
+        m_bytes_in.fetch_add(bytes,lib::memory_order_relaxed);
+        m_messages_in.fetch_add(messages,lib::memory_order_relaxed);
+    }
+
+    void add_write(uint64_t bytes, uint64_t messages, uint64_t latency_us) {
+        m_bytes_out.fetch_add(bytes,lib::memory_order_relaxed);
+        m_messages_out.fetch_add(messages,lib::memory_order_relaxed);
+        m_latency_buckets[histogram::bucket_for(latency_us)].fetch_add(1,
+            lib::memory_order_relaxed);
+        m_latency_count.fetch_add(1,lib::memory_order_relaxed);
+        m_latency_sum.fetch_add(latency_us,lib::memory_order_relaxed);
+    }
+
+    uint64_t get_connections_created() const {
+        return m_connections_created.load(lib::memory_order_relaxed);
+    }
+
+    uint64_t get_connections_closed() const {
+        return m_connections_closed.load(lib::memory_order_relaxed);
+    }
+
+    /// Connections created and not yet closed
+    uint64_t get_connections_open() const {
+        uint64_t closed = get_connections_closed();
+        uint64_t created = get_connections_created();
+        return created > closed ? created - closed : 0;
+    }
+
+    uint64_t get_bytes_in() const {
+        return m_bytes_in.load(lib::memory_order_relaxed);
+    }
+
+    uint64_t get_bytes_out() const {
+        return m_bytes_out.load(lib::memory_order_relaxed);
+    }
+
+    uint64_t get_messages_in() const {
+        return m_messages_in.load(lib::memory_order_relaxed);
+    }
+
+    uint64_t get_messages_out() const {
+        return m_messages_out.load(lib::memory_order_relaxed);
+    }
+
+    /// Write latency across all connections
+    histogram get_write_latency() const {
+        histogram h;
+        for (size_t i = 0; i < histogram::bucket_count; ++i) {
+            h.m_buckets[i] = m_latency_buckets[i].load(lib::memory_order_relaxed);
+        }
+        h.m_count = m_latency_count.load(lib::memory_order_relaxed);
+        h.m_sum = m_latency_sum.load(lib::memory_order_relaxed);
+        return h;
+    }
+private:
+    // Not copyable: shared by pointer between the endpoint and its
+    // connections
+    endpoint_metrics(endpoint_metrics const &);
+    endpoint_metrics & operator=(endpoint_metrics const &);
+
+    lib::atomic<uint64_t> m_connections_created;
+    lib::atomic<uint64_t> m_connections_closed;
+    lib::atomic<uint64_t> m_bytes_in;
+    lib::atomic<uint64_t> m_bytes_out;
+    lib::atomic<uint64_t> m_messages_in;
+    lib::atomic<uint64_t> m_messages_out;
+    lib::atomic<uint64_t> m_latency_buckets[histogram::bucket_count];
+    lib::atomic<uint64_t> m_latency_count;
+    lib::atomic<uint64_t> m_latency_sum;
+};
+
+/// Metrics of one connection paired with the labels identifying it
+/**
+ * The labels are a Prometheus label set such as `connection="42"`, which may
+ * be empty.
+ */
+typedef std::pair<std::string,connection_metrics> labeled_connection_metrics;
+
+namespace detail {
+
+inline void write_header(std::ostream & out, std::string const & prefix,
+    char const * name, char const * help, char const * type)
+{
+    out << "# HELP " << prefix << name << " " << help << "\n"
+        << "# TYPE " << prefix << name << " " << type << "\n";
+}
+
+inline void write_sample(std::ostream & out, std::string const & prefix,
+    char const * name, uint64_t value, std::string const & labels)
+{
+    out << prefix << name;
+    if (!labels.empty()) {
+        out << "{" << labels << "}";
+    }
+    out << " " << value << "\n";
+}
+
+inline void write_counter(std::ostream & out, std::string const & prefix,
+    char const * name, char const * help, char const * type, uint64_t value,
+    std::string const & labels)
+{
+    write_header(out,prefix,name,help,type);
+    write_sample(out,prefix,name,value,labels);
+}
+
+/// Write one metric family with a sample for each connection
+template <typename value_type>
+void write_family(std::ostream & out, std::string const & prefix,
+    char const * name, char const * help, char const * type,
+    std::vector<labeled_connection_metrics> const & cons,
+    value_type connection_metrics::* field)
+{
+    write_header(out,prefix,name,help,type);
+    for (size_t i = 0; i < cons.size(); ++i) {
+        write_sample(out,prefix,name,cons[i].second.*field,cons[i].first);
+    }
+}
+
+inline void write_histogram_samples(std::ostream & out,
+    std::string const & prefix, char const * name, histogram const & h,
+    std::string const & labels)
+{
+    std::string sep = labels.empty() ? "" : labels + ",";
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < histogram::bucket_count - 1; ++i) {
+        cumulative += h.get_bucket(i);
+        out << prefix << name << "_bucket{" << sep << "le=\""
+            << static_cast<double>(histogram::get_bucket_bound(i)) / 1e6
+            << "\"} " << cumulative << "\n";
+    }
+    out << prefix << name << "_bucket{" << sep << "le=\"+Inf\"} "
+        << h.get_count() << "\n";
+    out << prefix << name << "_sum";
+    if (!labels.empty()) {
+        out << "{" << labels << "}";
+    }
+    out << " " << static_cast<double>(h.get_sum()) / 1e6 << "\n";
+    out << prefix << name << "_count";
+    if (!labels.empty()) {
+        out << "{" << labels << "}";
+    }
+    out << " " << h.get_count() << "\n";
+}
+
+inline void write_histogram(std::ostream & out, std::string const & prefix,
+    char const * name, char const * help, histogram const & h,
+    std::string const & labels)
+{
+    write_header(out,prefix,name,help,"histogram");
+    write_histogram_samples(out,prefix,name,h,labels);
+}
+
+/// Quote a label value, escaping backslashes, quotes and newlines
+inline std::string quote_label(std::string const & value) {
+    std::string quoted;
+    quoted.reserve(value.size()+2);
+    quoted += '"';
+    for (std::string::const_iterator it = value.begin(); it != value.end();
+        ++it)
+    {
+        if (*it == '\\' || *it == '"') {
+            quoted += '\\';
+            quoted += *it;
+        } else if (*it == '\n') {
+            quoted += "\\n";
+        } else {
+            quoted += *it;
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+} // namespace detail
+
+/// Write endpoint metrics in the Prometheus text exposition format
+/**
+ * @param out The stream to write to
+ * @param m The metrics to write
+ * @param prefix Prepended to every metric name
+ */
+inline void write_prometheus(std::ostream & out, endpoint_metrics const & m,
+    std::string const & prefix = "websocketpp_")
+{
+    std::string const none;
+    detail::write_counter(out,prefix,"connections_total",
+        "Connections created.","counter",m.get_connections_created(),none);
+    detail::write_counter(out,prefix,"connections_open",
+        "Connections currently open.","gauge",m.get_connections_open(),none);
+    detail::write_counter(out,prefix,"received_bytes_total",
+        "Bytes read from the transport.","counter",m.get_bytes_in(),none);
+    detail::write_counter(out,prefix,"sent_bytes_total",
+        "Bytes written to the transport.","counter",m.get_bytes_out(),none);
+    detail::write_counter(out,prefix,"received_messages_total",
+        "Messages received.","counter",m.get_messages_in(),none);
+    detail::write_counter(out,prefix,"sent_frames_total",
+        "Frames written.","counter",m.get_messages_out(),none);
+    detail::write_histogram(out,prefix,"write_latency_seconds",
+        "Time from issuing a transport write to its completion.",
+        m.get_write_latency(),none);
+}
+
+/// Write the metrics of several connections in the Prometheus text format
+/**
+ * Each metric family gets one HELP and TYPE header followed by one sample per
+ * connection, so the labels must tell the connections apart.
+ *
+ * @param out The stream to write to
+ * @param cons The metrics to write, each with its label set
+ * @param prefix Prepended to every metric name
+ */
+inline void write_prometheus(std::ostream & out,
+    std::vector<labeled_connection_metrics> const & cons,
+    std::string const & prefix = "websocketpp_connection_")
+{
+    detail::write_family(out,prefix,"received_bytes_total",
+        "Bytes read from the transport.","counter",cons,
+        &connection_metrics::bytes_in);
+    detail::write_family(out,prefix,"sent_bytes_total",
+        "Bytes written to the transport.","counter",cons,
+        &connection_metrics::bytes_out);
+    detail::write_family(out,prefix,"received_messages_total",
+        "Messages received.","counter",cons,&connection_metrics::messages_in);
+    detail::write_family(out,prefix,"sent_frames_total",
+        "Frames written.","counter",cons,&connection_metrics::messages_out);
+    detail::write_family(out,prefix,"send_queue_depth",
+        "Messages waiting in the send queue.","gauge",cons,
+        &connection_metrics::send_queue_depth);
+    detail::write_family(out,prefix,"send_queue_peak",
+        "Largest send queue depth seen.","gauge",cons,
+        &connection_metrics::send_queue_peak);
+
+    detail::write_header(out,prefix,"write_latency_seconds",
+        "Time from issuing a transport write to its completion.","histogram");
+    for (size_t i = 0; i < cons.size(); ++i) {
+        detail::write_histogram_samples(out,prefix,"write_latency_seconds",
+            cons[i].second.write_latency,cons[i].first);
+    }
+}
+
+/// Write connection metrics in the Prometheus text exposition format
+/**
+ * Writes the headers of every metric family, so call this once per scrape.
+ * Use the vector overload to export several connections.
+ *
+ * @param out The stream to write to
+ * @param m The metrics to write
+ * @param labels Label set identifying the connection, for example
+ * `connection="42"`. May be empty.
+ * @param prefix Prepended to every metric name
+ */
+inline void write_prometheus(std::ostream & out, connection_metrics const & m,
+    std::string const & labels, std::string const & prefix =
+    "websocketpp_connection_")
+{
+    std::vector<labeled_connection_metrics> cons(1,
+        labeled_connection_metrics(labels,m));
+    write_prometheus(out,cons,prefix);
+}
+
+} // namespace metrics
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_METRICS_HPP
@@ -0,0 +1,838 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_MULTIPLEX_HPP
+#define WEBSOCKETPP_MULTIPLEX_HPP
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/cpp11.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/common/system_error.hpp>
+#include <websocketpp/frame.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+/// Many logical sessions over one WebSocket connection
+/**
+ * A channel wraps an open (or opening) connection and carries any number of
+ * sessions over it. Each WebSocket message on the connection holds one frame
+ * of one session:
+ *
+ *     stream id   4 bytes, big endian
+ *     type        1 byte: data, open, close or credit
+ *     payload     the rest of the message
+ *
+ * Both ends must use a channel. Sessions opened on a channel are given odd
+ * ids by the end that connected and even ids by the end that accepted, so
+ * either end may open them.
+ *
+ * Flow control is per session and credit based, in bytes of data payload.
+ * Each end of a session starts with the channel's initial window of credit
+ * and spends it as it sends; the receiver returns credit as data is handed
+ * to its message handler. A session that has no credit left queues its data
+ * until credit arrives, so one busy session cannot fill the connection's
+ * send queue ahead of the others. A message is sent as long as any credit is
+ * left, even if it is larger, so a session is never stuck on a big message.
+ *
+ * pool keeps channels open to upstream servers and hands out sessions on
+ * them, opening a new connection only when the existing ones are full.
+ *
+ * Channels, sessions and pools are not synchronized. They must be used from
+ * the thread that runs the endpoint's transport, where all of their handlers
+ * run as well.
+ */
+namespace multiplex {
+
+/// Multiplex error codes
+namespace error {
+enum value {
+    /// Catch-all multiplex error
+    general = 1,
+
+    /// The connection carrying the session closed or failed
+    connection_lost,
+
+    /// Attempted an operation on a session that has closed
+    session_closed,
+
+    /// Received a frame that is not a valid multiplex frame
+    invalid_frame,
+
+    /// All the pool's connections to the upstream are full
+    no_capacity
+};
+
+/// Multiplex error category
+class category : public lib::error_category {
+public:
+    char const * name() const _WEBSOCKETPP_NOEXCEPT_TOKEN_ {
+        return "websocketpp.multiplex";
+    }
+
+    std::string message(int value) const {
+        switch(value) {
+            case error::general:
+                return "Generic multiplex error";
+            case error::connection_lost:
+                return "The connection carrying the session was lost";
+            case error::session_closed:
+                return "The session is closed";
+            case error::invalid_frame:
+                return "Invalid multiplex frame";
+            case error::no_capacity:
+                return "No connection capacity left for the upstream";
+            default:
+                return "Unknown";
+        }
+    }
+};
+
+/// Get a reference to a static copy of the multiplex error category
+inline lib::error_category const & get_category() {
+    static category instance;
+    return instance;
+}
+
+/// Create an error code with the given value and the multiplex category
+inline lib::error_code make_error_code(error::value e) {
+    return lib::error_code(static_cast<int>(e), get_category());
+}
+
+} // namespace error
+
+/// Multiplex frame types
+namespace frame_type {
+enum value {
+    /// Session data
+    data = 0,
+    /// First frame of a new session
+    open = 1,
+    /// Last frame of a session
+    close = 2,
+    /// Grants the payload's 4 byte big endian count of bytes of credit
+    credit = 3
+};
+} // namespace frame_type
+
+/// Size of the header in front of every frame's payload
+static size_t const header_size = 5;
+
+/// Default initial window of credit of a session, in bytes
+static uint32_t const default_window = 65536;
+
+template <typename endpoint_type>
+class channel;
+
+/// One logical session carried by a channel
+template <typename endpoint_type>
+class session {
+public:
+    /// Type of this session
+    typedef session<endpoint_type> type;
+    /// Type of a shared pointer to this session
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Called with each data payload, which is only valid during the call
+    typedef lib::function<void(ptr, char const *, size_t)> message_handler;
+    /// Called once when the session ends, with an error if it did not end by
+    /// either side closing it
+    typedef lib::function<void(ptr, lib::error_code const &)> close_handler;
+
+    /// Set the handler for data received on this session
+    void set_message_handler(message_handler h) {
+        m_message_handler = h;
+    }
+
+    /// Set the handler called when the session ends
+    void set_close_handler(close_handler h) {
+        m_close_handler = h;
+    }
+
+    /// Send data on the session
+    /**
+     * The data is copied into a message straight away. It is sent as soon
+     * as the session has credit and the connection is open; until then it
+     * is queued on the session.
+     *
+     * @param payload The data to send
+     * @param len The size of the data
+     * @return A status code indicating an error, if any.
+     */
+    lib::error_code send(void const * payload, size_t len) {
+        lib::shared_ptr< channel<endpoint_type> > c = m_channel.lock();
+        if (m_closed || !c) {
+            return error::make_error_code(error::session_closed);
+        }
+        return c->send_data(*this,payload,len);
+    }
+
+    /// Send data on the session (see the buffer overload)
+    lib::error_code send(std::string const & payload) {
+        return send(payload.data(),payload.size());
+    }
+
+    /// Close the session
+    /**
+     * Data already queued on the session is discarded. The close handler is
+     * called with no error.
+     */
+    void close() {
+        lib::shared_ptr< channel<endpoint_type> > c = m_channel.lock();
+        if (m_closed || !c) {
+            return;
+        }
+        c->close_session(m_id,true,lib::error_code());
+    }
+
+    /// Get the session's stream id
+    uint32_t get_id() const {
+        return m_id;
+    }
+
+    /// Whether the session is still open
+    bool is_open() const {
+        return !m_closed;
+    }
+
+    /// Bytes of data queued on the session, waiting for credit
+    size_t get_buffered_amount() const {
+        return m_queued_bytes;
+    }
+
+    /// Bytes of credit left for sending
+    /**
+     * May be negative after a message larger than the credit left.
+     */
+    int64_t get_send_credit() const {
+        return m_send_credit;
+    }
+private:
+    friend class channel<endpoint_type>;
+
+    typedef typename endpoint_type::message_ptr message_ptr;
+
+    session(lib::shared_ptr< channel<endpoint_type> > c, uint32_t id,
+        uint32_t window)
+      : m_channel(c)
+      , m_id(id)
+      , m_closed(false)
+      , m_send_credit(window)
+      , m_unreturned(0)
+      , m_queued_bytes(0) {}
+
+    // non-copyable
+    session(session const &);
+    session & operator=(session const &);
+
+    lib::weak_ptr< channel<endpoint_type> > m_channel;
+    uint32_t                m_id;
+    bool                    m_closed;
+    int64_t                 m_send_credit;
+    /// Bytes received and handled but not returned to the sender as credit
+    uint32_t                m_unreturned;
+    std::deque<message_ptr> m_queue;
+    size_t                  m_queued_bytes;
+    message_handler         m_message_handler;
+    close_handler           m_close_handler;
+};
+
+/// Carries sessions over one WebSocket connection
+/**
+ * A channel takes over its connection's open, message, close and fail
+ * handlers.
+ */
+template <typename endpoint_type>
+class channel : public lib::enable_shared_from_this< channel<endpoint_type> > {
+public:
+    /// Type of this channel
+    typedef channel<endpoint_type> type;
+    /// Type of a shared pointer to this channel
+    typedef lib::shared_ptr<type> ptr;
+
+    /// Type of the sessions the channel carries
+    typedef session<endpoint_type> session_type;
+    /// Type of a shared pointer to a session
+    typedef typename session_type::ptr session_ptr;
+
+    /// Type of the endpoint's connections
+    typedef typename endpoint_type::connection_ptr connection_ptr;
+    /// Type of a pointer to a message
+    typedef typename endpoint_type::message_ptr message_ptr;
+
+    /// Called with each session the peer opens
+    typedef lib::function<void(session_ptr)> accept_handler;
+    /// Called when the connection opens
+    typedef lib::function<void(ptr)> open_handler;
+    /// Called once when the connection closes or fails, after every session
+    /// on it has been closed
+    typedef lib::function<void(ptr)> terminate_handler;
+
+    /// Wrap a connection in a channel
+    /**
+     * The connection may still be connecting; sessions opened before it is
+     * open are announced to the peer, with their queued data, once it is.
+     * Call this before connect() is called on a client connection, or from
+     * the open handler on a server.
+     *
+     * @param con The connection to carry the sessions
+     * @param initiator Whether this end opened the connection
+     * @param window Initial window of credit of each session, which must be
+     * the same at both ends
+     * @return The channel
+     */
+    static ptr attach(connection_ptr con, bool initiator,
+        uint32_t window = default_window)
+    {
+        ptr c(new type(con,initiator,window));
+
+        con->set_open_handler(lib::bind(&type::handle_open,c));
+        con->set_message_handler(lib::bind(&type::handle_message,c,
+            lib::placeholders::_2));
+        con->set_close_handler(lib::bind(&type::handle_terminate,c));
+        con->set_fail_handler(lib::bind(&type::handle_terminate,c));
+
+        if (con->get_state() == websocketpp::session::state::open) {
+            c->m_open = true;
+        }
+        return c;
+    }
+
+    /// Set the handler for sessions opened by the peer
+    /**
+     * Sessions the peer opens while no handler is set are closed at once.
+     */
+    void set_accept_handler(accept_handler h) {
+        m_accept_handler = h;
+    }
+
+    /// Set the handler called when the connection opens
+    void set_open_handler(open_handler h) {
+        m_open_handler = h;
+    }
+
+    /// Set the handler called when the connection ends
+    void set_terminate_handler(terminate_handler h) {
+        m_terminate_handler = h;
+    }
+
+    /// Open a session (exception free)
+    /**
+     * @param ec Set to indicate what error occurred, if any.
+     * @return The session, or an empty pointer on error
+     */
+    session_ptr open_session(lib::error_code & ec) {
+        if (!m_con) {
+            ec = error::make_error_code(error::connection_lost);
+            return session_ptr();
+        }
+
+        uint32_t id = m_next_id;
+        m_next_id += 2;
+
+        session_ptr s(new session_type(type::shared_from_this(),id,m_window));
+        m_sessions[id] = s;
+
+        if (m_open) {
+            send_frame(id,frame_type::open,NULL,0);
+        }
+        ec = lib::error_code();
+        return s;
+    }
+
+    /// Open a session
+    /**
+     * @return The session
+     */
+    session_ptr open_session() {
+        lib::error_code ec;
+        session_ptr s = open_session(ec);
+        if (ec) {
+            throw ec;
+        }
+        return s;
+    }
+
+    /// Number of open sessions
+    size_t get_session_count() const {
+        return m_sessions.size();
+    }
+
+    /// Whether the connection is open
+    bool is_open() const {
+        return m_open;
+    }
+
+    /// Whether the connection has closed or failed
+    bool is_terminated() const {
+        return !m_con;
+    }
+
+    /// Get the connection carrying the sessions
+    /**
+     * @return The connection, or an empty pointer once it has closed or
+     * failed
+     */
+    connection_ptr get_connection() const {
+        return m_con;
+    }
+private:
+    friend class session<endpoint_type>;
+
+    typedef std::map<uint32_t,session_ptr> session_map;
+
+    channel(connection_ptr con, bool initiator, uint32_t window)
+      : m_con(con)
+      , m_open(false)
+      , m_window(window)
+      , m_next_id(initiator ? 1 : 2) {}
+
+    // non-copyable
+    channel(channel const &);
+    channel & operator=(channel const &);
+
+    message_ptr make_frame(uint32_t id, frame_type::value t,
+        void const * payload, size_t len)
+    {
+        message_ptr msg = m_con->get_message(frame::opcode::binary,
+            header_size+len);
+        std::string & p = msg->get_raw_payload();
+        p.resize(header_size+len);
+        p[0] = static_cast<char>((id >> 24) & 0xff);
+        p[1] = static_cast<char>((id >> 16) & 0xff);
+        p[2] = static_cast<char>((id >> 8) & 0xff);
+        p[3] = static_cast<char>(id & 0xff);
+        p[4] = static_cast<char>(t);
+        if (len) {
+            std::copy(static_cast<char const *>(payload),
+                static_cast<char const *>(payload)+len,p.begin()+header_size);
+        }
+        return msg;
+    }
+
+    void send_frame(uint32_t id, frame_type::value t, void const * payload,
+        size_t len)
+    {
+        m_con->send(make_frame(id,t,payload,len));
+    }
+
+    void send_credit(uint32_t id, uint32_t bytes) {
+        char b[4];
+        b[0] = static_cast<char>((bytes >> 24) & 0xff);
+        b[1] = static_cast<char>((bytes >> 16) & 0xff);
+        b[2] = static_cast<char>((bytes >> 8) & 0xff);
+        b[3] = static_cast<char>(bytes & 0xff);
+        send_frame(id,frame_type::credit,b,4);
+    }
+
+    lib::error_code send_data(session_type & s, void const * payload,
+        size_t len)
+    {
+        message_ptr msg = make_frame(s.m_id,frame_type::data,payload,len);
+
+        if (m_open && s.m_queue.empty() && s.m_send_credit > 0) {
+            s.m_send_credit -= static_cast<int64_t>(len);
+            return m_con->send(msg);
+        }
+
+        s.m_queue.push_back(msg);
+        s.m_queued_bytes += len;
+        return lib::error_code();
+    }
+
+    /// Send as much of a session's queued data as its credit allows
+    void flush(session_type & s) {
+        while (m_open && !s.m_queue.empty() && s.m_send_credit > 0) {
+            message_ptr msg = s.m_queue.front();
+            s.m_queue.pop_front();
+
+            size_t len = msg->get_payload().size()-header_size;
+            s.m_queued_bytes -= len;
+            s.m_send_credit -= static_cast<int64_t>(len);
+            m_con->send(msg);
+        }
+    }
+
+    void close_session(uint32_t id, bool notify_peer,
+        lib::error_code const & ec)
+    {
+        typename session_map::iterator it = m_sessions.find(id);
+        if (it == m_sessions.end()) {
+            return;
+        }
+
+        session_ptr s = it->second;
+        m_sessions.erase(it);
+
+        s->m_closed = true;
+        s->m_queue.clear();
+        s->m_queued_bytes = 0;
+
+        if (notify_peer && m_open) {
+            send_frame(id,frame_type::close,NULL,0);
+        }
+
+        typename session_type::close_handler h = s->m_close_handler;
+        // drop the handlers, which may hold references to the session
+        s->m_message_handler = typename session_type::message_handler();
+        s->m_close_handler = typename session_type::close_handler();
+        if (h) {
+            h(s,ec);
+        }
+    }
+
+    void handle_open() {
+        m_open = true;
+
+        // announce the sessions opened while connecting
+        std::vector<session_ptr> pending;
+        for (typename session_map::iterator it = m_sessions.begin();
+             it != m_sessions.end(); ++it)
+        {
+            pending.push_back(it->second);
+        }
+        for (size_t i = 0; i < pending.size(); ++i) {
+            send_frame(pending[i]->m_id,frame_type::open,NULL,0);
+            flush(*pending[i]);
+        }
+
+        if (m_open_handler) {
+            m_open_handler(type::shared_from_this());
+        }
+    }
+
+    void handle_message(message_ptr msg) {
+        std::string const & p = msg->get_payload();
+        if (p.size() < header_size) {
+            return;
+        }
+
+        uint32_t id = (static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 24)
+                    | (static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 16)
+                    | (static_cast<uint32_t>(static_cast<unsigned char>(p[2])) << 8)
+                    |  static_cast<uint32_t>(static_cast<unsigned char>(p[3]));
+        char const * payload = p.data()+header_size;
+        size_t len = p.size()-header_size;
+
+        switch (static_cast<unsigned char>(p[4])) {
+            case frame_type::open:
+                handle_peer_open(id);
+                break;
+            case frame_type::data:
+                handle_data(id,payload,len);
+                break;
+            case frame_type::credit:
+                if (len == 4) {
+                    handle_credit(id,
+                        (static_cast<uint32_t>(static_cast<unsigned char>(payload[0])) << 24)
+                      | (static_cast<uint32_t>(static_cast<unsigned char>(payload[1])) << 16)
+                      | (static_cast<uint32_t>(static_cast<unsigned char>(payload[2])) << 8)
+                      |  static_cast<uint32_t>(static_cast<unsigned char>(payload[3])));
+                }
+                break;
+            case frame_type::close:
+                close_session(id,false,lib::error_code());
+                break;
+            default:
+                break;
+        }
+    }
+
+    void handle_peer_open(uint32_t id) {
+        // the peer must use the other parity, and may not reuse an id
+        if ((id & 1) == (m_next_id & 1) || m_sessions.count(id)) {
+            return;
+        }
+
+        if (!m_accept_handler) {
+            send_frame(id,frame_type::close,NULL,0);
+            return;
+        }
+
+        session_ptr s(new session_type(type::shared_from_this(),id,m_window));
+        m_sessions[id] = s;
+        m_accept_handler(s);
+    }
+
+    void handle_data(uint32_t id, char const * payload, size_t len) {
+        typename session_map::iterator it = m_sessions.find(id);
+        if (it == m_sessions.end()) {
+            // data still in flight when the session closed
+            return;
+        }
+
+        session_ptr s = it->second;
+        if (s->m_message_handler) {
+            s->m_message_handler(s,payload,len);
+        }
+
+        // return the credit once the handler is done with the data
+        if (s->m_closed) {
+            return;
+        }
+        s->m_unreturned += static_cast<uint32_t>(len);
+        if (s->m_unreturned >= m_window/2) {
+            send_credit(id,s->m_unreturned);
+            s->m_unreturned = 0;
+        }
+    }
+
+    void handle_credit(uint32_t id, uint32_t bytes) {
+        typename session_map::iterator it = m_sessions.find(id);
+        if (it == m_sessions.end()) {
+            return;
+        }
+
+        session_ptr s = it->second;
+        s->m_send_credit += bytes;
+        flush(*s);
+    }
+
+    void handle_terminate() {
+        // Dropping the connection and the handlers breaks the cycles between
+        // them and this channel.
+        ptr self = type::shared_from_this();
+        m_open = false;
+        m_con.reset();
+
+        lib::error_code ec = error::make_error_code(error::connection_lost);
+        while (!m_sessions.empty()) {
+            close_session(m_sessions.begin()->first,false,ec);
+        }
+
+        terminate_handler h = m_terminate_handler;
+        m_accept_handler = accept_handler();
+        m_open_handler = open_handler();
+        m_terminate_handler = terminate_handler();
+        if (h) {
+            h(self);
+        }
+    }
+
+    connection_ptr      m_con;
+    bool                m_open;
+    uint32_t            m_window;
+    uint32_t            m_next_id;
+    session_map         m_sessions;
+    accept_handler      m_accept_handler;
+    open_handler        m_open_handler;
+    terminate_handler   m_terminate_handler;
+};
+
+/// Warm client connections to upstream servers, shared by many sessions
+/**
+ * Sessions to an upstream URI go to the least loaded of the pool's open
+ * connections to it. A new connection is only opened when every existing one
+ * carries max_sessions sessions, up to max_connections per upstream.
+ * Connections stay open when their last session closes, ready for the next
+ * one; a connection that closes or fails is dropped from the pool, and its
+ * sessions end with error::connection_lost.
+ */
+template <typename client_type>
+class pool {
+public:
+    /// Type of the pool's channels
+    typedef channel<client_type> channel_type;
+    /// Type of a shared pointer to a channel
+    typedef typename channel_type::ptr channel_ptr;
+    /// Type of a shared pointer to a session
+    typedef typename channel_type::session_ptr session_ptr;
+
+    /// Create a pool of the client's connections
+    /**
+     * @param c The client endpoint to open connections with
+     * @param max_connections Most connections to open to each upstream
+     * @param max_sessions Most sessions to carry on each connection
+     * @param window Initial window of credit of each session
+     */
+    pool(client_type & c, size_t max_connections = 1,
+        size_t max_sessions = 1000, uint32_t window = default_window)
+      : m_client(c)
+      , m_max_connections(max_connections)
+      , m_max_sessions(max_sessions)
+      , m_window(window) {}
+
+    ~pool() {
+        // the channels outlive the pool until their connections end
+        for (typename upstream_map::iterator it = m_upstreams.begin();
+             it != m_upstreams.end(); ++it)
+        {
+            for (size_t i = 0; i < it->second.size(); ++i) {
+                it->second[i]->set_terminate_handler(
+                    typename channel_type::terminate_handler());
+            }
+        }
+    }
+
+    /// Open a session to an upstream (exception free)
+    /**
+     * The session can be sent on at once; its data is queued until its
+     * connection is open.
+     *
+     * @param uri The upstream's URI
+     * @param ec Set to indicate what error occurred, if any.
+     * @return The session, or an empty pointer on error
+     */
+    session_ptr open_session(std::string const & uri, lib::error_code & ec) {
+        channel_ptr c = select(uri,ec);
+        if (ec) {
+            return session_ptr();
+        }
+        return c->open_session(ec);
+    }
+
+    /// Open a session to an upstream
+    /**
+     * @param uri The upstream's URI
+     * @return The session
+     */
+    session_ptr open_session(std::string const & uri) {
+        lib::error_code ec;
+        session_ptr s = open_session(uri,ec);
+        if (ec) {
+            throw ec;
+        }
+        return s;
+    }
+
+    /// Open connections to an upstream ahead of use
+    /**
+     * @param uri The upstream's URI
+     * @param n Number of connections to have open or opening, at most
+     * max_connections
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void warm(std::string const & uri, size_t n, lib::error_code & ec) {
+        std::vector<channel_ptr> & chans = m_upstreams[uri];
+        if (n > m_max_connections) {
+            n = m_max_connections;
+        }
+        while (chans.size() < n) {
+            if (!connect(uri,ec)) {
+                return;
+            }
+        }
+        ec = lib::error_code();
+    }
+
+    /// Number of connections open or opening to an upstream
+    size_t get_connection_count(std::string const & uri) const {
+        typename upstream_map::const_iterator it = m_upstreams.find(uri);
+        return it == m_upstreams.end() ? 0 : it->second.size();
+    }
+private:
+    typedef std::map<std::string, std::vector<channel_ptr> > upstream_map;
+
+    // non-copyable
+    pool(pool const &);
+    pool & operator=(pool const &);
+
+    channel_ptr select(std::string const & uri, lib::error_code & ec) {
+        std::vector<channel_ptr> & chans = m_upstreams[uri];
+
+        channel_ptr best;
+        for (size_t i = 0; i < chans.size(); ++i) {
+            size_t n = chans[i]->get_session_count();
+            if (n < m_max_sessions &&
+                (!best || n < best->get_session_count()))
+            {
+                best = chans[i];
+            }
+        }
+
+        if (best) {
+            ec = lib::error_code();
+            return best;
+        }
+
+        if (chans.size() >= m_max_connections) {
+            ec = error::make_error_code(error::no_capacity);
+            return channel_ptr();
+        }
+        return connect(uri,ec);
+    }
+
+    channel_ptr connect(std::string const & uri, lib::error_code & ec) {
+        typename client_type::connection_ptr con =
+            m_client.get_connection(uri,ec);
+        if (ec) {
+            return channel_ptr();
+        }
+
+        channel_ptr c = channel_type::attach(con,true,m_window);
+        c->set_terminate_handler(lib::bind(&pool::handle_terminate,this,uri,
+            lib::placeholders::_1));
+        m_upstreams[uri].push_back(c);
+
+        m_client.connect(con);
+        ec = lib::error_code();
+        return c;
+    }
+
+    void handle_terminate(std::string uri, channel_ptr c) {
+        typename upstream_map::iterator it = m_upstreams.find(uri);
+        if (it == m_upstreams.end()) {
+            return;
+        }
+
+        std::vector<channel_ptr> & chans = it->second;
+        for (size_t i = 0; i < chans.size(); ++i) {
+            if (chans[i] == c) {
+                chans.erase(chans.begin()+i);
+                break;
+            }
+        }
+        if (chans.empty()) {
+            m_upstreams.erase(it);
+        }
+    }
+
+    client_type &   m_client;
+    size_t          m_max_connections;
+    size_t          m_max_sessions;
+    uint32_t        m_window;
+    upstream_map    m_upstreams;
+};
+
+} // namespace multiplex
+} // namespace websocketpp
+
+_WEBSOCKETPP_ERROR_CODE_ENUM_NS_START_
+template<> struct is_error_code_enum<websocketpp::multiplex::error::value>
+{
+    static bool const value = true;
+};
+_WEBSOCKETPP_ERROR_CODE_ENUM_NS_END_
+
+#endif // WEBSOCKETPP_MULTIPLEX_HPP
@@ -302,7 +302,7 @@ public:
             return make_error_code(error::invalid_opcode);
         }
 
-        std::string& i = in->get_raw_payload();
+        std::string const & i = in->get_payload();
         //std::string& o = out->get_raw_payload();
 
         // validate payload utf8
@@ -320,6 +320,7 @@ public:
         // hybi00 doesn't support compression
         // hybi00 doesn't have masking
 
+        out->set_opcode(frame::opcode::text);
         out->set_prepared(true);
 
         return lib::error_code();
@@ -346,6 +347,7 @@ public:
         val.append(1,'\xff');
         val.append(1,'\x00');
         out->set_payload(val);
+        out->set_opcode(frame::opcode::close);
         out->set_prepared(true);
 
         return lib::error_code();
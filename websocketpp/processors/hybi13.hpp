@@ -35,6 +35,7 @@
 #include <websocketpp/common/network.hpp>
 #include <websocketpp/common/platforms.hpp>
 #include <websocketpp/http/constants.hpp>
+#include <websocketpp/profiler_stage.hpp>
 
 #include <websocketpp/processors/processor.hpp>
 
@@ -72,6 +73,8 @@ public:
       : processor<config>(secure, p_is_server)
       , m_msg_manager(manager)
       , m_rng(rng)
+      , m_streaming(false)
+      , m_chunk_ready(false)
     {
         reset_headers();
     }
@@ -84,6 +87,23 @@ public:
         return m_permessage_deflate.is_implemented();
     }
 
+    extensions::compression_stats get_compression_stats() const {
+        return m_permessage_deflate.get_stats();
+    }
+
+    void set_streaming(bool value) {
+        m_streaming = value;
+    }
+
+    bool get_chunk(payload_chunk & chunk) {
+        if (!m_chunk_ready) {
+            return false;
+        }
+        chunk = m_chunk;
+        m_chunk_ready = false;
+        return true;
+    }
+
     err_str_pair negotiate_extensions(request_type const & req) {
         err_str_pair ret;
 
@@ -316,6 +336,7 @@ public:
         size_t p = 0;
 
         ec = lib::error_code();
+        m_chunk_ready = false;
 
         //std::cout << "consume: " << utility::to_hex(buf,len) << std::endl;
 
@@ -368,7 +389,23 @@ public:
 
                     m_current_msg = &m_control_msg;
                 } else {
-                    if (!m_data_msg.msg_ptr) {
+                    if (m_streaming) {
+                        // The message is never accumulated; its buffer only
+                        // holds the output of one decompression step.
+                        if (!m_data_msg.msg_ptr) {
+                            m_data_msg = msg_metadata(
+                                m_msg_manager->get_message(op,0),
+                                frame::get_masking_key(m_basic_header,m_extended_header)
+                            );
+                        } else {
+                            m_data_msg.prepared_key = prepare_masking_key(
+                                frame::get_masking_key(
+                                    m_basic_header,
+                                    m_extended_header
+                                )
+                            );
+                        }
+                    } else if (!m_data_msg.msg_ptr) {
                         if (m_bytes_needed > base::m_max_message_size) {
                             ec = make_error_code(error::message_too_big);
                             break;
@@ -408,6 +445,39 @@ public:
 				if (bytes_to_process > len - p){
 					bytes_to_process = len - p;
 				}
+                if (m_streaming && m_current_msg == &m_data_msg) {
+                    // Hand out whatever this call decoded. One chunk is
+                    // produced per call so that it stays valid until the
+                    // next one.
+                    m_chunk.opcode = m_data_msg.msg_ptr->get_opcode();
+                    m_chunk.data = NULL;
+                    m_chunk.len = 0;
+                    m_chunk.last = false;
+
+                    if (bytes_to_process > 0) {
+                        p += this->process_payload_bytes(buf+p,bytes_to_process,ec);
+
+                        if (ec) {break;}
+                    }
+
+                    if (m_bytes_needed == 0) {
+                        if (frame::get_fin(m_basic_header)) {
+                            if (m_chunk.opcode == frame::opcode::TEXT &&
+                                !m_data_msg.validator.complete())
+                            {
+                                ec = make_error_code(error::invalid_utf8);
+                                break;
+                            }
+                            m_chunk.last = true;
+                            m_data_msg.msg_ptr.reset();
+                        }
+                        this->reset_headers();
+                    }
+
+                    m_chunk_ready = (m_chunk.len > 0 || m_chunk.last);
+                    break;
+                }
+
                 if (bytes_to_process > 0) {
                     p += this->process_payload_bytes(buf+p,bytes_to_process,ec);
 
@@ -526,8 +596,7 @@ public:
             return make_error_code(error::invalid_opcode);
         }
 
-        std::string& i = in->get_raw_payload();
-        std::string& o = out->get_raw_payload();
+        std::string const & i = in->get_payload();
 
         // validate payload utf8
         if (op == frame::opcode::TEXT && !utf8_validator::validate(i)) {
@@ -537,33 +606,53 @@ public:
         frame::masking_key_type key;
         bool masked = !base::m_server;
         bool compressed = m_permessage_deflate.is_enabled()
-                          && in->get_compressed();
+                          && in->get_compressed()
+                          && m_permessage_deflate.should_compress(op,i.size());
         bool fin = in->get_fin();
 
+        // compress first; the header carries the compressed length
+        if (compressed) {
+            std::string& o = out->get_raw_payload();
+            o.clear();
+
+            profiler::conditional_stage_scope<config::enable_profiler_stages>
+                stage("websocket.deflate");
+            lib::error_code ec = m_permessage_deflate.compress(i,o);
+            if (ec) {
+                return ec;
+            }
+        }
+
+        size_t payload_size = compressed ? out->get_payload().size() : i.size();
+
         // generate header
-        frame::basic_header h(op,i.size(),fin,masked,compressed);
+        frame::basic_header h(op,payload_size,fin,masked,compressed);
 
         if (masked) {
             // Generate masking key.
             key.i = m_rng();
 
-            frame::extended_header e(i.size(),key.i);
+            frame::extended_header e(payload_size,key.i);
             out->set_header(frame::prepare_header(h,e));
         } else {
-            frame::extended_header e(i.size());
+            frame::extended_header e(payload_size);
             out->set_header(frame::prepare_header(h,e));
         }
 
         // prepare payload
         if (compressed) {
-            // compress and store in o after header.
-            m_permessage_deflate.compress(i,o);
-
             // mask in place if necessary
             if (masked) {
+                std::string& o = out->get_raw_payload();
                 this->masked_copy(o,o,key);
             }
+        } else if (!masked && in->get_shared_payload()) {
+            // Unmasked bytes are identical on the wire, so an immutable shared
+            // payload can be written as is. Only the header is per frame.
+            out->set_shared_payload(in->get_shared_payload());
         } else {
+            std::string& o = out->get_raw_payload();
+
             // no compression, just copy data into the output buffer
             o.resize(i.size());
 
@@ -577,6 +666,9 @@ public:
             }
         }
 
+        out->set_opcode(op);
+        out->set_fin(fin);
+        out->set_compressed(compressed);
         out->set_prepared(true);
 
         return lib::error_code();
@@ -628,12 +720,33 @@ public:
     }
 protected:
     /// Convert a client handshake key into a server response key in place
+    /**
+     * The key and GUID are hashed from a stack buffer and the digest is
+     * base64 encoded into another, so the only write to the heap is the final
+     * assign into `key`, which normally fits its existing storage. Keys much
+     * longer than the 24 characters RFC 6455 requires take the allocating
+     * path.
+     */
     lib::error_code process_handshake_key(std::string & key) const {
-        key.append(constants::handshake_guid);
+        static size_t const guid_len = sizeof(constants::handshake_guid) - 1;
 
         unsigned char message_digest[20];
-        sha1::calc(key.c_str(),key.length(),message_digest);
-        key = base64_encode(message_digest,20);
+        char buf[128];
+
+        if (key.size() + guid_len <= sizeof(buf)) {
+            std::copy(key.begin(),key.end(),buf);
+            std::copy(constants::handshake_guid,
+                constants::handshake_guid + guid_len, buf + key.size());
+            sha1::calc(buf,static_cast<int>(key.size()+guid_len),
+                message_digest);
+        } else {
+            key.append(constants::handshake_guid);
+            sha1::calc(key.c_str(),static_cast<int>(key.length()),
+                message_digest);
+        }
+
+        size_t len = base64_encode(message_digest,sizeof(message_digest),buf);
+        key.assign(buf,len);
 
         return lib::error_code();
     }
@@ -700,21 +813,10 @@ protected:
      */
     size_t process_payload_bytes(uint8_t * buf, size_t len, lib::error_code& ec)
     {
-        // unmask if masked
-        if (frame::get_masked(m_basic_header)) {
-            #ifdef WEBSOCKETPP_STRICT_MASKING
-                m_current_msg->prepared_key = frame::byte_mask_circ(
-                    buf,
-                    len,
-                    m_current_msg->prepared_key
-                );
-            #else
-                m_current_msg->prepared_key = frame::word_mask_circ(
-                    buf,
-                    len,
-                    m_current_msg->prepared_key
-                );
-            #endif
+        bool masked = frame::get_masked(m_basic_header);
+
+        if (m_streaming && m_current_msg == &m_data_msg) {
+            return process_payload_chunk(buf,len,ec);
         }
 
         std::string & out = m_current_msg->msg_ptr->get_raw_payload();
@@ -724,11 +826,26 @@ protected:
         if (m_permessage_deflate.is_enabled()
             && frame::get_rsv1(m_basic_header))
         {
-            // Decompress current buffer into the message buffer
-            m_permessage_deflate.decompress(buf,len,out);
+            // unmask in place; inflate reads the unmasked bytes from buf
+            if (masked) {
+                m_current_msg->prepared_key = unmask(buf,buf,len,
+                    m_current_msg->prepared_key);
+            }
 
-            // get the length of the newly uncompressed output
-            offset = out.size() - offset;
+            // Decompress current buffer into the message buffer
+            profiler::conditional_stage_scope<config::enable_profiler_stages>
+                stage("websocket.inflate");
+            ec = m_permessage_deflate.decompress(buf,len,out);
+            if (ec) {
+                return 0;
+            }
+        } else if (masked) {
+            // Unmask straight into the message buffer rather than unmasking
+            // buf in place and then copying it, saving a pass over the data.
+            out.resize(offset+len);
+            m_current_msg->prepared_key = unmask(buf,
+                reinterpret_cast<uint8_t *>(&out[offset]),len,
+                m_current_msg->prepared_key);
         } else {
             // No compression, straight copy
             out.append(reinterpret_cast<char *>(buf),len);
@@ -747,6 +864,76 @@ protected:
         return len;
     }
 
+    /// Decode payload bytes of a streamed data message into m_chunk
+    /**
+     * Uncompressed payloads are unmasked in place and the chunk points into
+     * buf. Compressed payloads are inflated into the data message's buffer,
+     * which is cleared first, and the chunk points there.
+     *
+     * @param buf Input/working buffer
+     * @param len Length of buf
+     * @return Number of bytes processed or zero in case of an error
+     */
+    size_t process_payload_chunk(uint8_t * buf, size_t len, lib::error_code& ec)
+    {
+        if (frame::get_masked(m_basic_header)) {
+            m_data_msg.prepared_key = unmask(buf,buf,len,
+                m_data_msg.prepared_key);
+        }
+
+        uint8_t const * begin = buf;
+        size_t size = len;
+
+        if (m_permessage_deflate.is_enabled()
+            && frame::get_rsv1(m_basic_header))
+        {
+            std::string & out = m_data_msg.msg_ptr->get_raw_payload();
+            out.clear();
+
+            profiler::conditional_stage_scope<config::enable_profiler_stages>
+                stage("websocket.inflate");
+            ec = m_permessage_deflate.decompress(buf,len,out);
+            if (ec) {
+                return 0;
+            }
+
+            begin = reinterpret_cast<uint8_t const *>(out.data());
+            size = out.size();
+        }
+
+        if (m_data_msg.msg_ptr->get_opcode() == frame::opcode::TEXT) {
+            if (!m_data_msg.validator.decode(begin,begin+size)) {
+                ec = make_error_code(error::invalid_utf8);
+                return 0;
+            }
+        }
+
+        m_chunk.data = begin;
+        m_chunk.len = size;
+
+        m_bytes_needed -= len;
+
+        return len;
+    }
+
+    /// Unmask len bytes of a frame payload using a circular prepared key
+    /**
+     * @param input Masked bytes
+     * @param output Buffer to write the unmasked bytes to. May equal input.
+     * @param len Number of bytes to unmask
+     * @param prepared_key The key state after the previous chunk
+     * @return The key state to use for the next chunk
+     */
+    static size_t unmask(uint8_t * input, uint8_t * output, size_t len,
+        size_t prepared_key)
+    {
+        #ifdef WEBSOCKETPP_STRICT_MASKING
+            return frame::byte_mask_circ(input,output,len,prepared_key);
+        #else
+            return frame::word_mask_circ(input,output,len,prepared_key);
+        #endif
+    }
+
     /// Validate an incoming basic header
     /**
      * Validates an incoming hybi13 basic header.
@@ -930,6 +1117,7 @@ protected:
             std::copy(payload.begin(),payload.end(),o.begin());
         }
 
+        out->set_opcode(op);
         out->set_prepared(true);
 
         return lib::error_code();
@@ -987,6 +1175,12 @@ protected:
     // Overall state of the processor
     state m_state;
 
+    // Whether data messages are delivered in chunks
+    bool m_streaming;
+    // Chunk decoded by the last call to consume and whether it is unclaimed
+    payload_chunk m_chunk;
+    bool m_chunk_ready;
+
     // Extensions
     permessage_deflate_type m_permessage_deflate;
 };
@@ -32,6 +32,8 @@
 #include <websocketpp/common/system_error.hpp>
 
 #include <websocketpp/close.hpp>
+#include <websocketpp/frame.hpp>
+#include <websocketpp/extensions/extension.hpp>
 #include <websocketpp/utilities.hpp>
 #include <websocketpp/uri.hpp>
 
@@ -149,6 +151,29 @@ uri_ptr get_uri_from_host(request_type & request, std::string scheme) {
     }
 }
 
+/// A view of part of an incoming data message
+/**
+ * Valid until the next call to the processor's consume. The bytes are
+ * already unmasked, decompressed, and (for text messages) UTF-8 validated as
+ * far as they go.
+ */
+struct payload_chunk {
+    payload_chunk()
+      : opcode(frame::opcode::continuation)
+      , data(NULL)
+      , len(0)
+      , last(false) {}
+
+    /// Opcode of the message the chunk belongs to (text or binary)
+    frame::opcode::value opcode;
+    /// Start of the chunk
+    uint8_t const * data;
+    /// Length of the chunk in bytes. May be zero for the last chunk.
+    size_t len;
+    /// Whether this chunk completes the message
+    bool last;
+};
+
 /// WebSocket protocol processor abstract base class
 template <typename config>
 class processor {
@@ -207,6 +232,16 @@ public:
         return false;
     }
 
+    /// Get counters describing what the compression extension did
+    /**
+     * Processors without a compression extension return all zeros.
+     *
+     * @return A copy of the compression statistics for this connection
+     */
+    virtual extensions::compression_stats get_compression_stats() const {
+        return extensions::compression_stats();
+    }
+
     /// Initializes extensions based on the Sec-WebSocket-Extensions header
     /**
      * Reads the Sec-WebSocket-Extensions header and determines if any of the
@@ -326,6 +361,31 @@ public:
     /// Tests whether the processor is in a fatal error state
     virtual bool get_error() const = 0;
 
+    /// Deliver data messages in chunks instead of as whole messages
+    /**
+     * In streaming mode the payload of data messages is not accumulated.
+     * After each call to consume, get_chunk returns the payload bytes that
+     * call decoded, and data messages never become ready. Control messages
+     * are unaffected. max_message_size does not apply to streamed messages.
+     *
+     * Processors that do not support streaming ignore this and keep
+     * delivering whole messages.
+     *
+     * @param value Whether streaming mode is on
+     */
+    virtual void set_streaming(bool) {}
+
+    /// Retrieve the chunk decoded by the most recent call to consume
+    /**
+     * Each chunk may be retrieved only once.
+     *
+     * @param [out] chunk Set to the decoded chunk if there is one
+     * @return Whether a chunk was available
+     */
+    virtual bool get_chunk(payload_chunk &) {
+        return false;
+    }
+
     /// Retrieves the number of bytes presently needed by the processor
     /// This value may be used as a hint to the transport layer as to how many
     /// bytes to wait for before running consume again.
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_PROFILER_HPP
+#define WEBSOCKETPP_PROFILER_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/stdint.hpp>
+#include <websocketpp/profiler_stage.hpp>
+
+#include <string.h>
+
+#if !defined(_WIN32)
+    // SIGPROF and ITIMER_PROF are POSIX. Elsewhere start() always fails.
+    #define _WEBSOCKETPP_PROFILER_SIGPROF_
+    #include <errno.h>
+    #include <sched.h>
+    #include <signal.h>
+    #include <sys/time.h>
+#endif
+
+#if defined(_WEBSOCKETPP_PROFILER_SIGPROF_) && defined(__linux__) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+    // Register layouts of the signal context known to walk_stack()
+    #define _WEBSOCKETPP_PROFILER_STACKS_
+    #include <ucontext.h>
+#endif
+
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+/// Low overhead sampling CPU profiler for the whole process
+/**
+ * While running, the profiler asks the kernel for a SIGPROF every period of
+ * consumed CPU time. The thread that receives it records its call stack and
+ * the pipeline stage it is in into a preallocated buffer; nothing is
+ * allocated or locked in the signal handler. The stack is walked by following
+ * frame pointers, since backtrace() is not async-signal-safe. At the default
+ * 100 Hz the cost is a single stack walk every 10ms of CPU, well below 1%.
+ *
+ * Stages are marked with stage_scope guards around the code being attributed,
+ * for example decoding, FreeLing analysis or compression:
+ *
+ * ```
+ * void on_audio(...) {
+ *     profiler::stage_scope stage("asr.decode");
+ *     ps_process_raw(...);
+ * }
+ * ```
+ *
+ * get_pprof() renders the samples in the gperftools CPU profile format read by
+ * `pprof`, optionally limited to one stage, so an admin endpoint can send it
+ * as a binary message:
+ *
+ * ```
+ * s.send(hdl, profiler::get_pprof(), frame::opcode::binary);
+ * ```
+ *
+ * Only one profiler can run per process, since SIGPROF is process wide. The
+ * profiler requires a POSIX system; elsewhere start() returns false. Call
+ * stacks are recorded on Linux on x86-64 and AArch64; elsewhere samples only
+ * carry their stage. stage_scope lives in profiler_stage.hpp, which is
+ * portable and is what the library itself includes. Build with `-fno-omit-frame-pointer`: in code compiled
+ * without frame pointers, the default at -O2 on x86-64, stacks end early or
+ * skip callers.
+ *
+ * The library marks its own stages when the config's enable_profiler_stages
+ * setting is true: `websocket.read` and `websocket.write` in the frame read
+ * and write handlers, `websocket.deflate` and `websocket.inflate` around
+ * permessage-deflate.
+ */
+namespace profiler {
+
+/// Deepest call stack recorded per sample
+static size_t const max_depth = 64;
+
+namespace detail {
+
+struct sample {
+    lib::atomic<int>    ready;
+    char const *        stage;
+    int                 depth;
+    void *              pcs[max_depth];
+};
+
+/// Profiler state shared with the signal handler
+/**
+ * samples and capacity are published with release ordering before running is
+ * set, and read with acquire ordering by the handler. in_handler counts the
+ * handlers currently executing so start() can wait for those of a previous
+ * run before replacing the buffer.
+ */
+struct state {
+    state() : samples(NULL), capacity(0), next(0), dropped(0), running(false),
+        in_handler(0), period_us(0) {}
+
+    lib::atomic<sample *>   samples;
+    lib::atomic<size_t>     capacity;
+    lib::atomic<size_t>     next;
+    lib::atomic<uint64_t>   dropped;
+    lib::atomic<bool>       running;
+    lib::atomic<int>        in_handler;
+    unsigned int            period_us;
+#ifdef _WEBSOCKETPP_PROFILER_SIGPROF_
+    struct sigaction        old_action;
+#endif
+};
+
+inline state & get_state() {
+    static state s;
+    return s;
+}
+
+/// Largest distance followed from one frame to its caller's
+static uintptr_t const max_frame_size = 1024 * 1024;
+
+/// Record the interrupted call stack by following saved frame pointers
+/**
+ * Starts from the registers saved in the signal context, so the handler and
+ * the signal trampoline are not part of the stack. Each frame holds the
+ * caller's frame pointer followed by the return address. A frame pointer
+ * must lie above the previous one and within max_frame_size of it, so a
+ * register holding other data ends the walk rather than faulting.
+ *
+ * Reads stack words that may not belong to any live object, so it is
+ * excluded from AddressSanitizer.
+ *
+ * @param context The ucontext_t passed to the SA_SIGINFO handler
+ * @param pcs Receives the interrupted program counter, then return addresses
+ * @return The number of addresses written
+ */
+#ifdef _WEBSOCKETPP_PROFILER_STACKS_
+__attribute__((no_sanitize_address))
+inline int walk_stack(void * context, void ** pcs) {
+    ucontext_t const * uc = static_cast<ucontext_t const *>(context);
+#if defined(__x86_64__)
+    uintptr_t pc = uc->uc_mcontext.gregs[REG_RIP];
+    uintptr_t fp = uc->uc_mcontext.gregs[REG_RBP];
+    uintptr_t sp = uc->uc_mcontext.gregs[REG_RSP];
+#else
+    uintptr_t pc = uc->uc_mcontext.pc;
+    uintptr_t fp = uc->uc_mcontext.regs[29];
+    uintptr_t sp = uc->uc_mcontext.sp;
+#endif
+
+    int n = 0;
+    pcs[n++] = reinterpret_cast<void *>(pc);
+
+    uintptr_t low = sp;
+    while (n < static_cast<int>(max_depth)) {
+        if (fp < low || fp - low > max_frame_size ||
+            fp % sizeof(uintptr_t) != 0)
+        {
+            break;
+        }
+
+        uintptr_t const * frame = reinterpret_cast<uintptr_t const *>(fp);
+        if (frame[1] == 0) {
+            break;
+        }
+        pcs[n++] = reinterpret_cast<void *>(frame[1]);
+
+        // callers' frames are above the callee's, the stack grows down
+        low = fp + 2 * sizeof(uintptr_t);
+        fp = frame[0];
+    }
+    return n;
+}
+#else
+// no known register layout, samples only carry their stage
+inline int walk_stack(void *, void **) {
+    return 0;
+}
+#endif
+
+#ifdef _WEBSOCKETPP_PROFILER_SIGPROF_
+inline void handle_sigprof(int, siginfo_t *, void * context) {
+    int saved_errno = errno;
+    state & s = get_state();
+
+    // Registered before running is checked, so start() either waits for this
+    // handler or this handler sees the profiler stopped.
+    s.in_handler.fetch_add(1,lib::memory_order_seq_cst);
+    if (s.running.load(lib::memory_order_seq_cst)) {
+        sample * samples = s.samples.load(lib::memory_order_acquire);
+        size_t capacity = s.capacity.load(lib::memory_order_acquire);
+        size_t i = s.next.fetch_add(1,lib::memory_order_relaxed);
+        if (i < capacity) {
+            sample & smp = samples[i];
+            smp.stage = get_stage();
+            smp.depth = walk_stack(context,smp.pcs);
+            smp.ready.store(1,lib::memory_order_release);
+        } else {
+            s.dropped.fetch_add(1,lib::memory_order_relaxed);
+        }
+    }
+    s.in_handler.fetch_sub(1,lib::memory_order_release);
+
+    errno = saved_errno;
+}
+#endif
+
+inline bool same_stage(char const * a, char const * b) {
+    return a == b || (a && b && strcmp(a,b) == 0);
+}
+
+inline void write_word(std::ostream & out, uintptr_t word) {
+    out.write(reinterpret_cast<char const *>(&word),sizeof(word));
+}
+
+} // namespace detail
+
+/// Start sampling
+/**
+ * Samples already recorded are kept; call reset() to discard them.
+ *
+ * @param hz Samples per second of CPU time
+ * @param capacity Maximum number of samples kept, allocated here. Samples
+ * beyond it are counted by get_dropped() and otherwise ignored.
+ * @return false if the profiler was already running or the timer could not
+ * be set up
+ */
+inline bool start(unsigned int hz = 100, size_t capacity = 100000) {
+#ifdef _WEBSOCKETPP_PROFILER_SIGPROF_
+    detail::state & s = detail::get_state();
+    if (s.running.load() || hz == 0) {
+        return false;
+    }
+
+    if (capacity != s.capacity.load(lib::memory_order_relaxed)) {
+        // A handler of the previous run may still be recording on another
+        // thread. New handlers see running false and leave the buffer alone.
+        while (s.in_handler.load(lib::memory_order_seq_cst) != 0) {
+            sched_yield();
+        }
+
+        detail::sample * samples = new detail::sample[capacity];
+        for (size_t i = 0; i < capacity; ++i) {
+            samples[i].ready.store(0);
+        }
+        delete[] s.samples.load(lib::memory_order_relaxed);
+        s.next.store(0);
+        s.samples.store(samples,lib::memory_order_release);
+        s.capacity.store(capacity,lib::memory_order_release);
+    }
+
+    struct sigaction action;
+    memset(&action,0,sizeof(action));
+    action.sa_sigaction = &detail::handle_sigprof;
+    action.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF,&action,&s.old_action) != 0) {
+        return false;
+    }
+
+    s.period_us = 1000000 / hz;
+    s.running.store(true);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = s.period_us / 1000000;
+    timer.it_interval.tv_usec = s.period_us % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF,&timer,NULL) != 0) {
+        s.running.store(false);
+        sigaction(SIGPROF,&s.old_action,NULL);
+        return false;
+    }
+    return true;
+#else
+    (void)hz;
+    (void)capacity;
+    return false;
+#endif
+}
+
+/// Stop sampling and restore the previous SIGPROF handler
+inline void stop() {
+#ifdef _WEBSOCKETPP_PROFILER_SIGPROF_
+    detail::state & s = detail::get_state();
+    if (!s.running.load()) {
+        return;
+    }
+
+    struct itimerval timer;
+    memset(&timer,0,sizeof(timer));
+    setitimer(ITIMER_PROF,&timer,NULL);
+    s.running.store(false);
+    sigaction(SIGPROF,&s.old_action,NULL);
+#endif
+}
+
+/// Whether the profiler is running
+inline bool is_running() {
+    return detail::get_state().running.load();
+}
+
+/// Discard all recorded samples
+/**
+ * Should be called while stopped; a sample being recorded concurrently may
+ * otherwise survive the reset.
+ */
+inline void reset() {
+    detail::state & s = detail::get_state();
+    detail::sample * samples = s.samples.load(lib::memory_order_acquire);
+    size_t capacity = s.capacity.load(lib::memory_order_acquire);
+    size_t used = s.next.load();
+    for (size_t i = 0; i < used && i < capacity; ++i) {
+        samples[i].ready.store(0);
+    }
+    s.next.store(0);
+    s.dropped.store(0);
+}
+
+/// Number of samples recorded and kept
+inline size_t get_sample_count() {
+    detail::state & s = detail::get_state();
+    size_t capacity = s.capacity.load(lib::memory_order_acquire);
+    size_t used = s.next.load();
+    return (used < capacity ? used : capacity);
+}
+
+/// Number of samples discarded because the buffer was full
+inline uint64_t get_dropped() {
+    return detail::get_state().dropped.load();
+}
+
+/// Write the samples in the gperftools CPU profile format
+/**
+ * The output is the binary profile followed by the process memory map, as
+ * expected by `pprof <binary> <file>`. Can be called while running.
+ *
+ * @param out The stream to write to, opened in binary mode
+ * @param stage Only include samples taken in this stage. NULL includes all
+ * samples.
+ */
+inline void write_pprof(std::ostream & out, char const * stage = NULL) {
+    detail::state & s = detail::get_state();
+
+    typedef std::map<std::vector<uintptr_t>,uint64_t> stack_map;
+    stack_map stacks;
+
+    detail::sample const * samples = s.samples.load(lib::memory_order_acquire);
+    size_t used = get_sample_count();
+    for (size_t i = 0; i < used; ++i) {
+        detail::sample const & smp = samples[i];
+        if (!smp.ready.load(lib::memory_order_acquire)) {
+            continue;
+        }
+        if (stage && !detail::same_stage(stage,smp.stage)) {
+            continue;
+        }
+        std::vector<uintptr_t> stack(smp.depth);
+        for (int j = 0; j < smp.depth; ++j) {
+            stack[j] = reinterpret_cast<uintptr_t>(smp.pcs[j]);
+        }
+        stacks[stack]++;
+    }
+
+    // header: header count, header words, version, period, padding
+    detail::write_word(out,0);
+    detail::write_word(out,3);
+    detail::write_word(out,0);
+    detail::write_word(out,s.period_us ? s.period_us : 10000);
+    detail::write_word(out,0);
+
+    stack_map::const_iterator it;
+    for (it = stacks.begin(); it != stacks.end(); ++it) {
+        detail::write_word(out,static_cast<uintptr_t>(it->second));
+        detail::write_word(out,it->first.size());
+        for (size_t j = 0; j < it->first.size(); ++j) {
+            detail::write_word(out,it->first[j]);
+        }
+    }
+
+    // trailer
+    detail::write_word(out,0);
+    detail::write_word(out,1);
+    detail::write_word(out,0);
+
+    std::ifstream maps("/proc/self/maps");
+    out << maps.rdbuf();
+}
+
+/// Return the samples in the gperftools CPU profile format
+/**
+ * @see write_pprof
+ */
+inline std::string get_pprof(char const * stage = NULL) {
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    write_pprof(out,stage);
+    return out.str();
+}
+
+/// Write the number of samples taken in each stage, one per line
+/**
+ * Samples taken outside any stage_scope are listed as `-`.
+ */
+inline void write_stage_summary(std::ostream & out) {
+    detail::state & s = detail::get_state();
+
+    std::map<std::string,uint64_t> counts;
+    detail::sample const * samples = s.samples.load(lib::memory_order_acquire);
+    size_t used = get_sample_count();
+    for (size_t i = 0; i < used; ++i) {
+        detail::sample const & smp = samples[i];
+        if (smp.ready.load(lib::memory_order_acquire)) {
+            counts[smp.stage ? smp.stage : "-"]++;
+        }
+    }
+
+    std::map<std::string,uint64_t>::const_iterator it;
+    for (it = counts.begin(); it != counts.end(); ++it) {
+        out << it->first << " " << it->second << "\n";
+    }
+}
+
+} // namespace profiler
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_PROFILER_HPP
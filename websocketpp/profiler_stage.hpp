@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_PROFILER_STAGE_HPP
+#define WEBSOCKETPP_PROFILER_STAGE_HPP
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/cpp11.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace profiler {
+
+namespace detail {
+
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_TOKEN_
+/// Stage of the calling thread
+/**
+ * Volatile because it is read from the signal handler; the compiler would
+ * otherwise drop a store that a stage_scope destructor overwrites.
+ */
+inline char const * volatile & stage_slot() {
+    static _WEBSOCKETPP_THREAD_LOCAL_TOKEN_ char const * volatile stage = NULL;
+    return stage;
+}
+#endif
+
+} // namespace detail
+
+/// Attributes the samples of the current thread to a stage while in scope
+/**
+ * Stage names are stored by pointer and must outlive the profile, string
+ * literals are the intended use. Scopes nest; the innermost one wins. A NULL
+ * stage leaves the current one in place.
+ *
+ * This header is portable and does not depend on the sampler in profiler.hpp.
+ * Where the compiler has no thread local storage the scope does nothing.
+ */
+class stage_scope {
+public:
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_TOKEN_
+    explicit stage_scope(char const * stage)
+      : m_previous(NULL)
+      , m_active(stage != NULL)
+    {
+        if (m_active) {
+            m_previous = detail::stage_slot();
+            detail::stage_slot() = stage;
+            lib::atomic_signal_fence(lib::memory_order_seq_cst);
+        }
+    }
+
+    ~stage_scope() {
+        if (m_active) {
+            lib::atomic_signal_fence(lib::memory_order_seq_cst);
+            detail::stage_slot() = m_previous;
+        }
+    }
+#else
+    explicit stage_scope(char const *) {}
+#endif
+private:
+    stage_scope(stage_scope const &);
+    stage_scope & operator=(stage_scope const &);
+
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_TOKEN_
+    char const * m_previous;
+    bool m_active;
+#endif
+};
+
+/// A stage_scope that is compiled out unless enabled is true
+/**
+ * Used by the library for its own marks, with the config's
+ * enable_profiler_stages setting as the argument.
+ */
+template <bool enabled>
+class conditional_stage_scope : public stage_scope {
+public:
+    explicit conditional_stage_scope(char const * stage)
+      : stage_scope(stage) {}
+};
+
+/// Disabled stage marks hold no state and do nothing
+template <>
+class conditional_stage_scope<false> {
+public:
+    explicit conditional_stage_scope(char const *) {}
+};
+
+/// Stage the calling thread is in, or NULL
+inline char const * get_stage() {
+#ifdef _WEBSOCKETPP_THREAD_LOCAL_TOKEN_
+    return detail::stage_slot();
+#else
+    return NULL;
+#endif
+}
+
+} // namespace profiler
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_PROFILER_STAGE_HPP
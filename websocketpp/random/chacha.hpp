@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef WEBSOCKETPP_RANDOM_CHACHA_HPP
+#define WEBSOCKETPP_RANDOM_CHACHA_HPP
+
+#include <websocketpp/common/random.hpp>
+#include <websocketpp/common/stdint.hpp>
+
+#include <cstddef>
+
+namespace websocketpp {
+namespace random {
+/// RNG policy based on the ChaCha20 stream cipher
+namespace chacha {
+
+/// Thread safe cryptographically secure random integer generator.
+/**
+ * This template class produces random integers from the ChaCha20 keystream.
+ * The engine is keyed once, at construction, from websocketpp::lib's
+ * random_device; each number after that is read from a buffered keystream
+ * block, so the random device is no longer hit for every frame. Numbers are
+ * produced in a uniformly distributed range from the smallest to largest
+ * value that int_type can store.
+ *
+ * Like random_device::int_generator, which it can replace as a config's
+ * rng_type, it is owned by the endpoint and shared by its connections.
+ * Thread-safety is provided via locking based on the concurrency template
+ * parameter; the lock is held only while a value is taken from the buffer
+ * or, once every 16 words, while the next block is computed.
+ *
+ * Call operator() to generate the next number
+ */
+template <typename int_type, typename concurrency>
+class int_generator {
+    public:
+        typedef typename concurrency::scoped_lock_type scoped_lock_type;
+        typedef typename concurrency::mutex_type mutex_type;
+
+        /// constructor
+        /**
+         * Reads a 256 bit key and a 64 bit nonce from the random device.
+         */
+        int_generator() : m_pos(block_words) {
+            lib::random_device dev;
+
+            // "expand 32-byte k"
+            m_state[0] = 0x61707865;
+            m_state[1] = 0x3320646e;
+            m_state[2] = 0x79622d32;
+            m_state[3] = 0x6b206574;
+            for (int i = 4; i < 12; ++i) {
+                m_state[i] = static_cast<uint32_t>(dev());
+            }
+            m_state[12] = 0;
+            m_state[13] = 0;
+            m_state[14] = static_cast<uint32_t>(dev());
+            m_state[15] = static_cast<uint32_t>(dev());
+        }
+
+        /// advances the engine's state and returns the generated value
+        int_type operator()() {
+            scoped_lock_type guard(m_lock);
+
+            int_type value = 0;
+            for (size_t i = 0; i < (sizeof(int_type)+3)/4; ++i) {
+                if (m_pos == block_words) {
+                    next_block();
+                }
+                // two 16 bit shifts, as a 32 bit shift of a 32 bit
+                // int_type would be undefined
+                value = static_cast<int_type>((value << 16) << 16)
+                      | static_cast<int_type>(m_block[m_pos++]);
+            }
+            return value;
+        }
+    private:
+        static size_t const block_words = 16;
+
+        static uint32_t rotl(uint32_t v, int n) {
+            return (v << n) | (v >> (32 - n));
+        }
+
+        static void quarter_round(uint32_t * x, int a, int b, int c, int d) {
+            x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+            x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+            x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+            x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+        }
+
+        /// Compute the next keystream block into m_block
+        void next_block() {
+            uint32_t x[block_words];
+            for (size_t i = 0; i < block_words; ++i) {
+                x[i] = m_state[i];
+            }
+
+            for (int i = 0; i < 10; ++i) {
+                quarter_round(x, 0, 4,  8, 12);
+                quarter_round(x, 1, 5,  9, 13);
+                quarter_round(x, 2, 6, 10, 14);
+                quarter_round(x, 3, 7, 11, 15);
+                quarter_round(x, 0, 5, 10, 15);
+                quarter_round(x, 1, 6, 11, 12);
+                quarter_round(x, 2, 7,  8, 13);
+                quarter_round(x, 3, 4,  9, 14);
+            }
+
+            for (size_t i = 0; i < block_words; ++i) {
+                m_block[i] = x[i] + m_state[i];
+            }
+
+            // 64 bit block counter
+            if (++m_state[12] == 0) {
+                ++m_state[13];
+            }
+            m_pos = 0;
+        }
+
+        uint32_t m_state[block_words];
+        uint32_t m_block[block_words];
+        size_t m_pos;
+
+        mutex_type m_lock;
+};
+
+} // namespace chacha
+} // namespace random
+} // namespace websocketpp
+
+#endif //WEBSOCKETPP_RANDOM_CHACHA_HPP
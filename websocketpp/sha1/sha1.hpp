@@ -36,6 +36,16 @@ under the same license as the original, which is listed below.
 #ifndef SHA1_DEFINED
 #define SHA1_DEFINED
 
+// Use the x86 SHA extensions when the compiler targets them (for example
+// -msha -msse4.1 or -march=native on a CPU that has them). This is decided at
+// compile time. Define WEBSOCKETPP_NO_SHA_EXTENSIONS to always use the
+// portable implementation.
+#if !defined(WEBSOCKETPP_NO_SHA_EXTENSIONS) && defined(__SHA__) \
+    && defined(__SSSE3__) && defined(__SSE4_1__)
+    #include <immintrin.h>
+    #define _WEBSOCKETPP_SHA1_SHANI_
+#endif
+
 namespace websocketpp {
 namespace sha1 {
 
@@ -116,6 +126,74 @@ namespace sha1 {
             result[3] += d;
             result[4] += e;
         }
+
+#ifdef _WEBSOCKETPP_SHA1_SHANI_
+        // Same contract as innerHash: w holds the 16 message words of one
+        // block as host order integers. Four rounds per group; each group also
+        // advances the message schedule for the groups that follow.
+        inline void innerHashShani(unsigned int* result, unsigned int* w)
+        {
+            __m128i abcd = _mm_shuffle_epi32(
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(result)), 0x1B);
+            __m128i abcd_save = abcd;
+            __m128i e_save = _mm_set_epi32(static_cast<int>(result[4]), 0, 0, 0);
+            __m128i e[2] = { e_save, _mm_setzero_si128() };
+            __m128i msg[4];
+
+            for (int i = 0; i < 4; ++i) {
+                msg[i] = _mm_shuffle_epi32(_mm_loadu_si128(
+                    reinterpret_cast<__m128i const *>(w + 4 * i)), 0x1B);
+            }
+
+            #define sha1group(g, f) \
+            { \
+                if (g == 0) { \
+                    e[0] = _mm_add_epi32(e[0], msg[0]); \
+                } else { \
+                    e[g & 1] = _mm_sha1nexte_epu32(e[g & 1], msg[g & 3]); \
+                } \
+                e[(g + 1) & 1] = abcd; \
+                if (g >= 3 && g <= 18) { \
+                    msg[(g + 1) & 3] = _mm_sha1msg2_epu32(msg[(g + 1) & 3], \
+                        msg[g & 3]); \
+                } \
+                abcd = _mm_sha1rnds4_epu32(abcd, e[g & 1], f); \
+                if (g >= 1 && g <= 16) { \
+                    msg[(g + 3) & 3] = _mm_sha1msg1_epu32(msg[(g + 3) & 3], \
+                        msg[g & 3]); \
+                } \
+                if (g >= 2 && g <= 17) { \
+                    msg[(g + 2) & 3] = _mm_xor_si128(msg[(g + 2) & 3], \
+                        msg[g & 3]); \
+                } \
+            }
+
+            sha1group(0,0)  sha1group(1,0)  sha1group(2,0)  sha1group(3,0)
+            sha1group(4,0)  sha1group(5,1)  sha1group(6,1)  sha1group(7,1)
+            sha1group(8,1)  sha1group(9,1)  sha1group(10,2) sha1group(11,2)
+            sha1group(12,2) sha1group(13,2) sha1group(14,2) sha1group(15,3)
+            sha1group(16,3) sha1group(17,3) sha1group(18,3) sha1group(19,3)
+
+            #undef sha1group
+
+            e[0] = _mm_sha1nexte_epu32(e[0], e_save);
+            abcd = _mm_add_epi32(abcd, abcd_save);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(result),
+                _mm_shuffle_epi32(abcd, 0x1B));
+            result[4] = static_cast<unsigned int>(_mm_extract_epi32(e[0], 3));
+        }
+#endif
+
+        // Hash one block with the best implementation available
+        inline void hashBlock(unsigned int* result, unsigned int* w)
+        {
+#ifdef _WEBSOCKETPP_SHA1_SHANI_
+            innerHashShani(result, w);
+#else
+            innerHash(result, w);
+#endif
+        }
     } // namespace
 
     /**
@@ -151,7 +229,7 @@ namespace sha1 {
                         | (((unsigned int) sarray[currentBlock + 1]) << 16)
                         | (((unsigned int) sarray[currentBlock]) << 24);
             }
-            innerHash(result, w);
+            hashBlock(result, w);
         }
 
         // Handle the last and not full 64 byte block if existing.
@@ -165,11 +243,11 @@ namespace sha1 {
         w[lastBlockBytes >> 2] |= 0x80 << ((3 - (lastBlockBytes & 3)) << 3);
         if (endCurrentBlock >= 56)
         {
-            innerHash(result, w);
+            hashBlock(result, w);
             clearWBuffert(w);
         }
         w[15] = bytelength << 3;
-        innerHash(result, w);
+        hashBlock(result, w);
 
         // Store hash in result pointer, and make sure we get in in the correct order on both endian models.
         for (int hashByte = 20; --hashByte >= 0;)
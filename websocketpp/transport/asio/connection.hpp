@@ -35,6 +35,7 @@
 #include <websocketpp/logger/levels.hpp>
 #include <websocketpp/http/constants.hpp>
 #include <websocketpp/transport/asio/base.hpp>
+#include <websocketpp/transport/asio/timer_wheel.hpp>
 #include <websocketpp/transport/base/connection.hpp>
 
 #include <websocketpp/base64/base64.hpp>
@@ -86,6 +87,8 @@ public:
     typedef lib::shared_ptr<boost::asio::io_service::strand> strand_ptr;
     /// Type of a pointer to the ASIO timer class
     typedef lib::shared_ptr<boost::asio::deadline_timer> timer_ptr;
+    /// Type of a pointer to a coarse timeout on the io_service's timer wheel
+    typedef wheel_timer::ptr timeout_ptr;
 
     // connection is friends with its associated endpoint to allow the endpoint
     // to call private/protected utility methods that we don't want to expose
@@ -97,6 +100,7 @@ public:
       : m_is_server(is_server)
       , m_alog(alog)
       , m_elog(elog)
+      , m_timer_wheel(NULL)
     {
         m_alog.write(log::alevel::devel,"asio con transport constructor");
     }
@@ -323,11 +327,10 @@ public:
      *
      * TODO: candidate for protected status
      *
-     * @param t Pointer to the timer in question
      * @param callback The function to call back
      * @param ec The status code
      */
-    void handle_timer(timer_ptr t, timer_handler callback,
+    void handle_timer(timer_ptr, timer_handler callback,
         boost::system::error_code const & ec)
     {
         if (ec) {
@@ -341,6 +344,33 @@ public:
             callback(lib::error_code());
         }
     }
+
+    /// Call back a function after a period of time, at coarse resolution
+    /**
+     * Like set_timer, but the timeout is kept on the timer wheel shared by
+     * every connection on the io_service rather than in its own asio timer.
+     * Arming and cancelling are constant time. The callback runs up to two
+     * ticks (config::timer_wheel_resolution) late and never early. Intended
+     * for timeouts that are expected to be cancelled, like handshake and pong
+     * timeouts.
+     *
+     * A cancelled timeout will return the error code error::operation_aborted
+     * A timeout that expired will return no error.
+     *
+     * @param duration Length of time to wait in milliseconds
+     *
+     * @param callback The function to call back when the timeout has expired
+     *
+     * @return A handle that can be used to cancel the timeout if it is no
+     * longer needed.
+     */
+    timeout_ptr set_timeout(long duration, timer_handler callback) {
+        if (config::enable_multithreading) {
+            return m_timer_wheel->schedule(duration,m_strand->wrap(callback));
+        } else {
+            return m_timer_wheel->schedule(duration,callback);
+        }
+    }
 protected:
     /// Get a pointer to this connection's strand
     strand_ptr get_strand() {
@@ -418,6 +448,9 @@ protected:
     lib::error_code init_asio (io_service_ptr io_service) {
         m_io_service = io_service;
 
+        m_timer_wheel = &boost::asio::use_service<timer_wheel>(*io_service);
+        m_timer_wheel->set_resolution(config::timer_wheel_resolution);
+
         if (config::enable_multithreading) {
             m_strand.reset(new boost::asio::strand(*io_service));
 
@@ -574,7 +607,7 @@ protected:
         m_alog.write(log::alevel::devel,m_proxy_data->write_buf);
 
         // Set a timer so we don't wait forever for the proxy to respond
-        m_proxy_data->timer = this->set_timer(
+        m_proxy_data->timer = this->set_timeout(
             m_proxy_data->timeout_proxy,
             lib::bind(
                 &type::handle_proxy_timeout,
@@ -639,7 +672,7 @@ protected:
         // Whatever aborted it will be issuing the callback so we are safe to
         // return
         if (ec == boost::asio::error::operation_aborted ||
-            m_proxy_data->timer->expires_from_now().is_negative())
+            m_proxy_data->timer->expired())
         {
             m_elog.write(log::elevel::devel,"write operation aborted");
             return;
@@ -705,7 +738,7 @@ protected:
         // Whatever aborted it will be issuing the callback so we are safe to
         // return
         if (ec == boost::asio::error::operation_aborted ||
-            m_proxy_data->timer->expires_from_now().is_negative())
+            m_proxy_data->timer->expired())
         {
             m_elog.write(log::elevel::devel,"read operation aborted");
             return;
@@ -1089,7 +1122,7 @@ private:
         std::string write_buf;
         boost::asio::streambuf read_buf;
         long timeout_proxy;
-        timer_ptr timer;
+        timeout_ptr timer;
     };
 
     std::string m_proxy;
@@ -1098,6 +1131,7 @@ private:
     // transport resources
     io_service_ptr  m_io_service;
     strand_ptr      m_strand;
+    timer_wheel *   m_timer_wheel;
     connection_hdl  m_connection_hdl;
 
     std::vector<boost::asio::const_buffer> m_bufs;
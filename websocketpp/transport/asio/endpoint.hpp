@@ -92,6 +92,7 @@ public:
       : m_external_io_service(false)
       , m_listen_backlog(0)
       , m_reuse_addr(false)
+      , m_reuse_port(false)
       , m_state(UNINITIALIZED)
     {
         //std::cout << "transport::asio::endpoint constructor" << std::endl;
@@ -125,6 +126,7 @@ public:
       , m_acceptor(src.m_acceptor)
       , m_listen_backlog(boost::asio::socket_base::max_connections)
       , m_reuse_addr(src.m_reuse_addr)
+      , m_reuse_port(src.m_reuse_port)
       , m_state(src.m_state)
     {
         src.m_io_service = NULL;
@@ -140,6 +142,7 @@ public:
             m_acceptor = rhs.m_acceptor;
             m_listen_backlog = rhs.m_listen_backlog;
             m_reuse_addr = rhs.m_reuse_addr;
+            m_reuse_port = rhs.m_reuse_port;
             m_state = rhs.m_state;
 
             rhs.m_io_service = NULL;
@@ -309,6 +312,29 @@ public:
         m_reuse_addr = value;
     }
 
+    /// Sets whether or not to use the SO_REUSEPORT flag when opening a listening socket
+    /**
+     * With SO_REUSEPORT several listening sockets may bind the same address
+     * and port, and the kernel spreads incoming connections across them. This
+     * lets a server scale across cores without sharing an io_service: run one
+     * endpoint per thread, each initialized with its own io_service and each
+     * listening on the same port with this option set. Every connection is
+     * then accepted, read, written and closed on the thread whose endpoint
+     * accepted it, with no strands or cross-thread handler dispatch.
+     *
+     * Listening fails with an asio operation_not_supported error on platforms
+     * that do not define SO_REUSEPORT.
+     *
+     * New values affect future calls to listen only.
+     *
+     * The default is false.
+     *
+     * @param value Whether or not to use the SO_REUSEPORT option
+     */
+    void set_reuse_port(bool value) {
+        m_reuse_port = value;
+    }
+
     /// Retrieve a reference to the endpoint's io_service
     /**
      * The io_service may be an internal or external one. This may be used to
@@ -350,6 +376,15 @@ public:
         if (!bec) {
             m_acceptor->set_option(boost::asio::socket_base::reuse_address(m_reuse_addr),bec);
         }
+        if (!bec && m_reuse_port) {
+#ifdef SO_REUSEPORT
+            typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET,
+                SO_REUSEPORT> reuse_port;
+            m_acceptor->set_option(reuse_port(true),bec);
+#else
+            bec = boost::asio::error::operation_not_supported;
+#endif
+        }
         if (!bec) {
             m_acceptor->bind(ep,bec);
         }
@@ -1059,6 +1094,7 @@ private:
     // Network constants
     int                 m_listen_backlog;
     bool                m_reuse_addr;
+    bool                m_reuse_port;
 
     elog_type* m_elog;
     alog_type* m_alog;
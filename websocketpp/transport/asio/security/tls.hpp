@@ -32,13 +32,19 @@
 #include <websocketpp/common/connection_hdl.hpp>
 #include <websocketpp/common/functional.hpp>
 #include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/system/error_code.hpp>
 
+#include <ctime>
 #include <iostream>
+#include <list>
+#include <map>
+#include <sstream>
 #include <string>
+#include <utility>
 
 namespace websocketpp {
 namespace transport {
@@ -54,6 +60,158 @@ typedef lib::function<void(connection_hdl,boost::asio::ssl::stream<
 typedef lib::function<lib::shared_ptr<boost::asio::ssl::context>(connection_hdl)>
     tls_init_handler;
 
+/// Shared cache of TLS sessions for abbreviated handshakes
+/**
+ * A session cache lets connections resume a previously negotiated TLS session
+ * instead of running a full handshake, which skips the public key operations
+ * that dominate handshake cost. One cache is shared by all of the connections
+ * of an endpoint and is safe to use from multiple threads.
+ *
+ * Client endpoints key sessions by the address and port of the server. Server
+ * endpoints key them by session ID. Once full, the least recently used session
+ * is evicted. Sessions past their OpenSSL timeout are never handed out.
+ */
+class session_cache {
+public:
+    /// Type of a shared pointer to a session cache
+    typedef lib::shared_ptr<session_cache> ptr;
+
+    /// Construct a cache that holds at most max_size sessions
+    explicit session_cache(size_t max_size) : m_max_size(max_size) {}
+
+    ~session_cache() {
+        clear();
+    }
+
+    /// Set the maximum number of sessions kept
+    /**
+     * Shrinking the cache evicts the least recently used sessions.
+     *
+     * @param max_size The new maximum number of sessions
+     */
+    void set_max_size(size_t max_size) {
+        scoped_lock_type lock(m_lock);
+        m_max_size = max_size;
+        trim();
+    }
+
+    /// Get the maximum number of sessions kept
+    size_t get_max_size() const {
+        scoped_lock_type lock(m_lock);
+        return m_max_size;
+    }
+
+    /// Get the number of sessions currently kept
+    size_t size() const {
+        scoped_lock_type lock(m_lock);
+        return m_index.size();
+    }
+
+    /// Store a session
+    /**
+     * Any session already stored under the same key is replaced.
+     *
+     * @param key The key to store the session under
+     * @param session The session. The cache takes over one reference to it.
+     */
+    void put(std::string const & key, SSL_SESSION * session) {
+        scoped_lock_type lock(m_lock);
+
+        index_type::iterator it = m_index.find(key);
+        if (it != m_index.end()) {
+            SSL_SESSION_free(it->second->second);
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+
+        m_lru.push_front(entry_type(key,session));
+        m_index[key] = m_lru.begin();
+        trim();
+    }
+
+    /// Look up a session
+    /**
+     * @param key The key the session was stored under
+     * @return The session with a new reference that the caller must release
+     * with SSL_SESSION_free, or NULL if there is no unexpired session for key.
+     */
+    SSL_SESSION * get(std::string const & key) {
+        scoped_lock_type lock(m_lock);
+
+        index_type::iterator it = m_index.find(key);
+        if (it == m_index.end()) {
+            return NULL;
+        }
+
+        SSL_SESSION * session = it->second->second;
+        if (SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session)
+            < static_cast<long>(std::time(NULL)))
+        {
+            SSL_SESSION_free(session);
+            m_lru.erase(it->second);
+            m_index.erase(it);
+            return NULL;
+        }
+
+        m_lru.splice(m_lru.begin(),m_lru,it->second);
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+        CRYPTO_add(&session->references,1,CRYPTO_LOCK_SSL_SESSION);
+#else
+        SSL_SESSION_up_ref(session);
+#endif
+        return session;
+    }
+
+    /// Remove a session
+    /**
+     * @param key The key the session was stored under
+     */
+    void erase(std::string const & key) {
+        scoped_lock_type lock(m_lock);
+
+        index_type::iterator it = m_index.find(key);
+        if (it != m_index.end()) {
+            SSL_SESSION_free(it->second->second);
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+    }
+
+    /// Remove all sessions
+    void clear() {
+        scoped_lock_type lock(m_lock);
+
+        for (lru_type::iterator it = m_lru.begin(); it != m_lru.end(); ++it) {
+            SSL_SESSION_free(it->second);
+        }
+        m_lru.clear();
+        m_index.clear();
+    }
+private:
+    typedef lib::lock_guard<lib::mutex> scoped_lock_type;
+    typedef std::pair<std::string,SSL_SESSION *> entry_type;
+    typedef std::list<entry_type> lru_type;
+    typedef std::map<std::string,lru_type::iterator> index_type;
+
+    // non-copyable
+    session_cache(session_cache const &);
+    session_cache & operator=(session_cache const &);
+
+    // must be called with m_lock held
+    void trim() {
+        while (m_index.size() > m_max_size) {
+            SSL_SESSION_free(m_lru.back().second);
+            m_index.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+    }
+
+    mutable lib::mutex  m_lock;
+    lru_type            m_lru;
+    index_type          m_index;
+    size_t              m_max_size;
+};
+
 /// TLS enabled Boost ASIO connection socket component
 /**
  * transport::asio::tls_socket::connection implements a secure connection socket
@@ -146,6 +304,17 @@ public:
         m_tls_init_handler = h;
     }
 
+    /// Set the session cache used to resume TLS sessions
+    /**
+     * Must be set before the connection is initialized. An empty pointer
+     * disables resumption through the cache.
+     *
+     * @param cache The cache to use
+     */
+    void set_session_cache(session_cache::ptr cache) {
+        m_session_cache = cache;
+    }
+
     /// Get the remote endpoint address
     /**
      * The iostream transport has no information about the ultimate remote
@@ -200,6 +369,10 @@ protected:
         m_strand = strand;
         m_is_server = is_server;
 
+        if (m_session_cache) {
+            init_session_cache();
+        }
+
         return lib::error_code();
     }
 
@@ -231,6 +404,10 @@ protected:
     void post_init(init_handler callback) {
         m_ec = socket::make_error_code(socket::error::tls_handshake_timeout);
 
+        if (m_session_cache && !m_is_server) {
+            resume_session();
+        }
+
         // TLS handshake
         if (m_strand) {
             m_socket->async_handshake(
@@ -319,6 +496,152 @@ protected:
         }
     }
 private:
+    /// Index of the SSL ex_data slot that points back at the connection
+    static int get_ex_index() {
+        static int index = SSL_get_ex_new_index(0,NULL,NULL,NULL,NULL);
+        return index;
+    }
+
+    /// Index of the SSL_CTX ex_data slot that records the cache setup
+    static int get_ctx_ex_index() {
+        static int index = SSL_CTX_get_ex_new_index(0,NULL,NULL,NULL,NULL);
+        return index;
+    }
+
+    /// Route new and resumed sessions through the shared cache
+    /**
+     * The callbacks are installed on the context returned by the tls init
+     * handler and find the cache through the SSL object, so contexts may be
+     * shared between endpoints.
+     *
+     * Contexts may differ in certificates and verification settings, so a
+     * session is only resumed through the context that established it. Each
+     * context gets an ID that is part of the session ID context and of every
+     * key it stores in the cache. A tls init handler that creates a context
+     * per connection therefore gets no resumption.
+     */
+    void init_session_cache() {
+        SSL_CTX * ctx = m_context->native_handle();
+        SSL * ssl = m_socket->native_handle();
+
+        SSL_set_ex_data(ssl,get_ex_index(),this);
+        m_context_key = init_context(ctx);
+
+        if (m_is_server) {
+            // Ticket keys belong to a single context. Resuming by session ID
+            // works no matter how the tls init handler hands out contexts.
+            SSL_set_options(ssl,SSL_OP_NO_TICKET);
+
+            SSL_set_session_id_context(ssl,
+                reinterpret_cast<unsigned char const *>(m_context_key.data()),
+                m_context_key.size());
+        }
+    }
+
+    /// Set a context up for the cache the first time it is seen
+    /**
+     * Installs the callbacks and the cache mode once per context and role
+     * rather than once per connection. A context shared by a server and a
+     * client endpoint ends up with both modes. The context's ex_data slot
+     * holds its ID, shifted past the two role flags.
+     *
+     * @param ctx The context
+     * @return The ID of the context, as a cache key prefix
+     */
+    std::string init_context(SSL_CTX * ctx) {
+        static lib::mutex lock;
+        static size_t next_id = 0;
+        lib::lock_guard<lib::mutex> guard(lock);
+
+        size_t const role = m_is_server ? 1 : 2;
+        size_t state = reinterpret_cast<size_t>(
+            SSL_CTX_get_ex_data(ctx,get_ctx_ex_index()));
+
+        if (!(state & role)) {
+            long mode = SSL_SESS_CACHE_OFF;
+            if (state == 0) {
+                state = ++next_id << 2;
+            } else {
+                mode = SSL_CTX_get_session_cache_mode(ctx);
+            }
+
+            SSL_CTX_sess_set_new_cb(ctx,&type::on_new_session);
+            if (m_is_server) {
+                mode |= SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL;
+                SSL_CTX_sess_set_get_cb(ctx,&type::on_get_session);
+            } else {
+                mode |= SSL_SESS_CACHE_CLIENT |
+                    SSL_SESS_CACHE_NO_INTERNAL_STORE;
+            }
+            SSL_CTX_set_session_cache_mode(ctx,mode);
+
+            state |= role;
+            SSL_CTX_set_ex_data(ctx,get_ctx_ex_index(),
+                reinterpret_cast<void *>(state));
+        }
+
+        size_t id = state >> 2;
+        return std::string(reinterpret_cast<char const *>(&id),sizeof(id));
+    }
+
+    /// Offer the server the session cached for its address, if any
+    void resume_session() {
+        std::stringstream s;
+        boost::system::error_code bec;
+        s << get_raw_socket().remote_endpoint(bec);
+        if (bec) {
+            return;
+        }
+        m_session_key = m_context_key + s.str();
+
+        SSL_SESSION * session = m_session_cache->get(m_session_key);
+        if (session) {
+            SSL_set_session(m_socket->native_handle(),session);
+            SSL_SESSION_free(session);
+        }
+    }
+
+    static int on_new_session(SSL * ssl, SSL_SESSION * session) {
+        type * con = static_cast<type *>(SSL_get_ex_data(ssl,get_ex_index()));
+        if (!con || !con->m_session_cache) {
+            return 0;
+        }
+
+        if (con->m_is_server) {
+            unsigned int len;
+            unsigned char const * id = SSL_SESSION_get_id(session,&len);
+            con->m_session_cache->put(con->m_context_key +
+                std::string(reinterpret_cast<char const *>(id),len),session);
+        } else if (!con->m_session_key.empty()) {
+            con->m_session_cache->put(con->m_session_key,session);
+        } else {
+            return 0;
+        }
+
+        // the cache keeps the reference OpenSSL handed us
+        return 1;
+    }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    static SSL_SESSION * on_get_session(SSL * ssl, unsigned char * id,
+        int len, int * copy)
+#else
+    static SSL_SESSION * on_get_session(SSL * ssl, unsigned char const * id,
+        int len, int * copy)
+#endif
+    {
+        // the returned session carries the reference OpenSSL takes over
+        *copy = 0;
+
+        type * con = static_cast<type *>(SSL_get_ex_data(ssl,get_ex_index()));
+        if (!con || !con->m_session_cache) {
+            return NULL;
+        }
+
+        return con->m_session_cache->get(con->m_context_key +
+            std::string(reinterpret_cast<char const *>(id),len));
+    }
+
     socket_type::handshake_type get_handshake_type() {
         if (m_is_server) {
             return boost::asio::ssl::stream_base::server;
@@ -338,6 +661,10 @@ private:
     connection_hdl      m_hdl;
     socket_init_handler m_socket_init_handler;
     tls_init_handler    m_tls_init_handler;
+
+    session_cache::ptr  m_session_cache;
+    std::string         m_context_key;
+    std::string         m_session_key;
 };
 
 /// TLS enabled Boost ASIO endpoint socket component
@@ -390,6 +717,40 @@ public:
     void set_tls_init_handler(tls_init_handler h) {
         m_tls_init_handler = h;
     }
+
+    /// Set the size of the endpoint's TLS session cache
+    /**
+     * With a non-zero size, connections created by this endpoint share a
+     * session cache and reconnecting peers resume their earlier session with
+     * an abbreviated handshake. Clients key cached sessions by server address
+     * and port, servers by session ID. A size of zero, the default, disables
+     * the cache and leaves session handling to the TLS contexts.
+     *
+     * A session is only resumed through the TLS context that established it,
+     * so the tls init handler should return a shared context rather than a
+     * new one per connection.
+     *
+     * Applies to connections created after the call.
+     *
+     * @param size The maximum number of sessions to keep
+     */
+    void set_tls_session_cache_size(size_t size) {
+        if (size == 0) {
+            m_session_cache.reset();
+        } else if (m_session_cache) {
+            m_session_cache->set_max_size(size);
+        } else {
+            m_session_cache.reset(new session_cache(size));
+        }
+    }
+
+    /// Get the endpoint's TLS session cache
+    /**
+     * @return The session cache, or an empty pointer if it is disabled
+     */
+    session_cache::ptr get_tls_session_cache() const {
+        return m_session_cache;
+    }
 protected:
     /// Initialize a connection
     /**
@@ -403,12 +764,14 @@ protected:
     lib::error_code init(socket_con_ptr scon) {
         scon->set_socket_init_handler(m_socket_init_handler);
         scon->set_tls_init_handler(m_tls_init_handler);
+        scon->set_session_cache(m_session_cache);
         return lib::error_code();
     }
 
 private:
     socket_init_handler m_socket_init_handler;
     tls_init_handler m_tls_init_handler;
+    session_cache::ptr m_session_cache;
 };
 
 } // namespace tls_socket
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
+#define WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
+
+#include <websocketpp/transport/base/connection.hpp>
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <boost/asio.hpp>
+
+#include <list>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace asio {
+
+class timer_wheel;
+
+/// A timeout scheduled on a timer_wheel
+/**
+ * Returned by timer_wheel::schedule. The wheel keeps the timeout alive until
+ * it has fired or been cancelled, so callers may drop their handle at any
+ * time.
+ */
+class wheel_timer : public lib::enable_shared_from_this<wheel_timer> {
+public:
+    typedef lib::shared_ptr<wheel_timer> ptr;
+
+    /// Cancel the timeout
+    /**
+     * If the timeout has not fired yet its handler is posted to the
+     * io_service with transport::error::operation_aborted, matching the
+     * behavior of a cancelled asio timer. Otherwise this does nothing.
+     */
+    void cancel();
+
+    /// Whether the timeout has fired
+    /**
+     * @return true once the handler has been dispatched with a success code
+     */
+    bool expired() const;
+private:
+    friend class timer_wheel;
+
+    typedef std::list<ptr>::iterator slot_iterator;
+
+    explicit wheel_timer(timer_wheel & wheel, timer_handler handler)
+      : m_wheel(wheel)
+      , m_handler(handler)
+      , m_rounds(0)
+      , m_slot(0)
+      , m_armed(false)
+      , m_expired(false) {}
+
+    timer_wheel &   m_wheel;
+    timer_handler   m_handler;
+    size_t          m_rounds;
+    size_t          m_slot;
+    slot_iterator   m_pos;
+    bool            m_armed;
+    bool            m_expired;
+};
+
+/// A hashed timer wheel shared by every connection on an io_service
+/**
+ * Connection timeouts (handshakes, pongs, proxies) are long, are almost always
+ * cancelled before they fire, and need no better than coarse resolution.
+ * Arming each of them as a separate asio deadline_timer costs a heap insertion
+ * and removal in the io_service's timer queue per timeout. The wheel instead
+ * keeps timeouts in a ring of slots, one per tick. Scheduling and cancelling
+ * are constant time list operations and a single asio timer drives the ring.
+ * It only runs while timeouts are pending.
+ *
+ * Each timeout is placed in the slot its expiry falls into and given a number
+ * of whole revolutions to wait, so durations longer than one revolution need
+ * no overflow levels. A timeout never fires early; it fires within two ticks
+ * after its duration has elapsed.
+ *
+ * The wheel is an io_service service. `boost::asio::use_service<timer_wheel>`
+ * returns the single instance for an io_service, so endpoints sharing an
+ * io_service share a wheel. The tick length is fixed by the first call to
+ * set_resolution.
+ *
+ * Handlers are called from the thread running the io_service, without any of
+ * the wheel's locks held. Callers that need serialization (a strand) should
+ * wrap their handler before scheduling it.
+ */
+class timer_wheel
+  : public boost::asio::detail::service_base<timer_wheel>
+{
+public:
+    /// Number of slots in the ring
+    static size_t const num_slots = 512;
+
+    /// Tick length used if set_resolution is never called (in ms)
+    static long const default_resolution = 100;
+
+    explicit timer_wheel(boost::asio::io_service & service)
+      : boost::asio::detail::service_base<timer_wheel>(service)
+      , m_timer(service)
+      , m_slots(num_slots)
+      , m_resolution(0)
+      , m_cursor(0)
+      , m_count(0)
+      , m_ticking(false) {}
+
+    /// Set the tick length
+    /**
+     * Only the first call has an effect, later calls are ignored.
+     *
+     * @param ms The tick length in milliseconds
+     */
+    void set_resolution(long ms) {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        if (m_resolution == 0 && ms > 0) {
+            m_resolution = ms;
+        }
+    }
+
+    /// Schedule a handler to be called after a duration
+    /**
+     * @param duration Length of time to wait in milliseconds
+     * @param handler The function to call with the result
+     * @return A handle that can be used to cancel the timeout
+     */
+    wheel_timer::ptr schedule(long duration, timer_handler handler) {
+        wheel_timer::ptr t(new wheel_timer(*this,handler));
+
+        lib::lock_guard<lib::mutex> lock(m_lock);
+
+        if (m_resolution == 0) {
+            m_resolution = default_resolution;
+        }
+
+        // One tick extra because the current tick is already partly over
+        size_t ticks = 1;
+        if (duration > 0) {
+            ticks += static_cast<size_t>(
+                (duration + m_resolution - 1) / m_resolution);
+        }
+
+        t->m_slot = (m_cursor + ticks) % num_slots;
+        t->m_rounds = (ticks - 1) / num_slots;
+        t->m_pos = m_slots[t->m_slot].insert(m_slots[t->m_slot].end(),t);
+        t->m_armed = true;
+        ++m_count;
+
+        if (!m_ticking) {
+            m_ticking = true;
+            m_timer.expires_from_now(
+                boost::posix_time::milliseconds(m_resolution));
+            m_timer.async_wait(lib::bind(
+                &timer_wheel::handle_tick,
+                this,
+                lib::placeholders::_1
+            ));
+        }
+
+        return t;
+    }
+
+    /// Number of timeouts that have neither fired nor been cancelled
+    size_t get_pending() const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return m_count;
+    }
+private:
+    friend class wheel_timer;
+
+    typedef std::list<wheel_timer::ptr> slot_type;
+
+    void shutdown_service() {
+        // Destroy the handlers outside of the lock, they may own
+        // connections whose destructors cancel timeouts.
+        std::vector<slot_type> slots(num_slots);
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            for (size_t i = 0; i < num_slots; ++i) {
+                for (slot_type::iterator it = m_slots[i].begin();
+                     it != m_slots[i].end(); ++it)
+                {
+                    (*it)->m_armed = false;
+                }
+                slots[i].swap(m_slots[i]);
+            }
+            m_count = 0;
+        }
+        for (size_t i = 0; i < num_slots; ++i) {
+            for (slot_type::iterator it = slots[i].begin();
+                 it != slots[i].end(); ++it)
+            {
+                (*it)->m_handler = timer_handler();
+            }
+        }
+    }
+
+    void cancel(wheel_timer & t) {
+        wheel_timer::ptr self;
+        timer_handler handler;
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+            if (!t.m_armed) {
+                return;
+            }
+            t.m_armed = false;
+            self = *t.m_pos;
+            m_slots[t.m_slot].erase(t.m_pos);
+            --m_count;
+            handler.swap(t.m_handler);
+        }
+        get_io_service().post(lib::bind(
+            &timer_wheel::call_handler,
+            handler,
+            make_error_code(transport::error::operation_aborted)
+        ));
+    }
+
+    bool expired(wheel_timer const & t) const {
+        lib::lock_guard<lib::mutex> lock(m_lock);
+        return t.m_expired;
+    }
+
+    void handle_tick(boost::system::error_code const & ec) {
+        if (ec) {
+            // the io_service is shutting down
+            return;
+        }
+
+        slot_type fired;
+        {
+            lib::lock_guard<lib::mutex> lock(m_lock);
+
+            m_cursor = (m_cursor + 1) % num_slots;
+            slot_type & slot = m_slots[m_cursor];
+
+            for (slot_type::iterator it = slot.begin(); it != slot.end();) {
+                if ((*it)->m_rounds > 0) {
+                    --(*it)->m_rounds;
+                    ++it;
+                } else {
+                    (*it)->m_armed = false;
+                    (*it)->m_expired = true;
+                    fired.splice(fired.end(),slot,it++);
+                    --m_count;
+                }
+            }
+
+            if (m_count > 0) {
+                // Measured from the previous expiry so the ring does not drift
+                m_timer.expires_at(m_timer.expires_at() +
+                    boost::posix_time::milliseconds(m_resolution));
+                m_timer.async_wait(lib::bind(
+                    &timer_wheel::handle_tick,
+                    this,
+                    lib::placeholders::_1
+                ));
+            } else {
+                m_ticking = false;
+            }
+        }
+
+        for (slot_type::iterator it = fired.begin(); it != fired.end(); ++it) {
+            timer_handler handler;
+            handler.swap((*it)->m_handler);
+            handler(lib::error_code());
+        }
+    }
+
+    static void call_handler(timer_handler handler, lib::error_code ec) {
+        handler(ec);
+    }
+
+    boost::asio::deadline_timer m_timer;
+    std::vector<slot_type>      m_slots;
+    long                        m_resolution;
+    size_t                      m_cursor;
+    size_t                      m_count;
+    bool                        m_ticking;
+    mutable lib::mutex          m_lock;
+};
+
+inline void wheel_timer::cancel() {
+    m_wheel.cancel(*this);
+}
+
+inline bool wheel_timer::expired() const {
+    return m_wheel.expired(*this);
+}
+
+} // namespace asio
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_ASIO_TIMER_WHEEL_HPP
@@ -93,6 +93,14 @@ namespace websocketpp {
  * disabled. This includes many security features designed to prevent denial of
  * service attacks. Use timer-free transport policies with caution.
  *
+ * **set_timeout**\n
+ * `timeout_ptr set_timeout(long duration, timer_handler handler)`\n
+ * Like set_timer, for timeouts that are expected to be cancelled and only need
+ * coarse resolution: handshake, close, and pong timeouts. A transport may
+ * serve these from a cheaper structure than its precise timers, such as a
+ * timer wheel. The returned handle must support cancel(). Transports without
+ * timer support return an empty pointer.
+ *
  * **get_remote_endpoint**\n
  * `std::string get_remote_endpoint()`\n
  * retrieve address of remote endpoint
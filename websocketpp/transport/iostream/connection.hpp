@@ -69,6 +69,7 @@ public:
     typedef typename concurrency_type::mutex_type mutex_type;
 
     typedef lib::shared_ptr<timer> timer_ptr;
+    typedef lib::shared_ptr<timer> timeout_ptr;
 
     explicit connection(bool is_server, alog_type & alog, elog_type & elog)
       : m_output_stream(NULL)
@@ -307,6 +308,20 @@ public:
     timer_ptr set_timer(long duration, timer_handler handler) {
         return timer_ptr();
     }
+
+    /// Call back a function after a period of time, at coarse resolution
+    /**
+     * Timers are not implemented in this transport. The timeout pointer will
+     * always be empty. The handler will never be called.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back when the timeout has expired
+     * @return A handle that can be used to cancel the timeout if it is no
+     * longer needed.
+     */
+    timeout_ptr set_timeout(long duration, timer_handler handler) {
+        return timeout_ptr();
+    }
 protected:
     /// Initialize the connection transport
     /**
@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_CON_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_CON_HPP
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/logger/levels.hpp>
+
+#include <websocketpp/transport/base/connection.hpp>
+#include <websocketpp/transport/uring/base.hpp>
+#include <websocketpp/transport/uring/service.hpp>
+
+#include <arpa/inet.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+template <typename config>
+class endpoint;
+
+/// uring transport connection component
+/**
+ * Reads and writes are submitted to the ring of the connection's service
+ * straight from and into the buffers handed over by the core connection. All
+ * operations and callbacks run on the thread running the service.
+ */
+template <typename config>
+class connection : public lib::enable_shared_from_this< connection<config> > {
+public:
+    /// Type of this connection transport component
+    typedef connection<config> type;
+    /// Type of a shared pointer to this connection transport component
+    typedef lib::shared_ptr<type> ptr;
+
+    /// transport concurrency policy
+    typedef typename config::concurrency_type concurrency_type;
+    /// Type of this transport's access logging policy
+    typedef typename config::alog_type alog_type;
+    /// Type of this transport's error logging policy
+    typedef typename config::elog_type elog_type;
+
+    /// Type of a pointer to a timer
+    typedef uring::timer_ptr timer_ptr;
+    /// Type of a pointer to a coarse timeout
+    typedef uring::timer_ptr timeout_ptr;
+
+    friend class endpoint<config>;
+
+    explicit connection(bool is_server, alog_type & alog, elog_type & elog)
+      : m_service(NULL)
+      , m_fd(-1)
+      , m_is_server(is_server)
+      , m_alog(alog)
+      , m_elog(elog)
+      , m_reading(false)
+      , m_read_buf(NULL)
+      , m_read_len(0)
+      , m_read_needed(0)
+      , m_read_total(0)
+      , m_write_first(0)
+    {
+        m_alog.write(log::alevel::devel,"uring con transport constructor");
+    }
+
+    ~connection() {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    /// Get a shared pointer to this component
+    ptr get_shared() {
+        return type::shared_from_this();
+    }
+
+    /// Tests whether or not the underlying transport is secure
+    /**
+     * The uring transport does not support TLS.
+     *
+     * @return false
+     */
+    bool is_secure() const {
+        return false;
+    }
+
+    /// Get the remote endpoint address
+    /**
+     * @return A string "address:port", with IPv6 addresses in brackets, or
+     * "Unknown" if the socket has no peer.
+     */
+    std::string get_remote_endpoint() const {
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+
+        if (m_fd < 0 || ::getpeername(m_fd,
+            reinterpret_cast<struct sockaddr *>(&addr),&len) != 0)
+        {
+            return "Unknown";
+        }
+
+        char host[INET6_ADDRSTRLEN];
+        std::stringstream s;
+
+        if (addr.ss_family == AF_INET6) {
+            struct sockaddr_in6 * a =
+                reinterpret_cast<struct sockaddr_in6 *>(&addr);
+            ::inet_ntop(AF_INET6,&a->sin6_addr,host,sizeof(host));
+            s << "[" << host << "]:" << ntohs(a->sin6_port);
+        } else if (addr.ss_family == AF_INET) {
+            struct sockaddr_in * a =
+                reinterpret_cast<struct sockaddr_in *>(&addr);
+            ::inet_ntop(AF_INET,&a->sin_addr,host,sizeof(host));
+            s << host << ":" << ntohs(a->sin_port);
+        } else {
+            return "Unknown";
+        }
+
+        return s.str();
+    }
+
+    /// Get the native socket descriptor
+    /**
+     * @return The socket, or -1 if the connection has none yet
+     */
+    int get_native_handle() const {
+        return m_fd;
+    }
+
+    /// Get the connection handle
+    connection_hdl get_handle() const {
+        return m_connection_hdl;
+    }
+
+    /// Call back a function after a period of time.
+    /**
+     * Sets a timer that calls back a function after the specified period of
+     * milliseconds. Returns a handle that can be used to cancel the timer.
+     * A cancelled timer will return the error code error::operation_aborted
+     * A timer that expired will return no error.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back when the timer has expired
+     * @return A handle that can be used to cancel the timer if it is no longer
+     * needed.
+     */
+    timer_ptr set_timer(long duration, timer_handler callback) {
+        return m_service->set_timer(duration,callback);
+    }
+
+    /// Call back a function after a period of time, at coarse resolution
+    /**
+     * Ring timeouts are already cheap to arm and cancel, so this is the same
+     * as set_timer.
+     */
+    timeout_ptr set_timeout(long duration, timer_handler callback) {
+        return m_service->set_timer(duration,callback);
+    }
+
+    /// Set Connection Handle
+    /**
+     * @param hdl A connection_hdl that the transport will use to refer
+     * to itself
+     */
+    void set_handle(connection_hdl hdl) {
+        m_connection_hdl = hdl;
+    }
+
+    /// Trigger the on_interrupt handler
+    /**
+     * This is thread safe.
+     */
+    lib::error_code interrupt(interrupt_handler handler) {
+        m_service->post(handler);
+        return lib::error_code();
+    }
+
+    /// Run a function on the service thread
+    /**
+     * This is thread safe.
+     */
+    lib::error_code dispatch(dispatch_handler handler) {
+        m_service->post(handler);
+        return lib::error_code();
+    }
+protected:
+    /// Set the service the connection submits to
+    void init_uring(service * s) {
+        m_service = s;
+    }
+
+    /// Hand the connection its socket
+    /**
+     * The connection owns the socket from here on and closes it on
+     * destruction.
+     */
+    void set_socket(int fd) {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+        m_fd = fd;
+    }
+
+    /// Initialize the connection transport
+    void init(init_handler handler) {
+        m_alog.write(log::alevel::devel,"uring connection init");
+        m_service->post(lib::bind(handler,lib::error_code()));
+    }
+
+    /// Initiate an async_read for at least num_bytes bytes into buf
+    /**
+     * Receives are resubmitted until num_bytes have arrived, each one asking
+     * for all of the space left in buf.
+     */
+    void async_read_at_least(size_t num_bytes, char *buf, size_t len,
+        read_handler handler)
+    {
+        if (m_alog.static_test(log::alevel::devel)) {
+            std::stringstream s;
+            s << "uring_con async_read_at_least: " << num_bytes;
+            m_alog.write(log::alevel::devel,s.str());
+        }
+
+        if (num_bytes > len) {
+            m_elog.write(log::elevel::devel,
+                "uring_con async_read_at_least error::invalid_num_bytes");
+            handler(make_error_code(error::invalid_num_bytes),size_t(0));
+            return;
+        }
+
+        if (m_reading) {
+            handler(make_error_code(error::double_read),size_t(0));
+            return;
+        }
+
+        m_reading = true;
+        m_read_buf = buf;
+        m_read_len = len;
+        m_read_needed = num_bytes;
+        m_read_total = 0;
+        m_read_handler = handler;
+
+        m_service->dispatch(lib::bind(&type::submit_read,get_shared()));
+    }
+
+    /// Write a single buffer
+    void async_write(char const * buf, size_t len, write_handler handler) {
+        m_iov.resize(1);
+        m_iov[0].iov_base = const_cast<char *>(buf);
+        m_iov[0].iov_len = len;
+        m_write_handler = handler;
+
+        m_service->dispatch(lib::bind(&type::submit_write,get_shared(),0));
+    }
+
+    /// Write a sequence of buffers in one gathered send
+    void async_write(std::vector<buffer> const & bufs, write_handler handler) {
+        m_iov.resize(bufs.size());
+        for (size_t i = 0; i < bufs.size(); ++i) {
+            m_iov[i].iov_base = const_cast<char *>(bufs[i].buf);
+            m_iov[i].iov_len = bufs[i].len;
+        }
+        m_write_handler = handler;
+
+        m_service->dispatch(lib::bind(&type::submit_write,get_shared(),0));
+    }
+
+    /// Shut down the socket
+    /**
+     * Shutting down both directions completes any receive still in flight.
+     * The descriptor itself is closed when the connection is destroyed.
+     */
+    void async_shutdown(shutdown_handler callback) {
+        if (m_alog.static_test(log::alevel::devel)) {
+            m_alog.write(log::alevel::devel,"uring connection async_shutdown");
+        }
+
+        lib::error_code ec;
+        if (m_fd >= 0 && ::shutdown(m_fd,SHUT_RDWR) != 0 && errno != ENOTCONN)
+        {
+            log_err(log::elevel::info,"uring async_shutdown",errno);
+            ec = make_error_code(error::pass_through);
+        }
+
+        m_service->post(lib::bind(callback,ec));
+    }
+
+    void log_err(log::level l, char const * msg, int err) {
+        if (m_elog.static_test(l)) {
+            std::stringstream s;
+            s << msg << " error: " << std::strerror(err) << " (" << err << ")";
+            m_elog.write(l,s.str());
+        }
+    }
+private:
+    class read_op : public operation {
+    public:
+        explicit read_op(ptr con) : m_con(con) {}
+
+        void complete(int res, unsigned) {
+            m_con->handle_read(res);
+        }
+    private:
+        ptr m_con;
+    };
+
+    class write_op : public operation {
+    public:
+        write_op(ptr con, size_t first) : m_con(con) {
+            std::memset(&m_msg,0,sizeof(m_msg));
+            m_msg.msg_iov = &con->m_iov[first];
+            // the kernel refuses more than IOV_MAX buffers in one message,
+            // any beyond that are sent by the next submission
+            size_t count = con->m_iov.size() - first;
+            m_msg.msg_iovlen = count < IOV_MAX ? count : IOV_MAX;
+        }
+
+        void complete(int res, unsigned) {
+            m_con->handle_write(res);
+        }
+
+        struct msghdr m_msg;
+    private:
+        ptr m_con;
+    };
+
+    void submit_read() {
+        struct io_uring_sqe * sqe = m_service->get_sqe();
+        if (!sqe) {
+            finish_read(make_error_code(error::general));
+            return;
+        }
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = m_fd;
+        sqe->addr = reinterpret_cast<__u64>(m_read_buf + m_read_total);
+        sqe->len = static_cast<__u32>(m_read_len - m_read_total);
+
+        m_service->start(new read_op(get_shared()),sqe);
+    }
+
+    void handle_read(int res) {
+        if (res > 0) {
+            m_read_total += static_cast<size_t>(res);
+            if (m_read_total < m_read_needed) {
+                submit_read();
+            } else {
+                finish_read(lib::error_code());
+            }
+        } else if (res == 0) {
+            finish_read(make_error_code(transport::error::eof));
+        } else if (res == -ECANCELED) {
+            finish_read(make_error_code(transport::error::operation_aborted));
+        } else {
+            log_err(log::elevel::info,"uring async_read_at_least",-res);
+            finish_read(make_error_code(error::pass_through));
+        }
+    }
+
+    void finish_read(lib::error_code const & ec) {
+        read_handler handler;
+        handler.swap(m_read_handler);
+        m_reading = false;
+
+        if (handler) {
+            handler(ec,m_read_total);
+        } else {
+            m_alog.write(log::alevel::devel,
+                "handle_read called with null read handler");
+        }
+    }
+
+    void submit_write(size_t first) {
+        m_write_first = first;
+
+        struct io_uring_sqe * sqe = m_service->get_sqe();
+        if (!sqe) {
+            finish_write(make_error_code(error::general));
+            return;
+        }
+
+        write_op * op = new write_op(get_shared(),first);
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = m_fd;
+        sqe->addr = reinterpret_cast<__u64>(&op->m_msg);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+
+        m_service->start(op,sqe);
+    }
+
+    void handle_write(int res) {
+        if (res < 0) {
+            if (res == -ECANCELED) {
+                finish_write(make_error_code(
+                    transport::error::operation_aborted));
+            } else {
+                log_err(log::elevel::info,"uring async_write",-res);
+                finish_write(make_error_code(error::pass_through));
+            }
+            return;
+        }
+
+        // skip what the kernel took and send the rest
+        size_t sent = static_cast<size_t>(res);
+        size_t first = m_write_first;
+        while (first < m_iov.size() && sent >= m_iov[first].iov_len) {
+            sent -= m_iov[first].iov_len;
+            ++first;
+        }
+
+        if (first == m_iov.size()) {
+            finish_write(lib::error_code());
+            return;
+        }
+
+        m_iov[first].iov_base = static_cast<char *>(m_iov[first].iov_base)
+            + sent;
+        m_iov[first].iov_len -= sent;
+        submit_write(first);
+    }
+
+    void finish_write(lib::error_code const & ec) {
+        m_iov.clear();
+
+        write_handler handler;
+        handler.swap(m_write_handler);
+
+        if (handler) {
+            handler(ec);
+        } else {
+            m_alog.write(log::alevel::devel,
+                "handle_write called with null write handler");
+        }
+    }
+
+    service *           m_service;
+    int                 m_fd;
+    bool const          m_is_server;
+    alog_type &         m_alog;
+    elog_type &         m_elog;
+
+    connection_hdl      m_connection_hdl;
+
+    bool                m_reading;
+    char *              m_read_buf;
+    size_t              m_read_len;
+    size_t              m_read_needed;
+    size_t              m_read_total;
+    read_handler        m_read_handler;
+
+    std::vector<struct iovec> m_iov;
+    size_t              m_write_first;
+    write_handler       m_write_handler;
+};
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_CON_HPP
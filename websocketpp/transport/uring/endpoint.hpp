@@ -0,0 +1,824 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_HPP
+
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/logger/levels.hpp>
+#include <websocketpp/error.hpp>
+#include <websocketpp/uri.hpp>
+
+#include <websocketpp/transport/base/endpoint.hpp>
+#include <websocketpp/transport/uring/connection.hpp>
+#include <websocketpp/transport/uring/service.hpp>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <string>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+/// uring transport endpoint component
+/**
+ * A server endpoint keeps one multishot accept in flight on its listening
+ * socket. Sockets accepted while no async_accept is waiting are queued and
+ * handed to the next connection. Client connects are submitted together
+ * with a linked timeout of config::timeout_connect milliseconds.
+ *
+ * Host names are resolved synchronously with getaddrinfo.
+ */
+template <typename config>
+class endpoint {
+public:
+    /// Type of this endpoint transport component
+    typedef endpoint<config> type;
+
+    /// Type of the concurrency policy
+    typedef typename config::concurrency_type concurrency_type;
+    /// Type of the error logging policy
+    typedef typename config::elog_type elog_type;
+    /// Type of the access logging policy
+    typedef typename config::alog_type alog_type;
+
+    /// Type of this endpoint transport component's associated connection
+    /// transport component.
+    typedef uring::connection<config> transport_con_type;
+    /// Type of a shared pointer to this endpoint transport component's
+    /// associated connection transport component
+    typedef typename transport_con_type::ptr transport_con_ptr;
+
+    /// Type of a pointer to a timer
+    typedef uring::timer_ptr timer_ptr;
+
+    explicit endpoint()
+      : m_service(NULL)
+      , m_external_service(false)
+      , m_listen_fd(-1)
+      , m_listen_backlog(SOMAXCONN)
+      , m_reuse_addr(false)
+      , m_reuse_port(false)
+      , m_accept_op(NULL)
+      , m_state(UNINITIALIZED)
+    {
+        //std::cout << "transport::uring::endpoint constructor" << std::endl;
+    }
+
+    ~endpoint() {
+        if (m_accept_op) {
+            // the operation outlives us, make it drop what it accepts
+            m_accept_op->detach();
+            if (m_external_service) {
+                // the ring outlives us too, so end the multishot rather than
+                // leave it accepting on a service that will never stop it
+                m_service->dispatch(lib::bind(&type::cancel_accept,m_service,
+                    m_accept_op));
+            }
+        }
+        close_listen_socket();
+        close_accepted();
+
+        if (m_state != UNINITIALIZED && !m_external_service) {
+            delete m_service;
+        }
+    }
+
+    /// transport::uring objects are moveable but not copyable or assignable.
+    /// The following code sets this situation up based on whether or not we
+    /// have C++11 support or not
+#ifdef _WEBSOCKETPP_DELETED_FUNCTIONS_
+    endpoint(const endpoint & src) = delete;
+    endpoint& operator= (const endpoint & rhs) = delete;
+#else
+private:
+    endpoint(const endpoint & src);
+    endpoint & operator= (const endpoint & rhs);
+public:
+#endif
+
+    /// Return whether or not the endpoint produces secure connections.
+    bool is_secure() const {
+        return false;
+    }
+
+    /// initialize uring transport with external service (exception free)
+    /**
+     * Initialize the uring transport policy for this endpoint using the
+     * provided service object. init_uring must be called before any uring
+     * methods are used. Endpoints sharing a service share its ring and the
+     * thread that runs it.
+     *
+     * @param ptr A pointer to the service to use for uring events
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void init_uring(service * ptr, lib::error_code & ec) {
+        if (m_state != UNINITIALIZED) {
+            m_elog->write(log::elevel::library,
+                "init_uring called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        m_alog->write(log::alevel::devel,"uring::init_uring");
+
+        if (!ptr->is_initialized()) {
+            ptr->init(config::uring_queue_depth,ec);
+            if (ec) {
+                m_elog->write(log::elevel::fatal,
+                    "io_uring setup failed: "+ec.message());
+                return;
+            }
+        }
+
+        m_service = ptr;
+        m_external_service = true;
+        m_state = READY;
+        ec = lib::error_code();
+    }
+
+    /// initialize uring transport with external service
+    /**
+     * @param ptr A pointer to the service to use for uring events
+     */
+    void init_uring(service * ptr) {
+        lib::error_code ec;
+        init_uring(ptr,ec);
+        if (ec) { throw ec; }
+    }
+
+    /// Initialize uring transport with internal service (exception free)
+    /**
+     * This method of initialization will allocate and use an internally
+     * managed service.
+     *
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void init_uring(lib::error_code & ec) {
+        service * s = new service();
+        init_uring(s,ec);
+        if (ec) {
+            delete s;
+            return;
+        }
+        m_external_service = false;
+    }
+
+    /// Initialize uring transport with internal service
+    void init_uring() {
+        lib::error_code ec;
+        init_uring(ec);
+        if (ec) { throw ec; }
+    }
+
+    /// Retrieve a reference to the endpoint's service
+    /**
+     * @return A reference to the endpoint's service
+     */
+    service & get_service() {
+        return *m_service;
+    }
+
+    /// Sets whether to use the SO_REUSEADDR flag when opening listening sockets
+    /**
+     * Must be called before listen to have an effect.
+     *
+     * @param value Whether or not to use the SO_REUSEADDR option
+     */
+    void set_reuse_addr(bool value) {
+        m_reuse_addr = value;
+    }
+
+    /// Sets whether to use the SO_REUSEPORT flag when opening listening sockets
+    /**
+     * Lets several endpoints, each with its own service and thread, listen on
+     * the same port and have the kernel spread connections across them.
+     * Must be called before listen to have an effect.
+     *
+     * @param value Whether or not to use the SO_REUSEPORT option
+     */
+    void set_reuse_port(bool value) {
+        m_reuse_port = value;
+    }
+
+    /// Set the backlog of the listening socket
+    /**
+     * Must be called before listen to have an effect. The default is
+     * SOMAXCONN.
+     *
+     * @param backlog The length of the kernel's queue of pending connections
+     */
+    void set_listen_backlog(int backlog) {
+        m_listen_backlog = backlog;
+    }
+
+    /// Set up endpoint for listening on a port (exception free)
+    /**
+     * Listens on all IPv6 and IPv4 addresses.
+     *
+     * @param port The port to listen on.
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void listen(uint16_t port, lib::error_code & ec) {
+        struct sockaddr_in6 addr;
+        std::memset(&addr,0,sizeof(addr));
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_any;
+        addr.sin6_port = htons(port);
+
+        listen(reinterpret_cast<struct sockaddr const *>(&addr),sizeof(addr),
+            ec);
+    }
+
+    /// Set up endpoint for listening on a port
+    /**
+     * @param port The port to listen on.
+     */
+    void listen(uint16_t port) {
+        lib::error_code ec;
+        listen(port,ec);
+        if (ec) { throw ec; }
+    }
+
+    /// Set up endpoint for listening on a host and service (exception free)
+    /**
+     * The host and service are resolved with getaddrinfo and the first result
+     * is used. An empty host listens on all addresses.
+     *
+     * @param host A string identifying a location. May be a host name or an
+     * IP address.
+     * @param service A string identifying a port or a service name.
+     * @param ec Set to indicate what error occurred, if any.
+     */
+    void listen(std::string const & host, std::string const & service,
+        lib::error_code & ec)
+    {
+        struct addrinfo hints;
+        std::memset(&hints,0,sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+
+        struct addrinfo * res = NULL;
+        if (::getaddrinfo(host.empty() ? NULL : host.c_str(),service.c_str(),
+            &hints,&res) != 0 || !res)
+        {
+            m_elog->write(log::elevel::info,
+                "uring::listen could not resolve "+host+":"+service);
+            ec = make_error_code(error::invalid_host_service);
+            return;
+        }
+
+        listen(res->ai_addr,res->ai_addrlen,ec);
+        ::freeaddrinfo(res);
+    }
+
+    /// Set up endpoint for listening on a host and service
+    /**
+     * @param host A string identifying a location. May be a host name or an
+     * IP address.
+     * @param service A string identifying a port or a service name.
+     */
+    void listen(std::string const & host, std::string const & service) {
+        lib::error_code ec;
+        listen(host,service,ec);
+        if (ec) { throw ec; }
+    }
+
+    /// Stop listening (exception free)
+    /**
+     * Stop listening and accepting new connections. This will not end any
+     * existing connections. Connections waiting in async_accept are called
+     * back with websocketpp::error::operation_canceled.
+     *
+     * @param ec A status code indicating an error, if any.
+     */
+    void stop_listening(lib::error_code & ec) {
+        if (m_state != LISTENING) {
+            m_elog->write(log::elevel::library,
+                "uring::stop_listening called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        m_state = READY;
+        m_service->dispatch(lib::bind(&type::handle_stop_listening,this));
+        ec = lib::error_code();
+    }
+
+    /// Stop listening
+    void stop_listening() {
+        lib::error_code ec;
+        stop_listening(ec);
+        if (ec) { throw ec; }
+    }
+
+    /// Check if the endpoint is listening
+    /**
+     * @return Whether or not the endpoint is listening.
+     */
+    bool is_listening() const {
+        return (m_state == LISTENING);
+    }
+
+    /// wraps the run method of the service
+    std::size_t run() {
+        return m_service->run();
+    }
+
+    /// wraps the stop method of the service
+    void stop() {
+        m_service->stop();
+    }
+
+    /// wraps the reset method of the service
+    void reset() {
+        m_service->reset();
+    }
+
+    /// wraps the stopped method of the service
+    bool stopped() const {
+        return m_service->stopped();
+    }
+
+    /// Marks the endpoint as perpetual, stopping it from exiting when empty
+    /**
+     * Perpetual endpoints will not automatically exit when they run out of
+     * connections to process. To stop a perpetual endpoint call
+     * `stop_perpetual`.
+     */
+    void start_perpetual() {
+        m_service->add_work();
+    }
+
+    /// Clears the endpoint's perpetual flag, allowing it to exit when empty
+    void stop_perpetual() {
+        m_service->remove_work();
+    }
+
+    /// Call back a function after a period of time.
+    /**
+     * Sets a timer that calls back a function after the specified period of
+     * milliseconds. Returns a handle that can be used to cancel the timer.
+     * A cancelled timer will return the error code error::operation_aborted
+     * A timer that expired will return no error.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back when the timer has expired
+     * @return A handle that can be used to cancel the timer if it is no longer
+     * needed.
+     */
+    timer_ptr set_timer(long duration, timer_handler callback) {
+        return m_service->set_timer(duration,callback);
+    }
+
+    /// Accept the next connection attempt and assign it to con (exception free)
+    /**
+     * @param tcon The connection to accept into.
+     * @param callback The function to call when the operation is complete.
+     * @param ec A status code indicating an error, if any.
+     */
+    void async_accept(transport_con_ptr tcon, accept_handler callback,
+        lib::error_code & ec)
+    {
+        if (m_state != LISTENING) {
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::async_accept_not_listening);
+            return;
+        }
+
+        m_alog->write(log::alevel::devel, "uring::async_accept");
+
+        m_service->dispatch(lib::bind(&type::handle_async_accept,this,tcon,
+            callback));
+        ec = lib::error_code();
+    }
+
+    /// Accept the next connection attempt and assign it to con.
+    /**
+     * @param tcon The connection to accept into.
+     * @param callback The function to call when the operation is complete.
+     */
+    void async_accept(transport_con_ptr tcon, accept_handler callback) {
+        lib::error_code ec;
+        async_accept(tcon,callback,ec);
+        if (ec) {
+            throw ec;
+        }
+    }
+protected:
+    /// Initialize logging
+    /**
+     * The loggers are located in the main endpoint class. As such, the
+     * transport doesn't have direct access to them. This method is called
+     * by the endpoint constructor to allow shared logging from the transport
+     * component. These are raw pointers to member variables of the endpoint.
+     * In particular, they cannot be used in the transport constructor as they
+     * haven't been constructed yet, and cannot be used in the transport
+     * destructor as they will have been destroyed by then.
+     */
+    void init_logging(alog_type * a, elog_type * e) {
+        m_alog = a;
+        m_elog = e;
+    }
+
+    /// Initiate a new connection
+    /**
+     * Only the first address the host resolves to is tried. Proxies are not
+     * supported.
+     */
+    void async_connect(transport_con_ptr tcon, uri_ptr u, connect_handler cb) {
+        struct addrinfo hints;
+        std::memset(&hints,0,sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        struct addrinfo * res = NULL;
+        if (::getaddrinfo(u->get_host().c_str(),u->get_port_str().c_str(),
+            &hints,&res) != 0 || !res)
+        {
+            m_elog->write(log::elevel::info,
+                "uring::async_connect could not resolve "+u->get_host());
+            cb(make_error_code(error::invalid_host_service));
+            return;
+        }
+
+        int fd = ::socket(res->ai_family,SOCK_STREAM|SOCK_CLOEXEC,0);
+        if (fd < 0) {
+            ::freeaddrinfo(res);
+            log_err(log::elevel::info,"uring::async_connect socket",errno);
+            cb(make_error_code(error::pass_through));
+            return;
+        }
+        tcon->set_socket(fd);
+
+        connect_op * op = new connect_op(this,tcon,cb);
+        std::memcpy(&op->m_addr,res->ai_addr,res->ai_addrlen);
+        op->m_addrlen = res->ai_addrlen;
+        ::freeaddrinfo(res);
+
+        m_service->dispatch(lib::bind(&type::submit_connect,this,op));
+    }
+
+    /// Initialize a connection
+    /**
+     * init is called by an endpoint once for each newly created connection.
+     * It's purpose is to give the transport policy the chance to perform any
+     * transport specific initialization that couldn't be done via the default
+     * constructor.
+     *
+     * @param tcon A pointer to the transport portion of the connection.
+     * @return A status code indicating the success or failure of the operation
+     */
+    lib::error_code init(transport_con_ptr tcon) {
+        m_alog->write(log::alevel::devel, "transport::uring::init");
+
+        if (m_state == UNINITIALIZED) {
+            return make_error_code(error::not_initialized);
+        }
+
+        tcon->init_uring(m_service);
+        return lib::error_code();
+    }
+
+    void log_err(log::level l, char const * msg, int err) {
+        if (m_elog->static_test(l)) {
+            std::stringstream s;
+            s << msg << " error: " << std::strerror(err) << " (" << err << ")";
+            m_elog->write(l,s.str());
+        }
+    }
+private:
+    enum state {
+        UNINITIALIZED = 0,
+        READY = 1,
+        LISTENING = 2
+    };
+
+    struct pending_accept {
+        pending_accept(transport_con_ptr c, accept_handler h)
+          : tcon(c), callback(h) {}
+
+        transport_con_ptr tcon;
+        accept_handler callback;
+    };
+
+    // A multishot accept. It completes once per accepted socket and only
+    // leaves the ring when cancelled or on error.
+    class accept_op : public operation {
+    public:
+        explicit accept_op(type * e) : m_endpoint(e) {}
+
+        void complete(int res, unsigned flags) {
+            if (m_endpoint) {
+                m_endpoint->handle_accept(this,res,flags);
+            } else {
+                discard(res);
+            }
+        }
+
+        void discard(int res) {
+            if (res >= 0) {
+                ::close(res);
+            }
+        }
+
+        void detach() {
+            m_endpoint = NULL;
+        }
+    private:
+        type * m_endpoint;
+    };
+
+    class connect_op : public operation {
+    public:
+        connect_op(type * e, transport_con_ptr tcon, connect_handler cb)
+          : m_endpoint(e), m_tcon(tcon), m_callback(cb), m_addrlen(0) {}
+
+        void complete(int res, unsigned) {
+            m_endpoint->handle_connect(m_callback,res);
+        }
+
+        type *                      m_endpoint;
+        transport_con_ptr           m_tcon;
+        connect_handler             m_callback;
+        struct sockaddr_storage     m_addr;
+        socklen_t                   m_addrlen;
+        struct __kernel_timespec    m_timeout;
+    };
+
+    void listen(struct sockaddr const * addr, socklen_t len,
+        lib::error_code & ec)
+    {
+        if (m_state != READY) {
+            m_elog->write(log::elevel::library,
+                "uring::listen called from the wrong state");
+            using websocketpp::error::make_error_code;
+            ec = make_error_code(websocketpp::error::invalid_state);
+            return;
+        }
+
+        m_alog->write(log::alevel::devel,"uring::listen");
+
+        int fd = ::socket(addr->sa_family,SOCK_STREAM|SOCK_CLOEXEC,0);
+        if (fd < 0) {
+            log_err(log::elevel::info,"uring::listen socket",errno);
+            ec = make_error_code(error::pass_through);
+            return;
+        }
+
+        int on = 1;
+        int off = 0;
+        if (addr->sa_family == AF_INET6) {
+            ::setsockopt(fd,IPPROTO_IPV6,IPV6_V6ONLY,&off,sizeof(off));
+        }
+        if (m_reuse_addr) {
+            ::setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+        }
+        if (m_reuse_port) {
+            ::setsockopt(fd,SOL_SOCKET,SO_REUSEPORT,&on,sizeof(on));
+        }
+
+        if (::bind(fd,addr,len) != 0) {
+            log_err(log::elevel::info,"uring::listen bind",errno);
+            ::close(fd);
+            ec = make_error_code(error::pass_through);
+            return;
+        }
+        if (::listen(fd,m_listen_backlog) != 0) {
+            log_err(log::elevel::info,"uring::listen listen",errno);
+            ::close(fd);
+            ec = make_error_code(error::pass_through);
+            return;
+        }
+
+        m_listen_fd = fd;
+        m_state = LISTENING;
+        ec = lib::error_code();
+    }
+
+    void handle_async_accept(transport_con_ptr tcon, accept_handler callback)
+    {
+        if (m_state != LISTENING) {
+            callback(make_error_code(websocketpp::error::operation_canceled));
+            return;
+        }
+
+        if (!m_accepted.empty()) {
+            tcon->set_socket(m_accepted.front());
+            m_accepted.pop_front();
+            m_service->post(lib::bind(callback,lib::error_code()));
+            return;
+        }
+
+        m_pending.push_back(pending_accept(tcon,callback));
+
+        if (!m_accept_op) {
+            submit_accept();
+        }
+    }
+
+    void submit_accept() {
+        struct io_uring_sqe * sqe = m_service->get_sqe();
+        if (!sqe) {
+            fail_pending(make_error_code(error::general));
+            return;
+        }
+
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = m_listen_fd;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+
+        m_accept_op = new accept_op(this);
+        m_service->start(m_accept_op,sqe);
+    }
+
+    void handle_accept(accept_op * op, int res, unsigned flags) {
+        if (!(flags & IORING_CQE_F_MORE) && op == m_accept_op) {
+            m_accept_op = NULL;
+        }
+
+        if (res >= 0) {
+            if (m_state != LISTENING) {
+                ::close(res);
+            } else if (m_pending.empty()) {
+                m_accepted.push_back(res);
+            } else {
+                pending_accept p = m_pending.front();
+                m_pending.pop_front();
+                p.tcon->set_socket(res);
+                p.callback(lib::error_code());
+            }
+
+            // the kernel ended the multishot, start another one if needed
+            if (!m_accept_op && m_state == LISTENING && !m_pending.empty()) {
+                submit_accept();
+            }
+            return;
+        }
+
+        if (res == -ECANCELED) {
+            return;
+        }
+
+        log_err(log::elevel::info,"uring handle_accept",-res);
+        if (m_accept_op) {
+            return;
+        }
+
+        // The error ended the multishot, so none of the waiting connections
+        // will be accepted by it. Fail them all, then start another one unless
+        // their handlers already did.
+        fail_pending(make_error_code(error::pass_through));
+        if (!m_accept_op && m_state == LISTENING) {
+            submit_accept();
+        }
+    }
+
+    void handle_stop_listening() {
+        if (m_accept_op) {
+            m_accept_op->detach();
+            cancel_accept(m_service,m_accept_op);
+            m_accept_op = NULL;
+        }
+
+        close_listen_socket();
+        close_accepted();
+        fail_pending(make_error_code(websocketpp::error::operation_canceled));
+    }
+
+    /// Submit a cancellation of a multishot accept
+    /**
+     * Static so that it can run after the endpoint that started the accept
+     * was destroyed.
+     */
+    static void cancel_accept(service * s, accept_op * op) {
+        struct io_uring_sqe * sqe = s->get_sqe();
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<__u64>(op);
+        }
+    }
+
+    void fail_pending(lib::error_code const & ec) {
+        std::deque<pending_accept> pending;
+        pending.swap(m_pending);
+
+        while (!pending.empty()) {
+            pending.front().callback(ec);
+            pending.pop_front();
+        }
+    }
+
+    void close_listen_socket() {
+        if (m_listen_fd >= 0) {
+            ::close(m_listen_fd);
+            m_listen_fd = -1;
+        }
+    }
+
+    void close_accepted() {
+        while (!m_accepted.empty()) {
+            ::close(m_accepted.front());
+            m_accepted.pop_front();
+        }
+    }
+
+    void submit_connect(connect_op * op) {
+        if (!m_service->reserve(2)) {
+            connect_handler cb = op->m_callback;
+            delete op;
+            cb(make_error_code(error::general));
+            return;
+        }
+
+        long timeout = config::timeout_connect;
+        op->m_timeout.tv_sec = timeout / 1000;
+        op->m_timeout.tv_nsec = (timeout % 1000) * 1000000;
+
+        struct io_uring_sqe * sqe = m_service->get_sqe();
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->fd = op->m_tcon->get_native_handle();
+        sqe->addr = reinterpret_cast<__u64>(&op->m_addr);
+        sqe->off = op->m_addrlen;
+        sqe->flags = IOSQE_IO_LINK;
+        m_service->start(op,sqe);
+
+        sqe = m_service->get_sqe();
+        sqe->opcode = IORING_OP_LINK_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<__u64>(&op->m_timeout);
+        sqe->len = 1;
+    }
+
+    void handle_connect(connect_handler callback, int res) {
+        if (res == 0) {
+            m_alog->write(log::alevel::devel,"uring async_connect succeeded");
+            callback(lib::error_code());
+        } else if (res == -ECANCELED) {
+            m_elog->write(log::elevel::info,"TCP connect timed out");
+            callback(make_error_code(transport::error::timeout));
+        } else {
+            log_err(log::elevel::info,"uring async_connect",-res);
+            callback(make_error_code(error::pass_through));
+        }
+    }
+
+    elog_type *                 m_elog;
+    alog_type *                 m_alog;
+
+    service *                   m_service;
+    bool                        m_external_service;
+
+    int                         m_listen_fd;
+    int                         m_listen_backlog;
+    bool                        m_reuse_addr;
+    bool                        m_reuse_port;
+
+    accept_op *                 m_accept_op;
+    std::deque<int>             m_accepted;
+    std::deque<pending_accept>  m_pending;
+
+    state                       m_state;
+};
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_HPP
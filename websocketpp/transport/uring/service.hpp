@@ -0,0 +1,763 @@
+/*
+ * Copyright (c) 2013, Peter Thorson. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the WebSocket++ Project nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL PETER THORSON BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef WEBSOCKETPP_TRANSPORT_URING_SERVICE_HPP
+#define WEBSOCKETPP_TRANSPORT_URING_SERVICE_HPP
+
+#include <websocketpp/transport/base/connection.hpp>
+#include <websocketpp/transport/uring/base.hpp>
+
+#include <websocketpp/common/atomic.hpp>
+#include <websocketpp/common/functional.hpp>
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/common/thread.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+
+namespace websocketpp {
+namespace transport {
+namespace uring {
+
+class service;
+
+/// An operation submitted to a service's ring
+/**
+ * The address of the operation is the user_data of its submission. The service
+ * owns operations from the time they are started until their final completion
+ * and deletes them afterwards.
+ */
+class operation {
+public:
+    operation() : m_prev(NULL), m_next(NULL) {}
+    virtual ~operation() {}
+
+    /// Handle a completion of this operation
+    /**
+     * @param res The result of the completion. A negative errno on failure.
+     * @param flags The completion flags. IORING_CQE_F_MORE is set if further
+     * completions will follow for this operation.
+     */
+    virtual void complete(int res, unsigned flags) = 0;
+
+    /// Handle a completion that arrives while the service is being destroyed
+    /**
+     * Handlers are not called at this point. Operations that may complete
+     * with a new resource, such as an accepted socket, release it here.
+     *
+     * @param res The result of the completion
+     */
+    virtual void discard(int) {}
+private:
+    friend class service;
+
+    operation * m_prev;
+    operation * m_next;
+};
+
+class timer;
+
+/// Type of a pointer to a uring timer
+typedef lib::shared_ptr<timer> timer_ptr;
+
+/// An io_uring instance and the event loop that drives it
+/**
+ * All connections and endpoints that share a service submit their operations
+ * to the same ring. Submissions are not pushed to the kernel one at a time.
+ * They accumulate in the submission queue while handlers run and are
+ * submitted together, with the wait for the next completions, in one
+ * io_uring_enter call per loop iteration.
+ *
+ * A service is driven by exactly one thread calling run. Operations may only
+ * be started from that thread. Other threads hand work to it with post or
+ * dispatch, which wake the loop through an eventfd.
+ */
+class service {
+public:
+    /// Type of the functions run by post and dispatch
+    typedef lib::function<void()> handler;
+
+    service()
+      : m_ring_fd(-1)
+      , m_wake_fd(-1)
+      , m_sq_ptr(NULL)
+      , m_sq_size(0)
+      , m_cq_ptr(NULL)
+      , m_cq_size(0)
+      , m_sqes(NULL)
+      , m_sqes_size(0)
+      , m_sqe_tail(0)
+      , m_to_submit(0)
+      , m_ops(NULL)
+      , m_outstanding(0)
+      , m_wake_armed(false)
+      , m_work(0)
+      , m_running(false)
+      , m_stopped(false)
+      , m_shutdown(false) {}
+
+    ~service() {
+        m_shutdown = true;
+
+        if (m_ring_fd >= 0) {
+            drain();
+            ::close(m_ring_fd);
+        }
+
+        while (m_ops) {
+            operation * op = m_ops;
+            unlink(op);
+            delete op;
+        }
+
+        if (m_sqes) {
+            ::munmap(m_sqes,m_sqes_size);
+        }
+        if (m_cq_ptr && m_cq_ptr != m_sq_ptr) {
+            ::munmap(m_cq_ptr,m_cq_size);
+        }
+        if (m_sq_ptr) {
+            ::munmap(m_sq_ptr,m_sq_size);
+        }
+        if (m_wake_fd >= 0) {
+            ::close(m_wake_fd);
+        }
+    }
+
+    /// Set up the ring
+    /**
+     * @param entries Size of the submission queue. The completion queue is
+     * twice as large.
+     * @param [out] ec Set to error::setup_failed if io_uring is unavailable
+     */
+    void init(unsigned entries, lib::error_code & ec) {
+        if (m_ring_fd >= 0) {
+            ec = lib::error_code();
+            return;
+        }
+
+        struct io_uring_params p;
+        std::memset(&p,0,sizeof(p));
+
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup,entries,&p));
+        if (fd < 0) {
+            ec = make_error_code(error::setup_failed);
+            return;
+        }
+        m_ring_fd = fd;
+
+        m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP);
+        if (single) {
+            if (m_cq_size > m_sq_size) {
+                m_sq_size = m_cq_size;
+            }
+            m_cq_size = m_sq_size;
+        }
+
+        m_sq_ptr = map(m_sq_size,IORING_OFF_SQ_RING);
+        m_cq_ptr = single ? m_sq_ptr : map(m_cq_size,IORING_OFF_CQ_RING);
+        m_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        m_sqes = static_cast<struct io_uring_sqe *>(
+            map(m_sqes_size,IORING_OFF_SQES));
+        m_wake_fd = ::eventfd(0,EFD_CLOEXEC);
+
+        if (!m_sq_ptr || !m_cq_ptr || !m_sqes || m_wake_fd < 0) {
+            ec = make_error_code(error::setup_failed);
+            return;
+        }
+
+        char * sq = static_cast<char *>(m_sq_ptr);
+        m_sq_head = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        m_sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        m_sq_mask = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        m_sq_entries = p.sq_entries;
+        m_sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        m_sqe_tail = *m_sq_tail;
+
+        char * cq = static_cast<char *>(m_cq_ptr);
+        m_cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        m_cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        m_cq_mask = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+
+        arm_wake();
+
+        ec = lib::error_code();
+    }
+
+    /// Whether init has set up the ring
+    bool is_initialized() const {
+        return m_ring_fd >= 0;
+    }
+
+    /// Get a cleared submission queue entry
+    /**
+     * Must be called from the loop thread (or before run starts). If the
+     * submission queue is full the queued entries are submitted first. When
+     * entries must be submitted together, for example a linked pair, reserve
+     * room for all of them beforehand.
+     *
+     * @return The entry, or NULL if the queue could not make room.
+     */
+    struct io_uring_sqe * get_sqe() {
+        if (free_sqes() == 0) {
+            submit(0);
+            if (free_sqes() == 0) {
+                return NULL;
+            }
+        }
+
+        unsigned index = m_sqe_tail & m_sq_mask;
+        struct io_uring_sqe * sqe = &m_sqes[index];
+        std::memset(sqe,0,sizeof(*sqe));
+        m_sq_array[index] = index;
+        ++m_sqe_tail;
+        ++m_to_submit;
+        return sqe;
+    }
+
+    /// Make room for n submission queue entries
+    /**
+     * @param n Number of entries that must fit in the queue
+     * @return Whether the room is available
+     */
+    bool reserve(unsigned n) {
+        if (free_sqes() < n) {
+            submit(0);
+        }
+        return free_sqes() >= n;
+    }
+
+    /// Attach an operation to a prepared submission queue entry
+    /**
+     * The service takes ownership of op.
+     *
+     * @param op The operation to notify of completions
+     * @param sqe The entry describing it, obtained from get_sqe
+     */
+    void start(operation * op, struct io_uring_sqe * sqe) {
+        sqe->user_data = reinterpret_cast<__u64>(op);
+        link(op);
+        ++m_outstanding;
+    }
+
+    /// Queue a function to run on the loop thread
+    /**
+     * Safe to call from any thread.
+     *
+     * @param h The function to run
+     */
+    void post(handler h) {
+        if (m_shutdown) {
+            return;
+        }
+        {
+            lib::lock_guard<lib::mutex> lock(m_post_lock);
+            m_posted.push_back(h);
+        }
+        if (!running_in_this_thread()) {
+            wake();
+        }
+    }
+
+    /// Run a function on the loop thread, immediately if already on it
+    /**
+     * Before run has been called the calling thread is treated as the loop
+     * thread.
+     *
+     * @param h The function to run
+     */
+    void dispatch(handler h) {
+        if (m_shutdown) {
+            return;
+        }
+        if (running_in_this_thread() || !m_running) {
+            h();
+        } else {
+            post(h);
+        }
+    }
+
+    /// Whether the calling thread is the one running the loop
+    bool running_in_this_thread() const {
+        return m_running && ::pthread_equal(m_loop_thread,::pthread_self());
+    }
+
+    /// Run the event loop
+    /**
+     * Returns when stop is called, or when there are no operations in flight,
+     * no posted functions, and no outstanding work (see add_work).
+     *
+     * @return The number of completions and posted functions handled
+     */
+    size_t run() {
+        m_loop_thread = ::pthread_self();
+        m_running = true;
+
+        size_t count = 0;
+        while (!m_stopped) {
+            count += run_posted();
+            if (m_stopped) {
+                break;
+            }
+
+            bool posted = has_posted();
+            if (!posted && m_outstanding == 0 && m_work == 0) {
+                break;
+            }
+
+            // Push every entry queued by the handlers that just ran and wait
+            // for at least one completion, unless posted work is waiting.
+            submit(posted ? 0 : 1);
+            count += reap();
+        }
+
+        m_running = false;
+        return count;
+    }
+
+    /// Make run return as soon as possible
+    /**
+     * Safe to call from any thread. Operations in flight stay in flight and
+     * complete when run is called again after reset.
+     */
+    void stop() {
+        m_stopped = true;
+        wake();
+    }
+
+    /// Whether the service has been stopped
+    bool stopped() const {
+        return m_stopped;
+    }
+
+    /// Clear the stopped state so run may be called again
+    void reset() {
+        m_stopped = false;
+    }
+
+    /// Keep run from returning for lack of operations
+    void add_work() {
+        ++m_work;
+    }
+
+    /// Undo a previous add_work
+    void remove_work() {
+        --m_work;
+        wake();
+    }
+
+    /// Call back a function after a period of time
+    /**
+     * Safe to call from any thread. A cancelled timer calls back with
+     * transport::error::operation_aborted, an expired one with no error.
+     *
+     * @param duration Length of time to wait in milliseconds
+     * @param callback The function to call back
+     * @return A handle that can be used to cancel the timer
+     */
+    timer_ptr set_timer(long duration, timer_handler callback);
+private:
+    // non-copyable
+    service(service const &);
+    service & operator=(service const &);
+
+    friend class timer;
+
+    // Reads the eventfd that other threads write to in order to wake the loop
+    class wake_op : public operation {
+    public:
+        void complete(int, unsigned) {}
+    };
+
+    void * map(size_t size, __u64 offset) {
+        void * ptr = ::mmap(NULL,size,PROT_READ|PROT_WRITE,
+            MAP_SHARED|MAP_POPULATE,m_ring_fd,static_cast<off_t>(offset));
+        return ptr == MAP_FAILED ? NULL : ptr;
+    }
+
+    unsigned free_sqes() const {
+        unsigned head = __atomic_load_n(m_sq_head,__ATOMIC_ACQUIRE);
+        return m_sq_entries - (m_sqe_tail - head);
+    }
+
+    void link(operation * op) {
+        op->m_prev = NULL;
+        op->m_next = m_ops;
+        if (m_ops) {
+            m_ops->m_prev = op;
+        }
+        m_ops = op;
+    }
+
+    void unlink(operation * op) {
+        if (op->m_prev) {
+            op->m_prev->m_next = op->m_next;
+        } else {
+            m_ops = op->m_next;
+        }
+        if (op->m_next) {
+            op->m_next->m_prev = op->m_prev;
+        }
+        op->m_prev = op->m_next = NULL;
+    }
+
+    void arm_wake() {
+        struct io_uring_sqe * sqe = get_sqe();
+        if (!sqe) {
+            return;
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = m_wake_fd;
+        sqe->addr = reinterpret_cast<__u64>(&m_wake_value);
+        sqe->len = sizeof(m_wake_value);
+        sqe->off = static_cast<__u64>(-1);
+        sqe->user_data = reinterpret_cast<__u64>(&m_wake_op);
+        m_wake_armed = true;
+    }
+
+    void wake() {
+        if (m_wake_fd >= 0) {
+            uint64_t one = 1;
+            ssize_t r = ::write(m_wake_fd,&one,sizeof(one));
+            (void)r;
+        }
+    }
+
+    bool has_posted() {
+        lib::lock_guard<lib::mutex> lock(m_post_lock);
+        return !m_posted.empty();
+    }
+
+    size_t run_posted() {
+        std::deque<handler> posted;
+        {
+            lib::lock_guard<lib::mutex> lock(m_post_lock);
+            posted.swap(m_posted);
+        }
+        size_t count = posted.size();
+        while (!posted.empty() && !m_stopped) {
+            handler h;
+            h.swap(posted.front());
+            posted.pop_front();
+            h();
+        }
+        if (!posted.empty()) {
+            // stopped part way, keep the rest in order for the next run
+            lib::lock_guard<lib::mutex> lock(m_post_lock);
+            m_posted.insert(m_posted.begin(),posted.begin(),posted.end());
+        }
+        return count - posted.size();
+    }
+
+    void submit(unsigned wait) {
+        __atomic_store_n(m_sq_tail,m_sqe_tail,__ATOMIC_RELEASE);
+
+        if (m_to_submit == 0 && wait == 0) {
+            return;
+        }
+
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+        for (;;) {
+            int r = static_cast<int>(::syscall(__NR_io_uring_enter,m_ring_fd,
+                m_to_submit,wait,flags,NULL,0));
+            if (r >= 0) {
+                m_to_submit -= static_cast<unsigned>(r);
+                return;
+            }
+            if (errno != EINTR) {
+                // EAGAIN/EBUSY: the completion queue needs reaping first
+                return;
+            }
+        }
+    }
+
+    size_t reap() {
+        size_t count = 0;
+        unsigned head = *m_cq_head;
+
+        for (;;) {
+            unsigned tail = __atomic_load_n(m_cq_tail,__ATOMIC_ACQUIRE);
+            if (head == tail) {
+                break;
+            }
+
+            struct io_uring_cqe const & cqe = m_cqes[head & m_cq_mask];
+            __u64 user_data = cqe.user_data;
+            int res = cqe.res;
+            unsigned flags = cqe.flags;
+
+            ++head;
+            __atomic_store_n(m_cq_head,head,__ATOMIC_RELEASE);
+
+            if (user_data == 0) {
+                // completion of a cancel or link timeout request
+                continue;
+            }
+
+            operation * op = reinterpret_cast<operation *>(user_data);
+
+            if (op == &m_wake_op) {
+                m_wake_armed = false;
+                if (!m_shutdown) {
+                    arm_wake();
+                }
+                continue;
+            }
+
+            ++count;
+
+            if (m_shutdown) {
+                op->discard(res);
+                if (!(flags & IORING_CQE_F_MORE)) {
+                    unlink(op);
+                    --m_outstanding;
+                    delete op;
+                }
+                continue;
+            }
+
+            if (flags & IORING_CQE_F_MORE) {
+                op->complete(res,flags);
+                continue;
+            }
+
+            unlink(op);
+            --m_outstanding;
+            try {
+                op->complete(res,flags);
+            } catch (...) {
+                delete op;
+                throw;
+            }
+            delete op;
+        }
+
+        return count;
+    }
+
+    // Cancel everything in flight and wait for the kernel to let go of it,
+    // so that no buffer is written to after its owner has been destroyed.
+    void drain() {
+        if (m_outstanding == 0 && !m_wake_armed) {
+            return;
+        }
+
+        struct io_uring_sqe * sqe = get_sqe();
+        if (!sqe) {
+            return;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+
+        while (m_outstanding > 0 || m_wake_armed) {
+            unsigned before = *m_cq_head;
+            submit(1);
+            reap();
+            if (*m_cq_head == before) {
+                break;
+            }
+        }
+    }
+
+    int                     m_ring_fd;
+    int                     m_wake_fd;
+
+    void *                  m_sq_ptr;
+    size_t                  m_sq_size;
+    void *                  m_cq_ptr;
+    size_t                  m_cq_size;
+    struct io_uring_sqe *   m_sqes;
+    size_t                  m_sqes_size;
+
+    unsigned *              m_sq_head;
+    unsigned *              m_sq_tail;
+    unsigned *              m_sq_array;
+    unsigned                m_sq_mask;
+    unsigned                m_sq_entries;
+    unsigned                m_sqe_tail;
+    unsigned                m_to_submit;
+
+    unsigned *              m_cq_head;
+    unsigned *              m_cq_tail;
+    unsigned                m_cq_mask;
+    struct io_uring_cqe *   m_cqes;
+
+    // Operations in flight, owned by the service
+    operation *             m_ops;
+    size_t                  m_outstanding;
+
+    wake_op                 m_wake_op;
+    uint64_t                m_wake_value;
+    bool                    m_wake_armed;
+
+    lib::mutex              m_post_lock;
+    std::deque<handler>     m_posted;
+
+    lib::atomic<size_t>     m_work;
+    pthread_t               m_loop_thread;
+    lib::atomic<bool>       m_running;
+    lib::atomic<bool>       m_stopped;
+    bool                    m_shutdown;
+};
+
+/// A timer backed by an IORING_OP_TIMEOUT request
+class timer : public lib::enable_shared_from_this<timer> {
+public:
+    /// Cancel the timer
+    /**
+     * Safe to call from any thread. If the timer has not fired yet its
+     * callback is called with transport::error::operation_aborted.
+     */
+    void cancel() {
+        m_service.dispatch(lib::bind(&timer::handle_cancel,shared_from_this()));
+    }
+
+    /// Whether the timer has fired
+    bool expired() const {
+        return m_state == FIRED;
+    }
+private:
+    friend class service;
+
+    enum state {
+        WAITING = 0,
+        ARMED = 1,
+        FIRED = 2,
+        CANCELLED = 3
+    };
+
+    class timeout_op : public operation {
+    public:
+        explicit timeout_op(timer_ptr t) : m_timer(t) {}
+
+        void complete(int res, unsigned) {
+            m_timer->handle_complete(res);
+        }
+    private:
+        timer_ptr m_timer;
+    };
+
+    timer(service & s, timer_handler callback)
+      : m_service(s)
+      , m_callback(callback)
+      , m_op(NULL)
+      , m_state(WAITING) {}
+
+    void start(long duration) {
+        if (m_state == CANCELLED) {
+            finish(make_error_code(transport::error::operation_aborted));
+            return;
+        }
+
+        if (duration < 0) {
+            duration = 0;
+        }
+        m_ts.tv_sec = duration / 1000;
+        m_ts.tv_nsec = (duration % 1000) * 1000000;
+
+        struct io_uring_sqe * sqe = m_service.get_sqe();
+        if (!sqe) {
+            finish(make_error_code(transport::error::general));
+            return;
+        }
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<__u64>(&m_ts);
+        sqe->len = 1;
+
+        m_op = new timeout_op(shared_from_this());
+        m_service.start(m_op,sqe);
+        m_state = ARMED;
+    }
+
+    void handle_cancel() {
+        if (m_state == WAITING) {
+            m_state = CANCELLED;
+        } else if (m_state == ARMED && m_op) {
+            struct io_uring_sqe * sqe = m_service.get_sqe();
+            if (!sqe) {
+                return;
+            }
+            sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<__u64>(m_op);
+        }
+    }
+
+    void handle_complete(int res) {
+        m_op = NULL;
+        if (res == -ETIME) {
+            m_state = FIRED;
+            finish(lib::error_code());
+        } else if (res == -ECANCELED) {
+            m_state = CANCELLED;
+            finish(make_error_code(transport::error::operation_aborted));
+        } else {
+            m_state = CANCELLED;
+            finish(make_error_code(transport::error::pass_through));
+        }
+    }
+
+    void finish(lib::error_code const & ec) {
+        // release whatever the callback holds before it returns
+        timer_handler callback;
+        callback.swap(m_callback);
+        if (callback) {
+            callback(ec);
+        }
+    }
+
+    service &                   m_service;
+    timer_handler               m_callback;
+    operation *                 m_op;
+    struct __kernel_timespec    m_ts;
+    state                       m_state;
+};
+
+inline timer_ptr service::set_timer(long duration, timer_handler callback) {
+    timer_ptr t(new timer(*this,callback));
+    dispatch(lib::bind(&timer::start,t,duration));
+    return t;
+}
+
+} // namespace uring
+} // namespace transport
+} // namespace websocketpp
+
+#endif // WEBSOCKETPP_TRANSPORT_URING_SERVICE_HPP
@@ -32,6 +32,7 @@
 #include <websocketpp/error.hpp>
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -48,26 +49,24 @@ static uint16_t const uri_default_secure_port = 443;
 class uri {
 public:
     explicit uri(std::string const & uri_string) : m_valid(false) {
-        std::string::const_iterator it;
-        std::string::const_iterator temp;
+        // The parts are located first and each member is assigned once from
+        // its range, so parsing allocates no temporaries.
+        std::string::const_iterator it = uri_string.begin();
+        std::string::const_iterator const end = uri_string.end();
 
-        int state = 0;
-
-        it = uri_string.begin();
-
-        if (std::equal(it,it+6,"wss://")) {
+        if (has_prefix(uri_string,"wss://")) {
             m_secure = true;
             m_scheme = "wss";
             it += 6;
-        } else if (std::equal(it,it+5,"ws://")) {
+        } else if (has_prefix(uri_string,"ws://")) {
             m_secure = false;
             m_scheme = "ws";
             it += 5;
-        } else if (std::equal(it,it+7,"http://")) {
+        } else if (has_prefix(uri_string,"http://")) {
             m_secure = false;
             m_scheme = "http";
             it += 7;
-        } else if (std::equal(it,it+8,"https://")) {
+        } else if (has_prefix(uri_string,"https://")) {
             m_secure = true;
             m_scheme = "https";
             it += 8;
@@ -79,37 +78,24 @@ public:
         // either a host string
         // an IPv4 address
         // or an IPv6 address
-        if (*it == '[') {
+        bool has_port = false;
+        if (it != end && *it == '[') {
             ++it;
             // IPv6 literal
             // extract IPv6 digits until ]
-
-            // TODO: this doesn't work on g++... not sure why
-            //temp = std::find(it,it2,']');
-
-            temp = it;
-            while (temp != uri_string.end()) {
-                if (*temp == ']') {
-                    break;
-                }
-                ++temp;
-            }
-
-            if (temp == uri_string.end()) {
+            std::string::const_iterator temp = std::find(it,end,']');
+            if (temp == end) {
                 return;
-            } else {
-                // validate IPv6 literal parts
-                // can contain numbers, a-f and A-F
-                m_host.append(it,temp);
             }
+            m_host.assign(it,temp);
+
             it = temp+1;
-            if (it == uri_string.end()) {
-                state = 2;
+            if (it == end) {
+                // no port or resource
             } else if (*it == '/') {
-                state = 2;
                 ++it;
             } else if (*it == ':') {
-                state = 1;
+                has_port = true;
                 ++it;
             } else {
                 // problem
@@ -118,49 +104,36 @@ public:
         } else {
             // IPv4 or hostname
             // extract until : or /
-            while (state == 0) {
-                if (it == uri_string.end()) {
-                    state = 2;
-                    break;
-                } else if (*it == '/') {
-                    state = 2;
-                } else if (*it == ':') {
-                    // end hostname start port
-                    state = 1;
-                } else {
-                    m_host += *it;
-                }
-                ++it;
+            std::string::const_iterator temp = it;
+            while (temp != end && *temp != ':' && *temp != '/') {
+                ++temp;
             }
-        }
+            m_host.assign(it,temp);
 
-        // parse port
-        std::string port = "";
-        while (state == 1) {
-            if (it == uri_string.end()) {
-                // state is not used after this point presently.
-                // this should be re-enabled if it ever is needed in a future
-                // refactoring
-                //state = 3;
-                break;
-            } else if (*it == '/') {
-                state = 3;
-            } else {
-                port += *it;
+            it = temp;
+            if (it != end) {
+                has_port = (*it == ':');
+                ++it;
             }
-            ++it;
         }
 
+        // parse port
         lib::error_code ec;
-        m_port = get_port_from_string(port, ec);
+        if (has_port) {
+            std::string::const_iterator temp = std::find(it,end,'/');
+            m_port = get_port_from_range(it,temp,ec);
+            it = (temp == end ? end : temp+1);
+        } else {
+            m_port = default_port();
+        }
 
         if (ec) {
             return;
         }
 
+        m_resource.reserve(1+(end-it));
         m_resource = "/";
-        m_resource.append(it,uri_string.end());
-
+        m_resource.append(it,end);
 
         m_valid = true;
     }
@@ -240,19 +213,25 @@ public:
     }
 
     std::string get_host_port() const {
-        if (m_port == (m_secure ? uri_default_secure_port : uri_default_port)) {
+        if (m_port == default_port()) {
             return m_host;
         } else {
-            std::stringstream p;
-            p << m_host << ":" << m_port;
-            return p.str();
+            std::string p;
+            p.reserve(m_host.size()+6);
+            p = m_host;
+            p += ':';
+            append_port(p,m_port);
+            return p;
         }
     }
 
     std::string get_authority() const {
-        std::stringstream p;
-        p << m_host << ":" << m_port;
-        return p.str();
+        std::string p;
+        p.reserve(m_host.size()+6);
+        p = m_host;
+        p += ':';
+        append_port(p,m_port);
+        return p;
     }
 
     uint16_t get_port() const {
@@ -260,9 +239,9 @@ public:
     }
 
     std::string get_port_str() const {
-        std::stringstream p;
-        p << m_port;
-        return p.str();
+        std::string p;
+        append_port(p,m_port);
+        return p;
     }
 
     std::string const & get_resource() const {
@@ -270,16 +249,20 @@ public:
     }
 
     std::string str() const {
-        std::stringstream s;
+        std::string s;
+        s.reserve(m_scheme.size()+3+m_host.size()+6+m_resource.size());
 
-        s << m_scheme << "://" << m_host;
+        s = m_scheme;
+        s += "://";
+        s += m_host;
 
-        if (m_port != (m_secure ? uri_default_secure_port : uri_default_port)) {
-            s << ":" << m_port;
+        if (m_port != default_port()) {
+            s += ':';
+            append_port(s,m_port);
         }
 
-        s << m_resource;
-        return s.str();
+        s += m_resource;
+        return s;
     }
 
     /// Return the query portion
@@ -316,19 +299,56 @@ public:
     void set_port(const std::string& port);
     void set_resource(const std::string& resource);*/
 private:
+    uint16_t default_port() const {
+        return (m_secure ? uri_default_secure_port : uri_default_port);
+    }
+
+    static bool has_prefix(std::string const & s, char const * prefix) {
+        std::string::size_type n = std::strlen(prefix);
+        return s.size() >= n && s.compare(0,n,prefix) == 0;
+    }
+
+    /// Append the decimal digits of a port number
+    static void append_port(std::string & s, uint16_t port) {
+        char digits[5];
+        int n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + port % 10);
+            port /= 10;
+        } while (port);
+        while (n) {
+            s += digits[--n];
+        }
+    }
+
     uint16_t get_port_from_string(std::string const & port, lib::error_code &
         ec) const
+    {
+        return get_port_from_range(port.begin(),port.end(),ec);
+    }
+
+    /// Parse a port number from the leading digits of a range
+    /**
+     * An empty range gives the default port for the scheme. Zero, numbers
+     * above 65535 and ranges that do not start with a digit are invalid.
+     */
+    uint16_t get_port_from_range(std::string::const_iterator begin,
+        std::string::const_iterator end, lib::error_code & ec) const
     {
         ec = lib::error_code();
 
-        if (port == "") {
-            return (m_secure ? uri_default_secure_port : uri_default_port);
+        if (begin == end) {
+            return default_port();
         }
 
-        unsigned int t_port = static_cast<unsigned int>(atoi(port.c_str()));
-
-        if (t_port > 65535) {
-            ec = error::make_error_code(error::invalid_port);
+        unsigned long t_port = 0;
+        std::string::const_iterator it = begin;
+        for (; it != end && *it >= '0' && *it <= '9'; ++it) {
+            t_port = t_port * 10 + static_cast<unsigned long>(*it - '0');
+            if (t_port > 65535) {
+                ec = error::make_error_code(error::invalid_port);
+                return 0;
+            }
         }
 
         if (t_port == 0) {
@@ -31,6 +31,15 @@
 
 #include <websocketpp/common/stdint.hpp>
 
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define _WEBSOCKETPP_SSE2_UTF8_
+#endif
+
 namespace websocketpp {
 namespace utf8_validator {
 
@@ -75,6 +84,39 @@ inline uint32_t decode(uint32_t * state, uint32_t * codep, uint8_t byte) {
   return *state;
 }
 
+/// Count the leading run of ASCII bytes in a buffer
+/**
+ * Scans 16 bytes at a time with SSE2 where available, then 8 bytes at a time,
+ * and stops at the first block containing a byte with the high bit set. The
+ * count covers whole blocks only, so a few trailing ASCII bytes may be left
+ * for the caller's byte by byte path.
+ *
+ * @param [in] data The bytes to scan
+ * @param [in] len The number of bytes available
+ * @return The number of leading bytes known to be ASCII
+ */
+inline size_t ascii_prefix(uint8_t const * data, size_t len) {
+    size_t i = 0;
+
+#ifdef _WEBSOCKETPP_SSE2_UTF8_
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data+i));
+        if (_mm_movemask_epi8(v) != 0) {
+            return i;
+        }
+    }
+#endif
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        std::memcpy(&w,data+i,8);
+        if (w & 0x8080808080808080ull) {
+            break;
+        }
+    }
+    return i;
+}
+
 /// Provides streaming UTF8 validation functionality
 class validator {
 public:
@@ -115,6 +157,59 @@ public:
         return true;
     }
 
+    /// Advance validator state with a contiguous range of bytes
+    /**
+     * Whenever the decoder is between codepoints and the next byte is ASCII,
+     * the run of ASCII bytes that follows is skipped in blocks instead of
+     * being stepped through the state machine. The result is identical to the
+     * byte by byte decoder, including when a sequence is split across calls.
+     *
+     * @param begin Pointer to the first byte of the input
+     * @param end Pointer one past the last byte of the input
+     * @return Whether or not decoding the bytes resulted in a validation error.
+     */
+    bool decode (uint8_t const * begin, uint8_t const * end) {
+        uint8_t const * it = begin;
+        while (it != end) {
+            if (m_state == utf8_accept && *it < 0x80) {
+                size_t n = ascii_prefix(it,static_cast<size_t>(end-it));
+                if (n) {
+                    it += n;
+                    m_codepoint = *(it-1);
+                    continue;
+                }
+            }
+
+            if (utf8_validator::decode(&m_state,&m_codepoint,*it)
+                == utf8_reject)
+            {
+                return false;
+            }
+            ++it;
+        }
+        return true;
+    }
+
+    /// Advance validator state with a range of a std::string
+    /**
+     * Forwards to the contiguous overload so strings get the ASCII fast path.
+     */
+    bool decode (std::string::const_iterator begin,
+        std::string::const_iterator end)
+    {
+        if (begin == end) {
+            return true;
+        }
+        uint8_t const * b = reinterpret_cast<uint8_t const *>(&*begin);
+        return decode(b,b+(end-begin));
+    }
+
+    /// Advance validator state with a range of a mutable std::string
+    bool decode (std::string::iterator begin, std::string::iterator end) {
+        return decode(std::string::const_iterator(begin),
+            std::string::const_iterator(end));
+    }
+
     /// Return whether the input sequence ended on a valid utf8 codepoint
     /**
      * @return Whether or not the input sequence ended on a valid codepoint.
@@ -89,6 +89,31 @@ struct ci_less : std::binary_function<std::string, std::string, bool> {
     }
 };
 
+/// Compare two byte ranges of equal length, ignoring ASCII case
+/**
+ * Used for HTTP header names, which are ASCII tokens, so no locale is
+ * consulted.
+ *
+ * @param [in] s1 The first range
+ * @param [in] s2 The second range
+ * @param [in] len The length of both ranges
+ * @return Whether the ranges are equal when both are converted to lowercase
+ */
+inline bool ci_equal(char const * s1, char const * s2, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c1 = static_cast<unsigned char>(s1[i]);
+        unsigned char c2 = static_cast<unsigned char>(s2[i]);
+        if (c1 != c2) {
+            if (c1 >= 'A' && c1 <= 'Z') { c1 += 'a' - 'A'; }
+            if (c2 >= 'A' && c2 <= 'Z') { c2 += 'a' - 'A'; }
+            if (c1 != c2) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 /// Find substring (case insensitive)
 /**
  * @param [in] haystack The string to search in